@@ -0,0 +1,594 @@
+#!/usr/bin/env python3
+"""
+BLE Benchmark for Zobo ESP32
+Drives the robot over its BLE command protocol and measures it, so
+firmware releases can be compared with the same numbers.
+
+Usage:
+  python bench.py rtt                          # 1000 drive frames at 20 Hz, RTT percentiles
+  python bench.py rtt --rate 50 --count 5000   # Sustained write rate
+  python bench.py rtt --ack cumulative         # Cumulative acks (delivery only, RTT of last seq)
+  python bench.py rtt --protocol legacy        # Text opcodes (CMD_STOP) answered with "OK"
+  python bench.py soak --minutes 60            # Long run, one summary row per --window
+  python bench.py soak --wifi-cycle 30         # ... while WiFi connects / disconnects every 30 s
+  python bench.py soak --wifi-fetch URL        # ... while the robot fetches URL every --wifi-period s
+  python bench.py ota --url URL                # Time a WiFi update (installs it!)
+  python bench.py ota --file build/zobo_esp32.zota  # Time a BLE transfer (installs it!)
+
+Common options:
+  --address XX:XX:..   Connect to this device instead of scanning for "Zobo"
+  --json FILE          Write the summary as JSON
+  --csv FILE           Write one row per command (rtt/soak)
+
+Drive frames carry --speed (0 by default), lift the wheels before using
+anything else. Device counters (latency histograms, loop timing, watchdog)
+are reset at the start and read back into the summary at the end.
+"""
+
+import argparse
+import asyncio
+import csv
+import json
+import struct
+import sys
+import time
+from datetime import datetime
+from pathlib import Path
+
+try:
+    from bleak import BleakClient, BleakScanner
+except ImportError:
+    print("Installing bleak...")
+    import subprocess
+    subprocess.check_call([sys.executable, "-m", "pip", "install", "bleak"])
+    from bleak import BleakClient, BleakScanner
+
+DEVICE_NAME = "Zobo"
+
+# Nordic UART Service (ble_service.c)
+RX_UUID = "6e400002-b5a3-f393-e0a9-e50e24dcca9e"
+TX_UUID = "6e400003-b5a3-f393-e0a9-e50e24dcca9e"
+OTA_UUID = "6e400004-b5a3-f393-e0a9-e50e24dcca9e"
+
+# Commands (main.c)
+CMD_STOP = 0x02
+CMD_WIFI_CONNECT = 0x51
+CMD_WIFI_DISCONNECT = 0x52
+CMD_OTA_UPDATE = 0x60
+CMD_OTA_CHECK = 0x61
+CMD_GET_VERSION = 0x62
+CMD_GET_LOOP_STATS = 0x64
+CMD_GET_LATENCY = 0x65
+CMD_GET_MEMORY = 0x66
+CMD_CONN_PARAMS = 0x67
+CMD_BLE_OTA = 0x68
+CMD_SET_ACK_MODE = 0x71
+CMD_WATCHDOG = 0x7A
+CMD_MOTOR_FRAME = 0x80
+
+# Binary drive frame (motor_frame.h)
+MOTOR_FRAME_VERSION = 1
+MOTOR_FRAME_FLAG_TIMESTAMP = 0x01
+
+# ble_ack_mode_t (ble_service.h)
+ACK_MODES = {"legacy": 0, "none": 1, "per-seq": 2, "cumulative": 3}
+CONN_PROFILES = {"idle": 0, "normal": 1, "driving": 2, "auto": 0xFF}
+
+# BLE OTA (ble_ota.h)
+BLE_OTA_BEGIN = 0x01
+BLE_OTA_END = 0x02
+BLE_OTA_ABORT = 0x03
+BLE_OTA_ACK = 0x01
+BLE_OTA_NACK = 0x02
+BLE_OTA_ACK_TIMEOUT_S = 1.0
+BLE_OTA_STALL_TIMEOUT_S = 10.0
+
+def percentile(sorted_values, p):
+    """Nearest-rank percentile of an already sorted list."""
+    if not sorted_values:
+        return None
+    rank = max(1, int(round(p / 100 * len(sorted_values))))
+    return sorted_values[min(rank, len(sorted_values)) - 1]
+
+def rtt_summary(rtts):
+    """p50/p90/p99/max/mean of RTTs in ms."""
+    values = sorted(rtts)
+    if not values:
+        return {}
+    return {
+        "n": len(values),
+        "p50": round(percentile(values, 50), 2),
+        "p90": round(percentile(values, 90), 2),
+        "p99": round(percentile(values, 99), 2),
+        "max": round(values[-1], 2),
+        "mean": round(sum(values) / len(values), 2),
+    }
+
+class Link:
+    """Connection to the robot: writes commands, splits and routes replies."""
+
+    def __init__(self, client):
+        self.client = client
+        self.t0 = time.perf_counter()
+        self.lines = []             # (t, line) of every non-ack reply
+        self.waiters = []           # (prefix, future)
+        self.on_ack = None          # Called with (t, fields) for ACK: lines
+        self.on_ok = None           # Called with t for OK lines
+        self.on_ota = None          # Called with raw OTA characteristic notifications
+
+    def now(self):
+        return time.perf_counter() - self.t0
+
+    async def start(self):
+        await self.client.start_notify(TX_UUID, self._on_tx)
+
+    async def start_ota(self, callback):
+        self.on_ota = callback
+        await self.client.start_notify(OTA_UUID, self._on_ota)
+
+    def _on_tx(self, _sender, data):
+        t = self.now()
+        for line in bytes(data).decode("utf-8", errors="replace").split("\n"):
+            if not line:
+                continue
+            if line.startswith("ACK:") and self.on_ack:
+                self.on_ack(t, line[4:].split(":"))
+                continue
+            if line == "OK" and self.on_ok:
+                self.on_ok(t)
+                continue
+            self.lines.append((t, line))
+            for waiter in list(self.waiters):
+                prefix, future = waiter
+                if line.startswith(prefix) and not future.done():
+                    future.set_result(line)
+                    self.waiters.remove(waiter)
+
+    def _on_ota(self, _sender, data):
+        if self.on_ota:
+            self.on_ota(bytes(data))
+
+    async def write(self, data, response=True):
+        await self.client.write_gatt_char(RX_UUID, bytes(data), response=response)
+
+    def expect(self, prefix):
+        """Future for the next reply starting with prefix (register before writing)."""
+        future = asyncio.get_running_loop().create_future()
+        self.waiters.append((prefix, future))
+        return future
+
+    async def request(self, data, prefix, timeout=5.0):
+        """Send a command and wait for its reply line (None on timeout)."""
+        reply = self.expect(prefix)
+        await self.write(data)
+        try:
+            return await asyncio.wait_for(reply, timeout)
+        except asyncio.TimeoutError:
+            return None
+
+    async def request_lines(self, data, prefixes, settle=0.5):
+        """Send a command and collect every reply matching prefixes for settle seconds."""
+        start = len(self.lines)
+        await self.write(data)
+        await asyncio.sleep(settle)
+        return [line for _, line in self.lines[start:] if line.startswith(tuple(prefixes))]
+
+async def connect(address):
+    """Find the robot and open a Link."""
+    if address:
+        device = address
+    else:
+        print(f"Scanning for {DEVICE_NAME}...")
+        device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=10.0)
+        if device is None:
+            print(f"ERROR: {DEVICE_NAME} not found")
+            sys.exit(1)
+    client = BleakClient(device)
+    await client.connect()
+    link = Link(client)
+    await link.start()
+    print(f"Connected to {client.address}")
+    return link
+
+async def read_device_info(link):
+    """Firmware version and link parameters."""
+    return {
+        "version": await link.request([CMD_GET_VERSION], "VERSION:"),
+        "conn": await link.request([CMD_CONN_PARAMS], "CONN:"),
+    }
+
+async def reset_device_counters(link):
+    await link.request([CMD_GET_LOOP_STATS, 1], "LOOP:")
+    await link.request_lines([CMD_GET_LATENCY, 1], ["LAT:"])
+    await link.request([CMD_WATCHDOG, 1], "WDOG:")
+
+async def read_device_counters(link):
+    """What the firmware saw during the run."""
+    return {
+        "loop": await link.request([CMD_GET_LOOP_STATS], "LOOP:"),
+        "latency": await link.request_lines([CMD_GET_LATENCY], ["LAT:"]),
+        "watchdog": await link.request([CMD_WATCHDOG], "WDOG:"),
+        "memory": await link.request_lines([CMD_GET_MEMORY], ["MEM:", "STACK:"]),
+    }
+
+class CommandTracker:
+    """Send time and outcome per command; matches acks back to sends."""
+
+    def __init__(self, link, deadline_ms, legacy=False):
+        self.link = link
+        self.deadline_ms = deadline_ms
+        self.legacy = legacy
+        self.samples = []           # [seq, sent, rtt_ms or None]
+        self.by_seq = {}            # wire seq (u16) -> sample, while unacked
+        self.fifo = []              # Legacy: unanswered samples in send order
+        self.write_errors = 0
+        link.on_ack = self._on_ack
+        link.on_ok = self._on_ok
+
+    def sent(self, seq, t):
+        sample = [seq, t, None]
+        self.samples.append(sample)
+        if self.legacy:
+            self.fifo.append(sample)
+        else:
+            self.by_seq[seq & 0xFFFF] = sample
+
+    def _done(self, sample, t):
+        if sample[2] is None:
+            sample[2] = (t - sample[1]) * 1000
+
+    def _on_ack(self, t, fields):
+        try:
+            last = int(fields[0])
+        except ValueError:
+            return
+        sample = self.by_seq.pop(last, None)
+        if sample is None:
+            return
+        self._done(sample, t)
+        if len(fields) > 1:
+            # Cumulative: everything sent before the last seq got through,
+            # only the last one has a meaningful RTT
+            for other in [s for s in self.by_seq.values() if s[0] < sample[0]]:
+                other[2] = 0.0 if other[2] is None else other[2]
+                del self.by_seq[other[0] & 0xFFFF]
+
+    def _on_ok(self, t):
+        if self.fifo:
+            self._done(self.fifo.pop(0), t)
+
+    def summary(self, samples=None, cumulative=False):
+        samples = self.samples if samples is None else samples
+        acked = [s for s in samples if s[2] is not None]
+        # Cumulative acks only time the last frame of each batch
+        rtts = [s[2] for s in acked if not (cumulative and s[2] == 0.0)]
+        return {
+            "sent": len(samples),
+            "acked": len(acked),
+            "dropped": len(samples) - len(acked),
+            "late": sum(1 for r in rtts if r > self.deadline_ms),
+            "rtt_ms": rtt_summary(rtts),
+        }
+
+def motor_frame(seq, t_ms, speed):
+    """Single-setpoint CMD_MOTOR_FRAME with a sender timestamp."""
+    return struct.pack("<BBBBHHIhh", CMD_MOTOR_FRAME, MOTOR_FRAME_VERSION,
+                       MOTOR_FRAME_FLAG_TIMESTAMP, 1, seq & 0xFFFF, 0,
+                       t_ms & 0xFFFFFFFF, speed, speed)
+
+async def drive(link, tracker, args, stop_at, on_tick=None):
+    """Send commands at args.rate until stop_at (link time) or args.count."""
+    period = 1.0 / args.rate
+    next_t = link.now()
+    seq = 0
+    while (args.count == 0 or seq < args.count) and link.now() < stop_at:
+        if args.protocol == "frame":
+            data = motor_frame(seq, int(link.now() * 1000), args.speed)
+        else:
+            data = [CMD_STOP]
+        tracker.sent(seq, link.now())
+        try:
+            await link.write(data, response=args.write_response)
+        except Exception:
+            tracker.write_errors += 1
+        seq += 1
+        if on_tick:
+            await on_tick()
+
+        next_t += period
+        delay = next_t - link.now()
+        if delay > 0:
+            await asyncio.sleep(delay)
+        else:
+            # Fell behind - don't burst to catch up
+            next_t = link.now()
+    # Stragglers
+    await asyncio.sleep(args.timeout)
+
+async def prepare_link(link, args):
+    info = await read_device_info(link)
+    print(f"  {info['version']}  {info['conn']}")
+    await link.request([CMD_CONN_PARAMS, CONN_PROFILES[args.profile]], "CONN:")
+    ack = "legacy" if args.protocol == "legacy" else args.ack
+    interval = args.ack_interval
+    reply = await link.request([CMD_SET_ACK_MODE, ACK_MODES[ack], interval & 0xFF, interval >> 8],
+                               "ACK_MODE:")
+    await reset_device_counters(link)
+    # Give the connection update time to land before reading it back
+    await asyncio.sleep(1.0)
+    info["conn"] = await link.request([CMD_CONN_PARAMS], "CONN:")
+    info["ack_mode"] = reply
+    print(f"  {info['conn']}  {reply}")
+    return info
+
+def print_summary(name, result):
+    rtt = result["rtt_ms"]
+    line = (f"  {name:<10} sent={result['sent']:>7} acked={result['acked']:>7} "
+            f"dropped={result['dropped']:>5} late={result['late']:>5}")
+    if rtt:
+        line += f"  rtt p50={rtt['p50']:.1f} p90={rtt['p90']:.1f} p99={rtt['p99']:.1f} max={rtt['max']:.1f} ms"
+    print(line)
+
+def write_csv(path, samples):
+    with open(path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["seq", "sent_s", "rtt_ms"])
+        for seq, sent, rtt in samples:
+            writer.writerow([seq, f"{sent:.6f}", "" if rtt is None else f"{rtt:.3f}"])
+    print(f"Samples written to {path}")
+
+def write_json(path, report):
+    Path(path).write_text(json.dumps(report, indent=2))
+    print(f"Summary written to {path}")
+
+def base_report(mode, args, info):
+    return {
+        "mode": mode,
+        "timestamp": datetime.now().isoformat(timespec="seconds"),
+        "device": info,
+        "config": {k: v for k, v in vars(args).items() if k not in ("json", "csv", "func")},
+    }
+
+async def run_rtt(args):
+    link = await connect(args.address)
+    try:
+        info = await prepare_link(link, args)
+        tracker = CommandTracker(link, args.deadline_ms, args.protocol == "legacy")
+        print(f"Sending {args.count} commands at {args.rate} Hz...")
+        start = link.now()
+        await drive(link, tracker, args, float("inf"))
+        elapsed = link.now() - start - args.timeout
+
+        result = tracker.summary(cumulative=args.ack == "cumulative")
+        result["write_errors"] = tracker.write_errors
+        result["rate_hz"] = round(result["sent"] / elapsed, 2) if elapsed > 0 else 0
+        print_summary("rtt", result)
+
+        report = base_report("rtt", args, info)
+        report["result"] = result
+        report["counters"] = await read_device_counters(link)
+        if args.csv:
+            write_csv(args.csv, tracker.samples)
+        if args.json:
+            write_json(args.json, report)
+    finally:
+        await link.client.disconnect()
+
+async def run_soak(args):
+    link = await connect(args.address)
+    try:
+        info = await prepare_link(link, args)
+        tracker = CommandTracker(link, args.deadline_ms, args.protocol == "legacy")
+        args.count = 0
+        start = link.now()
+        stop_at = start + args.minutes * 60
+        windows = []
+        state = {"window_start": start, "window_first": 0, "wifi_at": start, "wifi_up": False}
+
+        async def wifi_activity():
+            # Fire and forget - replies land in link.lines
+            if args.wifi_cycle:
+                state["wifi_up"] = not state["wifi_up"]
+                await link.write([CMD_WIFI_CONNECT if state["wifi_up"] else CMD_WIFI_DISCONNECT])
+            if args.wifi_fetch:
+                await link.write([CMD_OTA_CHECK] + list(args.wifi_fetch.encode()) + [0])
+
+        async def on_tick():
+            now = link.now()
+            wifi_period = args.wifi_cycle or (args.wifi_period if args.wifi_fetch else 0)
+            if wifi_period and now - state["wifi_at"] >= wifi_period:
+                state["wifi_at"] = now
+                await wifi_activity()
+            if now - state["window_start"] >= args.window:
+                # Leave the last timeout's worth of sends out, their acks may still come
+                cutoff = now - args.timeout
+                samples = [s for s in tracker.samples[state["window_first"]:] if s[1] < cutoff]
+                row = tracker.summary(samples, cumulative=args.ack == "cumulative")
+                row["t_s"] = round(now - start, 1)
+                row["wifi_up"] = state["wifi_up"]
+                windows.append(row)
+                print_summary(f"{row['t_s']:.0f}s", row)
+                state["window_start"] = now
+                state["window_first"] += len(samples)
+
+        print(f"Soak for {args.minutes} min at {args.rate} Hz...")
+        await drive(link, tracker, args, stop_at, on_tick)
+        if state["wifi_up"]:
+            await link.write([CMD_WIFI_DISCONNECT])
+
+        result = tracker.summary(cumulative=args.ack == "cumulative")
+        result["write_errors"] = tracker.write_errors
+        result["wifi_replies"] = sum(1 for _, line in link.lines if line.startswith(("WIFI:", "OTA:")))
+        print_summary("total", result)
+
+        report = base_report("soak", args, info)
+        report["result"] = result
+        report["windows"] = windows
+        report["counters"] = await read_device_counters(link)
+        if args.csv:
+            write_csv(args.csv, tracker.samples)
+        if args.json:
+            write_json(args.json, report)
+    finally:
+        await link.client.disconnect()
+
+async def ble_transfer(link, image):
+    """Stream image over the OTA characteristic (same protocol as the app)."""
+    reply = await link.request([CMD_BLE_OTA, BLE_OTA_BEGIN] + list(struct.pack("<I", len(image))),
+                               "BOTA:", timeout=10.0)
+    parts = (reply or "BOTA:ERR:No reply").split(":")
+    if len(parts) < 4 or parts[1] != "READY":
+        raise RuntimeError(":".join(parts[1:]))
+    window, payload = int(parts[2]), int(parts[3])
+    packets = (len(image) + payload - 1) // payload
+    print(f"  {len(image)} bytes in {packets} packets, window {window}, payload {payload}")
+
+    # Packet numbers are absolute here, the wire carries the low 16 bits
+    state = {"acked": 0, "next": 0, "progress": time.perf_counter(), "nacks": 0}
+    wake = asyncio.Event()
+
+    def on_ota(data):
+        if len(data) < 3:
+            return
+        seq = data[1] | (data[2] << 8)
+        packet = state["acked"] + ((seq - state["acked"]) & 0xFFFF)
+        if data[0] == BLE_OTA_ACK and packet > state["acked"]:
+            state["acked"] = packet
+            state["next"] = max(state["next"], packet)
+            state["progress"] = time.perf_counter()
+        elif data[0] == BLE_OTA_NACK:
+            state["next"] = packet
+            state["nacks"] += 1
+        wake.set()
+
+    await link.start_ota(on_ota)
+    try:
+        while state["acked"] < packets:
+            if state["next"] < packets and state["next"] - state["acked"] < window:
+                n = state["next"]
+                chunk = image[n * payload:(n + 1) * payload]
+                await link.client.write_gatt_char(OTA_UUID, struct.pack("<H", n & 0xFFFF) + chunk,
+                                                  response=False)
+                state["next"] = n + 1
+                continue
+
+            # Window full - wait for an ack, rewind if none comes
+            wake.clear()
+            try:
+                await asyncio.wait_for(wake.wait(), BLE_OTA_ACK_TIMEOUT_S)
+            except asyncio.TimeoutError:
+                if time.perf_counter() - state["progress"] >= BLE_OTA_ACK_TIMEOUT_S:
+                    state["next"] = state["acked"]
+            if time.perf_counter() - state["progress"] > BLE_OTA_STALL_TIMEOUT_S:
+                raise RuntimeError("No progress")
+    except Exception:
+        await link.write([CMD_BLE_OTA, BLE_OTA_ABORT])
+        raise
+    await link.write([CMD_BLE_OTA, BLE_OTA_END])
+    return state["nacks"]
+
+async def run_ota(args):
+    link = await connect(args.address)
+    try:
+        info = await read_device_info(link)
+        print(f"  {info['version']}  {info['conn']}")
+        await link.request([CMD_CONN_PARAMS, CONN_PROFILES[args.profile]], "CONN:")
+
+        done = link.expect("OTA:100:Update complete")
+        failed = link.expect("OTA:-1:")
+        start = link.now()
+        result = {"transport": "ble" if args.file else "wifi"}
+        if args.file:
+            image = Path(args.file).read_bytes()
+            result["bytes"] = len(image)
+            print(f"BLE transfer of {args.file}...")
+            result["nacks"] = await ble_transfer(link, image)
+            result["transfer_s"] = round(link.now() - start, 2)
+        else:
+            # The OTA task may report progress before the STARTED reply
+            started = link.expect("OTA:STARTED")
+            refused = link.expect("OTA:ERR:")
+            await link.write([CMD_OTA_UPDATE] + list(args.url.encode()) + [0])
+            reply, _ = await asyncio.wait([started, refused], timeout=5.0,
+                                          return_when=asyncio.FIRST_COMPLETED)
+            if not reply or refused in reply:
+                raise RuntimeError(refused.result() if refused.done() else "No reply")
+            print(f"WiFi update from {args.url}...")
+
+        finished, _ = await asyncio.wait([done, failed], timeout=args.ota_timeout,
+                                         return_when=asyncio.FIRST_COMPLETED)
+        result["total_s"] = round(link.now() - start, 2)
+        result["status"] = next(iter(finished)).result() if finished else "timeout"
+        result["progress"] = [(round(t - start, 2), line) for t, line in link.lines
+                              if t >= start and line.startswith(("OTA:", "OTASTAT:"))]
+        if "bytes" in result and result.get("transfer_s"):
+            result["bytes_per_sec"] = int(result["bytes"] / result["transfer_s"])
+        print(f"  {result['status']} after {result['total_s']} s")
+
+        report = base_report("ota", args, info)
+        report["result"] = result
+        if args.json:
+            write_json(args.json, report)
+    finally:
+        # The robot restarts into the new image and drops the link
+        try:
+            await link.client.disconnect()
+        except Exception:
+            pass
+
+def main():
+    parser = argparse.ArgumentParser(description="BLE benchmark for Zobo ESP32")
+    parser.add_argument("--address", help="Device address (default: scan for Zobo)")
+    parser.add_argument("--json", help="Write the summary to this JSON file")
+    parser.add_argument("--csv", help="Write per-command samples to this CSV file")
+    parser.add_argument("--profile", choices=CONN_PROFILES, default="driving",
+                        help="Connection profile requested before the run")
+    sub = parser.add_subparsers(dest="mode", required=True)
+
+    def drive_options(p):
+        p.add_argument("--rate", type=float, default=20.0, help="Commands per second")
+        p.add_argument("--protocol", choices=["frame", "legacy"], default="frame",
+                       help="Binary drive frames or text opcodes (CMD_STOP)")
+        p.add_argument("--ack", choices=["per-seq", "cumulative"], default="per-seq",
+                       help="Ack mode for frames")
+        p.add_argument("--ack-interval", type=int, default=100, help="Cumulative ack interval, ms")
+        p.add_argument("--speed", type=int, default=0, help="Setpoint carried by frames (-32767..32767)")
+        p.add_argument("--write-response", action="store_true", help="Write with response")
+        p.add_argument("--deadline-ms", type=float, default=100.0, help="RTT above this counts as late")
+        p.add_argument("--timeout", type=float, default=1.0, help="No ack after this counts as dropped, s")
+
+    p = sub.add_parser("rtt", help="Round-trip latency and sustained rate")
+    drive_options(p)
+    p.add_argument("--count", type=int, default=1000, help="Commands to send")
+    p.set_defaults(func=run_rtt)
+
+    p = sub.add_parser("soak", help="Long run, optionally with WiFi activity")
+    drive_options(p)
+    p.add_argument("--minutes", type=float, default=10.0, help="Run length")
+    p.add_argument("--window", type=float, default=60.0, help="Summary row every this many s")
+    p.add_argument("--wifi-cycle", type=float, default=0, help="Toggle WiFi connect/disconnect every s")
+    p.add_argument("--wifi-fetch", help="Have the robot fetch this URL (CMD_OTA_CHECK) periodically")
+    p.add_argument("--wifi-period", type=float, default=10.0, help="Fetch period, s")
+    p.set_defaults(func=run_soak)
+
+    p = sub.add_parser("ota", help="Time a firmware update")
+    source = p.add_mutually_exclusive_group(required=True)
+    source.add_argument("--url", help="WiFi update from this URL")
+    source.add_argument("--file", help="BLE transfer of this .bin / .zota")
+    p.add_argument("--ota-timeout", type=float, default=600.0, help="Give up after this many s")
+    p.set_defaults(func=run_ota)
+
+    args = parser.parse_args()
+    if getattr(args, "speed", 0) and abs(args.speed) > 32767:
+        parser.error("--speed out of range")
+
+    try:
+        asyncio.run(args.func(args))
+    except KeyboardInterrupt:
+        print("\nBenchmark stopped.")
+    except Exception as e:
+        print(f"\nERROR: {e}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
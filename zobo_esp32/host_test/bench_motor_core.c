@@ -0,0 +1,243 @@
+/**
+ * Motor Control Core - Microbenchmark
+ *
+ * Per-tick cost of the control core (intent pickup, ramp, playback,
+ * watchdog, closed loop, status) at several loop rates and for each ramp
+ * profile. The clock is simulated, so every rate sees exactly the same
+ * sequence of work; only the wall time spent in the core is measured.
+ *
+ * Host numbers rank profiles and rates against each other. For an
+ * estimate on the target pass --scale with the ESP32 / host slowdown
+ * (measure it once with the same build on both); budget is then the p99
+ * tick as a share of the tick period.
+ *
+ * Usage:
+ *   bench_motor_core                  10 s per scenario and rate
+ *   bench_motor_core --seconds 30
+ *   bench_motor_core --scale 40       estimate target cost
+ *   bench_motor_core --quick          smoke run (ctest)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim_hal.h"
+
+#define INTENT_PERIOD_MS    20      // App joystick stream, 50 Hz
+#define RAMP_CYCLE_MS       3500    // Forward for 2.5 s, then stop
+#define RAMP_FORWARD_MS     2500
+#define PLAYBACK_INTERVAL   10
+
+typedef enum {
+    SCENARIO_HOLD,          // Steady speed stream, watchdog fed
+    SCENARIO_RAMP,          // Forward ramp + stop in software
+    SCENARIO_HW_FADE,       // Same, handed to the fade engine
+    SCENARIO_PLAYBACK,      // Full setpoint batches
+    SCENARIO_CLOSED_LOOP,   // Speed stream with PID on both wheels
+} scenario_t;
+
+typedef struct {
+    const char *name;
+    scenario_t scenario;
+    ramp_profile_id_t profile;
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "hold", SCENARIO_HOLD, RAMP_PROFILE_LINEAR },
+    { "ramp-linear", SCENARIO_RAMP, RAMP_PROFILE_LINEAR },
+    { "ramp-s-curve", SCENARIO_RAMP, RAMP_PROFILE_S_CURVE },
+    { "ramp-exponential", SCENARIO_RAMP, RAMP_PROFILE_EXPONENTIAL },
+    { "hw-fade", SCENARIO_HW_FADE, RAMP_PROFILE_S_CURVE },
+    { "playback", SCENARIO_PLAYBACK, RAMP_PROFILE_LINEAR },
+    { "closed-loop", SCENARIO_CLOSED_LOOP, RAMP_PROFILE_LINEAR },
+};
+
+static const uint32_t rates_hz[] = { 100, 250, 500, 1000 };
+
+static volatile int32_t sink;       // Keeps the optimizer honest
+
+static inline int64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Cost of the timing itself, subtracted from every sample
+static int64_t timer_overhead_ns(void)
+{
+    enum { N = 10001 };
+    static int64_t samples[N];
+    for (int i = 0; i < N; i++) {
+        int64_t t0 = wall_ns();
+        samples[i] = wall_ns() - t0;
+    }
+    qsort(samples, N, sizeof(samples[0]), cmp_i64);
+    return samples[N / 2];
+}
+
+// Intent the scenario's sender would have posted at t_ms, if any
+static bool next_intent(const bench_case_t *bc, uint32_t t_ms, uint16_t seq, motor_intent_t *intent)
+{
+    memset(intent, 0, sizeof(*intent));
+    intent->flags = MOTOR_INTENT_FLAG_SEQ;
+    intent->seq = seq;
+    intent->count = 1;
+
+    switch (bc->scenario) {
+        case SCENARIO_RAMP:
+        case SCENARIO_HW_FADE: {
+            uint32_t phase_ms = t_ms % RAMP_CYCLE_MS;
+            if (phase_ms < RAMP_FORWARD_MS) {
+                intent->type = MOTOR_INTENT_FORWARD;
+                return t_ms % INTENT_PERIOD_MS == 0;
+            }
+            intent->type = MOTOR_INTENT_STOP;
+            return phase_ms == RAMP_FORWARD_MS;
+        }
+
+        case SCENARIO_PLAYBACK:
+            intent->type = MOTOR_INTENT_SETPOINTS;
+            intent->count = MOTOR_MAX_SETPOINTS;
+            intent->interval_ms = PLAYBACK_INTERVAL;
+            for (int i = 0; i < MOTOR_MAX_SETPOINTS; i++) {
+                intent->setpoints[i].left = (int16_t)(i * 1000);
+                intent->setpoints[i].right = (int16_t)(-i * 1000);
+            }
+            return t_ms % (MOTOR_MAX_SETPOINTS * PLAYBACK_INTERVAL) == 0;
+
+        default:
+            intent->type = MOTOR_INTENT_SET_SPEED;
+            intent->setpoints[0].left = (int16_t)(12000 + (t_ms / INTENT_PERIOD_MS % 8) * 1000);
+            intent->setpoints[0].right = 12000;
+            return t_ms % INTENT_PERIOD_MS == 0;
+    }
+}
+
+typedef struct {
+    uint32_t ticks;
+    int64_t mean_ns;
+    int64_t p99_ns;
+    int64_t max_ns;
+} result_t;
+
+static void run_case(const bench_case_t *bc, uint32_t rate_hz, uint32_t seconds,
+                     int64_t overhead_ns, result_t *result)
+{
+    sim_hal_t sim;
+    motor_hal_t hal;
+    motor_core_t core;
+    motor_intent_t intent;
+    motor_status_t status;
+
+    sim_hal_init(&sim, &hal);
+    motor_core_init(&core, &hal);
+    if (bc->scenario == SCENARIO_HW_FADE) {
+        sim.fade_polls = rate_hz;   // About a second per fade
+    }
+
+    motor_ramp_config_t config = {
+        .accel_profile = bc->profile,
+        .accel_ms = 2000,
+        .decel_profile = bc->profile,
+        .decel_ms = 500,
+    };
+    motor_core_set_ramp_config(&core, &config);
+    if (bc->scenario == SCENARIO_CLOSED_LOOP) {
+        sim.efficiency_q8 = 220;
+        motor_core_set_closed_loop(&core, true, NULL, rate_hz);
+    }
+
+    uint32_t ticks = seconds * rate_hz;
+    int64_t period_us = 1000000 / rate_hz;
+    int64_t *samples = malloc(ticks * sizeof(*samples));
+    int64_t total_ns = 0;
+    uint32_t sent_ms = UINT32_MAX;
+    uint16_t seq = 0;
+
+    for (uint32_t i = 0; i < ticks; i++) {
+        sim_advance_us(&sim, period_us);
+
+        // The sender runs on its own clock; at low rates several of its
+        // frames land in one tick and only the latest is picked up
+        uint32_t t_ms = (uint32_t)((int64_t)i * period_us / 1000);
+        bool have_intent = false;
+        for (uint32_t ms = (sent_ms == UINT32_MAX) ? 0 : sent_ms + 1; ms <= t_ms; ms++) {
+            motor_intent_t candidate;
+            if (next_intent(bc, ms, (uint16_t)(seq + 1), &candidate)) {
+                intent = candidate;
+                seq++;
+                have_intent = true;
+            }
+        }
+        sent_ms = t_ms;
+
+        int64_t t0 = wall_ns();
+        if (have_intent) {
+            motor_core_apply_intent(&core, &intent);
+        }
+        motor_core_tick(&core);
+        motor_core_get_status(&core, &status);
+        int64_t dt = wall_ns() - t0 - overhead_ns;
+
+        sink += status.speed.left;
+        samples[i] = dt > 0 ? dt : 0;
+        total_ns += samples[i];
+    }
+
+    qsort(samples, ticks, sizeof(*samples), cmp_i64);
+    result->ticks = ticks;
+    result->mean_ns = total_ns / ticks;
+    result->p99_ns = samples[(uint64_t)ticks * 99 / 100];
+    result->max_ns = samples[ticks - 1];
+    free(samples);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = 10;
+    double scale = 1.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            seconds = 1;
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--seconds N] [--scale F]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (seconds == 0 || scale <= 0) {
+        fprintf(stderr, "--seconds and --scale must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    int64_t overhead_ns = timer_overhead_ns();
+    printf("# %u s simulated per case, timer overhead %lld ns subtracted, scale %.2f\n",
+           seconds, (long long)overhead_ns, scale);
+    printf("%-8s %-18s %8s %9s %9s %9s %8s\n",
+           "rate_hz", "case", "ticks", "mean_ns", "p99_ns", "max_ns", "budget%");
+
+    for (size_t r = 0; r < sizeof(rates_hz) / sizeof(rates_hz[0]); r++) {
+        double period_ns = 1e9 / rates_hz[r];
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+            result_t res;
+            run_case(&cases[c], rates_hz[r], seconds, overhead_ns, &res);
+            printf("%-8u %-18s %8u %9.0f %9.0f %9.0f %8.4f\n",
+                   rates_hz[r], cases[c].name, res.ticks,
+                   res.mean_ns * scale, res.p99_ns * scale, res.max_ns * scale,
+                   100.0 * res.p99_ns * scale / period_ns);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+/**
+ * esp_err.h shim for host builds
+ *
+ * Just the error codes the host-built firmware sources use, with the
+ * values ESP-IDF gives them.
+ */
+
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_SUPPORTED   0x106
+
+#endif // ESP_ERR_H
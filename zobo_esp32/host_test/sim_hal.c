@@ -0,0 +1,106 @@
+/**
+ * Simulated Motor HAL
+ */
+
+#include "sim_hal.h"
+#include <string.h>
+
+static int64_t sim_now_us(void *ctx)
+{
+    return ((sim_hal_t *)ctx)->now_us;
+}
+
+static void sim_drive(void *ctx, int16_t left, int16_t right)
+{
+    sim_hal_t *sim = ctx;
+    sim->out.left = left;
+    sim->out.right = right;
+    sim->drives++;
+}
+
+static int32_t sim_counts(const sim_hal_t *sim, int16_t out, int64_t dt_us, int64_t *rem)
+{
+    // counts = out / MAX * max_cps * efficiency * dt, in 1e6 * MAX * 256 units
+    int64_t scaled = (int64_t)out * sim->max_counts_per_sec * sim->efficiency_q8 * dt_us + *rem;
+    int64_t unit = (int64_t)MOTOR_SPEED_MAX * 256 * 1000000;
+    int64_t counts = scaled / unit;
+    *rem = scaled - counts * unit;
+    return (int32_t)counts;
+}
+
+static void sim_read_encoders(void *ctx, int32_t *left, int32_t *right)
+{
+    sim_hal_t *sim = ctx;
+    int64_t dt_us = sim->now_us - sim->encoder_read_us;
+
+    sim->encoder_read_us = sim->now_us;
+    *left = sim_counts(sim, sim->out.left, dt_us, &sim->encoder_rem_left);
+    *right = sim_counts(sim, sim->out.right, dt_us, &sim->encoder_rem_right);
+}
+
+static bool sim_fade_begin(void *ctx, const motor_ramp_t *ramp)
+{
+    sim_hal_t *sim = ctx;
+    if (sim->fade_polls == 0) {
+        return false;
+    }
+    sim->fade_running = true;
+    sim->fade_left = sim->fade_polls;
+    sim->fade_from = ramp->from;
+    sim->fade_to = ramp->to;
+    sim->fade_begins++;
+    return true;
+}
+
+static bool sim_fade_update(void *ctx, const motor_ramp_t *ramp)
+{
+    sim_hal_t *sim = ctx;
+    if (--sim->fade_left > 0) {
+        return false;
+    }
+    sim->fade_running = false;
+    sim->out = sim->fade_to;
+    return true;
+}
+
+static void sim_fade_abort(void *ctx, motor_setpoint_t *reached)
+{
+    sim_hal_t *sim = ctx;
+    if (!sim->fade_running) {
+        return;
+    }
+    // Report half way, the core must take whatever the hardware says
+    sim->fade_running = false;
+    sim->fade_aborts++;
+    reached->left = (int16_t)((sim->fade_from.left + sim->fade_to.left) / 2);
+    reached->right = (int16_t)((sim->fade_from.right + sim->fade_to.right) / 2);
+    sim->out = *reached;
+}
+
+static void sim_event(void *ctx, motor_core_event_t event, uint32_t arg0, uint32_t arg1)
+{
+    sim_hal_t *sim = ctx;
+    sim->events[event]++;
+    sim->event_arg0[event] = arg0;
+    sim->event_arg1[event] = arg1;
+}
+
+void sim_hal_init(sim_hal_t *sim, motor_hal_t *hal)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->now_us = 1000000;      // Start clear of zero, like a running esp_timer
+    sim->encoder_read_us = sim->now_us;
+    sim->max_counts_per_sec = 3000;
+    sim->efficiency_q8 = 256;
+
+    *hal = (motor_hal_t){
+        .ctx = sim,
+        .now_us = sim_now_us,
+        .drive = sim_drive,
+        .read_encoders = sim_read_encoders,
+        .fade_begin = sim_fade_begin,
+        .fade_update = sim_fade_update,
+        .fade_abort = sim_fade_abort,
+        .event = sim_event,
+    };
+}
@@ -0,0 +1,56 @@
+/**
+ * Simulated Motor HAL - Header
+ *
+ * motor_hal_t for host builds: a clock that only moves when told to, an
+ * H-bridge that records what it was driven with, encoders that follow the
+ * output and an optional fade engine that finishes a ramp after a fixed
+ * number of polls.
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "motor_core.h"
+
+#define SIM_EVENT_COUNT     (MOTOR_CORE_EV_NO_ENCODER + 1)
+
+typedef struct {
+    int64_t now_us;
+
+    // H-bridge
+    motor_setpoint_t out;           // Last drive() call
+    uint32_t drives;
+
+    // Encoders: full output gives max_counts_per_sec scaled by efficiency
+    uint32_t max_counts_per_sec;
+    int32_t efficiency_q8;          // 256 = wheel turns exactly as commanded
+    int64_t encoder_read_us;
+    int64_t encoder_rem_left;       // Fractional counts carried between reads
+    int64_t encoder_rem_right;
+
+    // Fade engine (fade_polls == 0 leaves ramps to software)
+    uint32_t fade_polls;
+    uint32_t fade_left;             // Polls until the running fade finishes
+    bool fade_running;
+    motor_setpoint_t fade_from;
+    motor_setpoint_t fade_to;
+    uint32_t fade_begins;
+    uint32_t fade_aborts;
+
+    uint32_t events[SIM_EVENT_COUNT];
+    uint32_t event_arg0[SIM_EVENT_COUNT];
+    uint32_t event_arg1[SIM_EVENT_COUNT];
+} sim_hal_t;
+
+// Reset the simulation and point hal at it. Encoders are on, fade is off
+void sim_hal_init(sim_hal_t *sim, motor_hal_t *hal);
+
+// Move the clock
+static inline void sim_advance_us(sim_hal_t *sim, int64_t us)
+{
+    sim->now_us += us;
+}
+
+#endif // SIM_HAL_H
@@ -0,0 +1,592 @@
+/**
+ * Motor Control Core - Unit Tests
+ *
+ * Runs main/motor_core.c against the simulated HAL. Time only moves when a
+ * test advances it, so every ramp, hold and timeout is checked to the tick.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_hal.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do {                                                    \
+    if (!(cond)) {                                                          \
+        printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);   \
+        failures++;                                                         \
+    }                                                                       \
+} while (0)
+
+#define CHECK_EQ(a, b) do {                                                 \
+    long long a_ = (long long)(a), b_ = (long long)(b);                     \
+    if (a_ != b_) {                                                         \
+        printf("  %s:%d: %s == %lld, expected %s == %lld\n",                \
+               __FILE__, __LINE__, #a, a_, #b, b_);                         \
+        failures++;                                                         \
+    }                                                                       \
+} while (0)
+
+#define CHECK_NEAR(a, b, tol) do {                                          \
+    long long a_ = (long long)(a), b_ = (long long)(b);                     \
+    if (llabs(a_ - b_) > (tol)) {                                           \
+        printf("  %s:%d: %s == %lld, expected %lld +- %d\n",                \
+               __FILE__, __LINE__, #a, a_, b_, (tol));                      \
+        failures++;                                                         \
+    }                                                                       \
+} while (0)
+
+#define RAMP_START  MOTOR_SPEED_FROM_DUTY8(MOTOR_CORE_RAMP_START_DUTY8)
+#define RAMP_END    MOTOR_SPEED_FROM_DUTY8(MOTOR_CORE_RAMP_END_DUTY8)
+
+// Fresh core on a fresh simulation, ticking at rate_hz
+typedef struct {
+    sim_hal_t sim;
+    motor_hal_t hal;
+    motor_core_t core;
+    uint32_t rate_hz;
+} fixture_t;
+
+static void setup(fixture_t *f, uint32_t rate_hz)
+{
+    sim_hal_init(&f->sim, &f->hal);
+    motor_core_init(&f->core, &f->hal);
+    f->rate_hz = rate_hz;
+}
+
+// Advance the clock and tick, like the control loop does, for ms
+static void run_ms(fixture_t *f, uint32_t ms)
+{
+    int64_t period_us = 1000000 / f->rate_hz;
+    int64_t end_us = f->sim.now_us + (int64_t)ms * 1000;
+    while (f->sim.now_us < end_us) {
+        sim_advance_us(&f->sim, period_us);
+        motor_core_tick(&f->core);
+    }
+}
+
+static bool post(fixture_t *f, motor_intent_type_t type, int16_t left, int16_t right)
+{
+    motor_intent_t intent = {
+        .type = type,
+        .count = 1,
+        .setpoints = { { .left = left, .right = right } },
+    };
+    return motor_core_apply_intent(&f->core, &intent);
+}
+
+static bool post_seq(fixture_t *f, uint16_t seq, int16_t left, int16_t right)
+{
+    motor_intent_t intent = {
+        .type = MOTOR_INTENT_SET_SPEED,
+        .count = 1,
+        .flags = MOTOR_INTENT_FLAG_SEQ,
+        .seq = seq,
+        .setpoints = { { .left = left, .right = right } },
+    };
+    return motor_core_apply_intent(&f->core, &intent);
+}
+
+static void test_set_speed_drives_immediately(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+
+    CHECK(post(&f, MOTOR_INTENT_SET_SPEED, 12000, -8000));
+    CHECK_EQ(f.sim.out.left, 12000);
+    CHECK_EQ(f.sim.out.right, -8000);
+    CHECK_EQ(f.sim.drives, 1);
+
+    motor_status_t status;
+    motor_core_get_status(&f.core, &status);
+    CHECK_EQ(status.speed.left, 12000);
+    CHECK(!status.ramping);
+    CHECK_EQ(status.inactivity_ms, 500);
+}
+
+static void test_forward_ramp_latches(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+
+    post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    CHECK_EQ(f.sim.out.left, RAMP_START);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_RAMP_START], 1);
+    CHECK_EQ(f.sim.event_arg0[MOTOR_CORE_EV_RAMP_START], RAMP_END);
+
+    // Linear over 2 s, fed every 200 ms so the watchdog stays out of it
+    for (int i = 0; i < 5; i++) {
+        run_ms(&f, 200);
+        post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    }
+    CHECK(f.core.ramp.active);
+    CHECK_NEAR(f.sim.out.left, (RAMP_START + RAMP_END) / 2, 16);
+    CHECK_EQ(f.sim.out.left, f.sim.out.right);
+
+    for (int i = 0; i < 5; i++) {
+        run_ms(&f, 200);
+        post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    }
+    CHECK(!f.core.ramp.active);
+    CHECK(f.core.forward_latched);
+    CHECK_EQ(f.sim.out.left, RAMP_END);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_RAMP_DONE], 1);
+    CHECK_EQ(f.sim.event_arg0[MOTOR_CORE_EV_RAMP_DONE], 0);
+
+    // Latched: further forward intents only feed the watchdog
+    uint32_t drives = f.sim.drives;
+    post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    CHECK_EQ(f.sim.drives, drives);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_RAMP_START], 1);
+}
+
+static void test_ramp_profiles_monotonic(void)
+{
+    static const ramp_profile_id_t profiles[] = {
+        RAMP_PROFILE_LINEAR, RAMP_PROFILE_S_CURVE, RAMP_PROFILE_EXPONENTIAL,
+    };
+
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+        fixture_t f;
+        setup(&f, 1000);
+        motor_ramp_config_t config = MOTOR_CORE_DEFAULT_RAMP_CONFIG();
+        config.decel_profile = profiles[p];
+        config.decel_ms = 400;
+        motor_core_set_ramp_config(&f.core, &config);
+
+        post(&f, MOTOR_INTENT_SET_SPEED, 20000, -20000);
+        post(&f, MOTOR_INTENT_RAMP_TO, 0, 0);
+
+        int16_t prev = f.sim.out.left;
+        int ticks = 0;
+        while (f.core.ramp.active && ticks < 1000) {
+            run_ms(&f, 1);
+            CHECK(f.sim.out.left <= prev);
+            CHECK_NEAR(f.sim.out.right, -f.sim.out.left, 1);     // Shift rounds toward -inf
+            prev = f.sim.out.left;
+            ticks++;
+        }
+        // Exactly at the end of the ramp, not a tick later
+        CHECK_EQ(ticks, 400);
+        CHECK_EQ(f.sim.out.left, 0);
+        CHECK(!f.core.forward_latched);
+    }
+}
+
+static void test_s_curve_starts_gently(void)
+{
+    int16_t at_10pct[2];
+    static const ramp_profile_id_t profiles[] = { RAMP_PROFILE_LINEAR, RAMP_PROFILE_S_CURVE };
+
+    for (int p = 0; p < 2; p++) {
+        fixture_t f;
+        setup(&f, 1000);
+        motor_ramp_config_t config = MOTOR_CORE_DEFAULT_RAMP_CONFIG();
+        config.decel_profile = profiles[p];
+        config.decel_ms = 1000;
+        motor_core_set_ramp_config(&f.core, &config);
+
+        post(&f, MOTOR_INTENT_RAMP_TO, 30000, 30000);
+        run_ms(&f, 100);
+        at_10pct[p] = f.sim.out.left;
+    }
+    CHECK_NEAR(at_10pct[0], 3000, 16);
+    CHECK(at_10pct[1] < at_10pct[0] / 2);
+}
+
+static void test_zero_duration_ramp_jumps(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    motor_ramp_config_t config = MOTOR_CORE_DEFAULT_RAMP_CONFIG();
+    config.accel_ms = 0;
+    motor_core_set_ramp_config(&f.core, &config);
+
+    post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    CHECK(!f.core.ramp.active);
+    CHECK(f.core.forward_latched);
+    CHECK_EQ(f.sim.out.left, RAMP_END);
+}
+
+static void test_setpoint_playback(void)
+{
+    fixture_t f;
+    setup(&f, 1000);
+
+    motor_intent_t intent = {
+        .type = MOTOR_INTENT_SETPOINTS,
+        .count = 3,
+        .interval_ms = 100,
+        .setpoints = { { 1000, 1000 }, { 2000, -2000 }, { 3000, 0 } },
+    };
+    motor_core_apply_intent(&f.core, &intent);
+    CHECK_EQ(f.sim.out.left, 1000);
+
+    run_ms(&f, 99);
+    CHECK_EQ(f.sim.out.left, 1000);
+    run_ms(&f, 1);
+    CHECK_EQ(f.sim.out.left, 2000);
+    CHECK_EQ(f.sim.out.right, -2000);
+    run_ms(&f, 100);
+    CHECK_EQ(f.sim.out.left, 3000);
+
+    // The last setpoint is held, and it fed the watchdog when it played
+    run_ms(&f, 499);
+    CHECK_EQ(f.sim.out.left, 3000);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_WATCHDOG], 0);
+    run_ms(&f, 1);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_WATCHDOG], 1);
+}
+
+static void test_watchdog_hold_then_decel(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    motor_watchdog_config_t config = { .hold_ms = 300, .decel_ms = 200 };
+    motor_core_set_watchdog_config(&f.core, &config);
+
+    post(&f, MOTOR_INTENT_SET_SPEED, 16000, 16000);
+    run_ms(&f, 298);
+    CHECK_EQ(f.sim.out.left, 16000);
+    CHECK(!f.core.ramp.active);
+
+    motor_status_t status;
+    motor_core_get_status(&f.core, &status);
+    CHECK_EQ(status.inactivity_ms, 2);
+
+    run_ms(&f, 2);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_WATCHDOG], 1);
+    CHECK_EQ(f.sim.event_arg0[MOTOR_CORE_EV_WATCHDOG], 300);
+    CHECK_EQ(f.sim.event_arg1[MOTOR_CORE_EV_WATCHDOG], 200);
+    CHECK(f.core.ramp.active);
+    motor_core_get_status(&f.core, &status);
+    CHECK_EQ(status.inactivity_ms, 0);
+
+    run_ms(&f, 100);
+    CHECK(f.sim.out.left > 0 && f.sim.out.left < 16000);
+
+    run_ms(&f, 100);
+    CHECK_EQ(f.sim.out.left, 0);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_INACTIVITY], 1);
+    CHECK(!f.core.watchdog_armed);
+
+    motor_watchdog_stats_t stats;
+    motor_core_get_watchdog_stats(&f.core, &stats);
+    CHECK_EQ(stats.timeouts, 1);
+
+    // Disarmed: nothing more happens
+    run_ms(&f, 1000);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_WATCHDOG], 1);
+}
+
+static void test_watchdog_timing_independent_of_rate(void)
+{
+    static const uint32_t rates[] = { 100, 250, 500, 1000 };
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        fixture_t f;
+        setup(&f, rates[r]);
+
+        post(&f, MOTOR_INTENT_SET_SPEED, 10000, 10000);
+        int64_t fed_us = f.sim.now_us;
+        while (f.sim.events[MOTOR_CORE_EV_WATCHDOG] == 0) {
+            run_ms(&f, 1000 / rates[r]);
+        }
+        // Caught on the first tick at or after the hold time
+        int64_t late_us = f.sim.now_us - fed_us - 500 * 1000;
+        CHECK(late_us >= 0 && late_us < 1000000 / rates[r]);
+    }
+}
+
+static void test_stop_disarms_watchdog(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+
+    post(&f, MOTOR_INTENT_SET_SPEED, 16000, 16000);
+    run_ms(&f, 100);
+    post(&f, MOTOR_INTENT_STOP, 0, 0);
+    CHECK(f.core.ramp.active);
+    run_ms(&f, 1000);
+    CHECK_EQ(f.sim.out.left, 0);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_WATCHDOG], 0);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_INACTIVITY], 0);
+}
+
+static void test_stale_and_gap_counting(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    motor_watchdog_stats_t stats;
+
+    CHECK(post_seq(&f, 1, 1000, 1000));
+    run_ms(&f, 20);
+    CHECK(post_seq(&f, 2, 2000, 2000));
+    run_ms(&f, 20);
+    CHECK(post_seq(&f, 5, 5000, 5000));     // 3 and 4 lost
+    run_ms(&f, 20);
+    CHECK(!post_seq(&f, 4, 4000, 4000));    // Late, dropped
+    CHECK(!post_seq(&f, 5, 5000, 5000));    // Duplicate, dropped
+    CHECK_EQ(f.sim.out.left, 5000);
+
+    motor_core_get_watchdog_stats(&f.core, &stats);
+    CHECK_EQ(stats.gaps, 2);
+    CHECK_EQ(stats.stale, 2);
+    CHECK_EQ(stats.max_gap_ms, 20);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_STALE], 2);
+    CHECK_EQ(f.sim.event_arg0[MOTOR_CORE_EV_STALE], 5);
+    CHECK_EQ(f.sim.event_arg1[MOTOR_CORE_EV_STALE], 5);
+
+    // Wrap-around is newer, not stale
+    f.core.last_seq = 0xFFFF;
+    CHECK(post_seq(&f, 0, 100, 100));
+
+    // After a stop the app may restart its counter
+    post(&f, MOTOR_INTENT_STOP, 0, 0);
+    CHECK(post_seq(&f, 1, 3000, 3000));
+    CHECK_EQ(f.sim.out.left, 3000);
+
+    motor_core_reset_watchdog_stats(&f.core);
+    motor_core_get_watchdog_stats(&f.core, &stats);
+    CHECK_EQ(stats.gaps + stats.stale + stats.timeouts + stats.max_gap_ms, 0);
+}
+
+static void test_scheduled_intent(void)
+{
+    fixture_t f;
+    setup(&f, 100);
+
+    // Fleet frame for 25 ms ahead: nothing moves until the first tick past it
+    motor_intent_t intent = {
+        .type = MOTOR_INTENT_SET_SPEED,
+        .count = 1,
+        .apply_at_us = f.sim.now_us + 25000,
+        .setpoints = { { 9000, 9000 } },
+    };
+    CHECK(motor_core_apply_intent(&f.core, &intent));
+    CHECK_EQ(f.sim.drives, 0);
+    run_ms(&f, 20);
+    CHECK_EQ(f.sim.drives, 0);
+    run_ms(&f, 10);
+    CHECK_EQ(f.sim.out.left, 9000);
+
+    // The hold runs from when it applied, not from when it arrived
+    motor_status_t status;
+    motor_core_get_status(&f.core, &status);
+    CHECK_EQ(status.inactivity_ms, 500);
+
+    // A due time in the past applies straight away
+    intent.apply_at_us = f.sim.now_us - 5000;
+    intent.setpoints[0].left = 7000;
+    motor_core_apply_intent(&f.core, &intent);
+    CHECK_EQ(f.sim.out.left, 7000);
+
+    // Queued intents run in apply-time order, not arrival order
+    intent.apply_at_us = f.sim.now_us + 40000;
+    intent.setpoints[0].left = 12000;
+    motor_core_apply_intent(&f.core, &intent);
+    intent.apply_at_us = f.sim.now_us + 20000;
+    intent.setpoints[0].left = 11000;
+    motor_core_apply_intent(&f.core, &intent);
+    CHECK_EQ(f.core.scheduled_count, 2);
+    run_ms(&f, 20);
+    CHECK_EQ(f.sim.out.left, 11000);
+    run_ms(&f, 20);
+    CHECK_EQ(f.sim.out.left, 12000);
+    CHECK_EQ(f.core.scheduled_count, 0);
+
+    // A stop clears the queue
+    intent.apply_at_us = f.sim.now_us + 50000;
+    intent.setpoints[0].left = 20000;
+    motor_core_apply_intent(&f.core, &intent);
+    post(&f, MOTOR_INTENT_STOP, 0, 0);
+    CHECK_EQ(f.core.scheduled_count, 0);
+    run_ms(&f, 1000);
+    CHECK_EQ(f.sim.out.left, 0);
+}
+
+static void test_scheduled_stream_long_lead(void)
+{
+    fixture_t f;
+    setup(&f, 100);
+
+    // App stream every 100 ms with a 250 ms lead (slow link in the fleet):
+    // each frame arrives before the previous one is due, and must still run
+    motor_intent_t intent = {
+        .type = MOTOR_INTENT_SET_SPEED,
+        .flags = MOTOR_INTENT_FLAG_SEQ,
+        .count = 1,
+    };
+    uint32_t moving_ticks = 0;
+    for (uint16_t seq = 1; seq <= 20; seq++) {
+        intent.seq = seq;
+        intent.apply_at_us = f.sim.now_us + 250000;
+        intent.setpoints[0] = (motor_setpoint_t){ (int16_t)(8000 + seq * 100), 8000 };
+        CHECK(motor_core_apply_intent(&f.core, &intent));
+        CHECK(f.core.scheduled_count <= 3);
+        for (int t = 0; t < 10; t++) {
+            run_ms(&f, 10);
+            moving_ticks += f.sim.out.left != 0;
+        }
+    }
+
+    // Moving from the first frame's apply time on, watchdog fed throughout
+    CHECK_EQ(moving_ticks, (2000 - 250) / 10 + 1);
+    CHECK_EQ(f.sim.out.left, 8000 + 18 * 100);
+    motor_watchdog_stats_t stats;
+    motor_core_get_watchdog_stats(&f.core, &stats);
+    CHECK_EQ(stats.timeouts, 0);
+    CHECK_EQ(stats.gaps + stats.stale, 0);
+}
+
+static void test_hw_fade(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    f.sim.fade_polls = 5;
+
+    post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    CHECK(f.core.ramp.hw_fade);
+    CHECK_EQ(f.sim.fade_begins, 1);
+    uint32_t drives = f.sim.drives;
+
+    // The hardware owns the duty: no drive calls while it runs
+    run_ms(&f, 8);
+    CHECK(f.core.ramp.active);
+    CHECK_EQ(f.sim.drives, drives);
+    run_ms(&f, 2);
+    CHECK(!f.core.ramp.active);
+    CHECK(f.core.forward_latched);
+    CHECK_EQ(f.core.current.left, RAMP_END);
+    CHECK_EQ(f.sim.event_arg0[MOTOR_CORE_EV_RAMP_DONE], 1);
+
+    // A new command mid-fade takes the speed the hardware reached
+    post(&f, MOTOR_INTENT_RAMP_TO, 0, 0);
+    CHECK_EQ(f.sim.fade_begins, 2);
+    post(&f, MOTOR_INTENT_RAMP_TO, 8000, 8000);
+    CHECK_EQ(f.sim.fade_aborts, 1);
+    CHECK_EQ(f.core.ramp.from.left, RAMP_END / 2);
+    CHECK_EQ(f.sim.fade_begins, 3);
+
+    // A fade to zero ends with a real stop on the bridge, not just zero duty
+    post(&f, MOTOR_INTENT_SET_SPEED, -16000, -16000);
+    post(&f, MOTOR_INTENT_RAMP_TO, 0, 0);
+    CHECK(f.core.ramp.hw_fade);
+    drives = f.sim.drives;
+    run_ms(&f, 10);
+    CHECK(!f.core.ramp.active);
+    CHECK_EQ(f.sim.drives, drives + 1);
+    CHECK_EQ(f.sim.out.left, 0);
+    CHECK_EQ(f.sim.out.right, 0);
+}
+
+static void test_closed_loop_tracks_target(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    f.sim.efficiency_q8 = 200;      // Loaded wheel, feedforward alone falls short
+
+    motor_core_set_closed_loop(&f.core, true, NULL, f.rate_hz);
+    CHECK(f.core.closed_loop);
+
+    // Speeds are targets now; only the controller drives
+    post(&f, MOTOR_INTENT_SET_SPEED, 16000, 8000);
+    CHECK_EQ(f.sim.drives, 1);      // The stop from enabling closed loop
+    for (int i = 0; i < 15; i++) {
+        run_ms(&f, 200);
+        post(&f, MOTOR_INTENT_SET_SPEED, 16000, 8000);
+    }
+
+    motor_status_t status;
+    motor_core_get_status(&f.core, &status);
+    CHECK_NEAR(status.measured.left, 16000, 480);
+    CHECK_NEAR(status.measured.right, 8000, 240);
+    CHECK(f.sim.out.left > 16000);
+
+    // Stopping cuts the output straight away
+    post(&f, MOTOR_INTENT_SET_SPEED, 0, 0);
+    CHECK_EQ(f.sim.out.left, 0);
+    run_ms(&f, 10);
+    CHECK_EQ(f.sim.out.left, 0);
+}
+
+static void test_closed_loop_without_encoders(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    f.sim.efficiency_q8 = 0;        // No encoders fitted: counts stay at zero
+
+    motor_core_set_closed_loop(&f.core, true, NULL, f.rate_hz);
+    CHECK(f.core.closed_loop);
+
+    // Idle wheels aren't expected to count
+    run_ms(&f, 1000);
+    CHECK(f.core.closed_loop);
+
+    // Driven but silent: back to open loop on the commanded speed before
+    // the PID winds the output up
+    post(&f, MOTOR_INTENT_SET_SPEED, 12000, 12000);
+    run_ms(&f, MOTOR_CORE_ENCODER_TIMEOUT_MS - 10);
+    CHECK(f.core.closed_loop);
+    run_ms(&f, 20);
+    CHECK(!f.core.closed_loop);
+    CHECK_EQ(f.sim.events[MOTOR_CORE_EV_NO_ENCODER], 1);
+    CHECK_EQ(f.sim.out.left, 12000);
+    CHECK_EQ(f.sim.out.right, 12000);
+
+    motor_status_t status;
+    motor_core_get_status(&f.core, &status);
+    CHECK(!status.closed_loop);
+}
+
+static void test_closed_loop_ramps_in_software(void)
+{
+    fixture_t f;
+    setup(&f, 500);
+    f.sim.fade_polls = 5;
+
+    motor_core_set_closed_loop(&f.core, true, NULL, f.rate_hz);
+    post(&f, MOTOR_INTENT_FORWARD, 0, 0);
+    CHECK(f.core.ramp.active);
+    CHECK(!f.core.ramp.hw_fade);
+    CHECK_EQ(f.sim.fade_begins, 0);
+
+    motor_core_set_closed_loop(&f.core, false, NULL, f.rate_hz);
+    CHECK(!f.core.closed_loop);
+    CHECK(!f.core.ramp.active);
+    CHECK_EQ(f.sim.out.left, 0);
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        void (*fn)(void);
+    } tests[] = {
+        { "set_speed_drives_immediately", test_set_speed_drives_immediately },
+        { "forward_ramp_latches", test_forward_ramp_latches },
+        { "ramp_profiles_monotonic", test_ramp_profiles_monotonic },
+        { "s_curve_starts_gently", test_s_curve_starts_gently },
+        { "zero_duration_ramp_jumps", test_zero_duration_ramp_jumps },
+        { "setpoint_playback", test_setpoint_playback },
+        { "watchdog_hold_then_decel", test_watchdog_hold_then_decel },
+        { "watchdog_timing_independent_of_rate", test_watchdog_timing_independent_of_rate },
+        { "stop_disarms_watchdog", test_stop_disarms_watchdog },
+        { "stale_and_gap_counting", test_stale_and_gap_counting },
+        { "scheduled_intent", test_scheduled_intent },
+        { "scheduled_stream_long_lead", test_scheduled_stream_long_lead },
+        { "hw_fade", test_hw_fade },
+        { "closed_loop_tracks_target", test_closed_loop_tracks_target },
+        { "closed_loop_without_encoders", test_closed_loop_without_encoders },
+        { "closed_loop_ramps_in_software", test_closed_loop_ramps_in_software },
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        int before = failures;
+        tests[i].fn();
+        printf("%s %s\n", failures == before ? "PASS" : "FAIL", tests[i].name);
+    }
+
+    printf("%d failure(s)\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
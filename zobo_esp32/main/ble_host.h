@@ -0,0 +1,85 @@
+/**
+ * BLE Host Backend - Header
+ *
+ * Internal interface between ble_service.c (TX coalescing, acks,
+ * connection profiles) and the Bluetooth host stack that owns the GATT
+ * table and the link. Exactly one backend is built, picked by the host
+ * selected in sdkconfig:
+ *   ble_host_nimble.c     CONFIG_BT_NIMBLE_ENABLED (default)
+ *   ble_host_bluedroid.c  CONFIG_BT_BLUEDROID_ENABLED
+ * Nothing outside the BLE service includes this header.
+ */
+
+#ifndef BLE_HOST_H
+#define BLE_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Characteristics of the NUS service
+typedef enum {
+    BLE_HOST_CHAR_TX,           // 6e400003, notify
+    BLE_HOST_CHAR_RX,           // 6e400002, write
+    BLE_HOST_CHAR_OTA,          // 6e400004, write / notify
+    BLE_HOST_CHAR_TELEM,        // 6e400005, notify
+} ble_host_char_t;
+
+#define BLE_HOST_DEVICE_NAME    "Zobo"
+#define BLE_HOST_LOCAL_MTU      500
+#define BLE_HOST_DLE_TX_OCTETS  251     // Data Length Extension, max LL payload
+
+// ---------------------------------------------------------------------------
+// Implemented by the backend
+// ---------------------------------------------------------------------------
+
+// Bring up controller and host, register the service and start advertising
+esp_err_t ble_host_init(void);
+
+// Notify a characteristic on the current connection. False if there is
+// none or the stack is out of buffers
+bool ble_host_notify(ble_host_char_t chr, const uint8_t *data, uint16_t len);
+
+// Ask the central for new connection parameters; the outcome arrives
+// through ble_service_on_conn_params()
+esp_err_t ble_host_update_conn_params(uint16_t min_int, uint16_t max_int,
+                                      uint16_t latency, uint16_t timeout);
+
+// Refresh the link RSSI, reported through ble_service_on_rssi()
+void ble_host_read_rssi(void);
+
+// Connectable advertising (0.625 ms units). A changed interval applies
+// straight away when advertising, otherwise on the next start
+void ble_host_set_adv_interval(uint16_t min, uint16_t max);
+void ble_host_adv_start(void);
+void ble_host_adv_stop(void);
+
+// ---------------------------------------------------------------------------
+// Implemented by ble_service.c, called from the host task
+// ---------------------------------------------------------------------------
+
+// Link up, with the parameters the central picked (interval 1.25 ms,
+// timeout 10 ms units)
+void ble_service_on_connect(uint16_t interval, uint16_t latency, uint16_t timeout);
+
+// Link down. The backend restarts advertising afterwards
+void ble_service_on_disconnect(void);
+
+void ble_service_on_mtu(uint16_t mtu);
+
+// Write to RX or OTA
+void ble_service_on_write(ble_host_char_t chr, uint8_t *data, uint16_t len);
+
+// CCCD of TX, OTA or TELEM changed
+void ble_service_on_subscribe(ble_host_char_t chr, bool enabled);
+
+// Connection parameter update finished (status 0 = accepted), requested
+// by us or started by the central
+void ble_service_on_conn_params(int status, uint16_t interval, uint16_t latency,
+                                uint16_t timeout);
+
+void ble_service_on_data_len(uint16_t tx_octets, uint16_t rx_octets);
+void ble_service_on_rssi(int8_t rssi);
+void ble_service_on_adv_started(void);
+
+#endif // BLE_HOST_H
@@ -0,0 +1,348 @@
+/**
+ * BLE Host Backend - Bluedroid
+ */
+
+#include "ble_host.h"
+#include "ble_service.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_bt_main.h"
+#include "esp_gatt_common_api.h"
+
+static const char *TAG = "BLE";
+
+// Nordic UART Service UUIDs
+static uint8_t service_uuid[16] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E
+};
+
+static uint8_t char_rx_uuid[16] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x02, 0x00, 0x40, 0x6E
+};
+
+static uint8_t char_tx_uuid[16] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x03, 0x00, 0x40, 0x6E
+};
+
+// Firmware transfer characteristic (see ble_ota.h)
+static uint8_t char_ota_uuid[16] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x04, 0x00, 0x40, 0x6E
+};
+
+// Binary telemetry characteristic (see telemetry.h)
+static uint8_t char_telem_uuid[16] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x05, 0x00, 0x40, 0x6E
+};
+
+// State variables
+static uint16_t s_gatts_if = ESP_GATT_IF_NONE;
+static uint16_t s_conn_id = 0;
+static bool s_connected = false;
+static esp_bd_addr_t s_peer_bda;
+
+// Advertising restart requested after an interval change
+static volatile bool s_adv_restart = false;
+
+// GATT handles
+enum {
+    IDX_SVC,
+    IDX_CHAR_TX,
+    IDX_CHAR_TX_VAL,
+    IDX_CHAR_TX_CFG,
+    IDX_CHAR_RX,
+    IDX_CHAR_RX_VAL,
+    IDX_CHAR_OTA,
+    IDX_CHAR_OTA_VAL,
+    IDX_CHAR_OTA_CFG,
+    IDX_CHAR_TELEM,
+    IDX_CHAR_TELEM_VAL,
+    IDX_CHAR_TELEM_CFG,
+    IDX_NB,
+};
+
+static uint16_t s_handle_table[IDX_NB];
+
+// Value handle per ble_host_char_t
+static const uint8_t s_char_idx[] = {
+    [BLE_HOST_CHAR_TX] = IDX_CHAR_TX_VAL,
+    [BLE_HOST_CHAR_RX] = IDX_CHAR_RX_VAL,
+    [BLE_HOST_CHAR_OTA] = IDX_CHAR_OTA_VAL,
+    [BLE_HOST_CHAR_TELEM] = IDX_CHAR_TELEM_VAL,
+};
+
+// Advertising parameters
+static esp_ble_adv_params_t s_adv_params = {
+    .adv_int_min = BLE_ADV_INTERVAL_FAST_MIN,
+    .adv_int_max = BLE_ADV_INTERVAL_FAST_MAX,
+    .adv_type = ADV_TYPE_IND,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .channel_map = ADV_CHNL_ALL,
+    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+static uint8_t s_adv_data[] = {
+    0x02, 0x01, 0x06,
+    0x05, 0x09, 'Z', 'o', 'b', 'o',
+    0x11, 0x07,
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E
+};
+
+// GATT database
+static const esp_gatts_attr_db_t s_gatt_db[IDX_NB] = {
+    [IDX_SVC] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_PRI_SERVICE},
+         ESP_GATT_PERM_READ, sizeof(service_uuid), sizeof(service_uuid), service_uuid}
+    },
+    [IDX_CHAR_TX] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_NOTIFY}}
+    },
+    [IDX_CHAR_TX_VAL] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_128, char_tx_uuid, 0, 500, 0, NULL}
+    },
+    [IDX_CHAR_TX_CFG] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
+         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 2, 0, NULL}
+    },
+    [IDX_CHAR_RX] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR}}
+    },
+    [IDX_CHAR_RX_VAL] = {
+        {ESP_GATT_RSP_BY_APP},
+        {ESP_UUID_LEN_128, char_rx_uuid, ESP_GATT_PERM_WRITE, 500, 0, NULL}
+    },
+    [IDX_CHAR_OTA] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_NOTIFY}}
+    },
+    [IDX_CHAR_OTA_VAL] = {
+        {ESP_GATT_RSP_BY_APP},
+        {ESP_UUID_LEN_128, char_ota_uuid, ESP_GATT_PERM_WRITE, 500, 0, NULL}
+    },
+    [IDX_CHAR_OTA_CFG] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
+         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 2, 0, NULL}
+    },
+    [IDX_CHAR_TELEM] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_NOTIFY}}
+    },
+    [IDX_CHAR_TELEM_VAL] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_128, char_telem_uuid, ESP_GATT_PERM_READ, 64, 0, NULL}
+    },
+    [IDX_CHAR_TELEM_CFG] = {
+        {ESP_GATT_AUTO_RSP},
+        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
+         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 2, 0, NULL}
+    },
+};
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event) {
+        case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
+            esp_ble_gap_start_advertising(&s_adv_params);
+            break;
+        case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+            if (s_adv_restart) {
+                s_adv_restart = false;
+                if (!s_connected) {
+                    esp_ble_gap_start_advertising(&s_adv_params);
+                }
+            }
+            break;
+        case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+            if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ble_service_on_data_len(param->pkt_data_length_cmpl.params.tx_len,
+                                        param->pkt_data_length_cmpl.params.rx_len);
+            }
+            break;
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            ble_service_on_conn_params(param->update_conn_params.status,
+                                       param->update_conn_params.conn_int,
+                                       param->update_conn_params.latency,
+                                       param->update_conn_params.timeout);
+            break;
+        case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
+            if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ble_service_on_rssi(param->read_rssi_cmpl.rssi);
+            }
+            break;
+        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+            if (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ble_service_on_adv_started();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void on_cccd_write(ble_host_char_t chr, const esp_ble_gatts_cb_param_t *param)
+{
+    if (param->write.len == 2) {
+        uint16_t cccd = param->write.value[0] | (param->write.value[1] << 8);
+        ble_service_on_subscribe(chr, cccd == 0x0001);
+    }
+}
+
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                                esp_ble_gatts_cb_param_t *param)
+{
+    switch (event) {
+        case ESP_GATTS_REG_EVT:
+            ESP_LOGI(TAG, "GATT server registered");
+            s_gatts_if = gatts_if;
+            esp_ble_gap_config_adv_data_raw(s_adv_data, sizeof(s_adv_data));
+            esp_ble_gatts_create_attr_tab(s_gatt_db, gatts_if, IDX_NB, 0);
+            break;
+
+        case ESP_GATTS_CREAT_ATTR_TAB_EVT:
+            if (param->add_attr_tab.status == ESP_GATT_OK) {
+                memcpy(s_handle_table, param->add_attr_tab.handles, sizeof(s_handle_table));
+                esp_ble_gatts_start_service(s_handle_table[IDX_SVC]);
+                ESP_LOGI(TAG, "Service started");
+            }
+            break;
+
+        case ESP_GATTS_CONNECT_EVT:
+            s_connected = true;
+            s_conn_id = param->connect.conn_id;
+            memcpy(s_peer_bda, param->connect.remote_bda, sizeof(s_peer_bda));
+            ble_service_on_connect(param->connect.conn_params.interval,
+                                   param->connect.conn_params.latency,
+                                   param->connect.conn_params.timeout);
+            // Longer link layer packets - an MTU sized write then needs 2
+            // packets instead of 20 (ignored by peers without DLE)
+            esp_ble_gap_set_pkt_data_len(param->connect.remote_bda, BLE_HOST_DLE_TX_OCTETS);
+            break;
+
+        case ESP_GATTS_DISCONNECT_EVT:
+            s_connected = false;
+            ble_service_on_disconnect();
+            esp_ble_gap_start_advertising(&s_adv_params);
+            break;
+
+        case ESP_GATTS_MTU_EVT:
+            ble_service_on_mtu(param->mtu.mtu);
+            break;
+
+        case ESP_GATTS_WRITE_EVT:
+            if (param->write.handle == s_handle_table[IDX_CHAR_RX_VAL] ||
+                param->write.handle == s_handle_table[IDX_CHAR_OTA_VAL]) {
+                ble_service_on_write(param->write.handle == s_handle_table[IDX_CHAR_RX_VAL] ?
+                                     BLE_HOST_CHAR_RX : BLE_HOST_CHAR_OTA,
+                                     param->write.value, param->write.len);
+                if (param->write.need_rsp) {
+                    esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+                                               param->write.trans_id, ESP_GATT_OK, NULL);
+                }
+            } else if (param->write.handle == s_handle_table[IDX_CHAR_TX_CFG]) {
+                on_cccd_write(BLE_HOST_CHAR_TX, param);
+            } else if (param->write.handle == s_handle_table[IDX_CHAR_OTA_CFG]) {
+                on_cccd_write(BLE_HOST_CHAR_OTA, param);
+            } else if (param->write.handle == s_handle_table[IDX_CHAR_TELEM_CFG]) {
+                on_cccd_write(BLE_HOST_CHAR_TELEM, param);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+esp_err_t ble_host_init(void)
+{
+    // Release classic BT memory
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    // Initialize BT controller
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_bt_controller_init(&bt_cfg));
+    ESP_ERROR_CHECK(esp_bt_controller_enable(ESP_BT_MODE_BLE));
+
+    // Initialize Bluedroid
+    ESP_ERROR_CHECK(esp_bluedroid_init());
+    ESP_ERROR_CHECK(esp_bluedroid_enable());
+
+    // Register callbacks
+    ESP_ERROR_CHECK(esp_ble_gatts_register_callback(gatts_event_handler));
+    ESP_ERROR_CHECK(esp_ble_gap_register_callback(gap_event_handler));
+    ESP_ERROR_CHECK(esp_ble_gatts_app_register(0));
+    ESP_ERROR_CHECK(esp_ble_gatt_set_local_mtu(BLE_HOST_LOCAL_MTU));
+
+    ESP_LOGI(TAG, "Bluedroid host started");
+    return ESP_OK;
+}
+
+bool ble_host_notify(ble_host_char_t chr, const uint8_t *data, uint16_t len)
+{
+    if (!s_connected || s_gatts_if == ESP_GATT_IF_NONE) {
+        return false;
+    }
+    return esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_handle_table[s_char_idx[chr]],
+                                       len, (uint8_t *)data, false) == ESP_OK;
+}
+
+esp_err_t ble_host_update_conn_params(uint16_t min_int, uint16_t max_int,
+                                      uint16_t latency, uint16_t timeout)
+{
+    esp_ble_conn_update_params_t params = {
+        .min_int = min_int,
+        .max_int = max_int,
+        .latency = latency,
+        .timeout = timeout,
+    };
+    memcpy(params.bda, s_peer_bda, sizeof(params.bda));
+    return esp_ble_gap_update_conn_params(&params);
+}
+
+void ble_host_read_rssi(void)
+{
+    if (s_connected) {
+        esp_ble_gap_read_rssi(s_peer_bda);
+    }
+}
+
+void ble_host_set_adv_interval(uint16_t min, uint16_t max)
+{
+    s_adv_params.adv_int_min = min;
+    s_adv_params.adv_int_max = max;
+
+    // New parameters only apply to a fresh advertising set; the restart
+    // happens on the stop-complete event. While connected, the next
+    // disconnect picks them up
+    if (!s_connected) {
+        s_adv_restart = true;
+        esp_ble_gap_stop_advertising();
+    }
+}
+
+void ble_host_adv_start(void)
+{
+    esp_ble_gap_start_advertising(&s_adv_params);
+}
+
+void ble_host_adv_stop(void)
+{
+    esp_ble_gap_stop_advertising();
+}
@@ -0,0 +1,323 @@
+/**
+ * BLE Host Backend - NimBLE
+ * Same GATT table and advertising payload as the Bluedroid backend, on the
+ * much smaller NimBLE host: less heap and flash, and the host is up a good
+ * deal sooner after app_main.
+ */
+
+#include "ble_host.h"
+#include "ble_service.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+static const char *TAG = "BLE";
+
+#define BLE_DLE_TX_TIME_US      2120    // 251 octets on the 1M PHY
+
+// Nordic UART Service UUIDs
+static const ble_uuid128_t s_service_uuid = BLE_UUID128_INIT(
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E);
+
+static const ble_uuid128_t s_char_rx_uuid = BLE_UUID128_INIT(
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x02, 0x00, 0x40, 0x6E);
+
+static const ble_uuid128_t s_char_tx_uuid = BLE_UUID128_INIT(
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x03, 0x00, 0x40, 0x6E);
+
+// Firmware transfer characteristic (see ble_ota.h)
+static const ble_uuid128_t s_char_ota_uuid = BLE_UUID128_INIT(
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x04, 0x00, 0x40, 0x6E);
+
+// Binary telemetry characteristic (see telemetry.h)
+static const ble_uuid128_t s_char_telem_uuid = BLE_UUID128_INIT(
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x05, 0x00, 0x40, 0x6E);
+
+// State variables
+static volatile uint16_t s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+static uint8_t s_own_addr_type;
+static volatile bool s_synced = false;
+
+// Value handle per ble_host_char_t, filled in by ble_gatts_add_svcs()
+static uint16_t s_val_handles[BLE_HOST_CHAR_TELEM + 1];
+
+// Advertising interval (0.625 ms units)
+static volatile uint16_t s_adv_itvl_min = BLE_ADV_INTERVAL_FAST_MIN;
+static volatile uint16_t s_adv_itvl_max = BLE_ADV_INTERVAL_FAST_MAX;
+
+static const uint8_t s_adv_data[] = {
+    0x02, 0x01, 0x06,
+    0x05, 0x09, 'Z', 'o', 'b', 'o',
+    0x11, 0x07,
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E
+};
+
+// Writes arrive as mbuf chains; flattened here (host task only)
+static uint8_t s_write_buf[BLE_HOST_LOCAL_MTU];
+
+static int gatt_access(uint16_t conn_handle, uint16_t attr_handle,
+                       struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    uint16_t len = 0;
+    if (ble_hs_mbuf_to_flat(ctxt->om, s_write_buf, sizeof(s_write_buf), &len) != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    ble_service_on_write((ble_host_char_t)(uintptr_t)arg, s_write_buf, len);
+    return 0;
+}
+
+// GATT database
+static const struct ble_gatt_svc_def s_gatt_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = &s_service_uuid.u,
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = &s_char_tx_uuid.u,
+                .access_cb = gatt_access,
+                .arg = (void *)(uintptr_t)BLE_HOST_CHAR_TX,
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &s_val_handles[BLE_HOST_CHAR_TX],
+            },
+            {
+                .uuid = &s_char_rx_uuid.u,
+                .access_cb = gatt_access,
+                .arg = (void *)(uintptr_t)BLE_HOST_CHAR_RX,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
+                .val_handle = &s_val_handles[BLE_HOST_CHAR_RX],
+            },
+            {
+                .uuid = &s_char_ota_uuid.u,
+                .access_cb = gatt_access,
+                .arg = (void *)(uintptr_t)BLE_HOST_CHAR_OTA,
+                .flags = BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &s_val_handles[BLE_HOST_CHAR_OTA],
+            },
+            {
+                .uuid = &s_char_telem_uuid.u,
+                .access_cb = gatt_access,
+                .arg = (void *)(uintptr_t)BLE_HOST_CHAR_TELEM,
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &s_val_handles[BLE_HOST_CHAR_TELEM],
+            },
+            { 0 }
+        },
+    },
+    { 0 }
+};
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+
+static void adv_start(void)
+{
+    if (!s_synced || s_conn_handle != BLE_HS_CONN_HANDLE_NONE || ble_gap_adv_active()) {
+        return;
+    }
+
+    struct ble_gap_adv_params params = {
+        .conn_mode = BLE_GAP_CONN_MODE_UND,
+        .disc_mode = BLE_GAP_DISC_MODE_GEN,
+        .itvl_min = s_adv_itvl_min,
+        .itvl_max = s_adv_itvl_max,
+    };
+    int rc = ble_gap_adv_start(s_own_addr_type, NULL, BLE_HS_FOREVER, &params,
+                               gap_event_handler, NULL);
+    if (rc == 0) {
+        ble_service_on_adv_started();
+    } else if (rc != BLE_HS_EALREADY) {
+        ESP_LOGW(TAG, "Advertising start failed (%d)", rc);
+    }
+}
+
+// Parameters the link runs with (zeros if the connection is gone)
+static void conn_params(uint16_t handle, uint16_t *interval, uint16_t *latency, uint16_t *timeout)
+{
+    struct ble_gap_conn_desc desc;
+
+    if (ble_gap_conn_find(handle, &desc) == 0) {
+        *interval = desc.conn_itvl;
+        *latency = desc.conn_latency;
+        *timeout = desc.supervision_timeout;
+    } else {
+        *interval = *latency = *timeout = 0;
+    }
+}
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg)
+{
+    uint16_t interval, latency, timeout;
+
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            if (event->connect.status != 0) {
+                adv_start();
+                break;
+            }
+            s_conn_handle = event->connect.conn_handle;
+            conn_params(s_conn_handle, &interval, &latency, &timeout);
+            ble_service_on_connect(interval, latency, timeout);
+            // Longer link layer packets - an MTU sized write then needs 2
+            // packets instead of 20 (ignored by peers without DLE)
+            ble_gap_set_data_len(s_conn_handle, BLE_HOST_DLE_TX_OCTETS, BLE_DLE_TX_TIME_US);
+            break;
+
+        case BLE_GAP_EVENT_DISCONNECT:
+            s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+            ble_service_on_disconnect();
+            adv_start();
+            break;
+
+        case BLE_GAP_EVENT_CONN_UPDATE:
+            conn_params(event->conn_update.conn_handle, &interval, &latency, &timeout);
+            ble_service_on_conn_params(event->conn_update.status, interval, latency, timeout);
+            break;
+
+        case BLE_GAP_EVENT_MTU:
+            ble_service_on_mtu(event->mtu.value);
+            break;
+
+        case BLE_GAP_EVENT_SUBSCRIBE:
+            for (int i = 0; i <= BLE_HOST_CHAR_TELEM; i++) {
+                if (s_val_handles[i] == event->subscribe.attr_handle) {
+                    ble_service_on_subscribe((ble_host_char_t)i, event->subscribe.cur_notify);
+                }
+            }
+            break;
+
+#ifdef BLE_GAP_EVENT_DATA_LEN_CHG
+        case BLE_GAP_EVENT_DATA_LEN_CHG:
+            ble_service_on_data_len(event->data_len_chg.max_tx_octets,
+                                    event->data_len_chg.max_rx_octets);
+            break;
+#endif
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void on_sync(void)
+{
+    ble_hs_util_ensure_addr(0);
+    ble_hs_id_infer_auto(0, &s_own_addr_type);
+    ble_gap_adv_set_data(s_adv_data, sizeof(s_adv_data));
+    s_synced = true;
+    adv_start();
+}
+
+static void on_reset(int reason)
+{
+    s_synced = false;
+    ESP_LOGW(TAG, "Host reset (%d)", reason);
+}
+
+static void host_task(void *arg)
+{
+    // Returns only after nimble_port_stop()
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+esp_err_t ble_host_init(void)
+{
+    // Release classic BT memory
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    // Initialize controller and host
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+    if (ble_gatts_count_cfg(s_gatt_svcs) != 0 || ble_gatts_add_svcs(s_gatt_svcs) != 0) {
+        ESP_LOGE(TAG, "GATT table registration failed");
+        return ESP_FAIL;
+    }
+    ble_svc_gap_device_name_set(BLE_HOST_DEVICE_NAME);
+    ble_att_set_preferred_mtu(BLE_HOST_LOCAL_MTU);
+
+    nimble_port_freertos_init(host_task);
+
+    ESP_LOGI(TAG, "NimBLE host started");
+    return ESP_OK;
+}
+
+bool ble_host_notify(ble_host_char_t chr, const uint8_t *data, uint16_t len)
+{
+    uint16_t handle = s_conn_handle;
+    if (handle == BLE_HS_CONN_HANDLE_NONE) {
+        return false;
+    }
+
+    // Out of mbufs is the NimBLE equivalent of a congested link
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+    if (!om) {
+        return false;
+    }
+    return ble_gattc_notify_custom(handle, s_val_handles[chr], om) == 0;
+}
+
+esp_err_t ble_host_update_conn_params(uint16_t min_int, uint16_t max_int,
+                                      uint16_t latency, uint16_t timeout)
+{
+    struct ble_gap_upd_params params = {
+        .itvl_min = min_int,
+        .itvl_max = max_int,
+        .latency = latency,
+        .supervision_timeout = timeout,
+    };
+    return ble_gap_update_params(s_conn_handle, &params) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+void ble_host_read_rssi(void)
+{
+    int8_t rssi;
+    uint16_t handle = s_conn_handle;
+
+    if (handle != BLE_HS_CONN_HANDLE_NONE && ble_gap_conn_rssi(handle, &rssi) == 0) {
+        ble_service_on_rssi(rssi);
+    }
+}
+
+void ble_host_set_adv_interval(uint16_t min, uint16_t max)
+{
+    s_adv_itvl_min = min;
+    s_adv_itvl_max = max;
+
+    // Stopping is synchronous here, restart straight away. While connected,
+    // the next disconnect picks them up
+    if (ble_gap_adv_active()) {
+        ble_gap_adv_stop();
+        adv_start();
+    }
+}
+
+void ble_host_adv_start(void)
+{
+    adv_start();
+}
+
+void ble_host_adv_stop(void)
+{
+    ble_gap_adv_stop();
+}
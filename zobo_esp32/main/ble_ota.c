@@ -0,0 +1,312 @@
+/**
+ * BLE OTA Transport
+ */
+
+#include "ble_ota.h"
+#include "ble_service.h"
+#include "ota_writer.h"
+#include "ota_image.h"
+#include "sleep_manager.h"
+#include "coex_policy.h"
+#include "led.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "BLE_OTA";
+
+// Configuration
+#define BLE_OTA_CHUNK_SIZE      4096    // Flash write chunk
+#define BLE_OTA_IDLE_TIMEOUT_MS 10000   // Give up when the sender goes quiet
+#define BLE_OTA_PROGRESS_MS     1000
+#define BLE_OTA_ACK_EVERY       (BLE_OTA_WINDOW / 4)
+#define BLE_OTA_TASK_STACK      4096
+#define BLE_OTA_TASK_PRIORITY   5
+#define BLE_OTA_SEQ_LEN         2
+
+typedef struct {
+    uint16_t len;                   // 0 = end of image
+    uint8_t data[BLE_OTA_MAX_PAYLOAD];
+} ble_ota_packet_t;
+
+static ota_status_callback_t s_callback = NULL;
+static QueueHandle_t s_queue = NULL;    // Created on first use, kept afterwards
+static atomic_bool s_active = false;    // Transfer task running
+static atomic_bool s_receiving = false; // Accepting data packets
+static atomic_bool s_abort = false;
+static uint32_t s_size = 0;
+
+// BLE stack task side
+static uint16_t s_expected = 0;
+static bool s_gap_reported = false;
+static ble_ota_packet_t s_rx_packet;
+
+// Transfer task side
+static atomic_uint s_consumed_seq = 0;
+static atomic_uint s_consumed_bytes = 0;
+static ble_ota_packet_t s_packet;
+static const ble_ota_packet_t s_end_packet = { .len = 0 };
+
+static void notify_status(int progress, const char *status)
+{
+    ESP_LOGI(TAG, "[%d%%] %s", progress, status);
+    if (s_callback) {
+        s_callback(progress, status);
+    }
+}
+
+static void send_ack(void)
+{
+    uint16_t seq = (uint16_t)atomic_load(&s_consumed_seq);
+    uint32_t bytes = atomic_load(&s_consumed_bytes);
+    uint8_t msg[7] = {
+        BLE_OTA_ACK, seq & 0xFF, seq >> 8,
+        bytes & 0xFF, (bytes >> 8) & 0xFF, (bytes >> 16) & 0xFF, bytes >> 24,
+    };
+    ble_service_ota_notify(msg, sizeof(msg));
+}
+
+static void send_nack(uint16_t seq)
+{
+    uint8_t msg[3] = { BLE_OTA_NACK, seq & 0xFF, seq >> 8 };
+    ble_service_ota_notify(msg, sizeof(msg));
+}
+
+// Writes to the OTA characteristic (BLE stack task) - only sequence checks
+// and a copy into the queue, flashing happens on the transfer task
+static void on_ota_data(const uint8_t *data, uint16_t len)
+{
+    if (!atomic_load(&s_receiving) || len <= BLE_OTA_SEQ_LEN ||
+        len > BLE_OTA_SEQ_LEN + BLE_OTA_MAX_PAYLOAD) {
+        return;
+    }
+
+    uint16_t seq = data[0] | (data[1] << 8);
+    int16_t ahead = (int16_t)(seq - s_expected);
+    if (ahead != 0) {
+        // Go-back-N: report a gap once, then drop packets until the sender
+        // rewinds. Duplicates after a sender timeout get the ack it missed
+        if (!s_gap_reported) {
+            if (ahead > 0) {
+                send_nack(s_expected);
+            } else {
+                send_ack();
+            }
+            s_gap_reported = true;
+        }
+        return;
+    }
+
+    s_rx_packet.len = len - BLE_OTA_SEQ_LEN;
+    memcpy(s_rx_packet.data, data + BLE_OTA_SEQ_LEN, s_rx_packet.len);
+    if (xQueueSend(s_queue, &s_rx_packet, 0) != pdTRUE) {
+        // Sender ignored the window; make it resend from here
+        if (!s_gap_reported) {
+            send_nack(s_expected);
+            s_gap_reported = true;
+        }
+        return;
+    }
+    s_expected++;
+    s_gap_reported = false;
+}
+
+static void finish(int64_t start_us)
+{
+    esp_err_t err = ota_image_end();
+    if (err == ESP_OK) {
+        err = ota_writer_finish();
+    } else {
+        ota_writer_abort();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Finish failed: %s", esp_err_to_name(err));
+        notify_status(-1, "Update failed");
+        led_indicate_ota_fail();
+        return;
+    }
+
+    ota_manager_complete(atomic_load(&s_consumed_bytes), start_us);
+}
+
+static void transfer_task(void *arg)
+{
+    int64_t start_us = esp_timer_get_time();
+    int64_t last_progress_us = start_us;
+    uint32_t since_ack = 0;
+    bool done = false;
+
+    while (!done) {
+        if (xQueueReceive(s_queue, &s_packet, pdMS_TO_TICKS(BLE_OTA_IDLE_TIMEOUT_MS)) != pdTRUE) {
+            notify_status(-1, "Download failed (timeout)");
+            break;
+        }
+        if (atomic_load(&s_abort)) {
+            notify_status(-1, "Aborted");
+            break;
+        }
+        if (s_packet.len == 0) {
+            if (atomic_load(&s_consumed_bytes) != s_size) {
+                notify_status(-1, "Download failed (truncated)");
+            } else {
+                done = true;
+            }
+            break;
+        }
+
+        esp_err_t err = ota_image_feed(s_packet.data, s_packet.len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(err));
+            notify_status(-1, err == ESP_ERR_INVALID_VERSION ? "Download failed (delta base)"
+                                                             : "Download failed (flash)");
+            break;
+        }
+        atomic_fetch_add(&s_consumed_bytes, s_packet.len);
+        atomic_store(&s_consumed_seq, (atomic_load(&s_consumed_seq) + 1) & 0xFFFF);
+
+        // Ack once the packet is consumed, so the window tracks flash speed
+        if (++since_ack >= BLE_OTA_ACK_EVERY || uxQueueMessagesWaiting(s_queue) == 0) {
+            send_ack();
+            since_ack = 0;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_progress_us >= BLE_OTA_PROGRESS_MS * 1000LL) {
+            last_progress_us = now;
+            notify_status((int)((uint64_t)atomic_load(&s_consumed_bytes) * 100 / s_size), "Receiving");
+        }
+    }
+
+    atomic_store(&s_receiving, false);
+    if (done) {
+        finish(start_us);       // Restarts on success
+    } else {
+        ota_image_abort();
+        ota_writer_abort();
+        led_indicate_ota_fail();
+    }
+    sleep_manager_reset();
+    atomic_store(&s_active, false);
+    coex_policy_update();
+    vTaskDelete(NULL);
+}
+
+static void begin(const uint8_t *data, uint16_t len)
+{
+    if (len < 4) {
+        ble_service_send("BOTA:ERR:No size");
+        return;
+    }
+    if (atomic_load(&s_active) || ota_manager_is_in_progress() || ota_writer_is_active()) {
+        ble_service_send("BOTA:ERR:Busy");
+        return;
+    }
+    s_size = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    if (s_size == 0) {
+        ble_service_send("BOTA:ERR:No size");
+        return;
+    }
+
+    if (!s_queue) {
+        s_queue = xQueueCreate(BLE_OTA_WINDOW, sizeof(ble_ota_packet_t));
+        if (!s_queue) {
+            ble_service_send("BOTA:ERR:No memory");
+            return;
+        }
+    }
+    xQueueReset(s_queue);
+
+    esp_err_t err = ota_writer_begin(BLE_OTA_CHUNK_SIZE);
+    if (err == ESP_OK) {
+        err = ota_image_begin(0);
+        if (err != ESP_OK) {
+            ota_writer_abort();
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Begin failed: %s", esp_err_to_name(err));
+        ble_service_send("BOTA:ERR:Begin failed");
+        return;
+    }
+
+    s_expected = 0;
+    s_gap_reported = false;
+    atomic_store(&s_consumed_seq, 0);
+    atomic_store(&s_consumed_bytes, 0);
+    atomic_store(&s_abort, false);
+    atomic_store(&s_active, true);
+    if (xTaskCreate(transfer_task, "ble_ota", BLE_OTA_TASK_STACK, NULL, BLE_OTA_TASK_PRIORITY, NULL) != pdPASS) {
+        atomic_store(&s_active, false);
+        ota_image_abort();
+        ota_writer_abort();
+        ble_service_send("BOTA:ERR:No memory");
+        return;
+    }
+
+    // Packets carry whatever the negotiated MTU allows
+    uint16_t mtu = ble_service_get_mtu();
+    uint16_t payload = mtu > 3 + BLE_OTA_SEQ_LEN ? mtu - 3 - BLE_OTA_SEQ_LEN : 0;
+    if (payload > BLE_OTA_MAX_PAYLOAD) {
+        payload = BLE_OTA_MAX_PAYLOAD;
+    }
+    coex_policy_update();       // BT priority and a short connection interval
+    led_indicate_ota_progress();
+    ESP_LOGI(TAG, "Receiving %" PRIu32 " bytes, %d byte packets", s_size, payload);
+
+    atomic_store(&s_receiving, true);
+    char response[32];
+    snprintf(response, sizeof(response), "BOTA:READY:%d:%d", BLE_OTA_WINDOW, payload);
+    ble_service_send(response);
+}
+
+void ble_ota_command(const uint8_t *data, uint16_t len)
+{
+    if (len < 1) {
+        return;
+    }
+
+    switch (data[0]) {
+        case BLE_OTA_BEGIN:
+            begin(data + 1, len - 1);
+            break;
+
+        case BLE_OTA_END:
+            if (!atomic_load(&s_receiving)) {
+                ble_service_send("BOTA:ERR:Not started");
+                break;
+            }
+            // The sender ends once everything is acked, so there is room
+            atomic_store(&s_receiving, false);
+            xQueueSend(s_queue, &s_end_packet, pdMS_TO_TICKS(1000));
+            break;
+
+        case BLE_OTA_ABORT:
+            if (atomic_load(&s_active)) {
+                atomic_store(&s_receiving, false);
+                atomic_store(&s_abort, true);
+                xQueueSend(s_queue, &s_end_packet, 0);
+            }
+            break;
+
+        default:
+            ble_service_send("BOTA:ERR:Unknown");
+            break;
+    }
+}
+
+bool ble_ota_is_active(void)
+{
+    return atomic_load(&s_active);
+}
+
+void ble_ota_init(ota_status_callback_t callback)
+{
+    s_callback = callback;
+    ble_service_set_ota_callback(on_ota_data);
+}
@@ -0,0 +1,49 @@
+/**
+ * BLE OTA Transport - Header
+ * Firmware update straight over Bluetooth, for when there is no WiFi.
+ * The image (.bin or .zota) is streamed as write-without-response packets
+ * on the OTA characteristic (6e400004) under a sliding window; the
+ * device acks what it has consumed, so the sender never outruns flash.
+ *
+ * Control, on the command characteristic: CMD_BLE_OTA (0x68) + sub command
+ *   BEGIN  0x01 + image size (u32 LE)   -> "BOTA:READY:<window>:<max payload>"
+ *   END    0x02                         -> "OTA:100:..." then restart
+ *   ABORT  0x03
+ * Data, written to the OTA characteristic:
+ *   seq (u16 LE) + payload (up to max payload bytes)
+ * Notifications on the OTA characteristic:
+ *   ACK    0x01 + next seq (u16 LE) + bytes consumed (u32 LE)
+ *   NACK   0x02 + expected seq (u16 LE) - resend from there
+ */
+
+#ifndef BLE_OTA_H
+#define BLE_OTA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ota_manager.h"
+
+// Sub commands
+#define BLE_OTA_BEGIN           0x01
+#define BLE_OTA_END             0x02
+#define BLE_OTA_ABORT           0x03
+
+// Notifications
+#define BLE_OTA_ACK             0x01
+#define BLE_OTA_NACK            0x02
+
+// Packets in flight, and largest payload per packet (local MTU 500 - ATT
+// header - sequence number)
+#define BLE_OTA_WINDOW          16
+#define BLE_OTA_MAX_PAYLOAD     495
+
+// Register with the BLE service. Progress is reported through callback
+void ble_ota_init(ota_status_callback_t callback);
+
+// Handle a CMD_BLE_OTA command (without the command byte)
+void ble_ota_command(const uint8_t *data, uint16_t len);
+
+// Check if a BLE transfer is running
+bool ble_ota_is_active(void);
+
+#endif // BLE_OTA_H
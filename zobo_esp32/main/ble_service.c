@@ -1,200 +1,367 @@
 /**
  * BLE UART Service
+ * Host independent part: TX coalescing, acks and connection profiles. The
+ * GATT table and link events live in the host backend (see ble_host.h).
  */
 
 #include "ble_service.h"
+#include "ble_host.h"
+#include "coex_policy.h"
+#include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "esp_bt.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_bt_main.h"
-#include "esp_gatt_common_api.h"
+#include "esp_timer.h"
 
 static const char *TAG = "BLE";
 
-// Nordic UART Service UUIDs
-static uint8_t service_uuid[16] = {
-    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
-    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E
-};
+// TX coalescing
+#define BLE_TX_RING_SIZE        1024    // Power of two
+#define BLE_TX_MAX_MSG_LEN      255     // Longer strings are truncated
+#define BLE_TX_COALESCE_MS      5       // Wait this long for more strings before sending
+#define BLE_TX_TASK_STACK       3072
+#define BLE_TX_TASK_PRIORITY    5
+#define BLE_ATT_MAX_PAYLOAD     500     // Matches the TX characteristic max length
+#define BLE_DEFAULT_MTU         23
+#define BLE_DLE_DEFAULT_OCTETS  27
 
-static uint8_t char_rx_uuid[16] = {
-    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
-    0x93, 0xF3, 0xA3, 0xB5, 0x02, 0x00, 0x40, 0x6E
-};
+// Connection profiles: interval (1.25 ms units), peripheral latency and
+// supervision timeout (10 ms units)
+typedef struct {
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;
+    uint16_t timeout;
+} ble_conn_params_t;
 
-static uint8_t char_tx_uuid[16] = {
-    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
-    0x93, 0xF3, 0xA3, 0xB5, 0x03, 0x00, 0x40, 0x6E
+static const ble_conn_params_t s_conn_params[BLE_CONN_PROFILE_COUNT] = {
+    [BLE_CONN_PROFILE_IDLE]    = { 80, 160, 4, 600 },   // 100-200 ms, may skip 4 events
+    [BLE_CONN_PROFILE_NORMAL]  = { 24, 40, 0, 400 },    // 30-50 ms
+    [BLE_CONN_PROFILE_DRIVING] = { 6, 12, 0, 400 },     // 7.5-15 ms
 };
 
+// iOS refuses intervals below 15 ms; a rejected DRIVING request is retried
+// once with this range
+#define BLE_CONN_DRIVING_FALLBACK_MIN   12      // 15 ms
+#define BLE_CONN_DRIVING_FALLBACK_MAX   24      // 30 ms
+
+// Cumulative ack interval limits
+#define BLE_ACK_INTERVAL_MIN_MS 20
+#define BLE_ACK_INTERVAL_MAX_MS 5000
+
 // State variables
-static uint16_t s_gatts_if = ESP_GATT_IF_NONE;
-static uint16_t s_conn_id = 0;
 static bool s_connected = false;
 static bool s_notify_enabled = false;
 static ble_command_callback_t s_command_callback = NULL;
+static uint16_t s_mtu = BLE_DEFAULT_MTU;
 
-// GATT handles
-enum {
-    IDX_SVC,
-    IDX_CHAR_TX,
-    IDX_CHAR_TX_VAL,
-    IDX_CHAR_TX_CFG,
-    IDX_CHAR_RX,
-    IDX_CHAR_RX_VAL,
-    IDX_NB,
-};
+// Connection parameters: wanted profile, what the link runs, and at most
+// one update procedure in flight
+static portMUX_TYPE s_conn_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_conn_profile_t s_conn_profile = BLE_CONN_PROFILE_NORMAL;
+static ble_conn_profile_t s_conn_requested = BLE_CONN_PROFILE_COUNT;
+static ble_conn_profile_t s_conn_applied = BLE_CONN_PROFILE_COUNT;    // None yet
+static bool s_conn_pending = false;
+static bool s_conn_fallback = false;
+static uint16_t s_conn_interval = 0;
+static uint16_t s_conn_latency = 0;
+static uint16_t s_conn_timeout = 0;
+static uint16_t s_dle_tx = BLE_DLE_DEFAULT_OCTETS;
+static uint16_t s_dle_rx = BLE_DLE_DEFAULT_OCTETS;
 
-static uint16_t s_handle_table[IDX_NB];
+// OTA characteristic
+static bool s_ota_notify_enabled = false;
+static ble_data_callback_t s_ota_callback = NULL;
 
-// Advertising parameters
-static esp_ble_adv_params_t s_adv_params = {
-    .adv_int_min = 0x20,
-    .adv_int_max = 0x40,
-    .adv_type = ADV_TYPE_IND,
-    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-    .channel_map = ADV_CHNL_ALL,
-    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-};
+// Telemetry characteristic
+static bool s_telem_notify_enabled = false;
+static int8_t s_rssi = 0;
 
-static uint8_t s_adv_data[] = {
-    0x02, 0x01, 0x06,
-    0x05, 0x09, 'Z', 'o', 'b', 'o',
-    0x11, 0x07,
-    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
-    0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E
-};
+// Advertising interval in use
+static bool s_adv_slow = false;
 
-// GATT database
-static const esp_gatts_attr_db_t s_gatt_db[IDX_NB] = {
-    [IDX_SVC] = {
-        {ESP_GATT_AUTO_RSP},
-        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_PRI_SERVICE},
-         ESP_GATT_PERM_READ, sizeof(service_uuid), sizeof(service_uuid), service_uuid}
-    },
-    [IDX_CHAR_TX] = {
-        {ESP_GATT_AUTO_RSP},
-        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
-         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_NOTIFY}}
-    },
-    [IDX_CHAR_TX_VAL] = {
-        {ESP_GATT_AUTO_RSP},
-        {ESP_UUID_LEN_128, char_tx_uuid, 0, 500, 0, NULL}
-    },
-    [IDX_CHAR_TX_CFG] = {
-        {ESP_GATT_AUTO_RSP},
-        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
-         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 2, 0, NULL}
-    },
-    [IDX_CHAR_RX] = {
-        {ESP_GATT_AUTO_RSP},
-        {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
-         ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&(uint8_t){ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR}}
-    },
-    [IDX_CHAR_RX_VAL] = {
-        {ESP_GATT_RSP_BY_APP},
-        {ESP_UUID_LEN_128, char_rx_uuid, ESP_GATT_PERM_WRITE, 500, 0, NULL}
-    },
-};
+// Boot timing (esp_timer us, 0 until it happens)
+static int64_t s_first_adv_us = 0;
+static int64_t s_first_connect_us = 0;
+
+// TX ring of length-prefixed strings, drained by the TX task
+static uint8_t s_tx_ring[BLE_TX_RING_SIZE];
+static uint32_t s_tx_head = 0;     // Write counter
+static uint32_t s_tx_tail = 0;     // Read counter
+static uint32_t s_tx_dropped = 0;
+static portMUX_TYPE s_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_tx_frame[BLE_ATT_MAX_PAYLOAD];
+static TaskHandle_t s_tx_task = NULL;
+static StaticTask_t s_tx_task_buf;
+static StackType_t s_tx_task_stack[BLE_TX_TASK_STACK];
+
+// Ack state
+static volatile ble_ack_mode_t s_ack_mode = BLE_ACK_MODE_LEGACY;
+static volatile uint16_t s_ack_interval_ms = 100;
+static volatile uint16_t s_ack_last_seq = 0;
+static volatile uint16_t s_ack_pending = 0;
+
+// Ask for the wanted profile unless it is in place or a request is pending
+static void request_conn_params(bool fallback)
+{
+    portENTER_CRITICAL(&s_conn_lock);
+    ble_conn_profile_t profile = s_conn_profile;
+    bool start = s_connected && !s_conn_pending && (fallback || profile != s_conn_applied);
+    if (start) {
+        s_conn_pending = true;
+        s_conn_requested = profile;
+        s_conn_fallback = fallback;
+    }
+    portEXIT_CRITICAL(&s_conn_lock);
+    if (!start) {
+        return;
+    }
+
+    const ble_conn_params_t *p = &s_conn_params[profile];
+    if (ble_host_update_conn_params(fallback ? BLE_CONN_DRIVING_FALLBACK_MIN : p->min_int,
+                                    fallback ? BLE_CONN_DRIVING_FALLBACK_MAX : p->max_int,
+                                    p->latency, p->timeout) != ESP_OK) {
+        s_conn_pending = false;
+    }
+}
+
+void ble_service_on_conn_params(int status, uint16_t interval, uint16_t latency,
+                                uint16_t timeout)
+{
+    bool retry_fallback = false;
+
+    if (status == 0) {
+        s_conn_interval = interval;
+        s_conn_latency = latency;
+        s_conn_timeout = timeout;
+        ESP_LOGI(TAG, "Connection interval %.2f ms, latency %d, timeout %d ms",
+                 s_conn_interval * 1.25f, s_conn_latency, s_conn_timeout * 10);
+    } else {
+        ESP_LOGW(TAG, "Connection parameters for %s rejected (%d)",
+                 ble_service_conn_profile_name(s_conn_requested), status);
+        retry_fallback = s_conn_pending && s_conn_requested == BLE_CONN_PROFILE_DRIVING && !s_conn_fallback;
+    }
+
+    // Updates the central starts on its own arrive here too
+    if (s_conn_pending) {
+        // A rejection is final (apart from the one fallback), no retry loop
+        s_conn_applied = s_conn_requested;
+        s_conn_pending = false;
+    }
+    request_conn_params(retry_fallback);
+}
+
+void ble_service_on_connect(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    ESP_LOGI(TAG, "Device connected");
+    if (s_first_connect_us == 0) {
+        s_first_connect_us = esp_timer_get_time();
+    }
+    s_connected = true;
+    // Whatever the phone picked, until our profile is accepted
+    s_conn_interval = interval;
+    s_conn_latency = latency;
+    s_conn_timeout = timeout;
+    request_conn_params(false);
+    coex_policy_update();
+}
+
+void ble_service_on_disconnect(void)
+{
+    ESP_LOGI(TAG, "Device disconnected");
+    s_connected = false;
+    s_notify_enabled = false;
+    s_ota_notify_enabled = false;
+    s_telem_notify_enabled = false;
+    s_rssi = 0;
+    s_mtu = BLE_DEFAULT_MTU;
+    s_ack_mode = BLE_ACK_MODE_LEGACY;
+    s_ack_pending = 0;
+    s_conn_applied = BLE_CONN_PROFILE_COUNT;
+    s_conn_pending = false;
+    s_conn_interval = 0;
+    s_dle_tx = BLE_DLE_DEFAULT_OCTETS;
+    s_dle_rx = BLE_DLE_DEFAULT_OCTETS;
+    coex_policy_update();       // May have to pause the advertising the host restarts
+}
+
+void ble_service_on_mtu(uint16_t mtu)
+{
+    s_mtu = mtu;
+    ESP_LOGI(TAG, "MTU: %d", s_mtu);
+}
+
+void ble_service_on_write(ble_host_char_t chr, uint8_t *data, uint16_t len)
+{
+    if (chr == BLE_HOST_CHAR_RX) {
+        if (s_command_callback) {
+            s_command_callback(data, len);
+        }
+    } else if (chr == BLE_HOST_CHAR_OTA) {
+        if (s_ota_callback) {
+            s_ota_callback(data, len);
+        }
+    }
+}
 
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+void ble_service_on_subscribe(ble_host_char_t chr, bool enabled)
 {
-    switch (event) {
-        case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
-            esp_ble_gap_start_advertising(&s_adv_params);
+    switch (chr) {
+        case BLE_HOST_CHAR_TX:
+            s_notify_enabled = enabled;
+            ESP_LOGI(TAG, "Notifications %s", enabled ? "enabled" : "disabled");
             break;
-        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-            if (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS) {
-                ESP_LOGI(TAG, "Advertising started");
-            }
+        case BLE_HOST_CHAR_OTA:
+            s_ota_notify_enabled = enabled;
+            break;
+        case BLE_HOST_CHAR_TELEM:
+            s_telem_notify_enabled = enabled;
             break;
         default:
             break;
     }
 }
 
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param)
+void ble_service_on_data_len(uint16_t tx_octets, uint16_t rx_octets)
 {
-    switch (event) {
-        case ESP_GATTS_REG_EVT:
-            ESP_LOGI(TAG, "GATT server registered");
-            s_gatts_if = gatts_if;
-            esp_ble_gap_config_adv_data_raw(s_adv_data, sizeof(s_adv_data));
-            esp_ble_gatts_create_attr_tab(s_gatt_db, gatts_if, IDX_NB, 0);
-            break;
+    s_dle_tx = tx_octets;
+    s_dle_rx = rx_octets;
+    ESP_LOGI(TAG, "Data length: rx %d, tx %d", s_dle_rx, s_dle_tx);
+}
 
-        case ESP_GATTS_CREAT_ATTR_TAB_EVT:
-            if (param->add_attr_tab.status == ESP_GATT_OK) {
-                memcpy(s_handle_table, param->add_attr_tab.handles, sizeof(s_handle_table));
-                esp_ble_gatts_start_service(s_handle_table[IDX_SVC]);
-                ESP_LOGI(TAG, "Service started");
-            }
-            break;
+void ble_service_on_rssi(int8_t rssi)
+{
+    s_rssi = rssi;
+}
 
-        case ESP_GATTS_CONNECT_EVT:
-            ESP_LOGI(TAG, "Device connected");
-            s_connected = true;
-            s_conn_id = param->connect.conn_id;
-            break;
+void ble_service_on_adv_started(void)
+{
+    if (s_first_adv_us == 0) {
+        s_first_adv_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "Advertising started %" PRId64 " ms after boot", s_first_adv_us / 1000);
+    } else {
+        ESP_LOGI(TAG, "Advertising started");
+    }
+}
 
-        case ESP_GATTS_DISCONNECT_EVT:
-            ESP_LOGI(TAG, "Device disconnected");
-            s_connected = false;
-            s_notify_enabled = false;
-            esp_ble_gap_start_advertising(&s_adv_params);
-            break;
+// Append one string to the TX ring. Returns false if there is no room.
+static bool tx_ring_push(const char *data)
+{
+    size_t len = strlen(data);
+    if (len == 0) {
+        return true;
+    }
+    if (len > BLE_TX_MAX_MSG_LEN) {
+        len = BLE_TX_MAX_MSG_LEN;
+    }
+
+    bool ok = false;
+    portENTER_CRITICAL(&s_tx_lock);
+    if (BLE_TX_RING_SIZE - (s_tx_head - s_tx_tail) >= len + 1) {
+        s_tx_ring[s_tx_head++ & (BLE_TX_RING_SIZE - 1)] = (uint8_t)len;
+        for (size_t i = 0; i < len; i++) {
+            s_tx_ring[s_tx_head++ & (BLE_TX_RING_SIZE - 1)] = (uint8_t)data[i];
+        }
+        ok = true;
+    } else {
+        s_tx_dropped++;
+    }
+    portEXIT_CRITICAL(&s_tx_lock);
+    return ok;
+}
 
-        case ESP_GATTS_WRITE_EVT:
-            if (param->write.handle == s_handle_table[IDX_CHAR_RX_VAL]) {
-                if (s_command_callback) {
-                    s_command_callback(param->write.value, param->write.len);
-                }
-                if (param->write.need_rsp) {
-                    esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
-                                               param->write.trans_id, ESP_GATT_OK, NULL);
-                }
-            } else if (param->write.handle == s_handle_table[IDX_CHAR_TX_CFG]) {
-                if (param->write.len == 2) {
-                    uint16_t cccd = param->write.value[0] | (param->write.value[1] << 8);
-                    s_notify_enabled = (cccd == 0x0001);
-                    ESP_LOGI(TAG, "Notifications %s", s_notify_enabled ? "enabled" : "disabled");
-                }
+// Pop as many whole strings as fit into max_len bytes, '\n' separated
+static uint16_t tx_ring_pop_frame(uint8_t *out, uint16_t max_len)
+{
+    uint16_t used = 0;
+
+    portENTER_CRITICAL(&s_tx_lock);
+    while (s_tx_tail != s_tx_head) {
+        uint8_t len = s_tx_ring[s_tx_tail & (BLE_TX_RING_SIZE - 1)];
+        uint16_t needed = len + (used > 0 ? 1 : 0);
+
+        if (used + needed > max_len) {
+            if (used > 0) {
+                break;
             }
-            break;
+            // Single string longer than the MTU - send what fits
+            needed = max_len;
+        }
 
-        default:
-            break;
+        if (used > 0) {
+            out[used++] = '\n';
+            needed--;
+        }
+        uint32_t src = s_tx_tail + 1;
+        for (uint16_t i = 0; i < needed; i++) {
+            out[used++] = s_tx_ring[(src + i) & (BLE_TX_RING_SIZE - 1)];
+        }
+        s_tx_tail += 1 + len;
     }
+    portEXIT_CRITICAL(&s_tx_lock);
+
+    return used;
 }
 
-esp_err_t ble_service_init(void)
+static void queue_cumulative_ack(void)
+{
+    if (s_ack_pending == 0) {
+        return;
+    }
+    char buf[24];
+    snprintf(buf, sizeof(buf), "ACK:%u:%u", s_ack_last_seq, s_ack_pending);
+    s_ack_pending = 0;
+    tx_ring_push(buf);
+}
+
+static void tx_task(void *arg)
 {
-    // Release classic BT memory
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+    TickType_t last_ack = xTaskGetTickCount();
+
+    while (1) {
+        bool cumulative = (s_ack_mode == BLE_ACK_MODE_CUMULATIVE);
+        TickType_t wait = cumulative ? pdMS_TO_TICKS(s_ack_interval_ms) : portMAX_DELAY;
+
+        if (ulTaskNotifyTake(pdTRUE, wait) > 0) {
+            // Give bursts of status strings a moment to pile up
+            TickType_t window = pdMS_TO_TICKS(BLE_TX_COALESCE_MS);
+            vTaskDelay(window > 0 ? window : 1);
+        }
 
-    // Initialize BT controller
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_bt_controller_init(&bt_cfg));
-    ESP_ERROR_CHECK(esp_bt_controller_enable(ESP_BT_MODE_BLE));
+        if (cumulative && xTaskGetTickCount() - last_ack >= pdMS_TO_TICKS(s_ack_interval_ms)) {
+            last_ack = xTaskGetTickCount();
+            queue_cumulative_ack();
+        }
 
-    // Initialize Bluedroid
-    ESP_ERROR_CHECK(esp_bluedroid_init());
-    ESP_ERROR_CHECK(esp_bluedroid_enable());
+        uint16_t max_len = s_mtu - 3;
+        if (max_len > BLE_ATT_MAX_PAYLOAD) {
+            max_len = BLE_ATT_MAX_PAYLOAD;
+        }
+
+        uint16_t len;
+        while ((len = tx_ring_pop_frame(s_tx_frame, max_len)) > 0) {
+            if (s_connected && s_notify_enabled) {
+                ble_host_notify(BLE_HOST_CHAR_TX, s_tx_frame, len);
+            }
+        }
+    }
+}
 
-    // Register callbacks
-    ESP_ERROR_CHECK(esp_ble_gatts_register_callback(gatts_event_handler));
-    ESP_ERROR_CHECK(esp_ble_gap_register_callback(gap_event_handler));
-    ESP_ERROR_CHECK(esp_ble_gatts_app_register(0));
-    ESP_ERROR_CHECK(esp_ble_gatt_set_local_mtu(500));
+esp_err_t ble_service_init(void)
+{
+    s_tx_task = xTaskCreateStatic(tx_task, "ble_tx", BLE_TX_TASK_STACK, NULL, BLE_TX_TASK_PRIORITY,
+                                  s_tx_task_stack, &s_tx_task_buf);
+    if (!s_tx_task) {
+        return ESP_FAIL;
+    }
 
-    ESP_LOGI(TAG, "BLE service initialized");
-    return ESP_OK;
+    esp_err_t ret = ble_host_init();
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "BLE service initialized");
+    }
+    return ret;
 }
 
 void ble_service_set_callback(ble_command_callback_t callback)
@@ -204,10 +371,64 @@ void ble_service_set_callback(ble_command_callback_t callback)
 
 void ble_service_send(const char *data)
 {
-    if (s_connected && s_notify_enabled && s_gatts_if != ESP_GATT_IF_NONE) {
-        esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id,
-                                    s_handle_table[IDX_CHAR_TX_VAL],
-                                    strlen(data), (uint8_t *)data, false);
+    if (!s_connected || !s_notify_enabled || !s_tx_task) {
+        return;
+    }
+    if (tx_ring_push(data)) {
+        xTaskNotifyGive(s_tx_task);
+    }
+}
+
+void ble_service_set_ack_mode(ble_ack_mode_t mode, uint16_t interval_ms)
+{
+    if (interval_ms < BLE_ACK_INTERVAL_MIN_MS) {
+        interval_ms = BLE_ACK_INTERVAL_MIN_MS;
+    } else if (interval_ms > BLE_ACK_INTERVAL_MAX_MS) {
+        interval_ms = BLE_ACK_INTERVAL_MAX_MS;
+    }
+    s_ack_interval_ms = interval_ms;
+    s_ack_pending = 0;
+    s_ack_mode = mode;
+
+    // Wake the TX task so it picks up the new wait interval
+    if (s_tx_task) {
+        xTaskNotifyGive(s_tx_task);
+    }
+    ESP_LOGI(TAG, "Ack mode %d, interval %d ms", mode, interval_ms);
+}
+
+ble_ack_mode_t ble_service_get_ack_mode(uint16_t *interval_ms)
+{
+    if (interval_ms) {
+        *interval_ms = s_ack_interval_ms;
+    }
+    return s_ack_mode;
+}
+
+void ble_service_ack(void)
+{
+    if (s_ack_mode == BLE_ACK_MODE_LEGACY) {
+        ble_service_send("OK");
+    }
+}
+
+void ble_service_ack_seq(uint16_t seq)
+{
+    char buf[16];
+
+    switch (s_ack_mode) {
+        case BLE_ACK_MODE_PER_SEQ:
+            snprintf(buf, sizeof(buf), "ACK:%u", seq);
+            ble_service_send(buf);
+            break;
+
+        case BLE_ACK_MODE_CUMULATIVE:
+            s_ack_last_seq = seq;
+            s_ack_pending++;
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -216,10 +437,101 @@ bool ble_service_is_connected(void)
     return s_connected;
 }
 
+uint16_t ble_service_get_mtu(void)
+{
+    return s_mtu;
+}
+
+void ble_service_set_ota_callback(ble_data_callback_t callback)
+{
+    s_ota_callback = callback;
+}
+
+bool ble_service_ota_notify(const uint8_t *data, uint16_t len)
+{
+    if (!s_connected || !s_ota_notify_enabled) {
+        return false;
+    }
+    return ble_host_notify(BLE_HOST_CHAR_OTA, data, len);
+}
+
+bool ble_service_telemetry_subscribed(void)
+{
+    return s_connected && s_telem_notify_enabled;
+}
+
+bool ble_service_telemetry_notify(const uint8_t *data, uint16_t len)
+{
+    if (!s_connected || !s_telem_notify_enabled) {
+        return false;
+    }
+    return ble_host_notify(BLE_HOST_CHAR_TELEM, data, len);
+}
+
+void ble_service_read_rssi(void)
+{
+    if (s_connected) {
+        ble_host_read_rssi();
+    }
+}
+
+int8_t ble_service_get_rssi(void)
+{
+    return s_rssi;
+}
+
+void ble_service_set_conn_profile(ble_conn_profile_t profile)
+{
+    if (profile >= BLE_CONN_PROFILE_COUNT) {
+        return;
+    }
+    s_conn_profile = profile;
+    request_conn_params(false);
+}
+
+void ble_service_get_conn_info(ble_conn_info_t *info)
+{
+    info->profile = s_conn_profile;
+    info->interval = s_connected ? s_conn_interval : 0;
+    info->latency = s_conn_latency;
+    info->timeout = s_conn_timeout;
+    info->mtu = s_mtu;
+    info->tx_octets = s_dle_tx;
+    info->rx_octets = s_dle_rx;
+}
+
+const char *ble_service_conn_profile_name(ble_conn_profile_t profile)
+{
+    static const char *names[BLE_CONN_PROFILE_COUNT] = { "idle", "normal", "driving" };
+    return profile < BLE_CONN_PROFILE_COUNT ? names[profile] : "none";
+}
+
+void ble_service_set_adv_slow(bool slow)
+{
+    if (s_adv_slow == slow) {
+        return;
+    }
+
+    s_adv_slow = slow;
+    ble_host_set_adv_interval(slow ? BLE_ADV_INTERVAL_SLOW_MIN : BLE_ADV_INTERVAL_FAST_MIN,
+                              slow ? BLE_ADV_INTERVAL_SLOW_MAX : BLE_ADV_INTERVAL_FAST_MAX);
+    ESP_LOGI(TAG, "Advertising interval %s", slow ? "slow" : "fast");
+}
+
+int64_t ble_service_get_first_adv_us(void)
+{
+    return s_first_adv_us;
+}
+
+int64_t ble_service_get_first_connect_us(void)
+{
+    return s_first_connect_us;
+}
+
 void ble_service_pause(void)
 {
     ESP_LOGI(TAG, "Pausing BLE advertising...");
-    esp_ble_gap_stop_advertising();
+    ble_host_adv_stop();
     vTaskDelay(pdMS_TO_TICKS(100));
     ESP_LOGI(TAG, "BLE advertising stopped");
 }
@@ -227,6 +539,6 @@ void ble_service_pause(void)
 void ble_service_resume(void)
 {
     ESP_LOGI(TAG, "Resuming BLE advertising...");
-    esp_ble_gap_start_advertising(&s_adv_params);
+    ble_host_adv_start();
     ESP_LOGI(TAG, "BLE advertising resumed");
 }
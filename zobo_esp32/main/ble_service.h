@@ -9,22 +9,111 @@
 #include <stdint.h>
 #include "esp_err.h"
 
+// Acknowledgement mode, negotiated per connection (reset on disconnect)
+typedef enum {
+    BLE_ACK_MODE_LEGACY,        // "OK" after every command (default)
+    BLE_ACK_MODE_NONE,          // No acknowledgements
+    BLE_ACK_MODE_PER_SEQ,       // "ACK:<seq>" for every sequenced frame
+    BLE_ACK_MODE_CUMULATIVE,    // "ACK:<last seq>:<count>" every interval
+} ble_ack_mode_t;
+
 // Command callback - called when data received via BLE
 typedef void (*ble_command_callback_t)(uint8_t *data, uint16_t len);
 
+// Raw characteristic data callback (runs in the BLE stack task - keep short)
+typedef void (*ble_data_callback_t)(const uint8_t *data, uint16_t len);
+
 // Initialize BLE service
 esp_err_t ble_service_init(void);
 
 // Set command callback
 void ble_service_set_callback(ble_command_callback_t callback);
 
-// Send data to connected client
+// Queue a status string for the connected client
+// Pending strings are coalesced into one notification ('\n' separated) up to the MTU
 void ble_service_send(const char *data);
 
+// Set acknowledgement mode (interval_ms only used by BLE_ACK_MODE_CUMULATIVE)
+void ble_service_set_ack_mode(ble_ack_mode_t mode, uint16_t interval_ms);
+
+// Get acknowledgement mode and effective cumulative interval
+ble_ack_mode_t ble_service_get_ack_mode(uint16_t *interval_ms);
+
+// Acknowledge an unsequenced command (only replies in BLE_ACK_MODE_LEGACY)
+void ble_service_ack(void);
+
+// Acknowledge a sequenced frame according to the current ack mode
+void ble_service_ack_seq(uint16_t seq);
+
 // Check if device is connected
 bool ble_service_is_connected(void);
 
-// Pause BLE (for WiFi coexistence)
+// Negotiated ATT MTU of the current connection
+uint16_t ble_service_get_mtu(void);
+
+// Set the handler for writes to the OTA characteristic (6e400004)
+void ble_service_set_ota_callback(ble_data_callback_t callback);
+
+// Notify on the OTA characteristic. False if not connected / subscribed
+bool ble_service_ota_notify(const uint8_t *data, uint16_t len);
+
+// Telemetry characteristic (6e400005): subscription state and notify
+bool ble_service_telemetry_subscribed(void);
+bool ble_service_telemetry_notify(const uint8_t *data, uint16_t len);
+
+// Refresh the link RSSI (asynchronous) and read the last value (dBm, 0 =
+// unknown)
+void ble_service_read_rssi(void);
+int8_t ble_service_get_rssi(void);
+
+// Connection parameter profiles requested from the central. The original
+// ESP32 is a BLE 4.2 controller: 1M PHY only, Data Length Extension is
+// requested on every connect
+typedef enum {
+    BLE_CONN_PROFILE_IDLE,      // 100-200 ms, latency 4 - power saving
+    BLE_CONN_PROFILE_NORMAL,    // 30-50 ms
+    BLE_CONN_PROFILE_DRIVING,   // 7.5-15 ms, no latency (15-30 ms on iOS)
+    BLE_CONN_PROFILE_COUNT
+} ble_conn_profile_t;
+
+// What the link is running with
+typedef struct {
+    ble_conn_profile_t profile; // Requested
+    uint16_t interval;          // 1.25 ms units, 0 when not connected
+    uint16_t latency;           // Connection events the peripheral may skip
+    uint16_t timeout;           // Supervision timeout, 10 ms units
+    uint16_t mtu;
+    uint16_t tx_octets;         // Link layer payload (27 without DLE)
+    uint16_t rx_octets;
+} ble_conn_info_t;
+
+// Request a profile. Applied now if connected, otherwise on connect;
+// the last request wins. Only coex_policy calls this, everything else
+// goes through it
+void ble_service_set_conn_profile(ble_conn_profile_t profile);
+
+// Negotiated connection parameters
+void ble_service_get_conn_info(ble_conn_info_t *info);
+
+// Name of a profile for reports
+const char *ble_service_conn_profile_name(ble_conn_profile_t profile);
+
+// Advertising intervals (0.625 ms units). Slow advertising still keeps a
+// reconnect within ~0.5 s while letting the chip sleep between events
+#define BLE_ADV_INTERVAL_FAST_MIN   0x20    // 20 ms
+#define BLE_ADV_INTERVAL_FAST_MAX   0x40    // 40 ms
+#define BLE_ADV_INTERVAL_SLOW_MIN   0x0320  // 500 ms
+#define BLE_ADV_INTERVAL_SLOW_MAX   0x0360  // 540 ms
+
+// Switch between fast and slow connectable advertising
+void ble_service_set_adv_slow(bool slow);
+
+// Boot timing: time of first advertising start / first connection
+// (esp_timer microseconds, 0 if it hasn't happened yet)
+int64_t ble_service_get_first_adv_us(void);
+int64_t ble_service_get_first_connect_us(void);
+
+// Pause BLE advertising (for WiFi coexistence, see coex_policy.h)
 void ble_service_pause(void);
 
 // Resume BLE
@@ -0,0 +1,241 @@
+/**
+ * Coexistence Policy
+ */
+
+#include "coex_policy.h"
+#include "ble_service.h"
+#include "ble_ota.h"
+#include "ota_manager.h"
+#include "sleep_manager.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_coexist.h"
+#include "esp_wifi.h"
+
+static const char *TAG = "COEX";
+
+#define COEX_TASK_STACK         2560
+#define COEX_TASK_PRIORITY      2
+
+typedef struct {
+    esp_coex_prefer_t prefer;
+    wifi_ps_type_t wifi_ps;         // WIFI_PS_NONE is not allowed while BT is on
+    ble_conn_profile_t conn;
+    bool pause_adv;                 // Stop advertising while nobody is connected
+} coex_profile_t;
+
+static const coex_profile_t s_profiles[COEX_MODE_COUNT] = {
+    [COEX_MODE_BALANCED] = { ESP_COEX_PREFER_BALANCE, WIFI_PS_MIN_MODEM, BLE_CONN_PROFILE_NORMAL,  false },
+    [COEX_MODE_DRIVING]  = { ESP_COEX_PREFER_BT,      WIFI_PS_MAX_MODEM, BLE_CONN_PROFILE_DRIVING, false },
+    [COEX_MODE_OTA]      = { ESP_COEX_PREFER_WIFI,    WIFI_PS_MIN_MODEM, BLE_CONN_PROFILE_NORMAL,  true  },
+};
+
+_Static_assert(COEX_MODE_COUNT <= LATENCY_PROFILE_COUNT, "one latency profile per mode");
+
+static const char *s_mode_names[COEX_MODE_COUNT] = {
+    "auto", "balanced", "driving", "ota",
+};
+
+static TaskHandle_t s_task = NULL;
+static StaticTask_t s_task_buf;
+static StackType_t s_task_stack[COEX_TASK_STACK];
+static _Atomic coex_mode_t s_mode = COEX_MODE_AUTO;
+static _Atomic coex_mode_t s_active = COEX_MODE_BALANCED;
+static _Atomic uint32_t s_last_drive_ms = 0;
+static atomic_bool s_driving = false;
+static _Atomic ble_conn_profile_t s_conn_override = BLE_CONN_PROFILE_COUNT;    // None
+
+// Policy task only
+static bool s_applied = false;
+static bool s_applied_connected = false;
+static ble_conn_profile_t s_applied_conn = BLE_CONN_PROFILE_COUNT;
+static bool s_adv_paused = false;
+
+static inline uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static coex_mode_t choose_profile(void)
+{
+    coex_mode_t mode = atomic_load(&s_mode);
+    if (mode != COEX_MODE_AUTO) {
+        return mode;
+    }
+    // BLE firmware transfers want the same airtime as driving
+    if (atomic_load(&s_driving) || ble_ota_is_active()) {
+        return COEX_MODE_DRIVING;
+    }
+    if (ota_manager_is_in_progress()) {
+        return COEX_MODE_OTA;
+    }
+    return COEX_MODE_BALANCED;
+}
+
+// The only place the connection profile is picked: a CMD_CONN_PARAMS
+// override, then driving, then the sleep manager's idle tier
+static ble_conn_profile_t choose_conn(coex_mode_t profile)
+{
+    ble_conn_profile_t conn = atomic_load(&s_conn_override);
+    if (conn != BLE_CONN_PROFILE_COUNT) {
+        return conn;
+    }
+    conn = s_profiles[profile].conn;
+    if (conn != BLE_CONN_PROFILE_DRIVING && sleep_manager_get_state() == SLEEP_STATE_IDLE) {
+        return BLE_CONN_PROFILE_IDLE;
+    }
+    return conn;
+}
+
+static void apply(coex_mode_t profile, bool connected)
+{
+    const coex_profile_t *p = &s_profiles[profile];
+
+    esp_coex_preference_set(p->prefer);
+    esp_wifi_set_ps(p->wifi_ps);        // Not initialized yet is fine, retried on WiFi changes
+
+    if (p->pause_adv && !connected && !s_adv_paused) {
+        ble_service_pause();
+        s_adv_paused = true;
+    } else if (s_adv_paused && (!p->pause_adv || connected)) {
+        if (!connected) {
+            ble_service_resume();
+        }
+        s_adv_paused = false;
+    }
+}
+
+static void evaluate(void)
+{
+    if (atomic_load(&s_driving) &&
+        now_ms() - atomic_load(&s_last_drive_ms) >= COEX_DRIVE_HOLD_MS) {
+        atomic_store(&s_driving, false);
+    }
+
+    coex_mode_t profile = choose_profile();
+    coex_mode_t previous = atomic_load(&s_active);
+    bool connected = ble_service_is_connected();
+    bool changed = !s_applied || profile != previous;
+
+    if (changed && s_applied) {
+        latency_summary_t summary;
+        latency_trace_get_profile_summary(previous, &summary);
+        if (summary.count > 0) {
+            ESP_LOGI(TAG, "%s: latency p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32 " us (n=%" PRIu32 ")",
+                     s_mode_names[previous], summary.p50, summary.p99, summary.max, summary.count);
+        }
+    }
+    if (changed) {
+        // Commands from here on count under the new profile
+        latency_trace_set_profile(profile);
+    }
+
+    if (changed || connected != s_applied_connected) {
+        apply(profile, connected);
+        if (changed) {
+            ESP_LOGI(TAG, "Profile %s -> %s", s_applied ? s_mode_names[previous] : "-", s_mode_names[profile]);
+        }
+        atomic_store(&s_active, profile);
+        s_applied = true;
+        s_applied_connected = connected;
+    }
+
+    // Re-requested by ble_service itself on every connect
+    ble_conn_profile_t conn = choose_conn(profile);
+    if (conn != s_applied_conn) {
+        ble_service_set_conn_profile(conn);
+        s_applied_conn = conn;
+    }
+}
+
+static void coex_task(void *arg)
+{
+    while (1) {
+        // Event driven; only a running drive hold needs a timeout
+        TickType_t wait = portMAX_DELAY;
+        if (atomic_load(&s_driving)) {
+            uint32_t elapsed = now_ms() - atomic_load(&s_last_drive_ms);
+            wait = elapsed < COEX_DRIVE_HOLD_MS ? pdMS_TO_TICKS(COEX_DRIVE_HOLD_MS - elapsed) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        evaluate();
+    }
+}
+
+void coex_policy_note_drive(void)
+{
+    atomic_store_explicit(&s_last_drive_ms, now_ms(), memory_order_relaxed);
+    if (!atomic_exchange(&s_driving, true)) {
+        coex_policy_update();
+    }
+}
+
+void coex_policy_update(void)
+{
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+esp_err_t coex_policy_set_mode(coex_mode_t mode)
+{
+    if (mode >= COEX_MODE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    atomic_store(&s_mode, mode);
+    coex_policy_update();
+    return ESP_OK;
+}
+
+esp_err_t coex_policy_set_conn_override(ble_conn_profile_t profile)
+{
+    if (profile > BLE_CONN_PROFILE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    atomic_store(&s_conn_override, profile);
+    coex_policy_update();
+    return ESP_OK;
+}
+
+ble_conn_profile_t coex_policy_get_conn_override(void)
+{
+    return atomic_load(&s_conn_override);
+}
+
+coex_mode_t coex_policy_get_mode(void)
+{
+    return atomic_load(&s_mode);
+}
+
+coex_mode_t coex_policy_get_active(void)
+{
+    return atomic_load(&s_active);
+}
+
+void coex_policy_get_latency(coex_mode_t profile, latency_summary_t *summary)
+{
+    if (profile < COEX_MODE_COUNT) {
+        latency_trace_get_profile_summary(profile, summary);
+    } else {
+        *summary = (latency_summary_t){ 0 };
+    }
+}
+
+const char *coex_policy_mode_name(coex_mode_t mode)
+{
+    return mode < COEX_MODE_COUNT ? s_mode_names[mode] : "?";
+}
+
+esp_err_t coex_policy_init(void)
+{
+    s_task = xTaskCreateStatic(coex_task, "coex", COEX_TASK_STACK, NULL, COEX_TASK_PRIORITY,
+                               s_task_stack, &s_task_buf);
+    if (!s_task) {
+        return ESP_ERR_NO_MEM;
+    }
+    coex_policy_update();
+    return ESP_OK;
+}
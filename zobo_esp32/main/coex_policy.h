@@ -0,0 +1,72 @@
+/**
+ * Coexistence Policy - Header
+ *
+ * WiFi and BLE share one radio. Software coexistence alone hands out
+ * airtime without knowing what matters, so OTA downloads and WiFi
+ * connects push drive command latency up. This module picks a profile
+ * from what the robot is doing and applies it:
+ *   DRIVING  - radio preference to BT, short connection interval, WiFi in
+ *              max modem sleep (also used for BLE firmware transfers)
+ *   OTA      - radio preference to WiFi, normal connection interval,
+ *              advertising paused while no central is connected
+ *   BALANCED - IDF defaults
+ * The latency tracer keeps an RX->PWM histogram per profile (see
+ * latency_trace_set_profile), so profiles can be compared without touching
+ * the totals CMD_GET_LATENCY reports. The profile is re-evaluated on drive
+ * commands, OTA and WiFi changes, BLE connects / disconnects and power tier
+ * changes.
+ *
+ * This module also owns the BLE connection profile: the sleep manager and
+ * CMD_CONN_PARAMS only feed it. A manual override wins, then DRIVING, then
+ * IDLE while the sleep manager is in its idle tier, then the profile's own.
+ */
+
+#ifndef COEX_POLICY_H
+#define COEX_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "latency_trace.h"
+#include "ble_service.h"
+
+typedef enum {
+    COEX_MODE_AUTO,         // Pick a profile from activity
+    COEX_MODE_BALANCED,
+    COEX_MODE_DRIVING,
+    COEX_MODE_OTA,
+    COEX_MODE_COUNT
+} coex_mode_t;
+
+// A drive command keeps the DRIVING profile this long
+#define COEX_DRIVE_HOLD_MS      3000
+
+// Start the policy task (mode AUTO)
+esp_err_t coex_policy_init(void);
+
+// Force a profile or go back to AUTO
+esp_err_t coex_policy_set_mode(coex_mode_t mode);
+
+// Selected mode and the profile currently applied (never AUTO)
+coex_mode_t coex_policy_get_mode(void);
+coex_mode_t coex_policy_get_active(void);
+
+// Pin the connection profile (CMD_CONN_PARAMS), BLE_CONN_PROFILE_COUNT
+// hands it back to the policy
+esp_err_t coex_policy_set_conn_override(ble_conn_profile_t profile);
+ble_conn_profile_t coex_policy_get_conn_override(void);
+
+// Record a drive command (control dispatcher, cheap)
+void coex_policy_note_drive(void);
+
+// Re-evaluate after OTA / WiFi / connection state changed
+void coex_policy_update(void);
+
+// RX->PWM latency under a profile since boot / the last latency reset
+// (count 0 = no data)
+void coex_policy_get_latency(coex_mode_t profile, latency_summary_t *summary);
+
+// Name of a mode for reports
+const char *coex_policy_mode_name(coex_mode_t mode);
+
+#endif // COEX_POLICY_H
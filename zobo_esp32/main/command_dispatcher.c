@@ -0,0 +1,136 @@
+/**
+ * Command Dispatcher
+ *
+ * The BLE write callback runs on the Bluedroid task, so anything slow done
+ * there (logging, NVS writes, HTTP requests) stalls the whole BLE stack.
+ * Commands are copied into preallocated slots and handled by two tasks:
+ * a high-priority control task for motor/LED commands and a lower-priority
+ * service task for WiFi/OTA/info commands, so slow requests never sit in
+ * front of motor commands.
+ */
+
+#include "command_dispatcher.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "latency_trace.h"
+
+static const char *TAG = "DISPATCH";
+
+// One preallocated command slot
+typedef struct {
+    uint16_t len;
+    uint16_t trace;                            // Latency trace id (control commands)
+    uint8_t data[CMD_DISPATCH_MAX_LEN + 1];    // +1 keeps string payloads terminated
+} command_slot_t;
+
+// A queue of filled slots plus a queue of free slot indices
+typedef struct {
+    command_slot_t slots[CMD_DISPATCH_QUEUE_LEN];
+    QueueHandle_t ready_queue;
+    QueueHandle_t free_queue;
+    StaticQueue_t ready_queue_buf;
+    StaticQueue_t free_queue_buf;
+    uint8_t ready_storage[CMD_DISPATCH_QUEUE_LEN];
+    uint8_t free_storage[CMD_DISPATCH_QUEUE_LEN];
+} command_channel_t;
+
+static command_channel_t s_control;
+static command_channel_t s_service;
+static StaticTask_t s_control_task_buf;
+static StaticTask_t s_service_task_buf;
+static StackType_t s_control_stack[CMD_DISPATCH_CONTROL_STACK];
+static StackType_t s_service_stack[CMD_DISPATCH_SERVICE_STACK];
+static command_handler_t s_handler = NULL;
+static command_classifier_t s_is_control = NULL;
+static volatile uint32_t s_dropped = 0;
+
+static void channel_init(command_channel_t *ch)
+{
+    ch->ready_queue = xQueueCreateStatic(CMD_DISPATCH_QUEUE_LEN, sizeof(uint8_t),
+                                         ch->ready_storage, &ch->ready_queue_buf);
+    ch->free_queue = xQueueCreateStatic(CMD_DISPATCH_QUEUE_LEN, sizeof(uint8_t),
+                                        ch->free_storage, &ch->free_queue_buf);
+    for (uint8_t i = 0; i < CMD_DISPATCH_QUEUE_LEN; i++) {
+        xQueueSend(ch->free_queue, &i, 0);
+    }
+}
+
+static void dispatcher_task(void *arg)
+{
+    command_channel_t *ch = (command_channel_t *)arg;
+    uint8_t index;
+
+    while (1) {
+        if (xQueueReceive(ch->ready_queue, &index, portMAX_DELAY) == pdTRUE) {
+            command_slot_t *slot = &ch->slots[index];
+            if (ch == &s_control) {
+                latency_trace_mark(slot->trace, LATENCY_STAGE_DISPATCH);
+                latency_trace_set_current(slot->trace);
+            }
+            s_handler(slot->data, slot->len);
+            if (ch == &s_control) {
+                latency_trace_set_current(LATENCY_TRACE_NONE);
+            }
+            xQueueSend(ch->free_queue, &index, 0);
+        }
+    }
+}
+
+esp_err_t command_dispatcher_init(const command_dispatcher_config_t *config)
+{
+    if (!config || !config->handler || !config->is_control) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_handler = config->handler;
+    s_is_control = config->is_control;
+
+    channel_init(&s_control);
+    channel_init(&s_service);
+
+    if (!xTaskCreateStaticPinnedToCore(dispatcher_task, "cmd_control", CMD_DISPATCH_CONTROL_STACK,
+                                       &s_control, config->control_priority, s_control_stack,
+                                       &s_control_task_buf, config->control_core)) {
+        return ESP_FAIL;
+    }
+    if (!xTaskCreateStaticPinnedToCore(dispatcher_task, "cmd_service", CMD_DISPATCH_SERVICE_STACK,
+                                       &s_service, config->service_priority, s_service_stack,
+                                       &s_service_task_buf, config->service_core)) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Command dispatcher started (control prio %d, service prio %d)",
+             config->control_priority, config->service_priority);
+    return ESP_OK;
+}
+
+void command_dispatcher_post(uint8_t *data, uint16_t len)
+{
+    if (len < 1 || !s_handler) {
+        return;
+    }
+
+    command_channel_t *ch = s_is_control(data[0]) ? &s_control : &s_service;
+    uint8_t index;
+
+    // Never block the BLE stack - drop the command if no slot is free
+    if (len > CMD_DISPATCH_MAX_LEN || xQueueReceive(ch->free_queue, &index, 0) != pdTRUE) {
+        s_dropped++;
+        return;
+    }
+
+    command_slot_t *slot = &ch->slots[index];
+    memcpy(slot->data, data, len);
+    slot->data[len] = '\0';
+    slot->len = len;
+    slot->trace = (ch == &s_control) ? latency_trace_begin() : LATENCY_TRACE_NONE;
+    xQueueSend(ch->ready_queue, &index, 0);
+}
+
+uint32_t command_dispatcher_get_dropped(void)
+{
+    return s_dropped;
+}
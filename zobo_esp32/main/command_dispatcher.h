@@ -0,0 +1,76 @@
+/**
+ * Command Dispatcher - Header
+ * Moves BLE command handling off the Bluetooth stack task
+ */
+
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Queue sizing (storage is preallocated, so these are compile-time)
+#define CMD_DISPATCH_QUEUE_LEN      8       // Slots per queue
+#define CMD_DISPATCH_MAX_LEN        512     // Max bytes per command (local MTU is 500)
+#define CMD_DISPATCH_CONTROL_STACK  3072    // Task stacks (bytes)
+#define CMD_DISPATCH_SERVICE_STACK  4096    // WiFi/OTA handlers run the HTTP version check
+
+// Registry entry for one opcode. The handler gets the payload after the
+// opcode and is only called once min_len payload bytes are present
+typedef void (*command_fn_t)(uint8_t cmd, uint8_t *data, uint16_t len);
+
+#define CMD_FLAG_HOT        0x01    // Handled on the control dispatcher
+#define CMD_FLAG_DRIVE      0x02    // Counts as driving for the coexistence policy
+
+typedef enum {
+    CMD_ACK_REPLY,                  // Handler sends its own text reply
+    CMD_ACK_OK,                     // Dispatcher acks per the negotiated ack mode
+    CMD_ACK_SEQ,                    // Handler acks the frame sequence number
+    CMD_ACK_NONE,
+} command_ack_t;
+
+typedef struct {
+    command_fn_t fn;                // NULL = unknown opcode
+    uint16_t min_len;
+    uint8_t flags;                  // CMD_FLAG_*
+    uint8_t ack;                    // command_ack_t
+} command_entry_t;
+
+// Command handler - called from a dispatcher task, never from the BLE stack
+typedef void (*command_handler_t)(uint8_t *data, uint16_t len);
+
+// Classifier - returns true if the command belongs on the control (fast) queue
+typedef bool (*command_classifier_t)(uint8_t cmd);
+
+// Dispatcher task configuration
+typedef struct {
+    command_handler_t handler;
+    command_classifier_t is_control;
+    UBaseType_t control_priority;   // Motor/LED commands
+    UBaseType_t service_priority;   // WiFi/OTA/info commands
+    BaseType_t control_core;
+    BaseType_t service_core;
+} command_dispatcher_config_t;
+
+#define COMMAND_DISPATCHER_DEFAULT_CONFIG() {   \
+    .handler = NULL,                            \
+    .is_control = NULL,                         \
+    .control_priority = 6,                      \
+    .service_priority = 4,                      \
+    .control_core = 1,                          \
+    .service_core = tskNO_AFFINITY,             \
+}
+
+// Initialize queues and start dispatcher tasks
+esp_err_t command_dispatcher_init(const command_dispatcher_config_t *config);
+
+// Copy a command into the matching queue and return immediately
+// Matches ble_command_callback_t so it can be registered with the BLE service
+void command_dispatcher_post(uint8_t *data, uint16_t len);
+
+// Number of commands dropped because a queue was full
+uint32_t command_dispatcher_get_dropped(void);
+
+#endif // COMMAND_DISPATCHER_H
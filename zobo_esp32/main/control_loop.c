@@ -0,0 +1,193 @@
+/**
+ * Control Loop Scheduler
+ *
+ * A GPTimer alarm with auto-reload fires at a fixed rate and wakes the
+ * control task from its ISR. Periods are defined by the hardware timer,
+ * not by when the previous tick finished, so the loop keeps a fixed rate
+ * (vTaskDelayUntil semantics) at sub-tick resolution. Missed periods are
+ * counted as overruns instead of silently stretching the schedule.
+ */
+
+#include "control_loop.h"
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gptimer.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+static const char *TAG = "CTRL";
+
+#define TIMER_RESOLUTION_HZ     1000000     // 1 us per count
+
+static gptimer_handle_t s_timer = NULL;
+static TaskHandle_t s_task = NULL;
+static StaticTask_t s_task_buf;
+static StackType_t s_task_stack[CONTROL_LOOP_STACK_SIZE];
+static control_loop_tick_t s_tick = NULL;
+static uint32_t s_rate_hz = CONTROL_LOOP_HZ_DEFAULT;
+static uint32_t s_period_us = 1000000 / CONTROL_LOOP_HZ_DEFAULT;
+
+// Written by the ISR, read by the control task
+static volatile int64_t s_isr_time_us = 0;
+static volatile int64_t s_prev_isr_time_us = 0;
+
+// Statistics, written only by the control task
+static control_loop_stats_t s_stats;
+static uint64_t s_wake_latency_sum = 0;
+static uint64_t s_exec_time_sum = 0;
+static volatile bool s_reset_requested = false;
+static bool s_suspended = false;
+
+static bool IRAM_ATTR on_timer_alarm(gptimer_handle_t timer,
+                                     const gptimer_alarm_event_data_t *edata, void *ctx)
+{
+    BaseType_t high_task_woken = pdFALSE;
+
+    s_prev_isr_time_us = s_isr_time_us;
+    s_isr_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(s_task, &high_task_woken);
+
+    return high_task_woken == pdTRUE;
+}
+
+static void clear_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.rate_hz = s_rate_hz;
+    s_wake_latency_sum = 0;
+    s_exec_time_sum = 0;
+}
+
+static void control_task(void *arg)
+{
+    while (1) {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start = esp_timer_get_time();
+        int64_t isr_time = s_isr_time_us;
+        int64_t prev_isr_time = s_prev_isr_time_us;
+
+        if (s_reset_requested) {
+            s_reset_requested = false;
+            clear_stats();
+        }
+
+        s_tick();
+
+        int64_t end = esp_timer_get_time();
+        uint32_t latency = (uint32_t)(start - isr_time);
+        uint32_t exec_time = (uint32_t)(end - start);
+
+        // More than one notification means whole periods were skipped
+        if (pending > 1) {
+            s_stats.overruns += pending - 1;
+        }
+        if (prev_isr_time > 0) {
+            int64_t error = (isr_time - prev_isr_time) - s_period_us;
+            uint32_t abs_error = (uint32_t)(error < 0 ? -error : error);
+            if (abs_error > s_stats.period_error_max) {
+                s_stats.period_error_max = abs_error;
+            }
+        }
+        if (latency > s_stats.wake_latency_max) {
+            s_stats.wake_latency_max = latency;
+        }
+        if (exec_time > s_stats.exec_time_max) {
+            s_stats.exec_time_max = exec_time;
+        }
+        s_wake_latency_sum += latency;
+        s_exec_time_sum += exec_time;
+        s_stats.ticks++;
+    }
+}
+
+esp_err_t control_loop_start(const control_loop_config_t *config)
+{
+    if (!config || !config->tick ||
+        config->rate_hz < CONTROL_LOOP_HZ_MIN || config->rate_hz > CONTROL_LOOP_HZ_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_tick = config->tick;
+    s_rate_hz = config->rate_hz;
+    s_period_us = TIMER_RESOLUTION_HZ / config->rate_hz;
+    clear_stats();
+
+    s_task = xTaskCreateStaticPinnedToCore(control_task, "control_loop", CONTROL_LOOP_STACK_SIZE,
+                                           NULL, config->priority, s_task_stack, &s_task_buf,
+                                           config->core);
+    if (!s_task) {
+        return ESP_FAIL;
+    }
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = TIMER_RESOLUTION_HZ,
+    };
+    ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &s_timer));
+
+    gptimer_event_callbacks_t cbs = {
+        .on_alarm = on_timer_alarm,
+    };
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(s_timer, &cbs, NULL));
+    ESP_ERROR_CHECK(gptimer_enable(s_timer));
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = s_period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(s_timer, &alarm_config));
+    ESP_ERROR_CHECK(gptimer_start(s_timer));
+
+    ESP_LOGI(TAG, "Control loop started at %" PRIu32 " Hz on core %d",
+             s_rate_hz, (int)config->core);
+    return ESP_OK;
+}
+
+uint32_t control_loop_get_rate_hz(void)
+{
+    return s_rate_hz;
+}
+
+void control_loop_get_stats(control_loop_stats_t *stats)
+{
+    *stats = s_stats;
+    if (s_stats.ticks > 0) {
+        stats->wake_latency_avg = (uint32_t)(s_wake_latency_sum / s_stats.ticks);
+        stats->exec_time_avg = (uint32_t)(s_exec_time_sum / s_stats.ticks);
+    }
+}
+
+void control_loop_suspend(void)
+{
+    if (s_timer && !s_suspended) {
+        // Disabling also drops the driver's APB_FREQ_MAX lock, a stopped but
+        // enabled timer keeps both frequency scaling and light sleep away
+        gptimer_stop(s_timer);
+        gptimer_disable(s_timer);
+        s_suspended = true;
+        ESP_LOGI(TAG, "Control loop suspended");
+    }
+}
+
+void control_loop_resume(void)
+{
+    if (s_timer && s_suspended) {
+        // Restart the period from now and skip the stale jitter reference
+        s_isr_time_us = 0;
+        gptimer_enable(s_timer);
+        gptimer_set_raw_count(s_timer, 0);
+        gptimer_start(s_timer);
+        s_suspended = false;
+        ESP_LOGI(TAG, "Control loop resumed");
+    }
+}
+
+void control_loop_reset_stats(void)
+{
+    s_reset_requested = true;
+}
@@ -0,0 +1,69 @@
+/**
+ * Control Loop Scheduler - Header
+ * Fixed-rate motor control loop driven by a hardware timer
+ */
+
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define CONTROL_LOOP_HZ_MIN         100
+#define CONTROL_LOOP_HZ_MAX         1000
+#define CONTROL_LOOP_HZ_DEFAULT     500
+
+// Task stack is preallocated, so compile-time (bytes)
+#define CONTROL_LOOP_STACK_SIZE     3072
+
+// Tick callback - runs once per period on the control task
+typedef void (*control_loop_tick_t)(void);
+
+// Scheduler configuration
+typedef struct {
+    control_loop_tick_t tick;
+    uint32_t rate_hz;           // CONTROL_LOOP_HZ_MIN..CONTROL_LOOP_HZ_MAX
+    UBaseType_t priority;
+    BaseType_t core;
+} control_loop_config_t;
+
+#define CONTROL_LOOP_DEFAULT_CONFIG() {     \
+    .tick = NULL,                           \
+    .rate_hz = CONTROL_LOOP_HZ_DEFAULT,     \
+    .priority = 10,                         \
+    .core = 1,                              \
+}
+
+// Loop timing statistics (all times in microseconds)
+typedef struct {
+    uint32_t rate_hz;
+    uint32_t ticks;             // Periods executed
+    uint32_t overruns;          // Periods missed because the previous one ran late
+    uint32_t wake_latency_max;  // Timer interrupt -> tick start
+    uint32_t wake_latency_avg;
+    uint32_t period_error_max;  // |actual - nominal| between timer interrupts
+    uint32_t exec_time_max;     // Tick callback duration
+    uint32_t exec_time_avg;
+} control_loop_stats_t;
+
+// Start the timer and control task
+esp_err_t control_loop_start(const control_loop_config_t *config);
+
+// Get configured loop rate
+uint32_t control_loop_get_rate_hz(void);
+
+// Copy current statistics
+void control_loop_get_stats(control_loop_stats_t *stats);
+
+// Stop and disable / restart the timer so the chip can idle undisturbed
+// (DFS, modem sleep), releasing the timer's PM lock. Call from one task at
+// a time (the sleep manager)
+void control_loop_suspend(void);
+void control_loop_resume(void);
+
+// Clear statistics
+void control_loop_reset_stats(void);
+
+#endif // CONTROL_LOOP_H
@@ -0,0 +1,102 @@
+/**
+ * Event Log
+ *
+ * Writers claim a slot with one atomic increment and fill it in place.
+ * A dump racing a writer may print a half-written record; the ring is a
+ * diagnostic, not a transaction log.
+ */
+
+#include "evlog.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+static const char *TAG = "EVLOG";
+
+#define EVLOG_RING_LEN          256     // Power of two
+
+typedef struct {
+    uint32_t time_us;
+    uint16_t event;
+    uint8_t core;
+    uint8_t reserved;
+    uint32_t arg0;
+    uint32_t arg1;
+} evlog_record_t;
+
+static const uint8_t s_event_module[EV_COUNT] = {
+#define EVLOG_EVENT(name, module, format) [name] = module,
+#include "evlog_events.h"
+#undef EVLOG_EVENT
+};
+
+static evlog_record_t s_ring[EVLOG_RING_LEN];
+static _Atomic uint32_t s_head = 0;
+static _Atomic uint32_t s_ring_mask = EVLOG_MOD_ALL;
+static _Atomic uint32_t s_uart_mask = 0;
+
+static void print_record(const evlog_record_t *rec)
+{
+    ESP_LOGI(TAG, "EVL:%08" PRIx32 ":%04x:%u:%08" PRIx32 ":%08" PRIx32,
+             rec->time_us, rec->event, rec->core, rec->arg0, rec->arg1);
+}
+
+void evlog_write(evlog_event_t event, uint32_t arg0, uint32_t arg1)
+{
+    uint32_t bit = 1u << s_event_module[event];
+    if (!(atomic_load_explicit(&s_ring_mask, memory_order_relaxed) & bit)) {
+        return;
+    }
+
+    uint32_t index = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    evlog_record_t *rec = &s_ring[index & (EVLOG_RING_LEN - 1)];
+    rec->time_us = (uint32_t)esp_timer_get_time();
+    rec->event = event;
+    rec->core = (uint8_t)esp_cpu_get_core_id();
+    rec->arg0 = arg0;
+    rec->arg1 = arg1;
+
+    if (atomic_load_explicit(&s_uart_mask, memory_order_relaxed) & bit) {
+        print_record(rec);
+    }
+}
+
+void evlog_set_masks(uint32_t ring_mask, uint32_t uart_mask)
+{
+    // Echo needs the record, so it implies the ring
+    ring_mask = (ring_mask | uart_mask) & EVLOG_MOD_ALL;
+    atomic_store(&s_ring_mask, ring_mask);
+    atomic_store(&s_uart_mask, uart_mask & EVLOG_MOD_ALL);
+}
+
+void evlog_get_masks(uint32_t *ring_mask, uint32_t *uart_mask)
+{
+    *ring_mask = atomic_load(&s_ring_mask);
+    *uart_mask = atomic_load(&s_uart_mask);
+}
+
+uint32_t evlog_dump(void)
+{
+    uint32_t head = atomic_load(&s_head);
+    uint32_t count = head < EVLOG_RING_LEN ? head : EVLOG_RING_LEN;
+
+    for (uint32_t i = head - count; i != head; i++) {
+        evlog_record_t rec;
+        memcpy(&rec, &s_ring[i & (EVLOG_RING_LEN - 1)], sizeof(rec));
+        print_record(&rec);
+    }
+    return count;
+}
+
+uint32_t evlog_count(void)
+{
+    return atomic_load(&s_head);
+}
+
+void evlog_clear(void)
+{
+    atomic_store(&s_head, 0);
+}
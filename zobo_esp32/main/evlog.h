@@ -0,0 +1,56 @@
+/**
+ * Event Log - Header
+ *
+ * Deferred binary log for hot paths. A record is a timestamp, an event id
+ * and two 32-bit args written into a preallocated RAM ring; nothing is
+ * formatted or printed on the caller's task. Records are dumped over the
+ * serial console as EVL: lines and monitor.py resolves the format strings
+ * from evlog_events.h. Each module can be switched off, kept in the ring,
+ * or also echoed to the console as it happens.
+ */
+
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include <stdint.h>
+
+// Modules (bit positions in the masks)
+typedef enum {
+    EVLOG_MOD_CMD,
+    EVLOG_MOD_MOTOR,
+    EVLOG_MOD_LED,
+    EVLOG_MOD_WIFI,
+    EVLOG_MOD_COUNT
+} evlog_module_t;
+
+#define EVLOG_MOD_ALL               ((1u << EVLOG_MOD_COUNT) - 1)
+
+typedef enum {
+#define EVLOG_EVENT(name, module, format) name,
+#include "evlog_events.h"
+#undef EVLOG_EVENT
+    EV_COUNT
+} evlog_event_t;
+
+// CMD_EVLOG (0x74) sub commands
+#define EVLOG_CMD_MASKS             0x01    // + ring mask, uart mask
+#define EVLOG_CMD_DUMP              0x02    // Print the ring as EVL: lines
+#define EVLOG_CMD_CLEAR             0x03
+
+// Record an event - lock free, safe from any task
+void evlog_write(evlog_event_t event, uint32_t arg0, uint32_t arg1);
+
+// Modules recorded into the ring, and the subset also echoed to the
+// console immediately (costs UART time on the caller). Not persisted
+void evlog_set_masks(uint32_t ring_mask, uint32_t uart_mask);
+void evlog_get_masks(uint32_t *ring_mask, uint32_t *uart_mask);
+
+// Print the ring oldest first and return the number of records. From a
+// service task, the console write is slow
+uint32_t evlog_dump(void);
+
+// Records written since boot / the last clear (the ring keeps the newest)
+uint32_t evlog_count(void);
+void evlog_clear(void);
+
+#endif // EVLOG_H
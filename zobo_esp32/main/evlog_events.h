@@ -0,0 +1,21 @@
+/**
+ * Event Log - Event Table
+ *
+ * EVLOG_EVENT(name, module, format). Event ids are the position in this
+ * list, so append rather than reorder. The format strings never reach the
+ * firmware image; monitor.py reads this file to print the records. Args
+ * are 32-bit, %d/%i print them signed.
+ *
+ * No include guard - included with different EVLOG_EVENT definitions.
+ */
+
+EVLOG_EVENT(EV_CMD_RX,              EVLOG_MOD_CMD,      "cmd 0x%02x len %u")
+EVLOG_EVENT(EV_MOTOR_DRIVE,         EVLOG_MOD_MOTOR,    "drive cmd 0x%02x param %u")
+EVLOG_EVENT(EV_MOTOR_RAMP_START,    EVLOG_MOD_MOTOR,    "forward ramp start, target %d")
+EVLOG_EVENT(EV_MOTOR_RAMP_DONE,     EVLOG_MOD_MOTOR,    "ramp complete, latched at max (hw fade %u)")
+EVLOG_EVENT(EV_MOTOR_INACTIVITY,    EVLOG_MOD_MOTOR,    "watchdog stop %u ms after the last drive command")
+EVLOG_EVENT(EV_LED_SET,             EVLOG_MOD_LED,      "led cmd %u")
+EVLOG_EVENT(EV_WIFI_SET,            EVLOG_MOD_WIFI,     "credentials received, ssid %u bytes, password %u bytes")
+EVLOG_EVENT(EV_MOTOR_WATCHDOG,      EVLOG_MOD_MOTOR,    "no drive command for %u ms - decelerating over %u ms")
+EVLOG_EVENT(EV_MOTOR_STALE,         EVLOG_MOD_MOTOR,    "stale frame seq %u dropped (last %u)")
+EVLOG_EVENT(EV_MOTOR_NO_ENCODER,    EVLOG_MOD_MOTOR,    "no counts from encoder %u for %u ms - closed loop off")
@@ -0,0 +1,167 @@
+/**
+ * Fleet Mode
+ */
+
+#include "fleet.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "ble_service.h"
+
+static const char *TAG = "FLEET";
+
+#define NVS_NAMESPACE       "fleet"
+#define NVS_KEY_GROUP       "group"
+
+// Set from the service dispatcher, read by group frames
+static _Atomic uint8_t s_group = FLEET_GROUP_ALL;
+
+// Control dispatcher only: CMD_FLEET and group frames are both hot commands
+static int32_t s_offset_ms = 0;         // Robot ms - controller ms
+static int64_t s_synced_us = -1;        // Time of the last offset, -1 = never
+static fleet_stats_t s_stats;
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void fleet_init(void)
+{
+    nvs_handle_t nvs_handle;
+    uint8_t group;
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_u8(nvs_handle, NVS_KEY_GROUP, &group) == ESP_OK) {
+        atomic_store(&s_group, group);
+    }
+    nvs_close(nvs_handle);
+    ESP_LOGI(TAG, "Fleet group %u", group);
+}
+
+esp_err_t fleet_set_group(uint8_t group)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_u8(nvs_handle, NVS_KEY_GROUP, group);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (ret == ESP_OK) {
+        atomic_store(&s_group, group);
+        ESP_LOGI(TAG, "Fleet group %u", group);
+    }
+    return ret;
+}
+
+static bool is_synced(int64_t now_us)
+{
+    return s_synced_us >= 0 && now_us - s_synced_us < (int64_t)FLEET_SYNC_MAX_AGE_MS * 1000;
+}
+
+bool fleet_schedule(uint8_t group, uint32_t apply_at_ms, int64_t *apply_at_us)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    if (group != FLEET_GROUP_ALL && group != atomic_load_explicit(&s_group, memory_order_relaxed)) {
+        s_stats.foreign++;
+        return false;
+    }
+
+    *apply_at_us = 0;
+    if (!is_synced(now_us)) {
+        s_stats.unsynced++;
+        return true;
+    }
+
+    // Serial arithmetic on the 32-bit millisecond clocks, wraps after 49 days
+    uint32_t local_ms = apply_at_ms + (uint32_t)s_offset_ms;
+    int32_t lead_ms = (int32_t)(local_ms - (uint32_t)(now_us / 1000));
+    if (lead_ms > FLEET_MAX_LEAD_MS) {
+        s_stats.unsynced++;
+    } else if (lead_ms <= 0) {
+        s_stats.late++;
+    } else {
+        *apply_at_us = (now_us / 1000 + lead_ms) * 1000;
+        s_stats.scheduled++;
+    }
+    return true;
+}
+
+static void send_status(void)
+{
+    char response[128];
+    int64_t now_us = esp_timer_get_time();
+    bool synced = is_synced(now_us);
+
+    snprintf(response, sizeof(response),
+             "FLEET:group=%u,synced=%d,offset=%" PRId32 ",age=%" PRIu32 "s,scheduled=%" PRIu32
+             ",late=%" PRIu32 ",unsynced=%" PRIu32 ",foreign=%" PRIu32,
+             atomic_load(&s_group), synced, s_offset_ms,
+             synced ? (uint32_t)((now_us - s_synced_us) / 1000000) : 0,
+             s_stats.scheduled, s_stats.late, s_stats.unsynced, s_stats.foreign);
+    ble_service_send(response);
+}
+
+void fleet_command(const uint8_t *data, uint16_t len)
+{
+    char response[48];
+
+    if (len == 0) {
+        send_status();
+        return;
+    }
+
+    switch (data[0]) {
+        case FLEET_SUB_TIME:
+            if (len < 5) {
+                break;
+            }
+            // Echo the controller time with ours as close to it as possible
+            snprintf(response, sizeof(response), "FLEET:T:%" PRIu32 ":%" PRIu32,
+                     read_u32(&data[1]), (uint32_t)(esp_timer_get_time() / 1000));
+            ble_service_send(response);
+            return;
+
+        case FLEET_SUB_OFFSET:
+            if (len < 5) {
+                break;
+            }
+            s_offset_ms = (int32_t)read_u32(&data[1]);
+            s_synced_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "Clock offset %" PRId32 " ms", s_offset_ms);
+            send_status();
+            return;
+
+        case FLEET_SUB_RESET_STATS:
+            s_stats = (fleet_stats_t){ 0 };
+            send_status();
+            return;
+
+        default:
+            ble_service_send("FLEET:ERR:Invalid command");
+            return;
+    }
+    ble_service_send("FLEET:ERR:Invalid data");
+}
+
+uint8_t fleet_get_group(void)
+{
+    return atomic_load(&s_group);
+}
+
+void fleet_get_stats(fleet_stats_t *stats)
+{
+    *stats = s_stats;
+}
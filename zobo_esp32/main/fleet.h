@@ -0,0 +1,64 @@
+/**
+ * Fleet Mode - Header
+ *
+ * Lets one controller drive several robots in step. The app holds a link
+ * to every robot, syncs each robot to its own clock and then writes the
+ * same group frame (motor frame with MOTOR_FRAME_FLAG_GROUP) to all of
+ * them, stamped with an apply time a little in the future. Every robot
+ * applies it on its first control tick past that time, so neither the
+ * order of the writes nor the latency of each link shows up as skew.
+ *
+ * Clock sync, per robot:
+ *   app  -> 0x81 0x01 t0 (u32 controller ms)
+ *   robot-> "FLEET:T:<t0>:<robot ms>"          (app receives at t2)
+ *   app  -> 0x81 0x02 offset (i32, robot ms - (t0 + t2) / 2)
+ * The app keeps the lowest round trip of a few samples and repeats the
+ * sync well inside FLEET_SYNC_MAX_AGE_MS to stay ahead of crystal drift.
+ *
+ * Group ids pick a subset of a fleet: a robot follows group frames for
+ * FLEET_GROUP_ALL and for its own group (stored in NVS). The group is set
+ * with CMD_FLEET_GROUP (0x82) on the service dispatcher, so the flash write
+ * never holds up drive frames.
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// CMD_FLEET (0x81) sub commands. No payload reports "FLEET:..." status
+#define FLEET_SUB_TIME          0x01    // + controller ms (u32 LE)
+#define FLEET_SUB_OFFSET        0x02    // + offset ms (i32 LE)
+// 0x03 was the group id, now CMD_FLEET_GROUP
+#define FLEET_SUB_RESET_STATS   0x04
+
+#define FLEET_GROUP_ALL         0
+#define FLEET_MAX_LEAD_MS       2000    // Further ahead means the clocks disagree
+#define FLEET_SYNC_MAX_AGE_MS   120000  // 50 ppm of drift stays under 6 ms
+
+typedef struct {
+    uint32_t scheduled;         // Group frames applied at their apply time
+    uint32_t late;              // Arrived after their apply time, applied at once
+    uint32_t unsynced;          // No valid clock sync or implausible time, applied at once
+    uint32_t foreign;           // For another group, ignored
+} fleet_stats_t;
+
+// Load the group id
+void fleet_init(void);
+
+// Handle CMD_FLEET (data after the opcode), replies "FLEET:..."
+void fleet_command(const uint8_t *data, uint16_t len);
+
+// Map a group frame onto the local clock. False if it is for another
+// group; otherwise apply_at_us is the esp_timer time to apply it at, or 0
+// to apply it straight away
+bool fleet_schedule(uint8_t group, uint32_t apply_at_ms, int64_t *apply_at_us);
+
+// Set and persist the group id (any task, writes flash)
+esp_err_t fleet_set_group(uint8_t group);
+uint8_t fleet_get_group(void);
+void fleet_get_stats(fleet_stats_t *stats);
+
+#endif // FLEET_H
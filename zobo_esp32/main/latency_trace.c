@@ -0,0 +1,233 @@
+/**
+ * Latency Trace
+ *
+ * Stages run on different cores (Bluedroid on core 0, control on core 1),
+ * and each core's cycle counter runs from its own start, so timestamps use
+ * the shared esp_timer clock (1 us) rather than esp_cpu_get_cycle_count().
+ *
+ * Each stage is written by exactly one task and stages happen in order
+ * through the dispatcher queue and motor mailbox, so a record needs no
+ * locking. Histograms are only written by the control loop at the PWM
+ * stage.
+ */
+
+#include "latency_trace.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "LATENCY";
+
+#define TRACE_RING_LEN          32
+#define HIST_SUB_BITS           2                       // 4 buckets per power of two
+#define HIST_SUB_BUCKETS        (1 << HIST_SUB_BITS)
+#define HIST_OCTAVES            24                      // Up to ~16 s
+#define HIST_BUCKETS            (HIST_OCTAVES * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint16_t id;
+    uint32_t time_us[LATENCY_STAGE_COUNT];
+} trace_record_t;
+
+typedef struct {
+    uint32_t buckets[HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+} latency_hist_t;
+
+static trace_record_t s_ring[TRACE_RING_LEN];
+static uint16_t s_next_id = 0;                          // Bluedroid task only
+static _Atomic uint16_t s_current = LATENCY_TRACE_NONE;
+static latency_hist_t s_hist[LATENCY_SPAN_COUNT];
+static latency_hist_t s_profile_hist[LATENCY_PROFILE_COUNT];
+static _Atomic uint8_t s_profile = 0;
+static atomic_bool s_reset_requested = false;
+
+static const char *const s_span_names[LATENCY_SPAN_COUNT] = {
+    "rx_dispatch",
+    "dispatch_pickup",
+    "pickup_pwm",
+    "total",
+};
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+// Log-linear bucket: exact below HIST_SUB_BUCKETS, then HIST_SUB_BUCKETS per octave
+static uint32_t bucket_index(uint32_t value)
+{
+    if (value < HIST_SUB_BUCKETS) {
+        return value;
+    }
+    uint32_t msb = 31 - __builtin_clz(value);
+    uint32_t sub = (value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+    uint32_t index = (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+// Largest value that falls into a bucket
+static uint32_t bucket_upper(uint32_t index)
+{
+    if (index < HIST_SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t shift = index / HIST_SUB_BUCKETS - 1;
+    uint32_t sub = index % HIST_SUB_BUCKETS;
+    return ((HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static void hist_add(latency_hist_t *hist, uint32_t value)
+{
+    hist->buckets[bucket_index(value)]++;
+    hist->count++;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+uint16_t latency_trace_begin(void)
+{
+    uint16_t id = s_next_id++;
+    if (id == LATENCY_TRACE_NONE) {
+        id = s_next_id++;
+    }
+
+    trace_record_t *rec = &s_ring[id % TRACE_RING_LEN];
+    rec->id = id;
+    rec->time_us[LATENCY_STAGE_RX] = now_us();
+    return id;
+}
+
+void latency_trace_mark(uint16_t id, latency_stage_t stage)
+{
+    if (id == LATENCY_TRACE_NONE || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+
+    trace_record_t *rec = &s_ring[id % TRACE_RING_LEN];
+    if (rec->id != id) {
+        return;     // Overwritten by a newer command
+    }
+    rec->time_us[stage] = now_us();
+    if (stage != LATENCY_STAGE_PWM) {
+        return;
+    }
+
+    if (atomic_exchange(&s_reset_requested, false)) {
+        memset(s_hist, 0, sizeof(s_hist));
+        memset(s_profile_hist, 0, sizeof(s_profile_hist));
+    }
+
+    const uint32_t *t = rec->time_us;
+    hist_add(&s_hist[LATENCY_SPAN_RX_DISPATCH], t[LATENCY_STAGE_DISPATCH] - t[LATENCY_STAGE_RX]);
+    hist_add(&s_hist[LATENCY_SPAN_DISPATCH_PICKUP], t[LATENCY_STAGE_PICKUP] - t[LATENCY_STAGE_DISPATCH]);
+    hist_add(&s_hist[LATENCY_SPAN_PICKUP_PWM], t[LATENCY_STAGE_PWM] - t[LATENCY_STAGE_PICKUP]);
+    hist_add(&s_hist[LATENCY_SPAN_TOTAL], t[LATENCY_STAGE_PWM] - t[LATENCY_STAGE_RX]);
+    hist_add(&s_profile_hist[atomic_load_explicit(&s_profile, memory_order_relaxed)],
+             t[LATENCY_STAGE_PWM] - t[LATENCY_STAGE_RX]);
+
+    // A record completes once
+    rec->id = LATENCY_TRACE_NONE;
+}
+
+void latency_trace_set_current(uint16_t id)
+{
+    atomic_store_explicit(&s_current, id, memory_order_relaxed);
+}
+
+uint16_t latency_trace_current(void)
+{
+    return atomic_load_explicit(&s_current, memory_order_relaxed);
+}
+
+static void summarize(const latency_hist_t *hist, latency_summary_t *summary)
+{
+    // The control loop may add samples meanwhile; a summary can be off by one
+    uint32_t count = hist->count;
+    summary->count = count;
+    summary->max = hist->max;
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t p50_rank = (count + 1) / 2;
+    uint32_t p99_rank = count - count / 100;
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < HIST_BUCKETS && seen < p99_rank; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+        seen += hist->buckets[i];
+        uint32_t upper = bucket_upper(i);
+        if (upper > summary->max) {
+            upper = summary->max;
+        }
+        if (summary->p50 == 0 && seen >= p50_rank) {
+            summary->p50 = upper;
+        }
+        if (seen >= p99_rank) {
+            summary->p99 = upper;
+        }
+    }
+}
+
+void latency_trace_get_summary(latency_span_t span, latency_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (span < LATENCY_SPAN_COUNT) {
+        summarize(&s_hist[span], summary);
+    }
+}
+
+void latency_trace_set_profile(uint8_t profile)
+{
+    if (profile < LATENCY_PROFILE_COUNT) {
+        atomic_store_explicit(&s_profile, profile, memory_order_relaxed);
+    }
+}
+
+void latency_trace_get_profile_summary(uint8_t profile, latency_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (profile < LATENCY_PROFILE_COUNT) {
+        summarize(&s_profile_hist[profile], summary);
+    }
+}
+
+const char *latency_trace_span_name(latency_span_t span)
+{
+    return span < LATENCY_SPAN_COUNT ? s_span_names[span] : "?";
+}
+
+void latency_trace_dump(void)
+{
+    char line[160];
+
+    for (uint32_t span = 0; span < LATENCY_SPAN_COUNT; span++) {
+        const latency_hist_t *hist = &s_hist[span];
+        int pos = snprintf(line, sizeof(line), "LATH:%s:", s_span_names[span]);
+
+        // One "upper=count" pair per non-empty bucket, split over lines as needed
+        for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+            if (hist->buckets[i] == 0) {
+                continue;
+            }
+            if (pos > (int)sizeof(line) - 24) {
+                ESP_LOGI(TAG, "%s", line);
+                pos = snprintf(line, sizeof(line), "LATH:%s:", s_span_names[span]);
+            }
+            pos += snprintf(line + pos, sizeof(line) - pos, "%" PRIu32 "=%" PRIu32 ",",
+                            bucket_upper(i), hist->buckets[i]);
+        }
+        ESP_LOGI(TAG, "%s", line);
+    }
+}
+
+void latency_trace_reset(void)
+{
+    atomic_store(&s_reset_requested, true);
+}
@@ -0,0 +1,75 @@
+/**
+ * Latency Trace - Header
+ *
+ * Timestamps a control command at each hop from the BLE write to the PWM
+ * update and keeps log-bucketed histograms of every span. Records live in
+ * a preallocated ring; nothing on the hot path allocates or locks.
+ */
+
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LATENCY_TRACE_NONE      0xFFFF
+
+// Points along the control path
+typedef enum {
+    LATENCY_STAGE_RX,           // BLE write handed to the dispatcher (Bluedroid task)
+    LATENCY_STAGE_DISPATCH,     // Control dispatcher task picks it up
+    LATENCY_STAGE_PICKUP,       // Control loop takes the motor intent
+    LATENCY_STAGE_PWM,          // LEDC duty updated
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+// Histogrammed spans
+typedef enum {
+    LATENCY_SPAN_RX_DISPATCH,
+    LATENCY_SPAN_DISPATCH_PICKUP,
+    LATENCY_SPAN_PICKUP_PWM,
+    LATENCY_SPAN_TOTAL,         // RX -> PWM
+    LATENCY_SPAN_COUNT
+} latency_span_t;
+
+// Profile slots: the RX -> PWM total is also kept per profile, so modes
+// (coexistence profiles) can be compared without resetting the tracer
+#define LATENCY_PROFILE_COUNT   4
+
+// Histogram summary (microseconds; percentiles are bucket upper bounds)
+typedef struct {
+    uint32_t count;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} latency_summary_t;
+
+// Start a trace at LATENCY_STAGE_RX - returns its id
+uint16_t latency_trace_begin(void);
+
+// Timestamp a later stage; LATENCY_STAGE_PWM completes the trace.
+// Ids of LATENCY_TRACE_NONE are ignored
+void latency_trace_mark(uint16_t id, latency_stage_t stage);
+
+// Trace of the command the control dispatcher is currently handling
+void latency_trace_set_current(uint16_t id);
+uint16_t latency_trace_current(void);
+
+// Summarize one span
+void latency_trace_get_summary(latency_span_t span, latency_summary_t *summary);
+
+// Name of a span for reports
+const char *latency_trace_span_name(latency_span_t span);
+
+// Profile later samples are counted under (ignored if out of range) and
+// the RX -> PWM total collected under one
+void latency_trace_set_profile(uint8_t profile);
+void latency_trace_get_profile_summary(uint8_t profile, latency_summary_t *summary);
+
+// Log all histograms bucket by bucket to the console (parsed by monitor.py)
+void latency_trace_dump(void);
+
+// Clear histograms, per-profile ones too (applied by the writer on its next sample)
+void latency_trace_reset(void);
+
+#endif // LATENCY_TRACE_H
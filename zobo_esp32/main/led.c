@@ -3,118 +3,394 @@
  */
 
 #include "led.h"
+#include <stddef.h>
 #include "driver/gpio.h"
+#include "driver/ledc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
 static const char *TAG = "LED";
 
-// LED pins (active LOW)
+// LED pins (RGB active LOW)
 #define LED_MAIN            5
 #define LED_RED             27
 #define LED_GREEN           14
 #define LED_BLUE            12
 
+// RGB PWM (timer 1 - the motors use timers 0 and 2)
+#define LED_PWM_TIMER       LEDC_TIMER_1
+#define LED_PWM_FREQ_HZ     1000
+#define LED_PWM_RESOLUTION  LEDC_TIMER_8_BIT
+#define LED_CHANNEL_RED     LEDC_CHANNEL_2
+#define LED_CHANNEL_GREEN   LEDC_CHANNEL_3
+#define LED_CHANNEL_BLUE    LEDC_CHANNEL_4
+
+// Pattern engine frame period
+#define LED_FRAME_MS        20
+
+typedef struct {
+    uint8_t r, g, b;
+} led_color_t;
+
+typedef enum {
+    PATTERN_SOLID,          // color for duration (0 = forever)
+    PATTERN_BLINK,          // color on_ms / off_ms, repeats times (0 = forever)
+    PATTERN_BREATHE,        // color fades in and out over period_ms, repeats times
+    PATTERN_SEQUENCE,       // steps played in order
+} pattern_kind_t;
+
+// One sequence step; main < 0 leaves the main LED unchanged
+typedef struct {
+    led_color_t color;
+    int8_t main;
+    uint16_t duration_ms;
+} led_step_t;
+
+typedef struct {
+    pattern_kind_t kind;
+    led_color_t color;
+    uint16_t on_ms;         // Blink on time, breathe/solid period
+    uint16_t off_ms;
+    uint8_t repeats;
+    const led_step_t *steps;
+    uint8_t step_count;
+} led_pattern_t;
+
+#define RED     { 255, 0, 0 }
+#define GREEN   { 0, 255, 0 }
+#define BLUE    { 0, 0, 255 }
+#define CYAN    { 0, 255, 255 }
+#define WHITE   { 255, 255, 255 }
+#define BLACK   { 0, 0, 0 }
+
+static const led_step_t s_startup_steps[] = {
+    { BLACK, 0, 1000 },
+    { RED,   1, 1000 },
+    { BLUE, -1, 1000 },
+    { GREEN,-1, 1000 },
+    { BLACK,-1, 1000 },
+    { WHITE,-1,    0 },     // Last step holds
+};
+
+static const led_pattern_t s_patterns[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_STARTUP] = {
+        .kind = PATTERN_SEQUENCE,
+        .steps = s_startup_steps,
+        .step_count = sizeof(s_startup_steps) / sizeof(s_startup_steps[0]),
+    },
+    [LED_PATTERN_WIFI_CONNECTING] = { .kind = PATTERN_BLINK, .color = BLUE, .on_ms = 250, .off_ms = 250 },
+    [LED_PATTERN_WIFI_CONNECTED] = { .kind = PATTERN_SOLID, .color = GREEN, .on_ms = 3000 },
+    [LED_PATTERN_OTA_PROGRESS] = { .kind = PATTERN_BREATHE, .color = CYAN, .on_ms = 1500 },
+    [LED_PATTERN_OTA_SUCCESS] = { .kind = PATTERN_BLINK, .color = GREEN, .on_ms = 200, .off_ms = 200, .repeats = 5 },
+    [LED_PATTERN_OTA_FAIL] = { .kind = PATTERN_BLINK, .color = RED, .on_ms = 200, .off_ms = 200, .repeats = 5 },
+};
+
+// What each layer shows: a pattern, a static color, or nothing
+typedef struct {
+    bool active;
+    const led_pattern_t *pattern;   // NULL = static color
+    led_color_t color;
+    int64_t start_us;
+} led_layer_state_t;
+
+static led_layer_state_t s_layers[LED_LAYER_COUNT];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+// Only the frame timer renders; callers update layers and kick it
+static esp_timer_handle_t s_timer = NULL;
+static int8_t s_main_level = -1;    // Last main LED level set, under s_lock
+
+static void write_rgb(led_color_t c)
+{
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_RED, c.r);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_RED);
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_GREEN, c.g);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_GREEN);
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_BLUE, c.b);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, LED_CHANNEL_BLUE);
+}
+
+static led_color_t scale(led_color_t c, uint32_t level)
+{
+    led_color_t out = {
+        (uint8_t)(c.r * level / 255),
+        (uint8_t)(c.g * level / 255),
+        (uint8_t)(c.b * level / 255),
+    };
+    return out;
+}
+
+// Evaluate a pattern at elapsed ms. Returns false once it has finished
+static bool pattern_eval(const led_pattern_t *p, uint32_t elapsed, led_color_t *out, int8_t *main)
+{
+    static const led_color_t black = BLACK;
+    *main = -1;
+
+    switch (p->kind) {
+        case PATTERN_SOLID:
+            *out = p->color;
+            return p->on_ms == 0 || elapsed < p->on_ms;
+
+        case PATTERN_BLINK: {
+            uint32_t period = p->on_ms + p->off_ms;
+            if (p->repeats && elapsed >= period * p->repeats) {
+                return false;
+            }
+            *out = (elapsed % period) < p->on_ms ? p->color : black;
+            return true;
+        }
+
+        case PATTERN_BREATHE: {
+            if (p->repeats && elapsed >= (uint32_t)p->on_ms * p->repeats) {
+                return false;
+            }
+            // Triangle wave squared for a roughly perceptual fade
+            uint32_t half = p->on_ms / 2;
+            uint32_t t = elapsed % p->on_ms;
+            uint32_t x = (t < half) ? t : p->on_ms - t;
+            uint32_t level = x * 255 / half;
+            *out = scale(p->color, level * level / 255);
+            return true;
+        }
+
+        case PATTERN_SEQUENCE: {
+            for (uint8_t i = 0; i < p->step_count; i++) {
+                const led_step_t *step = &p->steps[i];
+                *out = step->color;
+                *main = step->main;
+                if (step->duration_ms == 0 || elapsed < step->duration_ms) {
+                    // Main LED levels of skipped steps still apply
+                    for (int8_t j = i; j >= 0 && *main < 0; j--) {
+                        *main = p->steps[j].main;
+                    }
+                    return true;
+                }
+                elapsed -= step->duration_ms;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+// Work out what to show and whether another frame is needed. Runs on the
+// esp_timer task only, so the LEDC writes never interleave
+static void render(void)
+{
+    led_color_t color = BLACK;
+    int8_t main = -1;
+    bool animating = false;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    for (int layer = LED_LAYER_COUNT - 1; layer >= 0; layer--) {
+        led_layer_state_t *ls = &s_layers[layer];
+        if (!ls->active) {
+            continue;
+        }
+        if (!ls->pattern) {
+            color = ls->color;
+            break;
+        }
+        if (pattern_eval(ls->pattern, (uint32_t)((now - ls->start_us) / 1000), &color, &main)) {
+            animating = true;
+            break;
+        }
+        ls->active = false;     // Finished - fall through to the layer below
+    }
+    bool set_main = main >= 0 && main != s_main_level;
+    if (set_main) {
+        s_main_level = main;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    write_rgb(color);
+    if (set_main) {
+        gpio_set_level(LED_MAIN, main);
+    }
+
+    // Only keep waking up while something moves, so the idle tier is
+    // undisturbed. Fails harmlessly if a caller already asked for a frame
+    if (animating) {
+        esp_timer_start_once(s_timer, LED_FRAME_MS * 1000);
+    }
+}
+
+// Render as soon as the timer task gets to it
+static void request_render(void)
+{
+    if (!s_timer) {
+        return;
+    }
+    // A pending frame would come too late, replace it; if two callers race
+    // the second start fails and the first one's frame covers both
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, 0);
+}
+
+static void frame_callback(void *arg)
+{
+    render();
+}
+
+static void set_layer(led_layer_t layer, const led_pattern_t *pattern, led_color_t color, bool active)
+{
+    if (layer >= LED_LAYER_COUNT) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_layers[layer].active = active;
+    s_layers[layer].pattern = pattern;
+    s_layers[layer].color = color;
+    s_layers[layer].start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+    request_render();
+}
+
 void led_init(void)
 {
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_DISABLE,
         .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1ULL << LED_MAIN) | (1ULL << LED_RED) |
-                        (1ULL << LED_GREEN) | (1ULL << LED_BLUE),
+        .pin_bit_mask = (1ULL << LED_MAIN),
         .pull_down_en = 0,
         .pull_up_en = 0,
     };
     gpio_config(&io_conf);
-
-    // Turn off all LEDs (active LOW, so HIGH = off)
     gpio_set_level(LED_MAIN, 0);
-    gpio_set_level(LED_RED, 1);
-    gpio_set_level(LED_GREEN, 1);
-    gpio_set_level(LED_BLUE, 1);
+
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .timer_num = LED_PWM_TIMER,
+        .duty_resolution = LED_PWM_RESOLUTION,
+        .freq_hz = LED_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ledc_timer_config(&timer_conf);
+
+    // RGB LEDs are active LOW - invert the output so duty = brightness
+    const int pins[] = { LED_RED, LED_GREEN, LED_BLUE };
+    const ledc_channel_t channels[] = { LED_CHANNEL_RED, LED_CHANNEL_GREEN, LED_CHANNEL_BLUE };
+    for (int i = 0; i < 3; i++) {
+        ledc_channel_config_t channel_conf = {
+            .speed_mode = LEDC_LOW_SPEED_MODE,
+            .channel = channels[i],
+            .timer_sel = LED_PWM_TIMER,
+            .intr_type = LEDC_INTR_DISABLE,
+            .gpio_num = pins[i],
+            .duty = 0,
+            .hpoint = 0,
+            .flags.output_invert = 1,
+        };
+        ledc_channel_config(&channel_conf);
+    }
+
+    if (!s_timer) {
+        esp_timer_create_args_t timer_args = {
+            .callback = frame_callback,
+            .name = "led_frame",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_timer));
+    }
 
     ESP_LOGI(TAG, "LEDs initialized");
 }
 
+void led_set_color(uint8_t red, uint8_t green, uint8_t blue)
+{
+    led_color_t color = { red, green, blue };
+    set_layer(LED_LAYER_USER, NULL, color, true);
+}
+
 void led_set_rgb(bool red, bool green, bool blue)
 {
-    // Active LOW LEDs
-    gpio_set_level(LED_RED, red ? 0 : 1);
-    gpio_set_level(LED_GREEN, green ? 0 : 1);
-    gpio_set_level(LED_BLUE, blue ? 0 : 1);
+    led_set_color(red ? 255 : 0, green ? 255 : 0, blue ? 255 : 0);
 }
 
 void led_set_main(bool on)
 {
+    portENTER_CRITICAL(&s_lock);
+    s_main_level = on ? 1 : 0;
+    portEXIT_CRITICAL(&s_lock);
     gpio_set_level(LED_MAIN, on ? 1 : 0);
 }
 
-void led_startup_sequence(void)
+void led_play_pattern(led_pattern_id_t pattern, led_layer_t layer)
 {
-    gpio_set_level(LED_MAIN, 0);
-    gpio_set_level(LED_RED, 1);
-    gpio_set_level(LED_GREEN, 1);
-    gpio_set_level(LED_BLUE, 1);
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    gpio_set_level(LED_MAIN, 1);
-    gpio_set_level(LED_RED, 0);  // Red on
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    static const led_color_t black = BLACK;
+    if (pattern == LED_PATTERN_NONE || pattern >= LED_PATTERN_COUNT) {
+        led_clear_layer(layer);
+        return;
+    }
+    set_layer(layer, &s_patterns[pattern], black, true);
+}
 
-    gpio_set_level(LED_BLUE, 0);  // Blue on
-    gpio_set_level(LED_RED, 1);   // Red off
-    vTaskDelay(pdMS_TO_TICKS(1000));
+void led_clear_layer(led_layer_t layer)
+{
+    static const led_color_t black = BLACK;
+    set_layer(layer, NULL, black, false);
+}
 
-    gpio_set_level(LED_GREEN, 0); // Green on
-    gpio_set_level(LED_BLUE, 1);  // Blue off
-    vTaskDelay(pdMS_TO_TICKS(1000));
+void led_off(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (int layer = 0; layer < LED_LAYER_COUNT; layer++) {
+        s_layers[layer].active = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    request_render();
+    led_set_main(false);
+}
 
-    gpio_set_level(LED_GREEN, 1); // Green off
-    vTaskDelay(pdMS_TO_TICKS(1000));
+void led_startup_sequence(void)
+{
+    led_startup_sequence_async();
+    vTaskDelay(pdMS_TO_TICKS(5000));
+}
 
-    // All RGB on
-    gpio_set_level(LED_RED, 0);
-    gpio_set_level(LED_GREEN, 0);
-    gpio_set_level(LED_BLUE, 0);
+void led_startup_sequence_async(void)
+{
+    led_play_pattern(LED_PATTERN_STARTUP, LED_LAYER_USER);
 }
 
 void led_indicate_wifi_connecting(void)
 {
-    // Blue blinking
-    led_set_rgb(false, false, true);
+    led_play_pattern(LED_PATTERN_WIFI_CONNECTING, LED_LAYER_STATUS);
 }
 
 void led_indicate_wifi_connected(void)
 {
-    // Green solid
-    led_set_rgb(false, true, false);
+    led_play_pattern(LED_PATTERN_WIFI_CONNECTED, LED_LAYER_STATUS);
+}
+
+void led_indicate_wifi_stopped(void)
+{
+    static const led_color_t black = BLACK;
+
+    // Only take down our own blink, not an OTA pattern that replaced it
+    portENTER_CRITICAL(&s_lock);
+    bool connecting = s_layers[LED_LAYER_STATUS].active &&
+                      s_layers[LED_LAYER_STATUS].pattern == &s_patterns[LED_PATTERN_WIFI_CONNECTING];
+    portEXIT_CRITICAL(&s_lock);
+    if (connecting) {
+        set_layer(LED_LAYER_STATUS, NULL, black, false);
+    }
 }
 
 void led_indicate_ota_progress(void)
 {
-    // Blue + Green = Cyan
-    led_set_rgb(false, true, true);
+    led_play_pattern(LED_PATTERN_OTA_PROGRESS, LED_LAYER_STATUS);
 }
 
 void led_indicate_ota_success(void)
 {
-    // Green blinking
-    for (int i = 0; i < 5; i++) {
-        led_set_rgb(false, true, false);
-        vTaskDelay(pdMS_TO_TICKS(200));
-        led_set_rgb(false, false, false);
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
+    led_clear_layer(LED_LAYER_STATUS);
+    led_play_pattern(LED_PATTERN_OTA_SUCCESS, LED_LAYER_ALERT);
 }
 
 void led_indicate_ota_fail(void)
 {
-    // Red blinking
-    for (int i = 0; i < 5; i++) {
-        led_set_rgb(true, false, false);
-        vTaskDelay(pdMS_TO_TICKS(200));
-        led_set_rgb(false, false, false);
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
+    led_clear_layer(LED_LAYER_STATUS);
+    led_play_pattern(LED_PATTERN_OTA_FAIL, LED_LAYER_ALERT);
 }
@@ -1,27 +1,71 @@
 /**
  * LED Control Module - Header
+ *
+ * RGB brightness is driven through LEDC PWM. Patterns play from an
+ * esp_timer on one of several layers; the highest active layer is shown,
+ * so status patterns sit on top of the user-set color and fall back to it
+ * when they finish. Setters only update the layers; the esp_timer task
+ * does all the drawing, so a change shows within a timer dispatch. No
+ * function here blocks, except the legacy led_startup_sequence().
  */
 
 #ifndef LED_H
 #define LED_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
-// Initialize LED GPIO
+// Layers, lowest priority first
+typedef enum {
+    LED_LAYER_USER,         // Colors set over BLE, startup animation
+    LED_LAYER_STATUS,       // WiFi / OTA progress
+    LED_LAYER_ALERT,        // Short results (OTA done / failed)
+    LED_LAYER_COUNT
+} led_layer_t;
+
+// Built-in patterns
+typedef enum {
+    LED_PATTERN_NONE,
+    LED_PATTERN_STARTUP,            // Red, blue, green, then all on
+    LED_PATTERN_WIFI_CONNECTING,    // Blue blink
+    LED_PATTERN_WIFI_CONNECTED,     // Green for 3 s
+    LED_PATTERN_OTA_PROGRESS,       // Cyan breathe
+    LED_PATTERN_OTA_SUCCESS,        // Green blink x5
+    LED_PATTERN_OTA_FAIL,           // Red blink x5
+    LED_PATTERN_COUNT
+} led_pattern_id_t;
+
+// Initialize LED GPIO and PWM
 void led_init(void);
 
-// Set RGB LED state
+// Set RGB LED state (user layer)
 void led_set_rgb(bool red, bool green, bool blue);
 
+// Set RGB brightness 0-255 (user layer)
+void led_set_color(uint8_t red, uint8_t green, uint8_t blue);
+
 // Set main LED state
 void led_set_main(bool on);
 
-// Run startup LED sequence
+// Play a pattern on a layer (replaces whatever that layer was showing)
+void led_play_pattern(led_pattern_id_t pattern, led_layer_t layer);
+
+// Drop a layer so the one below shows again
+void led_clear_layer(led_layer_t layer);
+
+// Everything off, all layers cleared (before sleep)
+void led_off(void);
+
+// Run startup LED sequence (blocks for ~5 s)
 void led_startup_sequence(void);
 
+// Run startup LED sequence in the background; setting a user color ends it
+void led_startup_sequence_async(void);
+
 // LED patterns for status indication
 void led_indicate_wifi_connecting(void);
 void led_indicate_wifi_connected(void);
+void led_indicate_wifi_stopped(void);     // Gave up or disconnected: ends the connecting blink
 void led_indicate_ota_progress(void);
 void led_indicate_ota_success(void);
 void led_indicate_ota_fail(void);
@@ -12,9 +12,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "motor.h"
@@ -22,10 +24,29 @@
 #include "ble_service.h"
 #include "wifi_manager.h"
 #include "ota_manager.h"
+#include "ota_image.h"
+#include "ble_ota.h"
 #include "sleep_manager.h"
+#include "command_dispatcher.h"
+#include "motor_frame.h"
+#include "control_loop.h"
+#include "wheel_encoder.h"
+#include "latency_trace.h"
+#include "coex_policy.h"
+#include "telemetry.h"
+#include "evlog.h"
+#include "mem_report.h"
+#include "fleet.h"
 
 static const char *TAG = "ZOBO";
 
+// Fast boot: LED sequence runs in the background and BLE comes up before
+// anything else, so the robot is drivable within a fraction of a second
+#define FAST_BOOT           1
+
+// Boot timing
+static int64_t s_first_command_us = 0;
+
 // BLE Command codes
 #define CMD_BACKWARD        0x00
 #define CMD_FORWARD         0x01
@@ -48,7 +69,26 @@ static const char *TAG = "ZOBO";
 #define CMD_OTA_CHECK       0x61    // Check for update: 0x61 + VERSION_URL\0
 #define CMD_GET_VERSION     0x62    // Get firmware version
 #define CMD_GET_INFO        0x63    // Get device info
+#define CMD_GET_LOOP_STATS  0x64    // Get control loop timing: 0x64 [+ 1 to reset]
+#define CMD_GET_LATENCY     0x65    // Get command latency histograms: 0x65 [+ 1 to reset]
+#define CMD_GET_MEMORY      0x66    // Get heap headroom and task stack high-water marks
+#define CMD_CONN_PARAMS     0x67    // BLE connection parameters: 0x67 [+ profile, 0xFF = auto]
+#define CMD_BLE_OTA         0x68    // Firmware over BLE: 0x68 + sub command, see ble_ota.h
 #define CMD_PING            0x70    // Keepalive ping
+#define CMD_SET_ACK_MODE    0x71    // Set ack mode: 0x71 + mode + interval_ms (u16 LE)
+#define CMD_TELEMETRY       0x72    // Telemetry stream: 0x72 [+ rate_hz, 0 = off], see telemetry.h
+#define CMD_COEX            0x73    // Coexistence policy: 0x73 [+ mode], see coex_policy.h
+#define CMD_EVLOG           0x74    // Event log: 0x74 [+ sub command], see evlog.h
+#define CMD_SET_RAMP        0x75    // Ramp config: 0x75 + accel profile, accel_ms, decel profile, decel_ms [, mode]
+#define CMD_SET_RAMP_CURVE  0x76    // Custom ramp curve: 0x76 + count + count x u16 (LE, Q16)
+#define CMD_SET_PWM         0x77    // PWM config: 0x77 [+ bits, left_hz (u32 LE), right_hz (u32 LE)]
+#define CMD_CLOSED_LOOP     0x78    // Closed loop: 0x78 [+ enable [+ kp, ki, kd, limit, max_cps (u16 LE)]]
+#define CMD_SET_POWER       0x79    // Power timeouts: 0x79 [+ idle_s, deep_min [, wake_s, window_ms]] (u16 LE)
+#define CMD_WATCHDOG        0x7A    // Drive watchdog: 0x7A [+ hold_ms, decel_ms (u16 LE)] or [+ 1 to reset stats]
+#define CMD_OTA_PIPELINE    0x7B    // OTA download tuning: 0x7B [+ http_buffer, chunk, progress_ms (u16 LE)]
+// Binary drive frame: CMD_MOTOR_FRAME (0x80), see motor_frame.h
+#define CMD_FLEET           0x81    // Fleet mode: 0x81 [+ sub command], see fleet.h
+#define CMD_FLEET_GROUP     0x82    // Fleet group: 0x82 [+ group id]
 
 // OTA status callback - sends status to BLE
 static void ota_status_callback(int progress, const char *status)
@@ -58,226 +98,741 @@ static void ota_status_callback(int progress, const char *status)
     ble_service_send(buf);
 }
 
-// Process motor/LED commands
-static void process_motor_command(uint8_t cmd, uint8_t param)
-{
-    switch (cmd) {
-        case CMD_BACKWARD:
-            motor_cancel_ramp();
-            motor_reset_inactivity();
-            motor_set_pwm(50, 50);
-            motor_set_direction(true, true);
-            ESP_LOGI(TAG, "Moving backward");
-            break;
-
-        case CMD_FORWARD:
-            motor_reset_inactivity();
-            motor_start_ramp();
-            break;
-
-        case CMD_STOP:
-            motor_cancel_ramp();
-            motor_stop();
-            led_set_main(false);
-            ESP_LOGI(TAG, "Stopped");
-            break;
-
-        case CMD_RIGHT:
-            motor_cancel_ramp();
-            motor_reset_inactivity();
-            motor_set_pwm(200, 255 - 200);
-            motor_set_direction(false, true);
-            ESP_LOGI(TAG, "Turning right");
-            break;
-
-        case CMD_LEFT:
-            motor_cancel_ramp();
-            motor_reset_inactivity();
-            motor_set_pwm(255 - 200, 200);
-            motor_set_direction(true, false);
-            ESP_LOGI(TAG, "Turning left");
-            break;
-
-        case CMD_MANUAL_PWM:
-            motor_cancel_ramp();
-            motor_reset_inactivity();
-            if (param >= 50) {
-                motor_set_pwm(180 - (param - 50), 180 + (param - 50));
-            } else {
-                motor_set_pwm(180 + (50 - param), 180 - (50 - param));
-            }
-            motor_set_direction(false, false);
-            ESP_LOGI(TAG, "Manual PWM: %d", param);
-            break;
-
-        case CMD_LED_GREEN:
-            led_set_rgb(false, true, false);
-            ESP_LOGI(TAG, "LED: Green");
-            break;
-
-        case CMD_LED_RED:
-            led_set_rgb(true, false, false);
-            ESP_LOGI(TAG, "LED: Red");
-            break;
-
-        case CMD_LED_BLUE:
-            led_set_rgb(false, false, true);
-            ESP_LOGI(TAG, "LED: Blue");
-            break;
-
-        case CMD_LED_ALL:
-            led_set_rgb(true, true, true);
-            ESP_LOGI(TAG, "LED: All");
-            break;
-    }
-}
-
-// WiFi connect task
-static void wifi_connect_task(void *arg)
+// Publish a single-setpoint motor intent to the control loop
+static void post_motor_intent(motor_intent_type_t type, int16_t left, int16_t right)
+{
+    motor_intent_t intent = {
+        .type = type,
+        .count = 1,
+        .trace = latency_trace_current(),
+        .setpoints[0] = { .left = left, .right = right },
+    };
+    motor_post_intent(&intent);
+}
+
+// Drive commands (legacy single-byte protocol)
+static void process_backward_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    post_motor_intent(MOTOR_INTENT_RAMP_TO,
+                      -MOTOR_SPEED_FROM_DUTY8(205), -MOTOR_SPEED_FROM_DUTY8(205));
+    evlog_write(EV_MOTOR_DRIVE, cmd, 0);
+}
+
+static void process_forward_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    post_motor_intent(MOTOR_INTENT_FORWARD, 0, 0);
+    evlog_write(EV_MOTOR_DRIVE, cmd, 0);
+}
+
+static void process_stop_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    post_motor_intent(MOTOR_INTENT_STOP, 0, 0);
+    led_set_main(false);
+    evlog_write(EV_MOTOR_DRIVE, cmd, 0);
+}
+
+static void process_right_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    post_motor_intent(MOTOR_INTENT_RAMP_TO,
+                      MOTOR_SPEED_FROM_DUTY8(200), -MOTOR_SPEED_FROM_DUTY8(200));
+    evlog_write(EV_MOTOR_DRIVE, cmd, 0);
+}
+
+static void process_left_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    post_motor_intent(MOTOR_INTENT_RAMP_TO,
+                      -MOTOR_SPEED_FROM_DUTY8(200), MOTOR_SPEED_FROM_DUTY8(200));
+    evlog_write(EV_MOTOR_DRIVE, cmd, 0);
+}
+
+static void process_manual_pwm_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    uint8_t param = (len >= 1) ? data[0] : 0;
+
+    if (param >= 50) {
+        post_motor_intent(MOTOR_INTENT_SET_SPEED,
+                          MOTOR_SPEED_FROM_DUTY8(180 - (param - 50)),
+                          MOTOR_SPEED_FROM_DUTY8(180 + (param - 50)));
+    } else {
+        post_motor_intent(MOTOR_INTENT_SET_SPEED,
+                          MOTOR_SPEED_FROM_DUTY8(180 + (50 - param)),
+                          MOTOR_SPEED_FROM_DUTY8(180 - (50 - param)));
+    }
+    evlog_write(EV_MOTOR_DRIVE, cmd, param);
+}
+
+// LED commands
+static void process_led_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    bool red = (cmd == CMD_LED_RED || cmd == CMD_LED_ALL);
+    bool green = (cmd == CMD_LED_GREEN || cmd == CMD_LED_ALL);
+    bool blue = (cmd == CMD_LED_BLUE || cmd == CMD_LED_ALL);
+
+    led_set_rgb(red, green, blue);
+    evlog_write(EV_LED_SET, cmd, 0);
+}
+
+// Process binary motor frame (no "OK" reply - the sequence number tracks it)
+static void process_motor_frame(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    static motor_frame_t frame;     // Only used from the control dispatcher task
+
+    // The frame layout counts the opcode byte
+    esp_err_t err = motor_frame_parse(data - 1, len + 1, &frame);
+    if (err != ESP_OK) {
+        ble_service_send("ERR:Frame");
+        return;
+    }
+
+    static motor_intent_t intent;   // Too large for the dispatcher stack frame
+    intent.apply_at_us = 0;
+    if ((frame.flags & MOTOR_FRAME_FLAG_GROUP) &&
+        !fleet_schedule(frame.group, frame.apply_at_ms, &intent.apply_at_us)) {
+        ble_service_ack_seq(frame.seq);     // Another group's frame, not ours to drive
+        return;
+    }
+
+    intent.type = (frame.count == 1) ? MOTOR_INTENT_SET_SPEED : MOTOR_INTENT_SETPOINTS;
+    intent.count = frame.count;
+    intent.interval_ms = frame.interval_ms;
+    intent.trace = latency_trace_current();
+    intent.flags = MOTOR_INTENT_FLAG_SEQ;
+    intent.seq = frame.seq;
+    memcpy(intent.setpoints, frame.setpoints, frame.count * sizeof(motor_setpoint_t));
+    motor_post_intent(&intent);
+    ble_service_ack_seq(frame.seq);
+}
+
+// Fleet clock sync (control dispatcher, so the time reply isn't queued
+// behind WiFi or OTA work)
+static void process_fleet_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    fleet_command(data, len);
+}
+
+// Fleet group membership - no payload reports. Service dispatcher: the
+// NVS write must not stall the group frames behind it
+static void process_fleet_group_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[32];
+
+    if (len >= 1 && fleet_set_group(data[0]) != ESP_OK) {
+        ble_service_send("FLEET:ERR:Save failed");
+        return;
+    }
+    snprintf(response, sizeof(response), "FLEET:group=%u", fleet_get_group());
+    ble_service_send(response);
+}
+
+// Negotiate acknowledgement mode for this connection
+static void process_ack_mode_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[32];
+
+    if (data[0] > BLE_ACK_MODE_CUMULATIVE) {
+        ble_service_send("ERR:Ack mode");
+        return;
+    }
+    uint16_t interval_ms = (len >= 3) ? (uint16_t)(data[1] | (data[2] << 8)) : 0;
+    ble_service_set_ack_mode((ble_ack_mode_t)data[0], interval_ms);
+
+    // Reply with what was actually applied (interval may be clamped)
+    ble_ack_mode_t mode = ble_service_get_ack_mode(&interval_ms);
+    snprintf(response, sizeof(response), "ACK_MODE:%d:%u", mode, interval_ms);
+    ble_service_send(response);
+}
+
+// Keepalive ping - the sleep timer is already reset by the dispatcher.
+// No response needed to reduce traffic
+static void process_ping_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+}
+
+// Push WiFi status changes (WiFi manager task)
+static void wifi_status_callback(wifi_status_t status)
+{
+    char response[64];
+    const char *status_str[] = {"DISCONNECTED", "CONNECTING", "CONNECTED", "FAILED"};
+
+    if (status == WIFI_STATUS_CONNECTED) {
+        snprintf(response, sizeof(response), "WIFI:CONNECTED:%s:%" PRIu32 "ms",
+                 wifi_manager_get_ip(), wifi_manager_get_connect_time_ms());
+    } else {
+        snprintf(response, sizeof(response), "WIFI:%s", status_str[status]);
+    }
+    ble_service_send(response);
+    coex_policy_update();       // WiFi power save can only be set once it runs
+}
+
+// Set WiFi credentials. Format: SSID\0PASSWORD\0
+static void process_wifi_set_command(uint8_t cmd, uint8_t *data, uint16_t len)
 {
     char response[128];
-    vTaskDelay(pdMS_TO_TICKS(500)); // Give BLE time to finish
 
-    if (wifi_manager_connect() == ESP_OK) {
-        snprintf(response, sizeof(response), "WIFI:CONNECTED:%s",
-                 wifi_manager_get_ip());
+    char *ssid = (char *)data;
+    char *password = ssid + strlen(ssid) + 1;
+
+    evlog_write(EV_WIFI_SET, strlen(ssid), strlen(password));
+
+    if (wifi_manager_set_credentials(ssid, password) == ESP_OK) {
+        snprintf(response, sizeof(response), "WIFI:OK:Saved %s", ssid);
     } else {
-        snprintf(response, sizeof(response), "WIFI:ERR:Connection failed");
+        snprintf(response, sizeof(response), "WIFI:ERR:Save failed");
     }
     ble_service_send(response);
-    vTaskDelete(NULL);
 }
 
-// Process WiFi commands
-static void process_wifi_command(uint8_t cmd, uint8_t *data, uint16_t len)
+static void process_wifi_connect_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    // The WiFi manager task answers through wifi_status_callback
+    if (wifi_manager_connect() != ESP_OK) {
+        ble_service_send("WIFI:ERR:No credentials");
+    }
+}
+
+static void process_wifi_disconnect_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    wifi_manager_disconnect();
+}
+
+static void process_wifi_status_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    wifi_status_callback(wifi_manager_get_status());
+}
+
+static void process_wifi_clear_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    wifi_manager_clear_credentials();
+    ble_service_send("WIFI:CLEARED");
+}
+
+// Start OTA update. Format: URL\0
+static void process_ota_update_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char *url = (char *)data;
+
+    // Check WiFi connection
+    if (wifi_manager_get_status() != WIFI_STATUS_CONNECTED) {
+        ble_service_send("OTA:ERR:WiFi not connected");
+        return;
+    }
+
+    esp_err_t ret = ota_manager_start_update(url);
+    if (ret == ESP_OK) {
+        ble_service_send("OTA:STARTED");
+    } else if (ret == ESP_ERR_NO_MEM) {
+        ble_service_send("OTA:ERR:Low memory");
+    } else {
+        ble_service_send("OTA:ERR:Failed to start");
+    }
+}
+
+// Check for update. Format: VERSION_URL\0
+static void process_ota_check_command(uint8_t cmd, uint8_t *data, uint16_t len)
 {
     char response[128];
+    char *url = (char *)data;
 
-    switch (cmd) {
-        case CMD_WIFI_SET: {
-            // Format: SSID\0PASSWORD\0
-            if (len < 2) {
-                ble_service_send("WIFI:ERR:Invalid data");
-                return;
-            }
+    if (wifi_manager_get_status() != WIFI_STATUS_CONNECTED) {
+        ble_service_send("OTA:ERR:WiFi not connected");
+        return;
+    }
+
+    bool update_available = false;
+    if (ota_manager_check_update(url, &update_available) == ESP_OK) {
+        snprintf(response, sizeof(response), "OTA:CHECK:%s",
+                 update_available ? "AVAILABLE" : "UP_TO_DATE");
+    } else {
+        snprintf(response, sizeof(response), "OTA:ERR:Check failed");
+    }
+    ble_service_send(response);
+}
 
-            // Debug: log raw data
-            ESP_LOGI(TAG, "WiFi SET raw data len=%d:", len);
-            for (int i = 0; i < len && i < 64; i++) {
-                ESP_LOGI(TAG, "  [%d] = 0x%02X '%c'", i, data[i], (data[i] >= 32 && data[i] < 127) ? data[i] : '.');
-            }
+static void process_version_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[64];
 
-            char *ssid = (char *)data;
-            char *password = ssid + strlen(ssid) + 1;
+    snprintf(response, sizeof(response), "VERSION:%s", ota_manager_get_version());
+    ble_service_send(response);
+}
 
-            ESP_LOGI(TAG, "Parsed SSID='%s' (len=%d), Password='***' (len=%d)",
-                     ssid, strlen(ssid), strlen(password));
+static void process_info_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[128];
 
-            if (wifi_manager_set_credentials(ssid, password) == ESP_OK) {
-                snprintf(response, sizeof(response), "WIFI:OK:Saved %s", ssid);
-            } else {
-                snprintf(response, sizeof(response), "WIFI:ERR:Save failed");
-            }
-            ble_service_send(response);
-            break;
+    snprintf(response, sizeof(response), "INFO:Zobo v%s,WiFi:%s",
+             ota_manager_get_version(),
+             wifi_manager_has_credentials() ? "configured" : "not_set");
+    ble_service_send(response);
+    snprintf(response, sizeof(response), "BOOT:adv=%" PRId64 "ms,conn=%" PRId64 "ms,cmd=%" PRId64 "ms",
+             ble_service_get_first_adv_us() / 1000,
+             ble_service_get_first_connect_us() / 1000,
+             s_first_command_us / 1000);
+    ble_service_send(response);
+    // Running image hash prefix - lets the app pick a matching delta update
+    const uint8_t *sha = ota_image_get_running_sha256();
+    if (sha) {
+        snprintf(response, sizeof(response), "IMAGE:%02x%02x%02x%02x%02x%02x%02x%02x",
+                 sha[0], sha[1], sha[2], sha[3], sha[4], sha[5], sha[6], sha[7]);
+        ble_service_send(response);
+    }
+    ota_stats_t stats;
+    if (ota_manager_get_last_stats(&stats)) {
+        snprintf(response, sizeof(response), "OTASTAT:bytes=%" PRIu32 ",xfer=%" PRIu32 ",ms=%" PRIu32 ",bps=%" PRIu32 ",stall_ms=%" PRIu32,
+                 stats.image_bytes, stats.transfer_bytes, stats.total_ms, stats.bytes_per_sec, stats.flash_stall_ms);
+        ble_service_send(response);
+    }
+}
+
+// Firmware over BLE, sub command in the first byte
+static void process_ble_ota_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    ble_ota_command(data, len);
+}
+
+// Ramp config: accel profile, accel_ms, decel profile, decel_ms [, mode]
+static void process_ramp_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    motor_ramp_config_t config = {
+        .accel_profile = (ramp_profile_id_t)data[0],
+        .accel_ms = (uint16_t)(data[1] | (data[2] << 8)),
+        .decel_profile = (ramp_profile_id_t)data[3],
+        .decel_ms = (uint16_t)(data[4] | (data[5] << 8)),
+    };
+    if (motor_set_ramp_config(&config) != ESP_OK) {
+        ble_service_send("RAMP:ERR:Invalid profile");
+        return;
+    }
+    if (len >= 7 && data[6] <= MOTOR_RAMP_HW_FADE) {
+        motor_set_ramp_mode((motor_ramp_mode_t)data[6]);
+    }
+    ble_service_send("RAMP:OK");
+}
+
+// Custom ramp curve: count + count x u16
+static void process_ramp_curve_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    uint16_t points[RAMP_LUT_SIZE];
+    uint8_t count = data[0];
+
+    if (count < 2 || count > RAMP_LUT_SIZE || len < 1 + count * 2) {
+        ble_service_send("RAMP:ERR:Invalid curve");
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        points[i] = (uint16_t)(data[1 + i * 2] | (data[2 + i * 2] << 8));
+    }
+    ramp_profile_set_custom(points, count);
+    ble_service_send("RAMP:OK");
+}
+
+// Process PWM config command - no payload reports the active config
+static void process_pwm_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[64];
+    motor_pwm_config_t config;
+
+    if (len == 0) {
+        motor_get_pwm_config(&config);
+        snprintf(response, sizeof(response), "PWM:%d:%" PRIu32 ":%" PRIu32,
+                 config.resolution_bits, config.left_freq_hz, config.right_freq_hz);
+        ble_service_send(response);
+        return;
+    }
+    if (len < 9) {
+        ble_service_send("PWM:ERR:Invalid data");
+        return;
+    }
+
+    config.resolution_bits = data[0];
+    config.left_freq_hz = (uint32_t)data[1] | ((uint32_t)data[2] << 8) |
+                          ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 24);
+    config.right_freq_hz = (uint32_t)data[5] | ((uint32_t)data[6] << 8) |
+                           ((uint32_t)data[7] << 16) | ((uint32_t)data[8] << 24);
+
+    esp_err_t ret = motor_save_pwm_config(&config);
+    if (ret == ESP_OK) {
+        ble_service_send("PWM:OK:Reboot to apply");
+    } else if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ble_service_send("PWM:ERR:Frequency too high for resolution");
+    } else if (ret == ESP_ERR_INVALID_ARG) {
+        ble_service_send("PWM:ERR:Out of range");
+    } else {
+        ble_service_send("PWM:ERR:Save failed");
+    }
+}
+
+// Process closed-loop command - no payload reports state and measured speeds
+static void process_closed_loop_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[64];
+
+    if (len == 0) {
+        motor_status_t status;
+        motor_get_status(&status);
+        snprintf(response, sizeof(response), "CLOSED_LOOP:%d:%d:%d",
+                 status.closed_loop, status.measured.left, status.measured.right);
+        ble_service_send(response);
+        return;
+    }
+
+    motor_closed_loop_config_t config;
+    const motor_closed_loop_config_t *new_config = NULL;
+    if (len >= 11) {
+        config.kp = data[1] | (data[2] << 8);
+        config.ki = data[3] | (data[4] << 8);
+        config.kd = data[5] | (data[6] << 8);
+        config.correction_limit = data[7] | (data[8] << 8);
+        config.max_counts_per_sec = data[9] | (data[10] << 8);
+        new_config = &config;
+    }
+
+    esp_err_t ret = motor_set_closed_loop(data[0] != 0, new_config);
+    if (ret == ESP_OK) {
+        ble_service_send("CLOSED_LOOP:OK");
+    } else if (ret == ESP_ERR_INVALID_STATE) {
+        ble_service_send("CLOSED_LOOP:ERR:No encoders");
+    } else {
+        ble_service_send("CLOSED_LOOP:ERR:Invalid config");
+    }
+}
+
+// Process power timeout command - no payload reports state, timeouts and
+// deep sleep wakes (wake_s 0 = no timer wakes)
+static void process_power_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[64];
+    sleep_manager_timeouts_t timeouts;
+
+    if (len == 4 || len >= 8) {
+        // Without the wake settings the stored ones stay
+        sleep_manager_get_timeouts(&timeouts);
+        timeouts.idle_timeout_ms = (uint32_t)(data[0] | (data[1] << 8)) * 1000;
+        timeouts.deep_timeout_ms = (uint32_t)(data[2] | (data[3] << 8)) * 60 * 1000;
+        if (len >= 8) {
+            timeouts.wake_period_s = data[4] | (data[5] << 8);
+            timeouts.wake_window_ms = data[6] | (data[7] << 8);
         }
+        if (sleep_manager_set_timeouts(&timeouts) != ESP_OK) {
+            ble_service_send("POWER:ERR:Invalid timeouts");
+            return;
+        }
+    } else if (len != 0) {
+        ble_service_send("POWER:ERR:Invalid data");
+        return;
+    }
 
-        case CMD_WIFI_CONNECT:
-            ble_service_send("WIFI:CONNECTING");
-            // Start WiFi connection in a separate task to avoid BLE/WiFi coexistence issues
-            xTaskCreate(wifi_connect_task, "wifi_connect", 4096, NULL, 5, NULL);
-            break;
-
-        case CMD_WIFI_DISCONNECT:
-            wifi_manager_disconnect();
-            ble_service_send("WIFI:DISCONNECTED");
-            break;
-
-        case CMD_WIFI_STATUS: {
-            wifi_status_t status = wifi_manager_get_status();
-            const char *status_str[] = {"DISCONNECTED", "CONNECTING", "CONNECTED", "FAILED"};
-            if (status == WIFI_STATUS_CONNECTED) {
-                snprintf(response, sizeof(response), "WIFI:%s:%s",
-                         status_str[status], wifi_manager_get_ip());
-            } else {
-                snprintf(response, sizeof(response), "WIFI:%s", status_str[status]);
-            }
-            ble_service_send(response);
-            break;
+    sleep_manager_get_timeouts(&timeouts);
+    snprintf(response, sizeof(response), "POWER:%d:%" PRIu32 ":%" PRIu32 ":%" PRIu32 ":%" PRIu32,
+             sleep_manager_get_state(), timeouts.idle_timeout_ms, timeouts.deep_timeout_ms,
+             timeouts.wake_period_s, timeouts.wake_window_ms);
+    ble_service_send(response);
+}
+
+// Process drive watchdog command - no payload reports timing and counters
+static void process_watchdog_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[96];
+    motor_watchdog_config_t config;
+    motor_watchdog_stats_t stats;
+
+    if (len >= 4) {
+        config.hold_ms = (uint16_t)(data[0] | (data[1] << 8));
+        config.decel_ms = (uint16_t)(data[2] | (data[3] << 8));
+        if (motor_set_watchdog_config(&config) != ESP_OK) {
+            ble_service_send("WDOG:ERR:Invalid timing");
+            return;
         }
+    } else if (len == 1 && data[0] == 1) {
+        motor_reset_watchdog_stats();
+    } else if (len != 0) {
+        ble_service_send("WDOG:ERR:Invalid data");
+        return;
+    }
 
-        case CMD_WIFI_CLEAR:
-            wifi_manager_clear_credentials();
-            ble_service_send("WIFI:CLEARED");
-            break;
+    // A new config is applied on the next control tick, report what was sent
+    if (len < 4) {
+        motor_get_watchdog_config(&config);
     }
+    motor_get_watchdog_stats(&stats);
+    snprintf(response, sizeof(response),
+             "WDOG:hold=%u,decel=%u,timeouts=%" PRIu32 ",stale=%" PRIu32 ",gaps=%" PRIu32 ",max_gap=%" PRIu32 "ms",
+             config.hold_ms, config.decel_ms, stats.timeouts, stats.stale, stats.gaps, stats.max_gap_ms);
+    ble_service_send(response);
 }
 
-// Process OTA commands
-static void process_ota_command(uint8_t cmd, uint8_t *data, uint16_t len)
+// OTA download pipeline tuning, for the next update
+static void process_ota_pipeline_command(uint8_t cmd, uint8_t *data, uint16_t len)
 {
-    char response[128];
+    char response[64];
+    ota_pipeline_config_t config;
+
+    if (len >= 6) {
+        config.http_buffer_size = data[0] | (data[1] << 8);
+        config.chunk_size = data[2] | (data[3] << 8);
+        config.progress_interval_ms = data[4] | (data[5] << 8);
+        esp_err_t ret = ota_manager_set_pipeline_config(&config);
+        if (ret != ESP_OK) {
+            ble_service_send(ret == ESP_ERR_INVALID_STATE ? "OTAPIPE:ERR:Update running"
+                                                          : "OTAPIPE:ERR:Invalid config");
+            return;
+        }
+    } else if (len != 0) {
+        ble_service_send("OTAPIPE:ERR:Invalid data");
+        return;
+    }
 
-    switch (cmd) {
-        case CMD_OTA_UPDATE: {
-            if (len < 1) {
-                ble_service_send("OTA:ERR:No URL");
-                return;
-            }
-            char *url = (char *)data;
+    ota_manager_get_pipeline_config(&config);
+    snprintf(response, sizeof(response), "OTAPIPE:%u:%u:%u",
+             config.http_buffer_size, config.chunk_size, config.progress_interval_ms);
+    ble_service_send(response);
+}
 
-            // Check WiFi connection
-            if (wifi_manager_get_status() != WIFI_STATUS_CONNECTED) {
-                ble_service_send("OTA:ERR:WiFi not connected");
-                return;
-            }
-
-            if (ota_manager_start_update(url) == ESP_OK) {
-                ble_service_send("OTA:STARTED");
-            } else {
-                ble_service_send("OTA:ERR:Failed to start");
-            }
-            break;
+// Process connection parameter command - no payload just reports. A
+// profile pins it until 0xFF hands it back to the coex policy
+static void process_conn_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[96];
+    ble_conn_info_t info;
+
+    if (len >= 1) {
+        ble_conn_profile_t profile = data[0] == 0xFF ? BLE_CONN_PROFILE_COUNT : (ble_conn_profile_t)data[0];
+        if (coex_policy_set_conn_override(profile) != ESP_OK) {
+            ble_service_send("CONN:ERR:Invalid profile");
+            return;
+        }
+    }
+
+    // Interval in 1.25 ms units, shown as ms with two decimals. The coex
+    // task applies an override, so report it rather than the old request
+    ble_service_get_conn_info(&info);
+    ble_conn_profile_t override = coex_policy_get_conn_override();
+    snprintf(response, sizeof(response),
+             "CONN:%s:int=%u.%02ums,lat=%u,to=%ums,mtu=%u,dle=%u/%u,phy=1M",
+             ble_service_conn_profile_name(override != BLE_CONN_PROFILE_COUNT ? override : info.profile),
+             info.interval * 5 / 4, (info.interval * 125) % 100,
+             info.latency, info.timeout * 10, info.mtu, info.tx_octets, info.rx_octets);
+    ble_service_send(response);
+}
+
+// Process coexistence command - no payload reports mode and per-profile latency
+static void process_coex_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[96];
+
+    if (len >= 1 && coex_policy_set_mode((coex_mode_t)data[0]) != ESP_OK) {
+        ble_service_send("COEX:ERR:Invalid mode");
+        return;
+    }
+
+    snprintf(response, sizeof(response), "COEX:%s:%s",
+             coex_policy_mode_name(coex_policy_get_mode()),
+             coex_policy_mode_name(coex_policy_get_active()));
+    ble_service_send(response);
+
+    for (int mode = COEX_MODE_BALANCED; mode < COEX_MODE_COUNT; mode++) {
+        latency_summary_t summary;
+        coex_policy_get_latency((coex_mode_t)mode, &summary);
+        if (summary.count == 0) {
+            continue;
         }
+        snprintf(response, sizeof(response),
+                 "COEXLAT:%s:n=%" PRIu32 ",p50=%" PRIu32 ",p99=%" PRIu32 ",max=%" PRIu32,
+                 coex_policy_mode_name((coex_mode_t)mode),
+                 summary.count, summary.p50, summary.p99, summary.max);
+        ble_service_send(response);
+    }
+}
 
-        case CMD_OTA_CHECK: {
-            if (len < 1) {
-                ble_service_send("OTA:ERR:No URL");
+// Process telemetry command - frames arrive on 6e400005 once subscribed
+static void process_telemetry_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[32];
+
+    if (len >= 1) {
+        esp_err_t ret = telemetry_set_rate(data[0]);
+        if (ret == ESP_ERR_INVALID_ARG) {
+            ble_service_send("TELEM:ERR:Invalid rate");
+            return;
+        } else if (ret != ESP_OK) {
+            ble_service_send("TELEM:ERR:Not connected");
+            return;
+        }
+    }
+
+    snprintf(response, sizeof(response), "TELEM:%u", telemetry_get_rate());
+    ble_service_send(response);
+}
+
+
+// Event log: no payload reports masks and record count
+static void process_evlog_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[64];
+    uint32_t ring_mask;
+    uint32_t uart_mask;
+
+    if (len >= 1) {
+        switch (data[0]) {
+            case EVLOG_CMD_MASKS:
+                if (len < 3) {
+                    ble_service_send("EVLOG:ERR:Invalid data");
+                    return;
+                }
+                evlog_set_masks(data[1], data[2]);
+                break;
+
+            case EVLOG_CMD_DUMP:
+                snprintf(response, sizeof(response), "EVLOG:DUMPED:%" PRIu32, evlog_dump());
+                ble_service_send(response);
                 return;
-            }
-            char *url = (char *)data;
 
-            if (wifi_manager_get_status() != WIFI_STATUS_CONNECTED) {
-                ble_service_send("OTA:ERR:WiFi not connected");
+            case EVLOG_CMD_CLEAR:
+                evlog_clear();
+                break;
+
+            default:
+                ble_service_send("EVLOG:ERR:Invalid command");
                 return;
-            }
-
-            bool update_available = false;
-            if (ota_manager_check_update(url, &update_available) == ESP_OK) {
-                snprintf(response, sizeof(response), "OTA:CHECK:%s",
-                         update_available ? "AVAILABLE" : "UP_TO_DATE");
-            } else {
-                snprintf(response, sizeof(response), "OTA:ERR:Check failed");
-            }
-            ble_service_send(response);
-            break;
         }
+    }
 
-        case CMD_GET_VERSION:
-            snprintf(response, sizeof(response), "VERSION:%s", ota_manager_get_version());
-            ble_service_send(response);
-            break;
+    evlog_get_masks(&ring_mask, &uart_mask);
+    snprintf(response, sizeof(response), "EVLOG:ring=0x%02" PRIx32 ",uart=0x%02" PRIx32 ",n=%" PRIu32,
+             ring_mask, uart_mask, evlog_count());
+    ble_service_send(response);
+}
+
+// Control loop timing: [1 to reset]
+static void process_loop_stats_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[128];
+    control_loop_stats_t stats;
+
+    control_loop_get_stats(&stats);
+    snprintf(response, sizeof(response),
+             "LOOP:%" PRIu32 "Hz,ticks=%" PRIu32 ",overruns=%" PRIu32
+             ",lat=%" PRIu32 "/%" PRIu32 ",jit=%" PRIu32 ",exec=%" PRIu32 "/%" PRIu32,
+             stats.rate_hz, stats.ticks, stats.overruns,
+             stats.wake_latency_avg, stats.wake_latency_max,
+             stats.period_error_max, stats.exec_time_avg, stats.exec_time_max);
+    ble_service_send(response);
+    if (len >= 1 && data[0] == 1) {
+        control_loop_reset_stats();
+    }
+}
+
+// Command latency histograms: [1 to reset]
+static void process_latency_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[128];
+
+    for (int span = 0; span < LATENCY_SPAN_COUNT; span++) {
+        latency_summary_t summary;
+        latency_trace_get_summary((latency_span_t)span, &summary);
+        snprintf(response, sizeof(response),
+                 "LAT:%s:n=%" PRIu32 ",p50=%" PRIu32 ",p99=%" PRIu32 ",max=%" PRIu32,
+                 latency_trace_span_name((latency_span_t)span),
+                 summary.count, summary.p50, summary.p99, summary.max);
+        ESP_LOGI(TAG, "%s", response);
+        ble_service_send(response);
+    }
+    latency_trace_dump();
+    if (len >= 1 && data[0] == 1) {
+        latency_trace_reset();
+    }
+}
+
+// Heap headroom, then stack high-water marks a few tasks per line
+static void process_memory_command(uint8_t cmd, uint8_t *data, uint16_t len)
+{
+    char response[128];
+    mem_heap_info_t heap;
+    mem_task_info_t tasks[MEM_REPORT_MAX_TASKS];
+
+    mem_report_get_heap(&heap);
+    snprintf(response, sizeof(response),
+             "MEM:free=%" PRIu32 ",min=%" PRIu32 ",largest=%" PRIu32 ",total=%" PRIu32,
+             heap.free_bytes, heap.min_free_bytes, heap.largest_block, heap.total_free_bytes);
+    ble_service_send(response);
 
-        case CMD_GET_INFO:
-            snprintf(response, sizeof(response), "INFO:Zobo v%s,WiFi:%s",
-                     ota_manager_get_version(),
-                     wifi_manager_has_credentials() ? "configured" : "not_set");
+    uint32_t count = mem_report_get_tasks(tasks, MEM_REPORT_MAX_TASKS);
+    int pos = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos > 0 && pos + strlen(tasks[i].name) + 12 >= sizeof(response)) {
             ble_service_send(response);
-            break;
+            pos = 0;
+        }
+        pos += snprintf(response + pos, sizeof(response) - pos, "%s%s=%" PRIu32,
+                        pos == 0 ? "STACK:" : ",", tasks[i].name, tasks[i].stack_free);
     }
+    if (pos > 0) {
+        ble_service_send(response);
+    }
+}
+
+// Command registry, indexed by opcode. Empty slots are unknown commands;
+// min_len counts payload bytes after the opcode
+#define COMMAND(fn_, min_len_, flags_, ack_) \
+    { .fn = (fn_), .min_len = (min_len_), .flags = (flags_), .ack = (ack_) }
+
+#define DRIVE   (CMD_FLAG_HOT | CMD_FLAG_DRIVE)
+
+static const command_entry_t s_commands[256] = {
+    [CMD_BACKWARD]          = COMMAND(process_backward_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_FORWARD]           = COMMAND(process_forward_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_STOP]              = COMMAND(process_stop_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_RIGHT]             = COMMAND(process_right_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_LEFT]              = COMMAND(process_left_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_MANUAL_PWM]        = COMMAND(process_manual_pwm_command, 0, DRIVE, CMD_ACK_OK),
+    [CMD_LED_GREEN]         = COMMAND(process_led_command, 0, CMD_FLAG_HOT, CMD_ACK_OK),
+    [CMD_LED_RED]           = COMMAND(process_led_command, 0, CMD_FLAG_HOT, CMD_ACK_OK),
+    [CMD_LED_BLUE]          = COMMAND(process_led_command, 0, CMD_FLAG_HOT, CMD_ACK_OK),
+    [CMD_LED_ALL]           = COMMAND(process_led_command, 0, CMD_FLAG_HOT, CMD_ACK_OK),
+
+    [CMD_WIFI_SET]          = COMMAND(process_wifi_set_command, 2, 0, CMD_ACK_REPLY),
+    [CMD_WIFI_CONNECT]      = COMMAND(process_wifi_connect_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_WIFI_DISCONNECT]   = COMMAND(process_wifi_disconnect_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_WIFI_STATUS]       = COMMAND(process_wifi_status_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_WIFI_CLEAR]        = COMMAND(process_wifi_clear_command, 0, 0, CMD_ACK_REPLY),
+
+    [CMD_OTA_UPDATE]        = COMMAND(process_ota_update_command, 1, 0, CMD_ACK_REPLY),
+    [CMD_OTA_CHECK]         = COMMAND(process_ota_check_command, 1, 0, CMD_ACK_REPLY),
+    [CMD_GET_VERSION]       = COMMAND(process_version_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_GET_INFO]          = COMMAND(process_info_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_GET_LOOP_STATS]    = COMMAND(process_loop_stats_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_GET_LATENCY]       = COMMAND(process_latency_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_GET_MEMORY]        = COMMAND(process_memory_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_CONN_PARAMS]       = COMMAND(process_conn_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_BLE_OTA]           = COMMAND(process_ble_ota_command, 1, 0, CMD_ACK_REPLY),
+
+    [CMD_PING]              = COMMAND(process_ping_command, 0, CMD_FLAG_HOT, CMD_ACK_NONE),
+    [CMD_SET_ACK_MODE]      = COMMAND(process_ack_mode_command, 1, CMD_FLAG_HOT, CMD_ACK_REPLY),
+    [CMD_TELEMETRY]         = COMMAND(process_telemetry_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_COEX]              = COMMAND(process_coex_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_EVLOG]             = COMMAND(process_evlog_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_SET_RAMP]          = COMMAND(process_ramp_command, 6, 0, CMD_ACK_REPLY),
+    [CMD_SET_RAMP_CURVE]    = COMMAND(process_ramp_curve_command, 1, 0, CMD_ACK_REPLY),
+    [CMD_SET_PWM]           = COMMAND(process_pwm_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_CLOSED_LOOP]       = COMMAND(process_closed_loop_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_SET_POWER]         = COMMAND(process_power_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_WATCHDOG]          = COMMAND(process_watchdog_command, 0, 0, CMD_ACK_REPLY),
+    [CMD_OTA_PIPELINE]      = COMMAND(process_ota_pipeline_command, 0, 0, CMD_ACK_REPLY),
+
+    [CMD_MOTOR_FRAME]       = COMMAND(process_motor_frame, MOTOR_FRAME_HEADER_LEN - 1, DRIVE, CMD_ACK_SEQ),
+    [CMD_FLEET]             = COMMAND(process_fleet_command, 0, CMD_FLAG_HOT, CMD_ACK_REPLY),
+    [CMD_FLEET_GROUP]       = COMMAND(process_fleet_group_command, 0, 0, CMD_ACK_REPLY),
+};
+
+#undef DRIVE
+
+// Commands handled by the high-priority control dispatcher
+static bool is_control_command(uint8_t cmd)
+{
+    return (s_commands[cmd].flags & CMD_FLAG_HOT) != 0;
 }
 
-// BLE command handler
+// BLE command handler (runs on a dispatcher task, not the BLE stack)
 static void ble_command_handler(uint8_t *data, uint16_t len)
 {
     if (len < 1) return;
@@ -286,45 +841,49 @@ static void ble_command_handler(uint8_t *data, uint16_t len)
     sleep_manager_reset();
 
     uint8_t cmd = data[0];
-    uint8_t param = (len > 1) ? data[1] : 0;
-
-    ESP_LOGI(TAG, "Command: 0x%02X, len: %d", cmd, len);
-
-    // Route command to appropriate handler
-    if (cmd <= CMD_LED_ALL) {
-        process_motor_command(cmd, param);
-        ble_service_send("OK");
-    } else if (cmd >= CMD_WIFI_SET && cmd <= CMD_WIFI_CLEAR) {
-        process_wifi_command(cmd, data + 1, len - 1);
-    } else if (cmd >= CMD_OTA_UPDATE && cmd <= CMD_GET_INFO) {
-        process_ota_command(cmd, data + 1, len - 1);
-    } else if (cmd == CMD_PING) {
-        // Keepalive ping - just reset sleep timer (already done above)
-        // No response needed to reduce traffic
-    } else {
+    const command_entry_t *entry = &s_commands[cmd];
+
+    if (s_first_command_us == 0) {
+        s_first_command_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "First command %" PRId64 " ms after boot", s_first_command_us / 1000);
+    }
+
+    evlog_write(EV_CMD_RX, cmd, len);
+
+    if (!entry->fn) {
         ESP_LOGW(TAG, "Unknown command: 0x%02X", cmd);
         ble_service_send("ERR:Unknown");
+        return;
+    }
+    if (len - 1 < entry->min_len) {
+        ESP_LOGW(TAG, "Command 0x%02X too short: %d < %d", cmd, len - 1, entry->min_len);
+        ble_service_send("ERR:Length");
+        return;
+    }
+
+    if (entry->flags & CMD_FLAG_DRIVE) {
+        coex_policy_note_drive();
+    }
+    entry->fn(cmd, data + 1, len - 1);
+    if (entry->ack == CMD_ACK_OK) {
+        ble_service_ack();
     }
 }
 
-// Control loop task
-static void control_loop_task(void *arg)
+// Control loop tick - runs at a fixed rate on the control task
+static void control_tick(void)
 {
-    const TickType_t delay = pdMS_TO_TICKS(10);
-
-    while (1) {
-        motor_update_ramp();
-        motor_check_inactivity();
-        vTaskDelay(delay);
-    }
+    motor_apply_intent();
+    motor_tick();
+    motor_publish_status();
 }
 
 // Main entry point
 void app_main(void)
 {
-    // Check if woke from deep sleep - if so, blink and sleep again
-    // This must be FIRST to avoid full initialization
-    sleep_manager_check_wake();
+    // Check if woke from deep sleep - if so, blink and boot into a short
+    // advertising window. This must be FIRST
+    bool timer_wake = sleep_manager_check_wake();
 
     ESP_LOGI(TAG, "Zobo ESP32 Robot Controller v%s Starting...", ota_manager_get_version());
 
@@ -338,27 +897,55 @@ void app_main(void)
 
     // Initialize hardware
     led_init();
+#if FAST_BOOT
+    if (!timer_wake) {
+        led_startup_sequence_async();
+    }
+#endif
     motor_init();
+    fleet_init();
+    if (wheel_encoder_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Wheel encoders unavailable, closed-loop control disabled");
+    }
 
+#if !FAST_BOOT
     // Run LED startup sequence (only on fresh boot, not from sleep)
-    led_startup_sequence();
+    if (!timer_wake) {
+        led_startup_sequence();
+    }
+#endif
+
+    // Start command dispatcher before BLE so no write is lost
+    command_dispatcher_config_t dispatch_cfg = COMMAND_DISPATCHER_DEFAULT_CONFIG();
+    dispatch_cfg.handler = ble_command_handler;
+    dispatch_cfg.is_control = is_control_command;
+    ESP_ERROR_CHECK(command_dispatcher_init(&dispatch_cfg));
+
+    // Initialize BLE first so advertising starts as early as possible - the
+    // GATT callback only copies commands into the dispatcher
+    ble_service_init();
+    ble_service_set_callback(command_dispatcher_post);
+    telemetry_init();
 
-    // Initialize WiFi manager (loads saved credentials)
+    // Load saved WiFi credentials; the WiFi stack itself starts on first connect
     wifi_manager_init();
+    wifi_manager_set_status_callback(wifi_status_callback);
 
     // Initialize OTA manager
     ota_manager_init();
     ota_manager_set_callback(ota_status_callback);
-
-    // Initialize BLE
-    ble_service_init();
-    ble_service_set_callback(ble_command_handler);
+    ble_ota_init(ota_status_callback);
 
     // Initialize sleep manager
     sleep_manager_init();
 
-    ESP_LOGI(TAG, "Ready! Waiting for BLE connection...");
+    // Radio airtime follows what the robot is doing
+    coex_policy_init();
+
+    ESP_LOGI(TAG, "Ready after %" PRId64 " ms! Waiting for BLE connection...", esp_timer_get_time() / 1000);
 
-    // Start control loop task
-    xTaskCreate(control_loop_task, "control_loop", 4096, NULL, 5, NULL);
+    // Start hardware-timed control loop
+    control_loop_config_t loop_cfg = CONTROL_LOOP_DEFAULT_CONFIG();
+    loop_cfg.tick = control_tick;
+    ESP_ERROR_CHECK(control_loop_start(&loop_cfg));
 }
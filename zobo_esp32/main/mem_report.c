@@ -0,0 +1,45 @@
+/**
+ * Memory Report
+ */
+
+#include "mem_report.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+
+// Firmware tasks first, then the IDF ones sharing internal RAM. Tasks
+// that only run during an update, or belong to the BLE host that isn't
+// built in, are skipped while absent
+static const char *const s_task_names[] = {
+    "control_loop", "cmd_control", "cmd_service", "ble_tx", "wifi_mgr",
+    "coex", "sleep_mgr", "ota_task", "ota_writer", "ota_report", "ble_ota",
+    "nimble_host", "BTC_TASK", "BTU_TASK", "btController", "wifi", "tiT",
+    "sys_evt", "esp_timer",
+};
+
+void mem_report_get_heap(mem_heap_info_t *info)
+{
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+    info->free_bytes = heap_caps_get_free_size(caps);
+    info->min_free_bytes = heap_caps_get_minimum_free_size(caps);
+    info->largest_block = heap_caps_get_largest_free_block(caps);
+    info->total_free_bytes = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t mem_report_get_tasks(mem_task_info_t *tasks, uint32_t max)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < sizeof(s_task_names) / sizeof(s_task_names[0]) && count < max; i++) {
+        TaskHandle_t task = xTaskGetHandle(s_task_names[i]);
+        if (!task) {
+            continue;
+        }
+        // ESP-IDF stacks are in bytes
+        tasks[count].name = s_task_names[i];
+        tasks[count].stack_free = uxTaskGetStackHighWaterMark(task);
+        count++;
+    }
+    return count;
+}
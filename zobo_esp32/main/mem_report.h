@@ -0,0 +1,34 @@
+/**
+ * Memory Report - Header
+ *
+ * Heap headroom and per-task stack high-water marks, for tuning the RAM
+ * that WiFi, Bluedroid and TLS compete for.
+ */
+
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stdint.h>
+
+#define MEM_REPORT_MAX_TASKS    24
+
+// Internal 8-bit capable RAM (where stacks, WiFi/BT buffers and TLS live)
+typedef struct {
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;        // Low-water mark since boot
+    uint32_t largest_block;         // Biggest single allocation possible now
+    uint32_t total_free_bytes;      // All heaps
+} mem_heap_info_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_free;            // Bytes never touched since the task started
+} mem_task_info_t;
+
+void mem_report_get_heap(mem_heap_info_t *info);
+
+// Known firmware and system tasks that are currently running. Walks the
+// task lists, so not for hot paths. Returns the number filled in
+uint32_t mem_report_get_tasks(mem_task_info_t *tasks, uint32_t max);
+
+#endif // MEM_REPORT_H
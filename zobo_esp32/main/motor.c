@@ -3,11 +3,23 @@
  */
 
 #include "motor.h"
+#include "motor_core.h"
+#include <string.h>
+#include <inttypes.h>
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "nvs.h"
+#include "control_loop.h"
+#include "ramp_profile.h"
+#include "wheel_encoder.h"
+#include "seqlock.h"
+#include "latency_trace.h"
+#include "evlog.h"
 
 static const char *TAG = "MOTOR";
 
@@ -18,25 +30,162 @@ static const char *TAG = "MOTOR";
 #define MOTOR_RIGHT_DIR     26
 
 // PWM Configuration
-#define PWM_FREQ_HZ         5000
-#define PWM_RESOLUTION      LEDC_TIMER_8_BIT
+#define PWM_TIMER_LEFT      LEDC_TIMER_0
+#define PWM_TIMER_RIGHT     LEDC_TIMER_2    // Own timer so each wheel can run its own frequency
 #define PWM_CHANNEL_LEFT    LEDC_CHANNEL_0
 #define PWM_CHANNEL_RIGHT   LEDC_CHANNEL_1
+#define PWM_SOURCE_CLK_HZ   80000000        // APB clock feeding the LEDC timers
 
-// Ramp Configuration
-#define RAMP_START_PWM      150
-#define RAMP_END_PWM        255
-#define RAMP_DURATION_MS    2000
-#define LOOP_DELAY_MS       10
-#define INACTIVITY_MS       300
-#define INACTIVITY_TICKS    (INACTIVITY_MS / LOOP_DELAY_MS)
-
-// State variables
-static bool ramp_forward_active = false;
-static bool forward_latched = false;
-static uint32_t ramp_start_ms = 0;
-static int inactivity_timer = 0;
-static bool timer_active = false;
+// PWM configuration storage
+#define NVS_NAMESPACE       "motor"
+#define NVS_KEY_PWM         "pwm"
+
+// Hardware fade: non-linear profiles are split into linear segments
+#define FADE_SEGMENTS_NONLINEAR 8
+#define FADE_DONE_LEFT      BIT0
+#define FADE_DONE_RIGHT     BIT1
+#define FADE_DONE_BOTH      (FADE_DONE_LEFT | FADE_DONE_RIGHT)
+
+// Ramp, latch, playback, watchdog and closed loop (control task only,
+// watchdog stats read from anywhere)
+static motor_core_t core;
+static const motor_hal_t hal;       // LEDC / esp_timer backend, defined below
+
+// Active PWM configuration, loaded from NVS in motor_init()
+static motor_pwm_config_t pwm_config = MOTOR_PWM_DEFAULT_CONFIG();
+static uint32_t duty_max = (1 << MOTOR_PWM_BITS_DEFAULT) - 1;
+static uint8_t speed_shift = 15 - MOTOR_PWM_BITS_DEFAULT;    // Q15 speed -> duty
+
+// Hardware fade state (fade_done_mask is also written from the fade ISR)
+static _Atomic motor_ramp_mode_t ramp_mode = MOTOR_RAMP_HW_FADE;
+static volatile bool fade_running = false;
+static volatile uint32_t fade_done_mask = 0;
+static bool fade_last_segment = false;
+static uint8_t fade_segment = 0;
+static uint8_t fade_segments = 0;
+static bool fade_dir_left = false;
+static bool fade_dir_right = false;
+
+// Closed-loop switch, requested from the command side
+typedef struct {
+    bool enable;
+    bool has_config;
+    motor_closed_loop_config_t config;
+} closed_loop_request_t;
+
+// Cross-task hand-off: intents and config in, status out. Writers are
+// the control dispatcher (intents), the service dispatcher (config) and
+// the control loop (status)
+SEQLOCK_DEFINE(intent_mailbox, motor_intent_t);
+SEQLOCK_DEFINE(ramp_config_box, motor_ramp_config_t);
+SEQLOCK_DEFINE(watchdog_config_box, motor_watchdog_config_t);
+SEQLOCK_DEFINE(closed_loop_box, closed_loop_request_t);
+SEQLOCK_DEFINE(status_snapshot, motor_status_t);
+static motor_intent_t intent;           // Control task only
+static uint32_t intent_seq = 0;
+static uint16_t pwm_trace = LATENCY_TRACE_NONE;     // Completed by the next duty update
+
+// Snapshot readers give up after a few tries and return the last value any
+// reader got: a writer preempted mid-update by a higher priority reader on
+// its own core would otherwise never finish
+#define SNAPSHOT_READ_TRIES 4
+static portMUX_TYPE snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+static motor_ramp_config_t last_ramp_config = MOTOR_CORE_DEFAULT_RAMP_CONFIG();
+static motor_watchdog_config_t last_watchdog_config = MOTOR_WATCHDOG_DEFAULT_CONFIG();
+static motor_status_t last_status;
+
+static void read_snapshot(_Atomic uint32_t *seq, _Atomic uint32_t *words,
+                          void *dst, void *last, size_t size)
+{
+    for (int i = 0; i < SNAPSHOT_READ_TRIES; i++) {
+        if (seqlock_read_words(seq, words, dst, size, NULL)) {
+            portENTER_CRITICAL(&snapshot_lock);
+            memcpy(last, dst, size);
+            portEXIT_CRITICAL(&snapshot_lock);
+            return;
+        }
+        taskYIELD();
+    }
+    portENTER_CRITICAL(&snapshot_lock);
+    memcpy(dst, last, size);
+    portEXIT_CRITICAL(&snapshot_lock);
+}
+
+#define read_snapshot_of(lock, dst, last) \
+    read_snapshot(&(lock).seq, (lock).words, (dst), (last), sizeof(*(dst)))
+
+// Fade completion (ISR). Only records which channel finished: the core
+// belongs to the control task, which sees the mask in hal_fade_update()
+// on its next tick and latches the forward ramp there
+static bool IRAM_ATTR on_fade_end(const ledc_cb_param_t *param, void *user_arg)
+{
+    if (param->event == LEDC_FADE_END_EVT && fade_running) {
+        fade_done_mask |= (uint32_t)(uintptr_t)user_arg;
+    }
+    return false;
+}
+
+esp_err_t motor_validate_pwm_config(const motor_pwm_config_t *config)
+{
+    if (!config ||
+        config->resolution_bits < MOTOR_PWM_BITS_MIN || config->resolution_bits > MOTOR_PWM_BITS_MAX ||
+        config->left_freq_hz < MOTOR_PWM_FREQ_MIN || config->right_freq_hz < MOTOR_PWM_FREQ_MIN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The timer divider needs freq * 2^bits to fit within the source clock
+    uint64_t max_freq = config->left_freq_hz > config->right_freq_hz ?
+                        config->left_freq_hz : config->right_freq_hz;
+    if ((max_freq << config->resolution_bits) > PWM_SOURCE_CLK_HZ) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+static void load_pwm_config(void)
+{
+    nvs_handle_t nvs_handle;
+    motor_pwm_config_t stored;
+    size_t len = sizeof(stored);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs_handle, NVS_KEY_PWM, &stored, &len) == ESP_OK &&
+        len == sizeof(stored)) {
+        if (motor_validate_pwm_config(&stored) == ESP_OK) {
+            pwm_config = stored;
+        } else {
+            ESP_LOGW(TAG, "Stored PWM config invalid, using defaults");
+        }
+    }
+    nvs_close(nvs_handle);
+}
+
+esp_err_t motor_save_pwm_config(const motor_pwm_config_t *config)
+{
+    esp_err_t ret = motor_validate_pwm_config(config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    nvs_handle_t nvs_handle;
+    ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(nvs_handle, NVS_KEY_PWM, config, sizeof(*config));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return ret;
+}
+
+void motor_get_pwm_config(motor_pwm_config_t *config)
+{
+    *config = pwm_config;
+}
 
 void motor_init(void)
 {
@@ -50,21 +199,28 @@ void motor_init(void)
     };
     gpio_config(&io_conf);
 
-    // Configure LEDC timer
+    load_pwm_config();
+    duty_max = (1UL << pwm_config.resolution_bits) - 1;
+    speed_shift = 15 - pwm_config.resolution_bits;
+
+    // Configure one LEDC timer per wheel
     ledc_timer_config_t timer_conf = {
         .speed_mode = LEDC_LOW_SPEED_MODE,
-        .timer_num = LEDC_TIMER_0,
-        .duty_resolution = PWM_RESOLUTION,
-        .freq_hz = PWM_FREQ_HZ,
+        .timer_num = PWM_TIMER_LEFT,
+        .duty_resolution = (ledc_timer_bit_t)pwm_config.resolution_bits,
+        .freq_hz = pwm_config.left_freq_hz,
         .clk_cfg = LEDC_AUTO_CLK,
     };
     ledc_timer_config(&timer_conf);
+    timer_conf.timer_num = PWM_TIMER_RIGHT;
+    timer_conf.freq_hz = pwm_config.right_freq_hz;
+    ledc_timer_config(&timer_conf);
 
     // Configure left motor PWM channel
     ledc_channel_config_t left_conf = {
         .speed_mode = LEDC_LOW_SPEED_MODE,
         .channel = PWM_CHANNEL_LEFT,
-        .timer_sel = LEDC_TIMER_0,
+        .timer_sel = PWM_TIMER_LEFT,
         .intr_type = LEDC_INTR_DISABLE,
         .gpio_num = PWM_MOTOR_LEFT,
         .duty = 0,
@@ -76,7 +232,7 @@ void motor_init(void)
     ledc_channel_config_t right_conf = {
         .speed_mode = LEDC_LOW_SPEED_MODE,
         .channel = PWM_CHANNEL_RIGHT,
-        .timer_sel = LEDC_TIMER_0,
+        .timer_sel = PWM_TIMER_RIGHT,
         .intr_type = LEDC_INTR_DISABLE,
         .gpio_num = PWM_MOTOR_RIGHT,
         .duty = 0,
@@ -84,15 +240,33 @@ void motor_init(void)
     };
     ledc_channel_config(&right_conf);
 
-    ESP_LOGI(TAG, "Motor PWM initialized");
+    // Hardware fade with completion callbacks for both channels
+    ledc_fade_func_install(0);
+    ledc_cbs_t fade_cbs = {
+        .fade_cb = on_fade_end,
+    };
+    ledc_cb_register(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_LEFT, &fade_cbs, (void *)FADE_DONE_LEFT);
+    ledc_cb_register(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_RIGHT, &fade_cbs, (void *)FADE_DONE_RIGHT);
+
+    motor_core_init(&core, &hal);
+    seqlock_write(ramp_config_box, &core.ramp_config);
+    seqlock_write(watchdog_config_box, &core.watchdog_config);
+
+    ESP_LOGI(TAG, "Motor PWM initialized: %d-bit, %" PRIu32 "/%" PRIu32 " Hz",
+             pwm_config.resolution_bits, pwm_config.left_freq_hz, pwm_config.right_freq_hz);
 }
 
-void motor_set_pwm(uint8_t left, uint8_t right)
+void motor_set_pwm(uint16_t left, uint16_t right)
 {
     ledc_set_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_LEFT, left);
     ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_LEFT);
     ledc_set_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_RIGHT, right);
     ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_RIGHT);
+
+    if (pwm_trace != LATENCY_TRACE_NONE) {
+        latency_trace_mark(pwm_trace, LATENCY_STAGE_PWM);
+        pwm_trace = LATENCY_TRACE_NONE;
+    }
 }
 
 void motor_set_direction(bool left_high, bool right_high)
@@ -101,76 +275,372 @@ void motor_set_direction(bool left_high, bool right_high)
     gpio_set_level(MOTOR_RIGHT_DIR, right_high ? 1 : 0);
 }
 
-void motor_stop(void)
+// Map a signed speed to duty for a given direction pin state. With DIR
+// high the H-bridge inverts PWM, so reverse speed is (max - duty).
+static uint32_t speed_to_duty_dir(int16_t speed, bool dir_high)
 {
-    motor_set_pwm(0, 0);
-    motor_set_direction(false, false);
-    ramp_forward_active = false;
-    forward_latched = false;
+    uint32_t magnitude = (uint32_t)(speed < 0 ? -speed : speed) >> speed_shift;
+    return dir_high ? duty_max - magnitude : magnitude;
 }
 
-void motor_start_ramp(void)
+static int16_t duty_to_speed(uint32_t duty, bool dir_high)
+{
+    return dir_high ? (int16_t)-((duty_max - duty) << speed_shift) : (int16_t)(duty << speed_shift);
+}
+
+static uint16_t speed_to_duty(int16_t speed, bool *dir_high)
+{
+    *dir_high = (speed < 0);
+    return (uint16_t)speed_to_duty_dir(speed, *dir_high);
+}
+
+// ---------------------------------------------------------------------------
+// HAL for the control core: esp_timer, LEDC + DIR pins, encoders, evlog
+// ---------------------------------------------------------------------------
+
+static int64_t hal_now_us(void *ctx)
+{
+    return esp_timer_get_time();
+}
+
+// Drive the H-bridge with signed speeds
+static void hal_drive(void *ctx, int16_t left, int16_t right)
+{
+    bool left_high, right_high;
+    uint16_t left_duty = speed_to_duty(left, &left_high);
+    uint16_t right_duty = speed_to_duty(right, &right_high);
+    motor_set_pwm(left_duty, right_duty);
+    motor_set_direction(left_high, right_high);
+}
+
+static void hal_read_encoders(void *ctx, int32_t *left, int32_t *right)
+{
+    wheel_encoder_read_delta(left, right);
+}
+
+// Stop a running hardware fade and report where it got to
+static void hal_fade_abort(void *ctx, motor_setpoint_t *reached)
+{
+    if (!fade_running) {
+        return;
+    }
+    fade_running = false;
+    ledc_fade_stop(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_LEFT);
+    ledc_fade_stop(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_RIGHT);
+    reached->left = duty_to_speed(ledc_get_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_LEFT), fade_dir_left);
+    reached->right = duty_to_speed(ledc_get_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL_RIGHT), fade_dir_right);
+}
+
+// Start one fade segment on a channel, or mark it done if the duty doesn't change
+static void fade_channel(ledc_channel_t channel, uint32_t done_bit, uint32_t target_duty, int time_ms)
 {
-    if (!ramp_forward_active && !forward_latched) {
-        ramp_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        ramp_forward_active = true;
-        motor_set_pwm(RAMP_START_PWM, RAMP_START_PWM);
-        motor_set_direction(false, false);
-        ESP_LOGI(TAG, "Starting forward ramp");
+    if (ledc_get_duty(LEDC_LOW_SPEED_MODE, channel) == target_duty || time_ms <= 0) {
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, channel, target_duty);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, channel);
+        fade_done_mask |= done_bit;
+        return;
     }
+    ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, channel, target_duty, time_ms);
+    ledc_fade_start(LEDC_LOW_SPEED_MODE, channel, LEDC_FADE_NO_WAIT);
 }
 
-void motor_update_ramp(void)
+// Hand the next segment of the ramp to the LEDC hardware on both channels
+static void fade_start_segment(const motor_ramp_t *ramp)
 {
-    if (ramp_forward_active) {
-        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        uint32_t elapsed = now - ramp_start_ms;
+    uint16_t phase = (uint16_t)(((uint32_t)(fade_segment + 1) * RAMP_Q16_ONE) / fade_segments);
+    uint16_t fraction = ramp_profile_eval(ramp->lut, phase);
+    int16_t left = motor_core_interp(ramp->from.left, ramp->to.left, fraction);
+    int16_t right = motor_core_interp(ramp->from.right, ramp->to.right, fraction);
+    int time_ms = (int)(ramp->duration_us / 1000 / fade_segments);
 
-        if (elapsed >= RAMP_DURATION_MS) {
-            motor_set_pwm(RAMP_END_PWM, RAMP_END_PWM);
-            ramp_forward_active = false;
-            forward_latched = true;
-            ESP_LOGI(TAG, "Ramp complete, latched at max");
-        } else {
-            uint16_t pwm_now = RAMP_START_PWM +
-                (uint32_t)(RAMP_END_PWM - RAMP_START_PWM) * elapsed / RAMP_DURATION_MS;
-            motor_set_pwm(pwm_now, pwm_now);
-        }
+    fade_done_mask = 0;
+    fade_last_segment = (fade_segment + 1 == fade_segments);
+    fade_channel(PWM_CHANNEL_LEFT, FADE_DONE_LEFT, speed_to_duty_dir(left, fade_dir_left), time_ms);
+    fade_channel(PWM_CHANNEL_RIGHT, FADE_DONE_RIGHT, speed_to_duty_dir(right, fade_dir_right), time_ms);
+}
+
+// A wheel can only fade in hardware if it doesn't change direction
+static bool fade_possible(int16_t from, int16_t to)
+{
+    return from == 0 || to == 0 || (from < 0) == (to < 0);
+}
+
+static bool hal_fade_begin(void *ctx, const motor_ramp_t *ramp)
+{
+    if (motor_get_ramp_mode() != MOTOR_RAMP_HW_FADE ||
+        !fade_possible(ramp->from.left, ramp->to.left) ||
+        !fade_possible(ramp->from.right, ramp->to.right)) {
+        return false;
     }
+
+    // Direction follows whichever end of the ramp is moving
+    fade_dir_left = (ramp->to.left != 0) ? (ramp->to.left < 0) : (ramp->from.left < 0);
+    fade_dir_right = (ramp->to.right != 0) ? (ramp->to.right < 0) : (ramp->from.right < 0);
+    motor_set_pwm(speed_to_duty_dir(ramp->from.left, fade_dir_left),
+                  speed_to_duty_dir(ramp->from.right, fade_dir_right));
+    motor_set_direction(fade_dir_left, fade_dir_right);
+
+    fade_segments = (ramp->lut == ramp_profile_get_lut(RAMP_PROFILE_LINEAR)) ?
+                    1 : FADE_SEGMENTS_NONLINEAR;
+    fade_segment = 0;
+    fade_running = true;
+    fade_start_segment(ramp);
+    return true;
+}
+
+// Chain segments; true once the last one finished on both channels
+static bool hal_fade_update(void *ctx, const motor_ramp_t *ramp)
+{
+    if (fade_done_mask != FADE_DONE_BOTH) {
+        return false;
+    }
+    if (!fade_last_segment) {
+        fade_segment++;
+        fade_start_segment(ramp);
+        return false;
+    }
+    fade_running = false;
+    return true;
+}
+
+static void hal_event(void *ctx, motor_core_event_t event, uint32_t arg0, uint32_t arg1)
+{
+    static const evlog_event_t ids[] = {
+        [MOTOR_CORE_EV_RAMP_START] = EV_MOTOR_RAMP_START,
+        [MOTOR_CORE_EV_RAMP_DONE] = EV_MOTOR_RAMP_DONE,
+        [MOTOR_CORE_EV_WATCHDOG] = EV_MOTOR_WATCHDOG,
+        [MOTOR_CORE_EV_INACTIVITY] = EV_MOTOR_INACTIVITY,
+        [MOTOR_CORE_EV_STALE] = EV_MOTOR_STALE,
+        [MOTOR_CORE_EV_NO_ENCODER] = EV_MOTOR_NO_ENCODER,
+    };
+    evlog_write(ids[event], arg0, arg1);
+}
+
+static const motor_hal_t hal = {
+    .now_us = hal_now_us,
+    .drive = hal_drive,
+    .read_encoders = hal_read_encoders,
+    .fade_begin = hal_fade_begin,
+    .fade_update = hal_fade_update,
+    .fade_abort = hal_fade_abort,
+    .event = hal_event,
+};
+
+// ---------------------------------------------------------------------------
+// Control task API, delegated to the core
+// ---------------------------------------------------------------------------
+
+void motor_set_speed(int16_t left, int16_t right)
+{
+    motor_core_set_speed(&core, left, right);
+}
+
+void motor_ramp_to(int16_t left, int16_t right)
+{
+    motor_core_ramp_to(&core, left, right);
+}
+
+void motor_play_setpoints(const motor_setpoint_t *setpoints, uint8_t count, uint16_t interval_ms)
+{
+    motor_core_play_setpoints(&core, setpoints, count, interval_ms);
+}
+
+void motor_cancel_setpoints(void)
+{
+    motor_core_cancel_setpoints(&core);
+}
+
+void motor_stop(void)
+{
+    motor_core_stop(&core);
+}
+
+void motor_stop_now(void)
+{
+    motor_core_stop_now(&core);
+}
+
+void motor_start_ramp(void)
+{
+    motor_core_start_ramp(&core);
 }
 
 bool motor_is_ramping(void)
 {
-    return ramp_forward_active;
+    return core.ramp.active;
 }
 
 bool motor_is_latched(void)
 {
-    return forward_latched;
+    return core.forward_latched;
 }
 
 void motor_cancel_ramp(void)
 {
-    ramp_forward_active = false;
-    forward_latched = false;
+    motor_core_cancel_ramp(&core);
+}
+
+void motor_tick(void)
+{
+    motor_core_tick(&core);
+}
+
+esp_err_t motor_set_ramp_config(const motor_ramp_config_t *config)
+{
+    if (!config ||
+        !ramp_profile_get_lut(config->accel_profile) ||
+        !ramp_profile_get_lut(config->decel_profile)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Picked up by the control loop before its next ramp
+    seqlock_write(ramp_config_box, config);
+    return ESP_OK;
+}
+
+void motor_get_ramp_config(motor_ramp_config_t *config)
+{
+    read_snapshot_of(ramp_config_box, config, &last_ramp_config);
+}
+
+void motor_set_ramp_mode(motor_ramp_mode_t mode)
+{
+    // A fade already running finishes; the mode applies to the next ramp
+    atomic_store_explicit(&ramp_mode, mode, memory_order_relaxed);
+}
+
+motor_ramp_mode_t motor_get_ramp_mode(void)
+{
+    return atomic_load_explicit(&ramp_mode, memory_order_relaxed);
+}
+
+esp_err_t motor_set_closed_loop(bool enable, const motor_closed_loop_config_t *config)
+{
+    if (enable && !wheel_encoder_is_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config && (config->max_counts_per_sec == 0 || config->correction_limit > MOTOR_SPEED_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    closed_loop_request_t request = {
+        .enable = enable,
+        .has_config = (config != NULL),
+    };
+    if (config) {
+        request.config = *config;
+    }
+    seqlock_write(closed_loop_box, &request);
+    return ESP_OK;
+}
+
+bool motor_is_closed_loop(void)
+{
+    return core.closed_loop;
+}
+
+void motor_post_intent(const motor_intent_t *new_intent)
+{
+    seqlock_write(intent_mailbox, new_intent);
+}
+
+// Take config published by other tasks (control task)
+static void apply_config(void)
+{
+    static closed_loop_request_t request;
+    static uint32_t ramp_config_seq = 0;
+    static uint32_t closed_loop_seq = 0;
+    static uint32_t watchdog_config_seq = 0;
+    static bool encoders_enabled = false;
+    motor_ramp_config_t config;
+    motor_watchdog_config_t wd_config;
+    uint32_t seq;
+
+    if (seqlock_read(ramp_config_box, &config, &seq) && seq != ramp_config_seq) {
+        ramp_config_seq = seq;
+        motor_core_set_ramp_config(&core, &config);
+    }
+    if (seqlock_read(watchdog_config_box, &wd_config, &seq) && seq != watchdog_config_seq) {
+        watchdog_config_seq = seq;
+        motor_core_set_watchdog_config(&core, &wd_config);
+    }
+    if (seqlock_read(closed_loop_box, &request, &seq) && seq != closed_loop_seq) {
+        closed_loop_seq = seq;
+        motor_core_set_closed_loop(&core, request.enable,
+                                   request.has_config ? &request.config : NULL,
+                                   control_loop_get_rate_hz());
+        ESP_LOGI(TAG, "Closed-loop control %s", core.closed_loop ? "enabled" : "disabled");
+    }
+
+    // Encoders only count while closed loop runs, including after the
+    // core dropped it for silent encoders
+    if (core.closed_loop != encoders_enabled) {
+        encoders_enabled = core.closed_loop;
+        wheel_encoder_enable(encoders_enabled);
+    }
+}
+
+void motor_apply_intent(void)
+{
+    uint32_t seq;
+
+    apply_config();
+
+    // A failed read means the producer is mid-write - pick it up next tick
+    if (!seqlock_read(intent_mailbox, &intent, &seq) || seq == intent_seq) {
+        return;
+    }
+    intent_seq = seq;
+    latency_trace_mark(intent.trace, LATENCY_STAGE_PICKUP);
+
+    // Traced up to the duty update it causes, unless dropped as stale
+    pwm_trace = intent.trace;
+    if (!motor_core_apply_intent(&core, &intent)) {
+        pwm_trace = LATENCY_TRACE_NONE;
+    }
+}
+
+void motor_publish_status(void)
+{
+    // Intents that didn't change the duty this tick aren't traced further
+    pwm_trace = LATENCY_TRACE_NONE;
+
+    motor_status_t status;
+    motor_core_get_status(&core, &status);
+    seqlock_write(status_snapshot, &status);
+}
+
+void motor_get_status(motor_status_t *status)
+{
+    read_snapshot_of(status_snapshot, status, &last_status);
 }
 
 void motor_reset_inactivity(void)
 {
-    timer_active = true;
-    inactivity_timer = INACTIVITY_TICKS;
+    motor_core_reset_inactivity(&core);
 }
 
-void motor_check_inactivity(void)
+esp_err_t motor_set_watchdog_config(const motor_watchdog_config_t *config)
 {
-    if (inactivity_timer > 0) {
-        inactivity_timer--;
-    } else if (timer_active) {
-        timer_active = false;
-        ramp_forward_active = false;
-        forward_latched = false;
-        motor_set_pwm(0, 0);
-        motor_set_direction(false, false);
-        ESP_LOGI(TAG, "Inactivity timeout - motors stopped");
+    if (!config ||
+        config->hold_ms < MOTOR_WATCHDOG_HOLD_MS_MIN || config->hold_ms > MOTOR_WATCHDOG_HOLD_MS_MAX ||
+        config->decel_ms > MOTOR_WATCHDOG_DECEL_MS_MAX) {
+        return ESP_ERR_INVALID_ARG;
     }
+    seqlock_write(watchdog_config_box, config);
+    return ESP_OK;
+}
+
+void motor_get_watchdog_config(motor_watchdog_config_t *config)
+{
+    read_snapshot_of(watchdog_config_box, config, &last_watchdog_config);
+}
+
+void motor_get_watchdog_stats(motor_watchdog_stats_t *stats)
+{
+    motor_core_get_watchdog_stats(&core, stats);
+}
+
+void motor_reset_watchdog_stats(void)
+{
+    motor_core_reset_watchdog_stats(&core);
 }
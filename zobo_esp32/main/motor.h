@@ -7,28 +7,209 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "esp_err.h"
+#include "ramp_profile.h"
 
-// Initialize motor PWM and GPIO
+// Signed wheel speed range (positive = forward)
+#define MOTOR_SPEED_MAX         32767
+
+// Convert a legacy 8-bit duty (0-255) to a signed speed
+#define MOTOR_SPEED_FROM_DUTY8(d)   ((int16_t)(((int32_t)(d) * MOTOR_SPEED_MAX) / 255))
+
+// PWM limits: 10-13 bit duty, ultrasonic frequency. freq * 2^bits must
+// not exceed the 80 MHz LEDC source clock (e.g. 11 bit tops out at 39 kHz)
+#define MOTOR_PWM_BITS_MIN      10
+#define MOTOR_PWM_BITS_MAX      13
+#define MOTOR_PWM_FREQ_MIN      20000
+#define MOTOR_PWM_BITS_DEFAULT  11
+#define MOTOR_PWM_FREQ_DEFAULT  20000
+
+// PWM configuration, stored in NVS and applied at init
+typedef struct {
+    uint8_t resolution_bits;    // Shared by both wheels
+    uint32_t left_freq_hz;
+    uint32_t right_freq_hz;
+} motor_pwm_config_t;
+
+#define MOTOR_PWM_DEFAULT_CONFIG() {            \
+    .resolution_bits = MOTOR_PWM_BITS_DEFAULT,  \
+    .left_freq_hz = MOTOR_PWM_FREQ_DEFAULT,     \
+    .right_freq_hz = MOTOR_PWM_FREQ_DEFAULT,    \
+}
+
+// Max setpoints that can be queued for playback
+#define MOTOR_MAX_SETPOINTS     32
+
+// Signed left/right wheel setpoint
+typedef struct {
+    int16_t left;
+    int16_t right;
+} motor_setpoint_t;
+
+// Complete drive intent, published by the command side and applied by
+// the control loop on its next tick (latest intent wins)
+typedef enum {
+    MOTOR_INTENT_NONE,
+    MOTOR_INTENT_STOP,          // Decelerate to a stop
+    MOTOR_INTENT_FORWARD,       // Forward ramp with latch
+    MOTOR_INTENT_RAMP_TO,       // Decelerate/turn to setpoints[0]
+    MOTOR_INTENT_SET_SPEED,     // Jump to setpoints[0]
+    MOTOR_INTENT_SETPOINTS,     // Play count setpoints, one every interval_ms
+} motor_intent_type_t;
+
+typedef struct {
+    uint8_t type;               // motor_intent_type_t
+    uint8_t count;
+    uint16_t interval_ms;
+    uint16_t trace;             // Latency trace id, LATENCY_TRACE_NONE if untraced
+    uint8_t flags;              // MOTOR_INTENT_FLAG_*
+    uint16_t seq;               // Sender sequence number, with MOTOR_INTENT_FLAG_SEQ
+    int64_t apply_at_us;        // esp_timer time to apply at, 0 = on pickup (fleet frames)
+    motor_setpoint_t setpoints[MOTOR_MAX_SETPOINTS];
+} motor_intent_t;
+
+// Intent flags
+#define MOTOR_INTENT_FLAG_SEQ   0x01    // seq is valid - stale/reordered intents are dropped
+
+// Consistent snapshot of the control loop's motor state
+typedef struct {
+    motor_setpoint_t speed;     // Commanded (or target in closed loop)
+    motor_setpoint_t measured;  // From encoders, zero when open loop
+    bool ramping;
+    bool latched;
+    bool closed_loop;
+    uint16_t inactivity_ms;     // Left before the watchdog decelerates, 0 when not armed
+} motor_status_t;
+
+// Command-stream watchdog. The last setpoint is held for hold_ms after the
+// last drive intent, then the motors decelerate to a stop over decel_ms
+#define MOTOR_WATCHDOG_HOLD_MS_MIN      100
+#define MOTOR_WATCHDOG_HOLD_MS_MAX      5000
+#define MOTOR_WATCHDOG_DECEL_MS_MAX     2000
+
+typedef struct {
+    uint16_t hold_ms;
+    uint16_t decel_ms;          // 0 = stop immediately
+} motor_watchdog_config_t;
+
+#define MOTOR_WATCHDOG_DEFAULT_CONFIG() {   \
+    .hold_ms = 500,                         \
+    .decel_ms = 300,                        \
+}
+
+typedef struct {
+    uint32_t timeouts;          // Holds that ran out into a deceleration
+    uint32_t stale;             // Intents dropped for an old sequence number
+    uint32_t gaps;              // Sequence numbers that never reached the loop
+    uint32_t max_gap_ms;        // Longest time between drive intents while armed
+} motor_watchdog_stats_t;
+
+// Ramp shaping: acceleration for the forward ramp, deceleration for
+// stop and direction changes
+typedef struct {
+    ramp_profile_id_t accel_profile;
+    uint16_t accel_ms;
+    ramp_profile_id_t decel_profile;
+    uint16_t decel_ms;
+} motor_ramp_config_t;
+
+// How ramps are executed
+typedef enum {
+    MOTOR_RAMP_SOFTWARE,    // Duty updated by the control loop every tick
+    MOTOR_RAMP_HW_FADE,     // LEDC fade hardware; falls back to software on direction changes
+} motor_ramp_mode_t;
+
+// Closed-loop wheel speed control. Speeds become targets and
+// max_counts_per_sec maps encoder counts onto MOTOR_SPEED_MAX
+typedef struct {
+    int32_t kp;                     // Q8 gains (256 = 1.0), ki/kd per control tick
+    int32_t ki;
+    int32_t kd;
+    int32_t correction_limit;       // Max PID trim on top of the target (Q15)
+    uint32_t max_counts_per_sec;    // Encoder counts/s at full speed
+} motor_closed_loop_config_t;
+
+#define MOTOR_CLOSED_LOOP_DEFAULT_CONFIG() {    \
+    .kp = 128,                                  \
+    .ki = 4,                                    \
+    .kd = 0,                                    \
+    .correction_limit = 8192,                   \
+    .max_counts_per_sec = 3000,                 \
+}
+
+// Initialize motor PWM and GPIO (PWM config is loaded from NVS)
 void motor_init(void);
 
-// Set PWM duty cycle (0-255)
-void motor_set_pwm(uint8_t left, uint8_t right);
+// Check a PWM config against the resolution, frequency and clock limits
+esp_err_t motor_validate_pwm_config(const motor_pwm_config_t *config);
+
+// Store a PWM config in NVS - takes effect on the next boot
+esp_err_t motor_save_pwm_config(const motor_pwm_config_t *config);
+
+// Get the PWM config in use
+void motor_get_pwm_config(motor_pwm_config_t *config);
+
+// Set raw PWM duty cycle (0 .. 2^resolution_bits - 1)
+void motor_set_pwm(uint16_t left, uint16_t right);
 
 // Set motor direction
 void motor_set_direction(bool left_high, bool right_high);
 
-// Stop both motors
+// Set signed wheel speeds (-MOTOR_SPEED_MAX..MOTOR_SPEED_MAX)
+void motor_set_speed(int16_t left, int16_t right);
+
+// Ramp from the current speeds to new ones using the deceleration profile
+void motor_ramp_to(int16_t left, int16_t right);
+
+// Play a batch of setpoints, one every interval_ms (replaces any pending batch)
+void motor_play_setpoints(const motor_setpoint_t *setpoints, uint8_t count, uint16_t interval_ms);
+void motor_cancel_setpoints(void);
+
+// Decelerate both motors to a stop
 void motor_stop(void);
 
+// Stop both motors immediately
+void motor_stop_now(void);
+
 // Ramp control
 void motor_start_ramp(void);
-void motor_update_ramp(void);
 bool motor_is_ramping(void);
 bool motor_is_latched(void);
 void motor_cancel_ramp(void);
 
-// Inactivity timeout
+// Ramp profiles (safe from any task, used from the next ramp on)
+esp_err_t motor_set_ramp_config(const motor_ramp_config_t *config);
+void motor_get_ramp_config(motor_ramp_config_t *config);
+void motor_set_ramp_mode(motor_ramp_mode_t mode);
+motor_ramp_mode_t motor_get_ramp_mode(void);
+
+// Closed-loop mode (needs wheel_encoder_init); config may be NULL to keep the
+// current one. Validated here, applied by the control loop on its next tick
+esp_err_t motor_set_closed_loop(bool enable, const motor_closed_loop_config_t *config);
+bool motor_is_closed_loop(void);
+
+// Lock-free hand-off between tasks. Post from a single producer (the
+// control dispatcher); apply, tick and publish run on the control loop
+void motor_post_intent(const motor_intent_t *intent);
+void motor_apply_intent(void);
+void motor_publish_status(void);
+
+// Control loop step after motor_apply_intent(): ramp, setpoint playback,
+// watchdog and closed loop (see motor_core.h)
+void motor_tick(void);
+
+// Latest status snapshot, or the one before if the control loop is
+// mid-update - safe from any task and never waits on the writer
+void motor_get_status(motor_status_t *status);
+
+// Command-stream watchdog: reset on every drive intent, checked every tick
 void motor_reset_inactivity(void);
-void motor_check_inactivity(void);
+
+// Watchdog timing (safe from any task, applied on the next tick) and
+// counters since boot / the last reset
+esp_err_t motor_set_watchdog_config(const motor_watchdog_config_t *config);
+void motor_get_watchdog_config(motor_watchdog_config_t *config);
+void motor_get_watchdog_stats(motor_watchdog_stats_t *stats);
+void motor_reset_watchdog_stats(void);
 
 #endif // MOTOR_H
@@ -0,0 +1,531 @@
+/**
+ * Motor Control Core
+ */
+
+#include "motor_core.h"
+#include <string.h>
+
+#define MEASURE_FILTER_SHIFT    3       // IIR smoothing of per-tick encoder counts
+
+static inline int64_t core_now(motor_core_t *core)
+{
+    return core->hal->now_us(core->hal->ctx);
+}
+
+static inline void core_event(motor_core_t *core, motor_core_event_t event,
+                              uint32_t arg0, uint32_t arg1)
+{
+    if (core->hal->event) {
+        core->hal->event(core->hal->ctx, event, arg0, arg1);
+    }
+}
+
+static inline void core_drive(motor_core_t *core, int16_t left, int16_t right)
+{
+    core->hal->drive(core->hal->ctx, left, right);
+}
+
+void motor_core_init(motor_core_t *core, const motor_hal_t *hal)
+{
+    memset(core, 0, sizeof(*core));
+    core->hal = hal;
+    core->ramp_config = (motor_ramp_config_t)MOTOR_CORE_DEFAULT_RAMP_CONFIG();
+    core->watchdog_config = (motor_watchdog_config_t)MOTOR_WATCHDOG_DEFAULT_CONFIG();
+    core->closed_loop_config = (motor_closed_loop_config_t)MOTOR_CLOSED_LOOP_DEFAULT_CONFIG();
+}
+
+void motor_core_set_ramp_config(motor_core_t *core, const motor_ramp_config_t *config)
+{
+    core->ramp_config = *config;
+}
+
+void motor_core_set_watchdog_config(motor_core_t *core, const motor_watchdog_config_t *config)
+{
+    core->watchdog_config = *config;
+}
+
+// Stop a running hardware fade and record where it got to
+static void fade_abort(motor_core_t *core)
+{
+    if (!core->fading) {
+        return;
+    }
+    core->fading = false;
+    if (core->hal->fade_abort) {
+        core->hal->fade_abort(core->hal->ctx, &core->current);
+    }
+}
+
+void motor_core_set_speed(motor_core_t *core, int16_t left, int16_t right)
+{
+    fade_abort(core);
+
+    core->current.left = left;
+    core->current.right = right;
+
+    // In closed loop the speed is a target for the controller; a stop
+    // still cuts the output right away
+    if (!core->closed_loop || (left == 0 && right == 0)) {
+        core_drive(core, left, right);
+    }
+}
+
+static void ramp_begin(motor_core_t *core, motor_setpoint_t to, ramp_profile_id_t profile,
+                       uint16_t duration_ms, bool latch_on_done)
+{
+    motor_ramp_t *ramp = &core->ramp;
+
+    fade_abort(core);
+
+    if (duration_ms == 0) {
+        ramp->active = false;
+        motor_core_set_speed(core, to.left, to.right);
+        core->forward_latched = latch_on_done;
+        return;
+    }
+
+    // The only division happens here, once per ramp
+    ramp->duration_us = (uint32_t)duration_ms * 1000;
+    ramp->phase_scale = (uint32_t)(((uint64_t)RAMP_Q16_ONE << 16) / ramp->duration_us);
+    ramp->lut = ramp_profile_get_lut(profile);
+    ramp->from = core->current;
+    ramp->to = to;
+    ramp->latch_on_done = latch_on_done;
+    ramp->start_us = core_now(core);
+    ramp->active = true;
+
+    // Closed loop owns the output every tick, so ramps stay in software
+    ramp->hw_fade = !core->closed_loop && core->hal->fade_begin &&
+                    core->hal->fade_begin(core->hal->ctx, ramp);
+    core->fading = ramp->hw_fade;
+}
+
+void motor_core_cancel_setpoints(motor_core_t *core)
+{
+    core->playback_count = 0;
+    core->playback_index = 0;
+}
+
+void motor_core_ramp_to(motor_core_t *core, int16_t left, int16_t right)
+{
+    motor_core_cancel_setpoints(core);
+    core->forward_latched = false;
+    motor_setpoint_t to = { .left = left, .right = right };
+    ramp_begin(core, to, core->ramp_config.decel_profile, core->ramp_config.decel_ms, false);
+}
+
+void motor_core_play_setpoints(motor_core_t *core, const motor_setpoint_t *setpoints,
+                               uint8_t count, uint16_t interval_ms)
+{
+    if (count > MOTOR_MAX_SETPOINTS) {
+        count = MOTOR_MAX_SETPOINTS;
+    }
+    if (count == 0) {
+        core->playback_count = 0;
+        return;
+    }
+
+    memcpy(core->playback, setpoints, count * sizeof(motor_setpoint_t));
+    core->playback_count = count;
+    core->playback_index = 1;
+    core->playback_interval_ms = interval_ms;
+    core->playback_next_us = core_now(core) + (int64_t)interval_ms * 1000;
+
+    // First setpoint applies immediately
+    motor_core_set_speed(core, core->playback[0].left, core->playback[0].right);
+}
+
+void motor_core_update_setpoints(motor_core_t *core)
+{
+    if (core->playback_index >= core->playback_count) {
+        return;
+    }
+
+    if (core_now(core) >= core->playback_next_us) {
+        // A batch keeps the motors alive until its last setpoint
+        const motor_setpoint_t *next = &core->playback[core->playback_index];
+        motor_core_reset_inactivity(core);
+        motor_core_set_speed(core, next->left, next->right);
+        core->playback_index++;
+        core->playback_next_us += (int64_t)core->playback_interval_ms * 1000;
+    }
+}
+
+void motor_core_stop(motor_core_t *core)
+{
+    motor_core_ramp_to(core, 0, 0);
+}
+
+void motor_core_stop_now(motor_core_t *core)
+{
+    fade_abort(core);
+    core->ramp.active = false;
+    core->forward_latched = false;
+    motor_core_cancel_setpoints(core);
+    motor_core_set_speed(core, 0, 0);
+}
+
+void motor_core_start_ramp(motor_core_t *core)
+{
+    if ((core->ramp.active && core->ramp.latch_on_done) || core->forward_latched) {
+        return;
+    }
+
+    int16_t start = MOTOR_SPEED_FROM_DUTY8(MOTOR_CORE_RAMP_START_DUTY8);
+    motor_setpoint_t to = {
+        .left = MOTOR_SPEED_FROM_DUTY8(MOTOR_CORE_RAMP_END_DUTY8),
+        .right = MOTOR_SPEED_FROM_DUTY8(MOTOR_CORE_RAMP_END_DUTY8),
+    };
+    motor_core_cancel_setpoints(core);
+    motor_core_set_speed(core, start, start);
+    ramp_begin(core, to, core->ramp_config.accel_profile, core->ramp_config.accel_ms, true);
+    core_event(core, MOTOR_CORE_EV_RAMP_START, (uint32_t)to.left, 0);
+}
+
+static void ramp_finish(motor_core_t *core, bool hw_fade)
+{
+    core->ramp.active = false;
+    if (core->ramp.latch_on_done) {
+        core->forward_latched = true;
+        core_event(core, MOTOR_CORE_EV_RAMP_DONE, hw_fade ? 1 : 0, 0);
+    }
+}
+
+void motor_core_update_ramp(motor_core_t *core)
+{
+    motor_ramp_t *ramp = &core->ramp;
+
+    if (!ramp->active) {
+        return;
+    }
+
+    if (ramp->hw_fade) {
+        // The hardware owns the output - the HAL chains its segments
+        if (!core->hal->fade_update(core->hal->ctx, ramp)) {
+            return;
+        }
+        core->fading = false;
+        // Finish through drive() like any other setpoint: a wheel faded to
+        // zero still has its direction pin set and, reversing, full duty
+        // on the other side of the bridge - that brakes instead of coasting
+        motor_core_set_speed(core, ramp->to.left, ramp->to.right);
+        ramp_finish(core, true);
+        return;
+    }
+
+    uint32_t elapsed = (uint32_t)(core_now(core) - ramp->start_us);
+    if (elapsed >= ramp->duration_us) {
+        motor_core_set_speed(core, ramp->to.left, ramp->to.right);
+        ramp_finish(core, false);
+        return;
+    }
+
+    // Table lookup + interpolation: no division on the hot path
+    uint16_t phase = (uint16_t)(((uint64_t)elapsed * ramp->phase_scale) >> 16);
+    uint16_t fraction = ramp_profile_eval(ramp->lut, phase);
+    motor_core_set_speed(core, motor_core_interp(ramp->from.left, ramp->to.left, fraction),
+                         motor_core_interp(ramp->from.right, ramp->to.right, fraction));
+}
+
+void motor_core_cancel_ramp(motor_core_t *core)
+{
+    // Any new drive command supersedes both ramps and queued setpoints
+    fade_abort(core);
+    core->ramp.active = false;
+    core->forward_latched = false;
+    motor_core_cancel_setpoints(core);
+}
+
+void motor_core_set_closed_loop(motor_core_t *core, bool enable,
+                                const motor_closed_loop_config_t *config, uint32_t rate_hz)
+{
+    if (config) {
+        core->closed_loop_config = *config;
+    }
+    const motor_closed_loop_config_t *cfg = &core->closed_loop_config;
+
+    motor_core_cancel_ramp(core);
+    motor_core_set_speed(core, 0, 0);
+
+    wheel_pid_init(&core->pid_left, cfg->kp, cfg->ki, cfg->kd, cfg->correction_limit);
+    wheel_pid_init(&core->pid_right, cfg->kp, cfg->ki, cfg->kd, cfg->correction_limit);
+    core->counts_to_speed = (int32_t)(((uint64_t)MOTOR_SPEED_MAX * rate_hz << 8) /
+                                      cfg->max_counts_per_sec);
+    core->measured.left = 0;
+    core->measured.right = 0;
+    core->counts_seen_left_us = core_now(core);
+    core->counts_seen_right_us = core_now(core);
+
+    // Drop counts accumulated while open loop
+    if (core->hal->read_encoders) {
+        int32_t dl, dr;
+        core->hal->read_encoders(core->hal->ctx, &dl, &dr);
+    }
+
+    core->closed_loop = enable && core->hal->read_encoders;
+}
+
+static int16_t closed_loop_wheel(const motor_core_t *core, wheel_pid_t *pid, int16_t target,
+                                 int16_t *measured_speed, int32_t delta)
+{
+    int32_t speed = (delta * core->counts_to_speed) >> 8;
+    *measured_speed = (int16_t)(*measured_speed + ((speed - *measured_speed) >> MEASURE_FILTER_SHIFT));
+
+    if (target == 0) {
+        // Don't hold the wheel against the gearbox at standstill
+        wheel_pid_reset(pid);
+        return 0;
+    }
+
+    // Feedforward the target, PID trims the difference
+    int32_t out = target + wheel_pid_update(pid, (int32_t)target - *measured_speed);
+    if (out > MOTOR_SPEED_MAX) {
+        out = MOTOR_SPEED_MAX;
+    } else if (out < -MOTOR_SPEED_MAX) {
+        out = -MOTOR_SPEED_MAX;
+    }
+    return (int16_t)out;
+}
+
+// True once a wheel has been driven for MOTOR_CORE_ENCODER_TIMEOUT_MS
+// without a single count. *seen_us is the last time that was still fine
+static bool encoder_silent(int64_t now, int64_t *seen_us, int16_t target, int32_t delta)
+{
+    if (target == 0 || delta != 0) {
+        *seen_us = now;
+        return false;
+    }
+    return now - *seen_us >= (int64_t)MOTOR_CORE_ENCODER_TIMEOUT_MS * 1000;
+}
+
+void motor_core_update_closed_loop(motor_core_t *core)
+{
+    if (!core->closed_loop) {
+        return;
+    }
+
+    int32_t dl, dr;
+    int64_t now = core_now(core);
+    core->hal->read_encoders(core->hal->ctx, &dl, &dr);
+
+    // Without feedback the PID would wind the output up to full; drop to
+    // open loop on the commanded speed instead
+    bool silent_left = encoder_silent(now, &core->counts_seen_left_us, core->current.left, dl);
+    bool silent_right = encoder_silent(now, &core->counts_seen_right_us, core->current.right, dr);
+    if (silent_left || silent_right) {
+        int64_t seen_us = silent_left ? core->counts_seen_left_us : core->counts_seen_right_us;
+        core->closed_loop = false;
+        core->measured = (motor_setpoint_t){ 0, 0 };
+        core_event(core, MOTOR_CORE_EV_NO_ENCODER, silent_left ? 0 : 1,
+                   (uint32_t)((now - seen_us) / 1000));
+        core_drive(core, core->current.left, core->current.right);
+        return;
+    }
+    int16_t left = closed_loop_wheel(core, &core->pid_left, core->current.left,
+                                     &core->measured.left, dl);
+    int16_t right = closed_loop_wheel(core, &core->pid_right, core->current.right,
+                                      &core->measured.right, dr);
+    core_drive(core, left, right);
+}
+
+static void execute_intent(motor_core_t *core, const motor_intent_t *intent);
+static void schedule_intent(motor_core_t *core, const motor_intent_t *intent);
+
+bool motor_core_apply_intent(motor_core_t *core, const motor_intent_t *intent)
+{
+    // Serial number arithmetic: anything not newer than the last applied
+    // frame is late or reordered. Once stopped, any number starts a new
+    // stream (app restarted its counter)
+    if (intent->flags & MOTOR_INTENT_FLAG_SEQ) {
+        int16_t delta = (int16_t)(intent->seq - core->last_seq);
+        if (core->seq_valid && core->watchdog_armed) {
+            if (delta <= 0) {
+                atomic_fetch_add(&core->wd_stale, 1);
+                core_event(core, MOTOR_CORE_EV_STALE, intent->seq, core->last_seq);
+                return false;
+            }
+            if (delta > 1) {
+                atomic_fetch_add(&core->wd_gaps, (uint32_t)(delta - 1));
+            }
+        }
+        core->last_seq = intent->seq;
+        core->seq_valid = true;
+    }
+
+    // A stop overrides everything still waiting to run
+    if (intent->type == MOTOR_INTENT_STOP) {
+        core->scheduled_count = 0;
+    }
+    if (intent->apply_at_us > core_now(core)) {
+        schedule_intent(core, intent);
+        return true;
+    }
+    execute_intent(core, intent);
+    return true;
+}
+
+static void schedule_intent(motor_core_t *core, const motor_intent_t *intent)
+{
+    // Full only if the lead is far longer than the app sends with: run the
+    // one due first early rather than drop a frame
+    if (core->scheduled_count == MOTOR_CORE_SCHEDULE_DEPTH) {
+        motor_intent_t due = core->scheduled[0];
+        core->scheduled_count--;
+        memmove(&core->scheduled[0], &core->scheduled[1],
+                core->scheduled_count * sizeof(core->scheduled[0]));
+        execute_intent(core, &due);
+    }
+
+    // Ordered by apply time, equal times in arrival order
+    uint8_t i = core->scheduled_count;
+    while (i > 0 && core->scheduled[i - 1].apply_at_us > intent->apply_at_us) {
+        core->scheduled[i] = core->scheduled[i - 1];
+        i--;
+    }
+    core->scheduled[i] = *intent;
+    core->scheduled_count++;
+}
+
+void motor_core_update_scheduled(motor_core_t *core)
+{
+    int64_t now = core_now(core);
+    uint8_t due = 0;
+
+    // Several can fall due in one tick at low loop rates; each runs in turn
+    while (due < core->scheduled_count && core->scheduled[due].apply_at_us <= now) {
+        execute_intent(core, &core->scheduled[due]);
+        due++;
+    }
+    if (due > 0) {
+        core->scheduled_count -= due;
+        memmove(&core->scheduled[0], &core->scheduled[due],
+                core->scheduled_count * sizeof(core->scheduled[0]));
+    }
+}
+
+static void execute_intent(motor_core_t *core, const motor_intent_t *intent)
+{
+    motor_setpoint_t target = intent->setpoints[0];
+    switch (intent->type) {
+        case MOTOR_INTENT_STOP:
+            // An explicit stop ends the stream, the watchdog has nothing to guard
+            core->watchdog_armed = false;
+            motor_core_cancel_ramp(core);
+            motor_core_stop(core);
+            break;
+
+        case MOTOR_INTENT_FORWARD:
+            motor_core_reset_inactivity(core);
+            motor_core_start_ramp(core);
+            break;
+
+        case MOTOR_INTENT_RAMP_TO:
+            motor_core_cancel_ramp(core);
+            motor_core_reset_inactivity(core);
+            motor_core_ramp_to(core, target.left, target.right);
+            break;
+
+        case MOTOR_INTENT_SET_SPEED:
+            motor_core_cancel_ramp(core);
+            motor_core_reset_inactivity(core);
+            motor_core_set_speed(core, target.left, target.right);
+            break;
+
+        case MOTOR_INTENT_SETPOINTS:
+            motor_core_cancel_ramp(core);
+            motor_core_reset_inactivity(core);
+            motor_core_play_setpoints(core, intent->setpoints, intent->count, intent->interval_ms);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void motor_core_reset_inactivity(motor_core_t *core)
+{
+    int64_t now = core_now(core);
+
+    if (core->watchdog_armed && !core->watchdog_decel) {
+        uint32_t gap_ms = (uint32_t)((now - core->watchdog_feed_us) / 1000);
+        if (gap_ms > atomic_load_explicit(&core->wd_max_gap_ms, memory_order_relaxed)) {
+            atomic_store_explicit(&core->wd_max_gap_ms, gap_ms, memory_order_relaxed);
+        }
+    }
+    core->watchdog_feed_us = now;
+    core->watchdog_armed = true;
+    core->watchdog_decel = false;
+}
+
+void motor_core_check_inactivity(motor_core_t *core)
+{
+    if (!core->watchdog_armed) {
+        return;
+    }
+
+    // Wall-clock time, so the timeout doesn't depend on the loop rate or
+    // on ticks lost to overruns
+    uint32_t elapsed_ms = (uint32_t)((core_now(core) - core->watchdog_feed_us) / 1000);
+
+    if (!core->watchdog_decel) {
+        if (elapsed_ms < core->watchdog_config.hold_ms) {
+            return;     // Hold the last setpoint through the gap
+        }
+        core->watchdog_decel = true;
+        atomic_fetch_add(&core->wd_timeouts, 1);
+        core_event(core, MOTOR_CORE_EV_WATCHDOG, elapsed_ms, core->watchdog_config.decel_ms);
+
+        motor_core_cancel_ramp(core);
+        motor_setpoint_t stop = { .left = 0, .right = 0 };
+        ramp_begin(core, stop, core->ramp_config.decel_profile, core->watchdog_config.decel_ms, false);
+        return;
+    }
+
+    if (!core->ramp.active) {
+        core->watchdog_armed = false;
+        core->watchdog_decel = false;
+        motor_core_stop_now(core);
+        core_event(core, MOTOR_CORE_EV_INACTIVITY, elapsed_ms, 0);
+    }
+}
+
+void motor_core_tick(motor_core_t *core)
+{
+    motor_core_update_scheduled(core);
+    motor_core_update_ramp(core);
+    motor_core_update_setpoints(core);
+    motor_core_check_inactivity(core);
+    motor_core_update_closed_loop(core);
+}
+
+void motor_core_get_status(motor_core_t *core, motor_status_t *status)
+{
+    *status = (motor_status_t){
+        .speed = core->current,
+        .measured = core->measured,
+        .ramping = core->ramp.active,
+        .latched = core->forward_latched,
+        .closed_loop = core->closed_loop,
+    };
+    if (core->watchdog_armed && !core->watchdog_decel) {
+        int64_t left_us = (int64_t)core->watchdog_config.hold_ms * 1000 -
+                          (core_now(core) - core->watchdog_feed_us);
+        status->inactivity_ms = left_us > 0 ? (uint16_t)(left_us / 1000) : 0;
+    }
+}
+
+void motor_core_get_watchdog_stats(motor_core_t *core, motor_watchdog_stats_t *stats)
+{
+    stats->timeouts = atomic_load(&core->wd_timeouts);
+    stats->stale = atomic_load(&core->wd_stale);
+    stats->gaps = atomic_load(&core->wd_gaps);
+    stats->max_gap_ms = atomic_load(&core->wd_max_gap_ms);
+}
+
+void motor_core_reset_watchdog_stats(motor_core_t *core)
+{
+    atomic_store(&core->wd_timeouts, 0);
+    atomic_store(&core->wd_stale, 0);
+    atomic_store(&core->wd_gaps, 0);
+    atomic_store(&core->wd_max_gap_ms, 0);
+}
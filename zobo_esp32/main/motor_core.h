@@ -0,0 +1,187 @@
+/**
+ * Motor Control Core - Header
+ *
+ * Ramp, forward latch, setpoint playback, closed loop and the
+ * command-stream watchdog, free of ESP-IDF and FreeRTOS. Time, the
+ * H-bridge and the encoders come in through motor_hal_t, so the same
+ * code runs in the control loop (motor.c) and natively on a PC against
+ * a simulated clock (host_test/).
+ *
+ * Not thread safe: one task (the control loop) owns a core. Only the
+ * watchdog counters may be read from elsewhere.
+ */
+
+#ifndef MOTOR_CORE_H
+#define MOTOR_CORE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "motor.h"
+#include "wheel_pid.h"
+
+// Forward ramp: starts at 150/255 duty and accelerates to full speed
+#define MOTOR_CORE_RAMP_START_DUTY8     150
+#define MOTOR_CORE_RAMP_END_DUTY8       255
+
+#define MOTOR_CORE_DEFAULT_RAMP_CONFIG() {      \
+    .accel_profile = RAMP_PROFILE_LINEAR,       \
+    .accel_ms = 2000,                           \
+    .decel_profile = RAMP_PROFILE_S_CURVE,      \
+    .decel_ms = 250,                            \
+}
+
+// Closed loop falls back to open loop when a driven wheel's encoder stays
+// silent this long (not fitted, unplugged, or the wheel is blocked)
+#define MOTOR_CORE_ENCODER_TIMEOUT_MS   300
+
+// Fleet frames waiting for their apply time. The app resends every 100 ms
+// with a lead of up to 500 ms, so a handful can be in flight at once
+#define MOTOR_CORE_SCHEDULE_DEPTH       8
+
+// Reported through motor_hal_t.event (evlog on the target)
+typedef enum {
+    MOTOR_CORE_EV_RAMP_START,   // arg0 = target speed
+    MOTOR_CORE_EV_RAMP_DONE,    // arg0 = 1 if the hardware ran the ramp
+    MOTOR_CORE_EV_WATCHDOG,     // arg0 = ms since the last intent, arg1 = decel ms
+    MOTOR_CORE_EV_INACTIVITY,   // arg0 = ms since the last intent
+    MOTOR_CORE_EV_STALE,        // arg0 = dropped seq, arg1 = last applied seq
+    MOTOR_CORE_EV_NO_ENCODER,   // arg0 = wheel (0 left, 1 right), arg1 = ms driven without counts
+} motor_core_event_t;
+
+// One ramp between two setpoints, shaped by a profile lookup table
+typedef struct {
+    bool active;
+    bool latch_on_done;         // Forward ramp latches at full speed
+    bool hw_fade;               // Ramp is executed by the HAL's fade hardware
+    const uint16_t *lut;
+    int64_t start_us;
+    uint32_t duration_us;
+    uint32_t phase_scale;       // Q16 phase per microsecond, scaled by 2^16
+    motor_setpoint_t from;
+    motor_setpoint_t to;
+} motor_ramp_t;
+
+// Interpolate from -> to by a Q16 fraction (Q15 keeps the product in 32 bits)
+static inline int16_t motor_core_interp(int16_t from, int16_t to, uint16_t fraction)
+{
+    return (int16_t)(from + (((int32_t)(to - from) * (fraction >> 1)) >> 15));
+}
+
+// Hardware and time. now_us and drive are required, the rest may be NULL
+typedef struct {
+    void *ctx;
+
+    // Monotonic microseconds
+    int64_t (*now_us)(void *ctx);
+
+    // Put signed speeds (-MOTOR_SPEED_MAX..MOTOR_SPEED_MAX) on the H-bridge
+    void (*drive)(void *ctx, int16_t left, int16_t right);
+
+    // Encoder counts since the previous call (closed loop)
+    void (*read_encoders)(void *ctx, int32_t *left, int32_t *right);
+
+    // Run a ramp without per-tick duty updates. fade_begin returns false
+    // to leave the ramp to software; fade_update returns true once the
+    // target is reached; fade_abort stops it and reports where it got to
+    bool (*fade_begin)(void *ctx, const motor_ramp_t *ramp);
+    bool (*fade_update)(void *ctx, const motor_ramp_t *ramp);
+    void (*fade_abort)(void *ctx, motor_setpoint_t *reached);
+
+    void (*event)(void *ctx, motor_core_event_t event, uint32_t arg0, uint32_t arg1);
+} motor_hal_t;
+
+typedef struct {
+    const motor_hal_t *hal;
+
+    motor_ramp_t ramp;
+    bool fading;
+    bool forward_latched;
+    motor_setpoint_t current;
+    motor_ramp_config_t ramp_config;
+
+    // Intents waiting for their apply time (fleet group frames), by time
+    motor_intent_t scheduled[MOTOR_CORE_SCHEDULE_DEPTH];
+    uint8_t scheduled_count;
+
+    // Setpoint playback
+    motor_setpoint_t playback[MOTOR_MAX_SETPOINTS];
+    uint8_t playback_count;
+    uint8_t playback_index;
+    uint16_t playback_interval_ms;
+    int64_t playback_next_us;
+
+    // Command-stream watchdog
+    motor_watchdog_config_t watchdog_config;
+    bool watchdog_armed;
+    bool watchdog_decel;
+    int64_t watchdog_feed_us;
+    bool seq_valid;
+    uint16_t last_seq;
+    _Atomic uint32_t wd_timeouts;
+    _Atomic uint32_t wd_stale;
+    _Atomic uint32_t wd_gaps;
+    _Atomic uint32_t wd_max_gap_ms;
+
+    // Closed-loop speed control
+    bool closed_loop;
+    motor_closed_loop_config_t closed_loop_config;
+    wheel_pid_t pid_left;
+    wheel_pid_t pid_right;
+    int32_t counts_to_speed;    // Q8: counts per tick -> Q15 speed
+    motor_setpoint_t measured;
+    int64_t counts_seen_left_us;    // Last tick the wheel counted or wasn't driven
+    int64_t counts_seen_right_us;
+} motor_core_t;
+
+// Reset to stopped, open loop, default ramp and watchdog config
+void motor_core_init(motor_core_t *core, const motor_hal_t *hal);
+
+// Config, applied from the next ramp / hold on
+void motor_core_set_ramp_config(motor_core_t *core, const motor_ramp_config_t *config);
+void motor_core_set_watchdog_config(motor_core_t *core, const motor_watchdog_config_t *config);
+
+// Switch closed loop (config may be NULL to keep the current one). Stops
+// the motors; rate_hz is the tick rate the PID runs at. Turns itself off
+// again if an encoder gives no counts while its wheel is driven
+void motor_core_set_closed_loop(motor_core_t *core, bool enable,
+                                const motor_closed_loop_config_t *config, uint32_t rate_hz);
+
+// Apply a drive intent. False if it was dropped for a stale sequence number.
+// An intent with apply_at_us in the future is queued and runs on the first
+// tick at or after that time; later ones don't replace it, so each frame of
+// a stream runs in turn however far ahead it was sent. Only a stop clears
+// the queue
+bool motor_core_apply_intent(motor_core_t *core, const motor_intent_t *intent);
+
+// Everything a control tick does after taking the latest intent: due
+// scheduled intents, ramp, playback, watchdog and closed loop, in that order
+void motor_core_tick(motor_core_t *core);
+
+// Individual steps of motor_core_tick()
+void motor_core_update_scheduled(motor_core_t *core);
+void motor_core_update_ramp(motor_core_t *core);
+void motor_core_update_setpoints(motor_core_t *core);
+void motor_core_check_inactivity(motor_core_t *core);
+void motor_core_update_closed_loop(motor_core_t *core);
+
+// Direct control
+void motor_core_set_speed(motor_core_t *core, int16_t left, int16_t right);
+void motor_core_ramp_to(motor_core_t *core, int16_t left, int16_t right);
+void motor_core_play_setpoints(motor_core_t *core, const motor_setpoint_t *setpoints,
+                               uint8_t count, uint16_t interval_ms);
+void motor_core_cancel_setpoints(motor_core_t *core);
+void motor_core_start_ramp(motor_core_t *core);
+void motor_core_cancel_ramp(motor_core_t *core);
+void motor_core_stop(motor_core_t *core);
+void motor_core_stop_now(motor_core_t *core);
+void motor_core_reset_inactivity(motor_core_t *core);
+
+// State for the status snapshot
+void motor_core_get_status(motor_core_t *core, motor_status_t *status);
+
+// Watchdog counters (safe from any task)
+void motor_core_get_watchdog_stats(motor_core_t *core, motor_watchdog_stats_t *stats);
+void motor_core_reset_watchdog_stats(motor_core_t *core);
+
+#endif // MOTOR_CORE_H
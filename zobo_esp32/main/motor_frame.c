@@ -0,0 +1,78 @@
+/**
+ * Binary Motor Frame
+ */
+
+#include "motor_frame.h"
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int16_t clamp_speed(int16_t v)
+{
+    // -32768 has no positive counterpart, keep the range symmetric
+    return (v < -MOTOR_SPEED_MAX) ? -MOTOR_SPEED_MAX : v;
+}
+
+esp_err_t motor_frame_parse(const uint8_t *data, uint16_t len, motor_frame_t *frame)
+{
+    if (len < MOTOR_FRAME_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    frame->version = data[1];
+    if (frame->version != MOTOR_FRAME_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    frame->flags = data[2];
+    frame->count = data[3];
+    frame->seq = read_u16(&data[4]);
+    frame->interval_ms = read_u16(&data[6]);
+
+    if (frame->count == 0 || frame->count > MOTOR_FRAME_MAX_SETPOINTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t offset = MOTOR_FRAME_HEADER_LEN;
+    if (frame->flags & MOTOR_FRAME_FLAG_TIMESTAMP) {
+        if (len < offset + MOTOR_FRAME_TIMESTAMP_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        frame->timestamp_ms = read_u32(&data[offset]);
+        offset += MOTOR_FRAME_TIMESTAMP_LEN;
+    } else {
+        frame->timestamp_ms = 0;
+    }
+
+    if (frame->flags & MOTOR_FRAME_FLAG_GROUP) {
+        if (len < offset + MOTOR_FRAME_GROUP_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        frame->group = data[offset];
+        frame->apply_at_ms = read_u32(&data[offset + 1]);
+        offset += MOTOR_FRAME_GROUP_LEN;
+    } else {
+        frame->group = 0;
+        frame->apply_at_ms = 0;
+    }
+
+    if (len < offset + (uint16_t)frame->count * MOTOR_FRAME_SETPOINT_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (uint8_t i = 0; i < frame->count; i++) {
+        const uint8_t *p = &data[offset + i * MOTOR_FRAME_SETPOINT_LEN];
+        frame->setpoints[i].left = clamp_speed((int16_t)read_u16(p));
+        frame->setpoints[i].right = clamp_speed((int16_t)read_u16(p + 2));
+    }
+
+    return ESP_OK;
+}
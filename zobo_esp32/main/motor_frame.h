@@ -0,0 +1,57 @@
+/**
+ * Binary Motor Frame - Header
+ *
+ * Compact versioned drive frame carrying one or more signed wheel
+ * setpoints. All multi-byte fields are little-endian.
+ *
+ *   [0]     CMD_MOTOR_FRAME opcode
+ *   [1]     version (MOTOR_FRAME_VERSION)
+ *   [2]     flags (MOTOR_FRAME_FLAG_*)
+ *   [3]     setpoint count (1..MOTOR_FRAME_MAX_SETPOINTS)
+ *   [4..5]  sequence number
+ *   [6..7]  interval between batched setpoints in ms (ignored if count == 1)
+ *   [8..11] sender timestamp in ms (only if MOTOR_FRAME_FLAG_TIMESTAMP)
+ *   group id (u8) and apply time in controller ms (u32), only if
+ *           MOTOR_FRAME_FLAG_GROUP - see fleet.h
+ *   then count x { int16 left, int16 right } in -32767..32767
+ */
+
+#ifndef MOTOR_FRAME_H
+#define MOTOR_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "motor.h"
+
+#define CMD_MOTOR_FRAME             0x80
+
+#define MOTOR_FRAME_VERSION         1
+#define MOTOR_FRAME_HEADER_LEN      8
+#define MOTOR_FRAME_TIMESTAMP_LEN   4
+#define MOTOR_FRAME_GROUP_LEN       5
+#define MOTOR_FRAME_SETPOINT_LEN    4
+#define MOTOR_FRAME_MAX_SETPOINTS   MOTOR_MAX_SETPOINTS
+
+// Frame flags
+#define MOTOR_FRAME_FLAG_TIMESTAMP  0x01
+#define MOTOR_FRAME_FLAG_GROUP      0x02    // Fleet group frame, applied at apply_at_ms
+
+// Parsed frame
+typedef struct {
+    uint8_t version;
+    uint8_t flags;
+    uint8_t count;
+    uint16_t seq;
+    uint16_t interval_ms;
+    uint32_t timestamp_ms;
+    uint8_t group;
+    uint32_t apply_at_ms;
+    motor_setpoint_t setpoints[MOTOR_FRAME_MAX_SETPOINTS];
+} motor_frame_t;
+
+// Parse a frame (including the opcode byte) into caller-provided storage
+// Returns ESP_ERR_INVALID_VERSION, ESP_ERR_INVALID_SIZE or ESP_ERR_INVALID_ARG on bad input
+esp_err_t motor_frame_parse(const uint8_t *data, uint16_t len, motor_frame_t *frame);
+
+#endif // MOTOR_FRAME_H
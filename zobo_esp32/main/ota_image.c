@@ -0,0 +1,364 @@
+/**
+ * OTA Image Decoder
+ */
+
+#include "ota_image.h"
+#include "ota_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "esp32/rom/miniz.h"   // tinfl lives in ROM, streaming inflate for free
+
+static const char *TAG = "OTA_IMG";
+
+// Base image reads for delta COPY ops
+#define DELTA_COPY_BUF_SIZE     1024
+
+typedef enum {
+    STAGE_DETECT,       // Waiting for enough bytes to tell plain from ZOTA
+    STAGE_PLAIN,        // Raw app image, pass through
+    STAGE_PAYLOAD,      // ZOTA payload
+    STAGE_DONE,         // Payload ended, anything more is an error
+} decode_stage_t;
+
+typedef enum {
+    DELTA_OP,
+    DELTA_ARGS,
+    DELTA_LITERAL,
+    DELTA_END,
+} delta_state_t;
+
+static decode_stage_t s_stage;
+static ota_image_header_t s_header;
+static size_t s_header_len;
+static uint32_t s_output_len;
+
+// Inflate state
+static tinfl_decompressor *s_inflator = NULL;
+static uint8_t *s_dict = NULL;
+static size_t s_dict_size;
+static size_t s_dict_ofs;
+
+// Delta state
+static const esp_partition_t *s_base = NULL;
+static uint8_t *s_copy_buf = NULL;
+static delta_state_t s_delta_state;
+static uint8_t s_delta_op;
+static uint8_t s_args[8];
+static size_t s_args_len;
+static size_t s_args_need;
+static uint32_t s_literal_left;
+
+static uint8_t s_running_sha[32];
+static bool s_running_sha_valid = false;
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t emit(const uint8_t *data, size_t len)
+{
+    s_output_len += len;
+    if (s_stage == STAGE_PAYLOAD && s_output_len > s_header.image_size) {
+        ESP_LOGE(TAG, "Output exceeds declared image size %" PRIu32, s_header.image_size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ota_writer_write(data, len);
+}
+
+static esp_err_t delta_copy(uint32_t offset, uint32_t len)
+{
+    if (offset > s_base->size || len > s_base->size - offset) {
+        ESP_LOGE(TAG, "COPY 0x%" PRIx32 "+%" PRIu32 " outside base image", offset, len);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    while (len > 0) {
+        size_t n = len < DELTA_COPY_BUF_SIZE ? len : DELTA_COPY_BUF_SIZE;
+        esp_err_t err = esp_partition_read(s_base, offset, s_copy_buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        err = emit(s_copy_buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        offset += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// Patch interpreter, fed with the (inflated) payload
+static esp_err_t delta_feed(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        switch (s_delta_state) {
+            case DELTA_OP:
+                s_delta_op = *data++;
+                len--;
+                s_args_len = 0;
+                if (s_delta_op == OTA_DELTA_OP_END) {
+                    s_delta_state = DELTA_END;
+                } else if (s_delta_op == OTA_DELTA_OP_COPY) {
+                    s_args_need = 8;
+                    s_delta_state = DELTA_ARGS;
+                } else if (s_delta_op == OTA_DELTA_OP_ADD) {
+                    s_args_need = 4;
+                    s_delta_state = DELTA_ARGS;
+                } else {
+                    ESP_LOGE(TAG, "Bad delta op 0x%02x", s_delta_op);
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                break;
+
+            case DELTA_ARGS: {
+                size_t n = s_args_need - s_args_len;
+                if (n > len) {
+                    n = len;
+                }
+                memcpy(s_args + s_args_len, data, n);
+                s_args_len += n;
+                data += n;
+                len -= n;
+                if (s_args_len < s_args_need) {
+                    break;
+                }
+                s_delta_state = DELTA_OP;
+                if (s_delta_op == OTA_DELTA_OP_COPY) {
+                    esp_err_t err = delta_copy(read_u32(s_args), read_u32(s_args + 4));
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                } else {
+                    s_literal_left = read_u32(s_args);
+                    if (s_literal_left > 0) {
+                        s_delta_state = DELTA_LITERAL;
+                    }
+                }
+                break;
+            }
+
+            case DELTA_LITERAL: {
+                size_t n = s_literal_left < len ? s_literal_left : len;
+                esp_err_t err = emit(data, n);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                s_literal_left -= n;
+                data += n;
+                len -= n;
+                if (s_literal_left == 0) {
+                    s_delta_state = DELTA_OP;
+                }
+                break;
+            }
+
+            case DELTA_END:
+                ESP_LOGE(TAG, "Data after delta end");
+                return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    return ESP_OK;
+}
+
+// Payload after inflate: the image itself or a patch
+static esp_err_t payload_feed(const uint8_t *data, size_t len)
+{
+    if (s_header.flags & OTA_IMAGE_FLAG_DELTA) {
+        return delta_feed(data, len);
+    }
+    return emit(data, len);
+}
+
+static esp_err_t inflate_feed(const uint8_t *data, size_t len)
+{
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+    do {
+        size_t in_bytes = len;
+        size_t out_bytes = s_dict_size - s_dict_ofs;
+        status = tinfl_decompress(s_inflator, data, &in_bytes, s_dict, s_dict + s_dict_ofs, &out_bytes,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        len -= in_bytes;
+
+        if (out_bytes > 0) {
+            esp_err_t err = payload_feed(s_dict + s_dict_ofs, out_bytes);
+            if (err != ESP_OK) {
+                return err;
+            }
+            s_dict_ofs = (s_dict_ofs + out_bytes) & (s_dict_size - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed (%d)", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            s_stage = STAGE_DONE;
+            if (len > 0) {
+                ESP_LOGE(TAG, "Data after compressed stream");
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            return ESP_OK;
+        }
+    } while (len > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+    return ESP_OK;
+}
+
+static esp_err_t header_parse(void)
+{
+    const ota_image_header_t *h = &s_header;
+
+    if (h->version != OTA_IMAGE_FORMAT_VERSION) {
+        ESP_LOGE(TAG, "Unsupported container version %d", h->version);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (h->flags & OTA_IMAGE_FLAG_DELTA) {
+        const uint8_t *running = ota_image_get_running_sha256();
+        if (!running || memcmp(running, h->base_sha256, sizeof(h->base_sha256)) != 0) {
+            ESP_LOGE(TAG, "Delta is for a different base image");
+            return ESP_ERR_INVALID_VERSION;
+        }
+        s_base = esp_ota_get_running_partition();
+        s_copy_buf = malloc(DELTA_COPY_BUF_SIZE);
+        if (!s_copy_buf) {
+            return ESP_ERR_NO_MEM;
+        }
+        s_delta_state = DELTA_OP;
+    }
+
+    if (h->flags & OTA_IMAGE_FLAG_DEFLATE) {
+        if (h->window_bits < 8 || h->window_bits > OTA_IMAGE_WINDOW_BITS_MAX) {
+            ESP_LOGE(TAG, "Unsupported window %d bits", h->window_bits);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        // The wrapping output buffer doubles as the LZ window
+        s_dict_size = (size_t)1 << h->window_bits;
+        s_dict_ofs = 0;
+        s_inflator = malloc(sizeof(tinfl_decompressor));
+        s_dict = malloc(s_dict_size);
+        if (!s_inflator || !s_dict) {
+            return ESP_ERR_NO_MEM;
+        }
+        tinfl_init(s_inflator);
+    }
+
+    ESP_LOGI(TAG, "ZOTA image: %" PRIu32 " bytes%s%s", h->image_size,
+             (h->flags & OTA_IMAGE_FLAG_DEFLATE) ? ", deflate" : "",
+             (h->flags & OTA_IMAGE_FLAG_DELTA) ? ", delta" : "");
+    s_stage = STAGE_PAYLOAD;
+    return ESP_OK;
+}
+
+esp_err_t ota_image_begin(size_t offset)
+{
+    ota_image_abort();
+    s_stage = offset > 0 ? STAGE_PLAIN : STAGE_DETECT;
+    s_header_len = 0;
+    s_output_len = offset;
+    return ESP_OK;
+}
+
+esp_err_t ota_image_feed(const uint8_t *data, size_t len)
+{
+    if (s_stage == STAGE_DETECT) {
+        // Collect the header; a plain image gives itself away on byte 0
+        size_t n = sizeof(s_header) - s_header_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy((uint8_t *)&s_header + s_header_len, data, n);
+        s_header_len += n;
+
+        if (memcmp(&s_header, OTA_IMAGE_MAGIC, s_header_len < 4 ? s_header_len : 4) != 0) {
+            s_stage = STAGE_PLAIN;
+            esp_err_t err = emit((const uint8_t *)&s_header, s_header_len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            return emit(data + n, len - n);
+        }
+        data += n;
+        len -= n;
+        if (s_header_len < sizeof(s_header)) {
+            return ESP_OK;
+        }
+        esp_err_t err = header_parse();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    switch (s_stage) {
+        case STAGE_PLAIN:
+            return emit(data, len);
+        case STAGE_PAYLOAD:
+            if (s_header.flags & OTA_IMAGE_FLAG_DEFLATE) {
+                return inflate_feed(data, len);
+            }
+            return payload_feed(data, len);
+        default:
+            ESP_LOGE(TAG, "Data after end of image");
+            return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+esp_err_t ota_image_end(void)
+{
+    esp_err_t err = ESP_OK;
+
+    if (s_stage == STAGE_DETECT) {
+        // Shorter than a header - can only be a (truncated) plain image
+        err = s_header_len > 0 ? emit((const uint8_t *)&s_header, s_header_len) : ESP_ERR_INVALID_SIZE;
+    } else if (s_stage != STAGE_PLAIN) {
+        bool inflating = s_header.flags & OTA_IMAGE_FLAG_DEFLATE;
+        bool delta = s_header.flags & OTA_IMAGE_FLAG_DELTA;
+        if ((inflating && s_stage != STAGE_DONE) || (delta && s_delta_state != DELTA_END)) {
+            ESP_LOGE(TAG, "Payload ended early");
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (s_output_len != s_header.image_size) {
+            ESP_LOGE(TAG, "Image is %" PRIu32 " bytes, expected %" PRIu32, s_output_len, s_header.image_size);
+            err = ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    ota_image_abort();
+    return err;
+}
+
+bool ota_image_is_passthrough(void)
+{
+    return s_stage == STAGE_PLAIN;
+}
+
+void ota_image_abort(void)
+{
+    free(s_inflator);
+    free(s_dict);
+    free(s_copy_buf);
+    s_inflator = NULL;
+    s_dict = NULL;
+    s_copy_buf = NULL;
+    s_base = NULL;
+}
+
+const uint8_t *ota_image_get_running_sha256(void)
+{
+    if (!s_running_sha_valid) {
+        // Hashes the whole image, so only done once
+        const esp_partition_t *running = esp_ota_get_running_partition();
+        s_running_sha_valid = running && esp_partition_get_sha256(running, s_running_sha) == ESP_OK;
+    }
+    return s_running_sha_valid ? s_running_sha : NULL;
+}
@@ -0,0 +1,61 @@
+/**
+ * OTA Image Decoder - Header
+ * Turns the downloaded stream into the app image written to flash.
+ * Accepts a plain app image (.bin) or a ZOTA container (.zota) holding a
+ * deflate-compressed image or a delta patch against the running image.
+ * See release.py for the producer side.
+ */
+
+#ifndef OTA_IMAGE_H
+#define OTA_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ZOTA container
+#define OTA_IMAGE_MAGIC             "ZOTA"
+#define OTA_IMAGE_FORMAT_VERSION    1
+#define OTA_IMAGE_FLAG_DEFLATE      0x01    // Payload is a zlib stream
+#define OTA_IMAGE_FLAG_DELTA        0x02    // Payload is a delta patch
+#define OTA_IMAGE_WINDOW_BITS_MAX   15      // 32 KB inflate window
+
+// Little endian, directly followed by the payload
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t flags;
+    uint8_t window_bits;            // Deflate window used by the encoder
+    uint8_t reserved;
+    uint32_t image_size;            // Size of the reconstructed image
+    uint8_t base_sha256[32];        // Image hash the delta applies to
+} ota_image_header_t;
+
+// Delta patch ops (after inflating), all lengths/offsets u32 LE
+#define OTA_DELTA_OP_END            0x00
+#define OTA_DELTA_OP_COPY           0x01    // + src_offset, len: copy from running image
+#define OTA_DELTA_OP_ADD            0x02    // + len, then len literal bytes
+
+// Start decoding a new stream. Output goes to ota_writer_write().
+// offset > 0 continues a plain image from that byte (resumed download)
+esp_err_t ota_image_begin(size_t offset);
+
+// Feed received bytes. ESP_ERR_INVALID_VERSION = delta for another base
+// image, ESP_ERR_INVALID_RESPONSE = corrupt payload
+esp_err_t ota_image_feed(const uint8_t *data, size_t len);
+
+// All input received - check the stream ended where it should
+esp_err_t ota_image_end(void);
+
+// True while input maps 1:1 onto the image (plain .bin), i.e. a download
+// can be resumed from a flash offset after a reboot
+bool ota_image_is_passthrough(void);
+
+// Release decoder memory (safe to call at any point)
+void ota_image_abort(void);
+
+// SHA-256 of the running app image, the base that deltas are built against
+const uint8_t *ota_image_get_running_sha256(void);
+
+#endif // OTA_IMAGE_H
@@ -3,28 +3,97 @@
  */
 
 #include "ota_manager.h"
+#include "ota_writer.h"
+#include "ota_image.h"
+#include "wifi_manager.h"
 #include "led.h"
+#include "coex_policy.h"
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
 #include "esp_crt_bundle.h"
 
 static const char *TAG = "OTA";
 
 // Embedded CA certificate for GitHub (DigiCert Global Root G2)
 
+// Pipeline limits
+#define OTA_HTTP_BUFFER_MIN         512
+#define OTA_HTTP_BUFFER_MAX         16384
+#define OTA_PROGRESS_INTERVAL_MIN   100
+#define OTA_PROGRESS_INTERVAL_MAX   10000
+#define OTA_MAX_REDIRECTS           10      // GitHub release assets redirect
+
+// The download task only exists during an update, so it stays on the
+// heap; TLS handshakes run on its stack
+#define OTA_TASK_STACK              8192
+#define OTA_TASK_PRIORITY           5
+#define OTA_REPORT_STACK            2560
+#define OTA_REPORT_PRIORITY         2
+
+// A TLS handshake needs an input record buffer in one piece (dynamic
+// mbedTLS buffers are sized per record); below this it fails half way
+#define OTA_TLS_MIN_FREE_BLOCK      (24 * 1024)
+
+// Dropped connections: retries in a row, and how long to wait for WiFi
+#define OTA_RESUME_RETRIES          5
+#define OTA_RESUME_DELAY_MS         1000    // Doubles with every failed attempt
+#define OTA_RESUME_DELAY_MAX_MS     16000
+#define OTA_RESUME_WIFI_WAIT_MS     60000
+
+// Stats of the last successful update, kept in NVS across the restart,
+// and where an interrupted download can be picked up again
+#define NVS_NAMESPACE               "ota"
+#define NVS_KEY_STATS               "stats"
+#define NVS_KEY_RESUME              "resume"
+
 static ota_status_callback_t s_callback = NULL;
 static bool s_ota_in_progress = false;
+static ota_pipeline_config_t s_pipeline = OTA_PIPELINE_DEFAULT_CONFIG();
+
+// Download progress, written by the OTA task and read by the reporter
+static atomic_uint s_bytes_received = 0;
+static atomic_uint s_image_size = 0;
+static atomic_bool s_report_run = false;
+static TaskHandle_t s_report_task = NULL;          // OTA task only
+static SemaphoreHandle_t s_report_done = NULL;     // Given as the reporter exits
+static StaticSemaphore_t s_report_done_buf;
 
-// OTA task parameters
+// Interrupted download, persisted at writer checkpoints
+typedef struct {
+    char url[256];
+    char etag[64];                  // Image identity as the server sees it
+    uint32_t total_size;
+    uint32_t offset;                // Sector aligned, verified by prefix_sha256
+    uint8_t prefix_sha256[32];      // Hash of the image bytes before offset
+} ota_resume_t;
+
+static ota_resume_t s_resume;
+
+// Response headers picked up by the HTTP event handler
+static struct {
+    char etag[64];
+    uint32_t range_total;           // From Content-Range, 0 if absent
+} s_response;
+
+// OTA task parameters - one update at a time, so a static copy
 typedef struct {
     char url[256];
 } ota_task_params_t;
 
+static ota_task_params_t s_task_params;
+
 static void notify_status(int progress, const char *status)
 {
     ESP_LOGI(TAG, "OTA: %s (%d%%)", status, progress);
@@ -33,9 +102,376 @@ static void notify_status(int progress, const char *status)
     }
 }
 
+static uint32_t bytes_per_sec(uint32_t bytes, int64_t us)
+{
+    return us > 0 ? (uint32_t)((uint64_t)bytes * 1000000ULL / (uint64_t)us) : 0;
+}
+
+// Sends progress at a fixed rate from its own low priority task, so a slow
+// BLE notification never holds up the download
+static void report_task(void *arg)
+{
+    int last_progress = -1;
+    uint32_t last_bytes = 0;
+    int64_t last_us = esp_timer_get_time();
+
+    while (atomic_load(&s_report_run)) {
+        // report_stop() wakes us early
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_pipeline.progress_interval_ms));
+        if (!atomic_load(&s_report_run)) {
+            break;
+        }
+
+        uint32_t bytes = atomic_load(&s_bytes_received);
+        uint32_t size = atomic_load(&s_image_size);
+        int64_t now = esp_timer_get_time();
+        int progress = size > 0 ? (int)((uint64_t)bytes * 100 / size) : 0;
+
+        if (progress != last_progress && progress < 100) {
+            char status[48];
+            snprintf(status, sizeof(status), "Downloading: %d%% (%" PRIu32 " KB/s)",
+                     progress, bytes_per_sec(bytes - last_bytes, now - last_us) / 1024);
+            notify_status(progress, status);
+            last_progress = progress;
+        }
+        last_bytes = bytes;
+        last_us = now;
+    }
+
+    xSemaphoreGive(s_report_done);
+    vTaskDelete(NULL);
+}
+
+static void report_start(void)
+{
+    if (!s_report_done) {
+        s_report_done = xSemaphoreCreateBinaryStatic(&s_report_done_buf);
+    }
+    atomic_store(&s_bytes_received, 0);
+    atomic_store(&s_image_size, 0);
+    atomic_store(&s_report_run, true);
+    if (xTaskCreate(report_task, "ota_report", OTA_REPORT_STACK, NULL,
+                    OTA_REPORT_PRIORITY, &s_report_task) != pdPASS) {
+        s_report_task = NULL;
+        atomic_store(&s_report_run, false);
+        ESP_LOGW(TAG, "No progress reporter - continuing without");
+    }
+}
+
+// Returns once the reporter is gone, so a retried update can't end up
+// with two of them
+static void report_stop(void)
+{
+    if (!s_report_task) {
+        return;
+    }
+    atomic_store(&s_report_run, false);
+    xTaskNotifyGive(s_report_task);
+    xSemaphoreTake(s_report_done, portMAX_DELAY);
+    s_report_task = NULL;
+}
+
+void ota_manager_save_stats(const ota_stats_t *stats)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs_handle, NVS_KEY_STATS, stats, sizeof(*stats)) == ESP_OK) {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+void ota_manager_complete(uint32_t transfer_bytes, int64_t start_us)
+{
+    ota_stats_t stats = {
+        .image_bytes = (uint32_t)ota_writer_get_written(),
+        .transfer_bytes = transfer_bytes,
+        .total_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000),
+        .flash_stall_ms = (uint32_t)(ota_writer_get_stall_us() / 1000),
+    };
+    stats.bytes_per_sec = bytes_per_sec(stats.transfer_bytes, (int64_t)stats.total_ms * 1000);
+    ota_manager_save_stats(&stats);
+
+    char status[64];
+    snprintf(status, sizeof(status), "%" PRIu32 "/%" PRIu32 " KB in %" PRIu32 ".%01" PRIu32 " s (%" PRIu32 " KB/s)",
+             stats.transfer_bytes / 1024, stats.image_bytes / 1024,
+             stats.total_ms / 1000, (stats.total_ms % 1000) / 100, stats.bytes_per_sec / 1024);
+    notify_status(100, status);
+    ESP_LOGI(TAG, "OTASTAT:bytes=%" PRIu32 ",xfer=%" PRIu32 ",ms=%" PRIu32 ",bps=%" PRIu32 ",stall_ms=%" PRIu32,
+             stats.image_bytes, stats.transfer_bytes, stats.total_ms, stats.bytes_per_sec, stats.flash_stall_ms);
+
+    notify_status(100, "Update complete, restarting...");
+    led_indicate_ota_success();
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    esp_restart();
+}
+
+// Resume record: kept in NVS at writer checkpoints, cleared once done
+static void save_resume(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs_handle, NVS_KEY_RESUME, &s_resume, sizeof(s_resume)) == ESP_OK) {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+static bool load_resume(ota_resume_t *resume)
+{
+    nvs_handle_t nvs_handle;
+    size_t len = sizeof(*resume);
+    bool found;
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    found = nvs_get_blob(nvs_handle, NVS_KEY_RESUME, resume, &len) == ESP_OK &&
+            len == sizeof(*resume) && resume->offset > 0 && resume->offset < resume->total_size;
+    nvs_close(nvs_handle);
+    return found;
+}
+
+static void clear_resume(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(nvs_handle, NVS_KEY_RESUME) == ESP_OK) {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+// Writer task: a checkpoint is only useful after a reboot for plain images,
+// the state of a compressed / delta stream lives in RAM
+static void on_checkpoint(size_t offset, const uint8_t sha256[32])
+{
+    if (!ota_image_is_passthrough() || s_resume.total_size == 0) {
+        return;
+    }
+    s_resume.offset = (uint32_t)offset;
+    memcpy(s_resume.prefix_sha256, sha256, sizeof(s_resume.prefix_sha256));
+    save_resume();
+}
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+    if (strcasecmp(evt->header_key, "ETag") == 0) {
+        strlcpy(s_response.etag, evt->header_value, sizeof(s_response.etag));
+    } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+        // bytes <first>-<last>/<total>
+        const char *slash = strrchr(evt->header_value, '/');
+        if (slash) {
+            s_response.range_total = strtoul(slash + 1, NULL, 10);
+        }
+    }
+    return ESP_OK;
+}
+
+// Open the request from offset, following redirects by hand (fetch_headers
+// doesn't). *total is the full body size, 0 if the server didn't say
+static esp_err_t http_open(esp_http_client_handle_t client, const char *url, uint32_t offset, uint32_t *total)
+{
+    // Start from the original URL each time - redirect targets are often
+    // short-lived signed links
+    esp_http_client_set_url(client, url);
+    if (offset > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", offset);
+        esp_http_client_set_header(client, "Range", range);
+    } else {
+        esp_http_client_delete_header(client, "Range");
+    }
+
+    for (int redirects = 0; redirects <= OTA_MAX_REDIRECTS; redirects++) {
+        memset(&s_response, 0, sizeof(s_response));
+        esp_err_t err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        int64_t content_length = esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status == 200 && offset == 0) {
+            *total = content_length > 0 ? (uint32_t)content_length : 0;
+            return ESP_OK;
+        }
+        if (status == 206 && offset > 0) {
+            *total = s_response.range_total;
+            return ESP_OK;
+        }
+        if (status >= 300 && status < 400) {
+            esp_http_client_flush_response(client, NULL);
+            esp_http_client_set_redirection(client);
+            esp_http_client_close(client);
+            continue;
+        }
+
+        ESP_LOGE(TAG, "HTTP status %d%s", status, offset > 0 ? " to a range request" : "");
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGE(TAG, "Too many redirects");
+    return ESP_FAIL;
+}
+
+// After a dropped connection, give WiFi time to come back. The WiFi
+// manager reconnects by itself; a request restarts it if it gave up
+static bool wait_for_wifi(int attempt)
+{
+    uint32_t delay_ms = OTA_RESUME_DELAY_MS << (attempt - 1);
+    if (delay_ms > OTA_RESUME_DELAY_MAX_MS) {
+        delay_ms = OTA_RESUME_DELAY_MAX_MS;
+    }
+    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    wifi_manager_connect();
+    return wifi_manager_wait_connected(pdMS_TO_TICKS(OTA_RESUME_WIFI_WAIT_MS)) == ESP_OK;
+}
+
+// Reopen with a Range request from the last received byte. A request that
+// fails to open counts as another attempt, like a read that drops
+static esp_err_t resume_download(esp_http_client_handle_t client, const char *url,
+                                 uint32_t total, int *retries)
+{
+    if (total == 0) {
+        return ESP_ERR_INVALID_SIZE;    // No size, no range to ask for
+    }
+
+    while (++*retries <= OTA_RESUME_RETRIES) {
+        uint32_t received = atomic_load(&s_bytes_received);
+        ESP_LOGW(TAG, "Connection lost at %" PRIu32 " bytes, resuming (%d/%d)",
+                 received, *retries, OTA_RESUME_RETRIES);
+        if (!wait_for_wifi(*retries)) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        uint32_t range_total = 0;
+        esp_err_t err = http_open(client, url, received, &range_total);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Resume request failed: %s", esp_err_to_name(err));
+            esp_http_client_close(client);
+            continue;
+        }
+        if (range_total != total || strcmp(s_response.etag, s_resume.etag) != 0) {
+            ESP_LOGE(TAG, "Image changed on the server");
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ESP_OK;
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
+
+// Receive the body and run it through the image decoder until it ends,
+// reopening with a Range request whenever the connection drops
+static esp_err_t download(esp_http_client_handle_t client, const char *url, uint32_t total)
+{
+    size_t read_size = s_pipeline.chunk_size;
+    uint8_t *buf = malloc(read_size);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int retries = 0;
+    esp_err_t err = ota_image_begin(atomic_load(&s_bytes_received));
+    while (err == ESP_OK) {
+        int len = esp_http_client_read(client, (char *)buf, read_size);
+        if (len > 0) {
+            atomic_fetch_add(&s_bytes_received, (unsigned)len);
+            err = ota_image_feed(buf, len);
+            retries = 0;
+            continue;
+        }
+        if (len == 0 && esp_http_client_is_complete_data_received(client)) {
+            err = ota_image_end();
+            break;
+        }
+
+        // Connection dropped - carry on from the last received byte
+        esp_http_client_close(client);
+        err = resume_download(client, url, total, &retries);
+    }
+
+    if (err != ESP_OK) {
+        ota_image_abort();
+    }
+    free(buf);
+    return err;
+}
+
+// The image itself is wrong, as opposed to the transfer failing: a resume
+// checkpoint for it is worthless
+static bool is_image_error(esp_err_t err)
+{
+    switch (err) {
+        case ESP_ERR_INVALID_STATE:
+        case ESP_ERR_INVALID_VERSION:
+        case ESP_ERR_INVALID_RESPONSE:
+        case ESP_ERR_NOT_SUPPORTED:
+        case ESP_ERR_OTA_VALIDATE_FAILED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static const char *download_error(esp_err_t err)
+{
+    switch (err) {
+        case ESP_ERR_INVALID_SIZE:
+            return "Download failed (truncated)";
+        case ESP_ERR_TIMEOUT:
+            return "Download failed (no WiFi)";
+        case ESP_ERR_INVALID_STATE:
+            return "Download failed (image changed)";
+        case ESP_ERR_INVALID_VERSION:
+            return "Download failed (delta base mismatch)";
+        case ESP_ERR_INVALID_RESPONSE:
+        case ESP_ERR_NOT_SUPPORTED:
+            return "Download failed (bad image)";
+        default:
+            return "Download failed";
+    }
+}
+
+// Try to continue a download a previous boot left unfinished. Returns the
+// offset it continues from, 0 to start over
+static uint32_t try_resume(esp_http_client_handle_t client, const char *url, uint32_t *total)
+{
+    ota_resume_t saved;
+
+    if (!load_resume(&saved) || strcmp(saved.url, url) != 0) {
+        return 0;
+    }
+    if (http_open(client, url, saved.offset, total) != ESP_OK) {
+        return 0;
+    }
+    if (*total != saved.total_size || strcmp(s_response.etag, saved.etag) != 0) {
+        ESP_LOGI(TAG, "Image changed since the interrupted download, starting over");
+        esp_http_client_close(client);
+        return 0;
+    }
+    if (ota_writer_resume(s_pipeline.chunk_size, saved.offset, saved.prefix_sha256) != ESP_OK) {
+        esp_http_client_close(client);
+        return 0;
+    }
+    return saved.offset;
+}
+
 static void ota_task(void *pvParameter)
 {
     ota_task_params_t *params = (ota_task_params_t *)pvParameter;
+    int64_t start_us = esp_timer_get_time();
+    uint32_t total = 0;
 
     notify_status(0, "Starting OTA update");
     led_indicate_ota_progress();
@@ -48,69 +484,78 @@ static void ota_task(void *pvParameter)
         .timeout_ms = 30000,
         .keep_alive_enable = true,
         .crt_bundle_attach = is_https ? esp_crt_bundle_attach : NULL,  // Use ESP-IDF cert bundle for HTTPS
-        .buffer_size = 1024,           // HTTP receive buffer
-        .buffer_size_tx = 1024,        // HTTP transmit buffer
-        .max_redirection_count = 10,   // GitHub uses redirects
+        .buffer_size = s_pipeline.http_buffer_size,     // HTTP receive buffer
+        .buffer_size_tx = 1024,                         // HTTP transmit buffer (headers only)
+        .max_redirection_count = OTA_MAX_REDIRECTS,
+        .event_handler = http_event_handler,
     };
 
-    esp_https_ota_config_t ota_config = {
-        .http_config = &config,
-        .partial_http_download = false,
-        .max_http_request_size = 0,
-    };
-
-    esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t err = esp_https_ota_begin(&ota_config, &https_ota_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
         notify_status(-1, "OTA begin failed");
         led_indicate_ota_fail();
         goto cleanup;
     }
 
-    int image_size = esp_https_ota_get_image_size(https_ota_handle);
-    int downloaded = 0;
-    int last_progress = 0;
-
-    while (1) {
-        err = esp_https_ota_perform(https_ota_handle);
-        if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-            break;
+    esp_err_t err = ESP_OK;
+    uint32_t start_offset = try_resume(client, params->url, &total);
+    if (start_offset > 0) {
+        char status[48];
+        snprintf(status, sizeof(status), "Resuming at %" PRIu32 " KB", start_offset / 1024);
+        notify_status((int)((uint64_t)start_offset * 100 / total), status);
+    } else {
+        err = http_open(client, params->url, 0, &total);
+        if (err == ESP_OK) {
+            err = ota_writer_begin(s_pipeline.chunk_size);
+            if (err != ESP_OK) {
+                esp_http_client_close(client);
+            }
         }
-
-        downloaded = esp_https_ota_get_image_len_read(https_ota_handle);
-        int progress = (image_size > 0) ? (downloaded * 100 / image_size) : 0;
-
-        if (progress != last_progress && progress % 10 == 0) {
-            char status[32];
-            snprintf(status, sizeof(status), "Downloading: %d%%", progress);
-            notify_status(progress, status);
-            last_progress = progress;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+            notify_status(-1, "OTA begin failed");
+            led_indicate_ota_fail();
+            esp_http_client_cleanup(client);
+            goto cleanup;
         }
     }
 
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "OTA perform failed: %s", esp_err_to_name(err));
-        notify_status(-1, "Download failed");
-        led_indicate_ota_fail();
-        esp_https_ota_abort(https_ota_handle);
-        goto cleanup;
-    }
+    // Describe this download for a later resume; the offset follows checkpoints
+    memset(&s_resume, 0, sizeof(s_resume));
+    strlcpy(s_resume.url, params->url, sizeof(s_resume.url));
+    strlcpy(s_resume.etag, s_response.etag, sizeof(s_resume.etag));
+    s_resume.total_size = total;
+    s_resume.offset = start_offset;
+    ota_writer_set_checkpoint_cb(on_checkpoint);
+
+    report_start();
+    atomic_store(&s_bytes_received, start_offset);
+    atomic_store(&s_image_size, total);
+    ESP_LOGI(TAG, "Download size %" PRIu32 " bytes, from %" PRIu32, total, start_offset);
+
+    err = download(client, params->url, total);
+    report_stop();
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
 
-    if (!esp_https_ota_is_complete_data_received(https_ota_handle)) {
-        ESP_LOGE(TAG, "Incomplete data received");
-        notify_status(-1, "Incomplete download");
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Download failed at %u bytes: %s",
+                 atomic_load(&s_bytes_received), esp_err_to_name(err));
+        notify_status(-1, download_error(err));
         led_indicate_ota_fail();
-        esp_https_ota_abort(https_ota_handle);
+        ota_writer_abort();
+        ota_writer_set_checkpoint_cb(NULL);
+        if (is_image_error(err)) {
+            clear_resume();     // Anything else may still resume from the checkpoint
+        }
         goto cleanup;
     }
 
-    err = esp_https_ota_finish(https_ota_handle);
+    err = ota_writer_finish();
+    ota_writer_set_checkpoint_cb(NULL);
+    clear_resume();
     if (err == ESP_OK) {
-        notify_status(100, "Update complete, restarting...");
-        led_indicate_ota_success();
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        esp_restart();
+        ota_manager_complete(atomic_load(&s_bytes_received) - start_offset, start_us);
     } else {
         ESP_LOGE(TAG, "OTA finish failed: %s", esp_err_to_name(err));
         notify_status(-1, "Update failed");
@@ -118,8 +563,8 @@ static void ota_task(void *pvParameter)
     }
 
 cleanup:
-    free(params);
     s_ota_in_progress = false;
+    coex_policy_update();
     vTaskDelete(NULL);
 }
 
@@ -147,7 +592,7 @@ void ota_manager_set_callback(ota_status_callback_t callback)
 
 esp_err_t ota_manager_start_update(const char *url)
 {
-    if (s_ota_in_progress) {
+    if (s_ota_in_progress || ota_writer_is_active()) {
         ESP_LOGW(TAG, "OTA already in progress");
         return ESP_ERR_INVALID_STATE;
     }
@@ -156,25 +601,69 @@ esp_err_t ota_manager_start_update(const char *url)
         return ESP_ERR_INVALID_ARG;
     }
 
-    ota_task_params_t *params = malloc(sizeof(ota_task_params_t));
-    if (!params) {
+    // Refuse up front rather than failing the handshake with the radio busy
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (strncmp(url, "https://", 8) == 0 && largest < OTA_TLS_MIN_FREE_BLOCK) {
+        ESP_LOGW(TAG, "Largest free block %u bytes, not enough for TLS", (unsigned)largest);
         return ESP_ERR_NO_MEM;
     }
 
-    strncpy(params->url, url, sizeof(params->url) - 1);
-    params->url[sizeof(params->url) - 1] = '\0';
+    strncpy(s_task_params.url, url, sizeof(s_task_params.url) - 1);
+    s_task_params.url[sizeof(s_task_params.url) - 1] = '\0';
 
     s_ota_in_progress = true;
 
-    if (xTaskCreate(ota_task, "ota_task", 8192, params, 5, NULL) != pdPASS) {
-        free(params);
+    if (xTaskCreate(ota_task, "ota_task", OTA_TASK_STACK, &s_task_params,
+                    OTA_TASK_PRIORITY, NULL) != pdPASS) {
         s_ota_in_progress = false;
-        return ESP_FAIL;
+        return ESP_ERR_NO_MEM;
     }
+    coex_policy_update();       // Radio preference to WiFi for the download
 
     return ESP_OK;
 }
 
+esp_err_t ota_manager_set_pipeline_config(const ota_pipeline_config_t *config)
+{
+    if (!config ||
+        config->http_buffer_size < OTA_HTTP_BUFFER_MIN || config->http_buffer_size > OTA_HTTP_BUFFER_MAX ||
+        config->chunk_size < OTA_WRITER_CHUNK_MIN || config->chunk_size > OTA_WRITER_CHUNK_MAX ||
+        config->chunk_size % OTA_WRITER_CHUNK_MIN != 0 ||     // Keeps checkpoints on sector boundaries
+        config->progress_interval_ms < OTA_PROGRESS_INTERVAL_MIN ||
+        config->progress_interval_ms > OTA_PROGRESS_INTERVAL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_ota_in_progress) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_pipeline = *config;
+    return ESP_OK;
+}
+
+void ota_manager_get_pipeline_config(ota_pipeline_config_t *config)
+{
+    *config = s_pipeline;
+}
+
+bool ota_manager_get_last_stats(ota_stats_t *stats)
+{
+    nvs_handle_t nvs_handle;
+    size_t len = sizeof(*stats);
+    bool found = false;
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    found = nvs_get_blob(nvs_handle, NVS_KEY_STATS, stats, &len) == ESP_OK && len == sizeof(*stats);
+    nvs_close(nvs_handle);
+    return found;
+}
+
+bool ota_manager_is_in_progress(void)
+{
+    return s_ota_in_progress;
+}
+
 const char* ota_manager_get_version(void)
 {
     return FIRMWARE_VERSION;
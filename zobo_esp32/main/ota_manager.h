@@ -6,6 +6,7 @@
 #define OTA_MANAGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 // OTA status callback
@@ -14,16 +15,63 @@ typedef void (*ota_status_callback_t)(int progress, const char *status);
 // Firmware version info
 #define FIRMWARE_VERSION "1.1.0"
 
+// Download pipeline tuning
+typedef struct {
+    uint16_t http_buffer_size;      // esp_http_client receive buffer (512-16384)
+    uint16_t chunk_size;            // Flash write chunk, two are allocated (1024-16384, 1 KB steps)
+    uint16_t progress_interval_ms;  // BLE progress rate limit (100-10000)
+} ota_pipeline_config_t;
+
+#define OTA_PIPELINE_DEFAULT_CONFIG() {     \
+    .http_buffer_size = 4096,               \
+    .chunk_size = 4096,                     \
+    .progress_interval_ms = 1000,           \
+}
+
+// Measurements of a completed update
+typedef struct {
+    uint32_t image_bytes;       // Written to flash
+    uint32_t transfer_bytes;    // Received (smaller for compressed / delta images)
+    uint32_t total_ms;          // Request start to image verified
+    uint32_t bytes_per_sec;     // Transfer rate
+    uint32_t flash_stall_ms;    // Time the download waited for a free buffer
+} ota_stats_t;
+
 // Initialize OTA manager
 esp_err_t ota_manager_init(void);
 
 // Set status callback
 void ota_manager_set_callback(ota_status_callback_t callback);
 
-// Start OTA update from URL
-// Returns ESP_OK if update started, ESP_FAIL on error
+// Start OTA update from URL (plain .bin or .zota container, see ota_image.h).
+// A dropped connection is resumed with a Range request once WiFi is back;
+// a plain image interrupted by a reboot resumes when the same URL is
+// requested again
+// Returns ESP_OK if update started, ESP_ERR_NO_MEM if the heap can't take
+// a TLS handshake or the task, ESP_ERR_INVALID_STATE if one is running
 esp_err_t ota_manager_start_update(const char *url);
 
+// Set download pipeline tuning (not while an update is running)
+esp_err_t ota_manager_set_pipeline_config(const ota_pipeline_config_t *config);
+
+// Get download pipeline tuning
+void ota_manager_get_pipeline_config(ota_pipeline_config_t *config);
+
+// Stats of the last successful update (survive the restart into it)
+bool ota_manager_get_last_stats(ota_stats_t *stats);
+
+// Record stats of an update that completed over another transport (BLE)
+void ota_manager_save_stats(const ota_stats_t *stats);
+
+// Finish an update whatever the transport, once ota_writer_finish()
+// succeeded: store and report the stats, show success, restart into the
+// new image. transfer_bytes is what came over the link, start_us when the
+// update started (esp_timer). Does not return
+void ota_manager_complete(uint32_t transfer_bytes, int64_t start_us);
+
+// Check if an update is running
+bool ota_manager_is_in_progress(void);
+
 // Get current firmware version
 const char* ota_manager_get_version(void);
 
@@ -0,0 +1,405 @@
+/**
+ * OTA Flash Writer
+ */
+
+#include "ota_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+static const char *TAG = "OTA_WR";
+
+#define OTA_WRITER_BUFFERS      2
+#define OTA_WRITER_STACK        4096
+#define OTA_WRITER_PRIORITY     4       // Below the transport task
+#define OTA_WRITER_DRAIN_MS     10000
+
+typedef struct {
+    uint8_t *data;
+    size_t len;     // 0 = stop
+} ota_chunk_t;
+
+static uint8_t *s_buffers[OTA_WRITER_BUFFERS];
+static QueueHandle_t s_free_queue = NULL;
+static QueueHandle_t s_full_queue = NULL;
+static TaskHandle_t s_task = NULL;
+static TaskHandle_t s_waiter = NULL;
+static esp_ota_handle_t s_handle = 0;
+static const esp_partition_t *s_partition = NULL;
+static bool s_raw = false;              // Resumed: plain partition writes, no esp_ota handle
+static size_t s_erased = 0;             // Raw mode: erased up to here
+static atomic_size_t s_written = 0;
+static volatile esp_err_t s_error = ESP_OK;
+static size_t s_chunk_size = 0;
+static int64_t s_stall_us = 0;
+
+// Chunk being filled by ota_writer_write()
+static uint8_t *s_fill_buf = NULL;
+static size_t s_fill_len = 0;
+
+// Running hash of everything in the partition, for resume checkpoints
+static mbedtls_sha256_context s_sha;
+static ota_writer_checkpoint_cb_t s_checkpoint_cb = NULL;
+static size_t s_last_checkpoint = 0;
+
+static esp_err_t flash_write(const uint8_t *data, size_t len)
+{
+    if (!s_raw) {
+        return esp_ota_write(s_handle, data, len);
+    }
+
+    size_t offset = atomic_load(&s_written);
+    if (offset + len > s_partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (s_erased < offset + len) {
+        esp_err_t err = esp_partition_erase_range(s_partition, s_erased, SPI_FLASH_SEC_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_erased += SPI_FLASH_SEC_SIZE;
+    }
+    return esp_partition_write(s_partition, offset, data, len);
+}
+
+static void checkpoint(size_t written)
+{
+    if (!s_checkpoint_cb || written % SPI_FLASH_SEC_SIZE != 0 ||
+        written - s_last_checkpoint < OTA_WRITER_CHECKPOINT_BYTES) {
+        return;
+    }
+
+    uint8_t sha[32];
+    mbedtls_sha256_context prefix;
+    mbedtls_sha256_init(&prefix);
+    mbedtls_sha256_clone(&prefix, &s_sha);
+    mbedtls_sha256_finish(&prefix, sha);
+    mbedtls_sha256_free(&prefix);
+
+    s_last_checkpoint = written;
+    s_checkpoint_cb(written, sha);
+}
+
+static void writer_task(void *arg)
+{
+    ota_chunk_t chunk;
+
+    while (xQueueReceive(s_full_queue, &chunk, portMAX_DELAY) == pdTRUE) {
+        if (chunk.len == 0) {
+            break;
+        }
+        if (s_error == ESP_OK) {
+            esp_err_t err = flash_write(chunk.data, chunk.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Flash write failed at %u: %s",
+                         (unsigned)atomic_load(&s_written), esp_err_to_name(err));
+                s_error = err;
+            } else {
+                mbedtls_sha256_update(&s_sha, chunk.data, chunk.len);
+                checkpoint(atomic_fetch_add(&s_written, chunk.len) + chunk.len);
+            }
+        }
+        xQueueSend(s_free_queue, &chunk.data, portMAX_DELAY);
+    }
+
+    s_task = NULL;
+    if (s_waiter) {
+        xTaskNotifyGive(s_waiter);
+    }
+    vTaskDelete(NULL);
+}
+
+static void release(void)
+{
+    for (int i = 0; i < OTA_WRITER_BUFFERS; i++) {
+        free(s_buffers[i]);
+        s_buffers[i] = NULL;
+    }
+    if (s_free_queue) {
+        vQueueDelete(s_free_queue);
+        s_free_queue = NULL;
+    }
+    if (s_full_queue) {
+        vQueueDelete(s_full_queue);
+        s_full_queue = NULL;
+    }
+    mbedtls_sha256_free(&s_sha);
+    s_handle = 0;
+    s_partition = NULL;
+    s_raw = false;
+    s_fill_buf = NULL;
+    s_fill_len = 0;
+}
+
+// Stop the writer task once it has drained the queue
+static bool stop_task(void)
+{
+    if (!s_task) {
+        return true;
+    }
+    ota_chunk_t stop = { .data = NULL, .len = 0 };
+    s_waiter = xTaskGetCurrentTaskHandle();
+    xQueueSend(s_full_queue, &stop, portMAX_DELAY);
+    bool stopped = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_WRITER_DRAIN_MS)) != 0;
+    s_waiter = NULL;
+    return stopped;
+}
+
+// Hash the part of the partition a previous session left behind
+static esp_err_t verify_prefix(size_t offset, const uint8_t *expected, uint8_t *scratch, size_t scratch_size)
+{
+    for (size_t pos = 0; pos < offset; ) {
+        size_t n = offset - pos < scratch_size ? offset - pos : scratch_size;
+        esp_err_t err = esp_partition_read(s_partition, pos, scratch, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        mbedtls_sha256_update(&s_sha, scratch, n);
+        pos += n;
+    }
+
+    uint8_t sha[32];
+    mbedtls_sha256_context prefix;
+    mbedtls_sha256_init(&prefix);
+    mbedtls_sha256_clone(&prefix, &s_sha);
+    mbedtls_sha256_finish(&prefix, sha);
+    mbedtls_sha256_free(&prefix);
+    return memcmp(sha, expected, sizeof(sha)) == 0 ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static esp_err_t begin(size_t chunk_size, size_t offset, const uint8_t *prefix_sha256)
+{
+    if (chunk_size < OTA_WRITER_CHUNK_MIN || chunk_size > OTA_WRITER_CHUNK_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_partition) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_partition = esp_ota_get_next_update_partition(NULL);
+    if (!s_partition) {
+        ESP_LOGE(TAG, "No update partition");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || offset >= s_partition->size) {
+        s_partition = NULL;
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mbedtls_sha256_init(&s_sha);
+    mbedtls_sha256_starts(&s_sha, 0);
+
+    s_free_queue = xQueueCreate(OTA_WRITER_BUFFERS, sizeof(uint8_t *));
+    s_full_queue = xQueueCreate(OTA_WRITER_BUFFERS + 1, sizeof(ota_chunk_t));
+    if (!s_free_queue || !s_full_queue) {
+        release();
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < OTA_WRITER_BUFFERS; i++) {
+        s_buffers[i] = malloc(chunk_size);
+        if (!s_buffers[i]) {
+            release();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t err;
+    if (offset > 0) {
+        // esp_ota can't pick up a half written slot, so a resumed session
+        // writes the partition directly and relies on the boot partition
+        // switch to verify the finished image
+        err = verify_prefix(offset, prefix_sha256, s_buffers[0], chunk_size);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Partial image at %u doesn't match, can't resume", (unsigned)offset);
+            release();
+            return err;
+        }
+        s_raw = true;
+        s_erased = offset;
+    } else {
+        // Sequential writes erase sector by sector instead of the whole slot up front
+        err = esp_ota_begin(s_partition, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+            release();
+            return err;
+        }
+    }
+
+    for (int i = 0; i < OTA_WRITER_BUFFERS; i++) {
+        xQueueSend(s_free_queue, &s_buffers[i], 0);
+    }
+    atomic_store(&s_written, offset);
+    s_last_checkpoint = offset;
+    s_error = ESP_OK;
+    s_chunk_size = chunk_size;
+    s_stall_us = 0;
+    if (xTaskCreate(writer_task, "ota_writer", OTA_WRITER_STACK, NULL,
+                    OTA_WRITER_PRIORITY, &s_task) != pdPASS) {
+        s_task = NULL;
+        if (!s_raw) {
+            esp_ota_abort(s_handle);
+        }
+        release();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Writing to %s at 0x%" PRIx32 " from %u, %u byte chunks",
+             s_partition->label, s_partition->address, (unsigned)offset, (unsigned)chunk_size);
+    return ESP_OK;
+}
+
+esp_err_t ota_writer_begin(size_t chunk_size)
+{
+    return begin(chunk_size, 0, NULL);
+}
+
+esp_err_t ota_writer_resume(size_t chunk_size, size_t offset, const uint8_t prefix_sha256[32])
+{
+    if (offset == 0 || !prefix_sha256) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return begin(chunk_size, offset, prefix_sha256);
+}
+
+void ota_writer_set_checkpoint_cb(ota_writer_checkpoint_cb_t cb)
+{
+    s_checkpoint_cb = cb;
+}
+
+uint8_t *ota_writer_acquire(TickType_t timeout)
+{
+    uint8_t *buf = NULL;
+
+    if (!s_free_queue || s_error != ESP_OK) {
+        return NULL;
+    }
+    int64_t start = esp_timer_get_time();
+    if (xQueueReceive(s_free_queue, &buf, timeout) != pdTRUE) {
+        buf = NULL;
+    }
+    s_stall_us += esp_timer_get_time() - start;
+    return buf;
+}
+
+esp_err_t ota_writer_submit(uint8_t *buf, size_t len)
+{
+    if (!s_full_queue || !buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0) {
+        // Nothing to write - hand the buffer straight back
+        xQueueSend(s_free_queue, &buf, 0);
+        return s_error;
+    }
+    ota_chunk_t chunk = { .data = buf, .len = len };
+    xQueueSend(s_full_queue, &chunk, portMAX_DELAY);
+    return s_error;
+}
+
+esp_err_t ota_writer_write(const void *data, size_t len)
+{
+    const uint8_t *src = data;
+
+    while (len > 0) {
+        if (!s_fill_buf) {
+            s_fill_buf = ota_writer_acquire(pdMS_TO_TICKS(OTA_WRITER_DRAIN_MS));
+            s_fill_len = 0;
+            if (!s_fill_buf) {
+                return s_error != ESP_OK ? s_error : ESP_ERR_TIMEOUT;
+            }
+        }
+
+        size_t n = s_chunk_size - s_fill_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s_fill_buf + s_fill_len, src, n);
+        s_fill_len += n;
+        src += n;
+        len -= n;
+
+        if (s_fill_len == s_chunk_size) {
+            uint8_t *buf = s_fill_buf;
+            s_fill_buf = NULL;
+            esp_err_t err = ota_writer_submit(buf, s_chunk_size);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return s_error;
+}
+
+esp_err_t ota_writer_finish(void)
+{
+    if (!s_partition) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_fill_buf) {
+        uint8_t *buf = s_fill_buf;
+        s_fill_buf = NULL;
+        ota_writer_submit(buf, s_fill_len);
+    }
+    if (!stop_task()) {
+        ESP_LOGE(TAG, "Writer did not drain");
+        s_error = ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t err = s_error;
+    if (err == ESP_OK) {
+        // esp_ota_end and esp_ota_set_boot_partition both validate the image
+        err = s_raw ? ESP_OK : esp_ota_end(s_handle);
+        if (err == ESP_OK) {
+            err = esp_ota_set_boot_partition(s_partition);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(err));
+        }
+    } else if (!s_raw) {
+        esp_ota_abort(s_handle);
+    }
+
+    if (s_task == NULL) {
+        release();
+    }
+    return err;
+}
+
+void ota_writer_abort(void)
+{
+    if (!s_partition) {
+        return;
+    }
+    s_error = ESP_FAIL;     // Writer skips anything still queued
+    bool stopped = stop_task();
+    if (!s_raw) {
+        esp_ota_abort(s_handle);
+    }
+    if (stopped) {
+        release();
+    }
+}
+
+bool ota_writer_is_active(void)
+{
+    return s_partition != NULL;
+}
+
+size_t ota_writer_get_written(void)
+{
+    return atomic_load(&s_written);
+}
+
+int64_t ota_writer_get_stall_us(void)
+{
+    return s_stall_us;
+}
@@ -0,0 +1,66 @@
+/**
+ * OTA Flash Writer - Header
+ * Double-buffered sink that writes image chunks to the inactive app
+ * partition from its own task, so the transport (HTTP, BLE) keeps
+ * receiving while the previous chunk is being flashed
+ */
+
+#ifndef OTA_WRITER_H
+#define OTA_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Chunk size limits (bytes)
+#define OTA_WRITER_CHUNK_MIN    1024
+#define OTA_WRITER_CHUNK_MAX    16384
+
+// Minimum distance between resume checkpoints (bytes)
+#define OTA_WRITER_CHECKPOINT_BYTES (64 * 1024)
+
+// Called from the writer task at sector aligned offsets with the SHA-256
+// of everything written up to there
+typedef void (*ota_writer_checkpoint_cb_t)(size_t offset, const uint8_t sha256[32]);
+
+// Select the next update partition, start esp_ota and allocate two chunk
+// buffers of chunk_size bytes
+esp_err_t ota_writer_begin(size_t chunk_size);
+
+// Continue a partially written image at a checkpoint offset. The flash
+// prefix is hashed first; ESP_ERR_INVALID_CRC if it doesn't match
+esp_err_t ota_writer_resume(size_t chunk_size, size_t offset, const uint8_t prefix_sha256[32]);
+
+// Register the checkpoint callback (NULL to disable)
+void ota_writer_set_checkpoint_cb(ota_writer_checkpoint_cb_t cb);
+
+// Take an empty buffer (chunk_size bytes). NULL on timeout or after a
+// write error
+uint8_t *ota_writer_acquire(TickType_t timeout);
+
+// Queue a filled buffer for flashing. Returns the first write error, if any
+esp_err_t ota_writer_submit(uint8_t *buf, size_t len);
+
+// Copy bytes into chunk buffers, submitting each one as it fills. For
+// producers that don't deal in whole chunks (decoders, BLE packets)
+esp_err_t ota_writer_write(const void *data, size_t len);
+
+// Flush the partially filled chunk, wait for pending writes, validate the
+// image and set it as boot partition
+esp_err_t ota_writer_finish(void);
+
+// Drop the update and free everything
+void ota_writer_abort(void);
+
+// True between begin/resume and finish/abort, whichever transport owns it
+bool ota_writer_is_active(void);
+
+// Bytes of the image in flash so far (including a resumed prefix)
+size_t ota_writer_get_written(void);
+
+// Time producers spent waiting for a free buffer (flash is the bottleneck)
+int64_t ota_writer_get_stall_us(void);
+
+#endif // OTA_WRITER_H
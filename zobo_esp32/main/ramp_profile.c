@@ -0,0 +1,85 @@
+/**
+ * Ramp Profiles
+ */
+
+#include "ramp_profile.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// t
+static const uint16_t s_lut_linear[RAMP_LUT_SIZE] = {
+        0,  2048,  4096,  6144,  8192, 10240, 12288, 14336,
+    16384, 18432, 20480, 22528, 24576, 26624, 28672, 30720,
+    32768, 34815, 36863, 38911, 40959, 43007, 45055, 47103,
+    49151, 51199, 53247, 55295, 57343, 59391, 61439, 63487,
+    65535,
+};
+
+// 6t^5 - 15t^4 + 10t^3
+static const uint16_t s_lut_s_curve[RAMP_LUT_SIZE] = {
+        0,    19,   145,   467,  1052,  1951,  3196,  4806,
+     6784,  9121, 11797, 14781, 18036, 21515, 25167, 28938,
+    32768, 36597, 40368, 44020, 47499, 50754, 53738, 56414,
+    58751, 60729, 62339, 63584, 64483, 65068, 65390, 65516,
+    65535,
+};
+
+// (1 - e^(-4t)) / (1 - e^(-4))
+static const uint16_t s_lut_exponential[RAMP_LUT_SIZE] = {
+        0,  7844, 14767, 20876, 26267, 31025, 35224, 38929,
+    42199, 45085, 47631, 49879, 51862, 53612, 55157, 56520,
+    57723, 58785, 59721, 60548, 61278, 61922, 62490, 62991,
+    63434, 63825, 64169, 64473, 64742, 64979, 65188, 65372,
+    65535,
+};
+
+// Custom curve is double buffered so an upload never tears a running ramp
+static uint16_t s_lut_custom[2][RAMP_LUT_SIZE];
+static volatile uint8_t s_custom_active = 0;
+static volatile bool s_custom_valid = false;
+
+const uint16_t *ramp_profile_get_lut(ramp_profile_id_t id)
+{
+    switch (id) {
+        case RAMP_PROFILE_LINEAR:
+            return s_lut_linear;
+        case RAMP_PROFILE_S_CURVE:
+            return s_lut_s_curve;
+        case RAMP_PROFILE_EXPONENTIAL:
+            return s_lut_exponential;
+        case RAMP_PROFILE_CUSTOM:
+            // Fall back to linear until a curve has been uploaded
+            return s_custom_valid ? s_lut_custom[s_custom_active] : s_lut_linear;
+        default:
+            return NULL;
+    }
+}
+
+esp_err_t ramp_profile_set_custom(const uint16_t *points, uint8_t count)
+{
+    if (!points || count < 2 || count > RAMP_LUT_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t target = s_custom_active ^ 1;
+    uint16_t *lut = s_lut_custom[target];
+
+    // Resample count points onto RAMP_LUT_SIZE entries (Q16 source position)
+    for (uint32_t i = 0; i < RAMP_LUT_SIZE; i++) {
+        uint32_t pos = (i * (uint32_t)(count - 1) << 16) / RAMP_LUT_SEGMENTS;
+        uint32_t index = pos >> 16;
+        int32_t frac = pos & 0xFFFF;
+
+        if (index >= (uint32_t)(count - 1)) {
+            lut[i] = points[count - 1];
+        } else {
+            int32_t a = points[index];
+            int32_t b = points[index + 1];
+            lut[i] = (uint16_t)(a + (((int64_t)(b - a) * frac) >> 16));
+        }
+    }
+
+    s_custom_active = target;
+    s_custom_valid = true;
+    return ESP_OK;
+}
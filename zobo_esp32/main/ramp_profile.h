@@ -0,0 +1,46 @@
+/**
+ * Ramp Profiles - Header
+ *
+ * Ramp shapes are stored as lookup tables mapping ramp progress (Q16,
+ * 0..65535) to output fraction (Q16). Each control tick is a table lookup
+ * plus one linear interpolation - no division.
+ */
+
+#ifndef RAMP_PROFILE_H
+#define RAMP_PROFILE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define RAMP_LUT_SEGMENTS       32
+#define RAMP_LUT_SIZE           (RAMP_LUT_SEGMENTS + 1)
+#define RAMP_LUT_SHIFT          11      // 65536 / RAMP_LUT_SEGMENTS = 1 << 11
+#define RAMP_Q16_ONE            65535
+
+// Built-in and user profiles
+typedef enum {
+    RAMP_PROFILE_LINEAR,
+    RAMP_PROFILE_S_CURVE,       // Smootherstep, zero slope at both ends
+    RAMP_PROFILE_EXPONENTIAL,   // Fast start, settles into the target
+    RAMP_PROFILE_CUSTOM,        // Uploaded with ramp_profile_set_custom()
+    RAMP_PROFILE_COUNT
+} ramp_profile_id_t;
+
+// Get lookup table for a profile (NULL if id is invalid)
+const uint16_t *ramp_profile_get_lut(ramp_profile_id_t id);
+
+// Evaluate a profile at phase (Q16) - returns output fraction (Q16)
+static inline uint16_t ramp_profile_eval(const uint16_t *lut, uint16_t phase)
+{
+    uint32_t index = phase >> RAMP_LUT_SHIFT;
+    int32_t frac = phase & ((1 << RAMP_LUT_SHIFT) - 1);
+    int32_t a = lut[index];
+    int32_t b = lut[index + 1];
+    return (uint16_t)(a + (((b - a) * frac) >> RAMP_LUT_SHIFT));
+}
+
+// Upload a custom curve of 2..RAMP_LUT_SIZE evenly spaced Q16 points;
+// it is resampled into the custom lookup table
+esp_err_t ramp_profile_set_custom(const uint16_t *points, uint8_t count);
+
+#endif // RAMP_PROFILE_H
@@ -0,0 +1,86 @@
+/**
+ * Sequence Lock - Header
+ *
+ * Single-writer, multi-reader publication of a small struct without
+ * critical sections. The writer bumps the sequence to odd, copies the
+ * payload word by word and bumps it back to even. Readers copy the
+ * payload and keep it only if the sequence was even and unchanged.
+ *
+ * A reader never spins: if the writer was preempted mid-update (possibly
+ * by the reader itself on the same core), the read simply fails and the
+ * caller tries again on its next cycle. Callers that need a value right
+ * away retry a bounded number of times and fall back to the last value
+ * they read (see motor.c), never loop until the writer is done.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Payload storage size in words for a given type
+#define SEQLOCK_WORDS(type)     ((sizeof(type) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+// Declare a seqlock holding one value of type
+#define SEQLOCK_DEFINE(name, type)                      \
+    static struct {                                     \
+        _Atomic uint32_t seq;                           \
+        _Atomic uint32_t words[SEQLOCK_WORDS(type)];    \
+    } name
+
+static inline void seqlock_write_words(_Atomic uint32_t *seq, _Atomic uint32_t *words,
+                                       const void *src, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)src;
+    uint32_t s = atomic_load_explicit(seq, memory_order_relaxed);
+
+    atomic_store_explicit(seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i * sizeof(uint32_t) < size; i++) {
+        uint32_t w = 0;
+        size_t n = size - i * sizeof(uint32_t);
+        memcpy(&w, p + i * sizeof(uint32_t), n < sizeof(w) ? n : sizeof(w));
+        atomic_store_explicit(&words[i], w, memory_order_relaxed);
+    }
+    atomic_store_explicit(seq, s + 2, memory_order_release);
+}
+
+// Returns false if a write was in progress or raced the copy (dst may then
+// hold a torn value and must be discarded). On success the sequence of the
+// copied value is stored in *seq_out if not NULL
+static inline bool seqlock_read_words(_Atomic uint32_t *seq, _Atomic uint32_t *words,
+                                      void *dst, size_t size, uint32_t *seq_out)
+{
+    uint8_t *p = (uint8_t *)dst;
+    uint32_t s1 = atomic_load_explicit(seq, memory_order_acquire);
+
+    if (s1 & 1) {
+        return false;
+    }
+    for (size_t i = 0; i * sizeof(uint32_t) < size; i++) {
+        uint32_t w = atomic_load_explicit(&words[i], memory_order_relaxed);
+        size_t n = size - i * sizeof(uint32_t);
+        memcpy(p + i * sizeof(uint32_t), &w, n < sizeof(w) ? n : sizeof(w));
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(seq, memory_order_relaxed) != s1) {
+        return false;
+    }
+
+    if (seq_out) {
+        *seq_out = s1;
+    }
+    return true;
+}
+
+#define seqlock_write(lock, value) \
+    seqlock_write_words(&(lock).seq, (lock).words, (value), sizeof(*(value)))
+
+#define seqlock_read(lock, value, seq_out) \
+    seqlock_read_words(&(lock).seq, (lock).words, (value), sizeof(*(value)), (seq_out))
+
+#endif // SEQLOCK_H
@@ -1,27 +1,78 @@
 /**
  * Sleep Manager
- * Handles power saving with deep sleep after inactivity
- * Periodically wakes up to blink LED, then goes back to sleep
+ * Handles power saving with frequency scaling and modem sleep while idle
+ * and deep sleep after long inactivity. The robot stays connectable the
+ * whole time it is idle.
+ *
+ * Automatic light sleep is configured but never entered on this board: with
+ * CONFIG_BTDM_CTRL_LPCLK_SEL_MAIN_XTAL the BT controller keeps the main
+ * crystal as its sleep clock and holds a no-light-sleep lock. A 32 kHz
+ * crystal with CONFIG_BTDM_CTRL_LPCLK_SEL_EXT_32K_XTAL removes that veto,
+ * but light sleep also needs every driver PM lock released: the control
+ * loop disables its GPTimer and the encoder PCNT units stop in IDLE (and
+ * only run at all with closed loop on). Check esp_pm_dump_locks() before
+ * relying on it.
  */
 
 #include "sleep_manager.h"
 #include "led.h"
+#include "ble_service.h"
+#include "coex_policy.h"
+#include "control_loop.h"
+#include "wheel_encoder.h"
+#include "ota_manager.h"
+#include "ota_writer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
+#include "esp_pm.h"
+#include "nvs.h"
 #include <inttypes.h>
+#include <stdatomic.h>
 
 static const char *TAG = "SLEEP";
 
 // Configuration
-#define INACTIVITY_TIMEOUT_MS   15000       // 15 seconds until sleep
-#define DEEP_SLEEP_DURATION_US  (10000000)  // 10 seconds between wakes
-#define BLINK_DURATION_MS       50          // LED on for 50ms (short blink)
+#define BLINK_DURATION_MS           50      // LED on for 50ms (short blink)
+#define CPU_FREQ_MAX_MHZ            240
+#define CPU_FREQ_MIN_MHZ            80      // Lowest frequency the BLE controller allows
+#define SLEEP_TASK_STACK            2048
+#define SLEEP_TASK_PRIORITY         3
 
-// State
-static volatile uint32_t last_activity_time = 0;
-static volatile bool is_sleeping = false;
+// NVS storage
+#define NVS_NAMESPACE               "power"
+#define NVS_KEY_TIMEOUTS            "timeouts"
+
+// State - reset from the command dispatchers, read by the sleep task
+static _Atomic uint32_t last_activity_time = 0;
+static _Atomic sleep_state_t state = SLEEP_STATE_ACTIVE;
+static _Atomic uint32_t idle_timeout_ms = SLEEP_IDLE_TIMEOUT_DEFAULT_MS;
+static _Atomic uint32_t deep_timeout_ms = SLEEP_DEEP_TIMEOUT_DEFAULT_MS;
+static _Atomic uint32_t wake_period_s = SLEEP_WAKE_PERIOD_DEFAULT_S;
+static _Atomic uint32_t wake_window_ms = SLEEP_WAKE_WINDOW_DEFAULT_MS;
+static bool timer_wake = false;
+
+// State transitions happen on the sleep task and on whichever dispatcher
+// wakes the device; the mutex keeps them ordered
+static SemaphoreHandle_t transition_lock = NULL;
+static StaticSemaphore_t transition_lock_buf;
+
+static StaticTask_t sleep_task_buf;
+static StackType_t sleep_task_stack[SLEEP_TASK_STACK];
+
+#if CONFIG_PM_ENABLE
+// Held while ACTIVE so frequency scaling (and light sleep, where the BT
+// sleep clock allows it) only kick in once the device is idle
+static esp_pm_lock_handle_t cpu_lock = NULL;
+static esp_pm_lock_handle_t no_sleep_lock = NULL;
+#endif
+
+static inline uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
 
 // Check if we woke from deep sleep
 static bool woke_from_deep_sleep(void)
@@ -30,29 +81,61 @@ static bool woke_from_deep_sleep(void)
     return (cause == ESP_SLEEP_WAKEUP_TIMER);
 }
 
-void sleep_manager_reset(void)
+static void enter_active(void)
 {
-    last_activity_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    is_sleeping = false;
+#if CONFIG_PM_ENABLE
+    if (cpu_lock) {
+        esp_pm_lock_acquire(cpu_lock);
+        esp_pm_lock_acquire(no_sleep_lock);
+    }
+#endif
+    wheel_encoder_suspend(false);     // Restarts the units if closed loop is on
+    control_loop_resume();
+    ble_service_set_adv_slow(false);
+    atomic_store(&state, SLEEP_STATE_ACTIVE);
+    coex_policy_update();       // Picks the connection profile for the new tier
+    ESP_LOGI(TAG, "Active");
 }
 
-bool sleep_manager_is_sleeping(void)
+static void enter_idle(uint32_t inactive_time)
 {
-    return is_sleeping;
+    ESP_LOGI(TAG, "Idle after %" PRIu32 " ms of inactivity - power saving enabled", inactive_time);
+
+    // Motors are already stopped by the inactivity timeout. Clearing every
+    // layer also stops the LED frame timer so it doesn't keep waking the CPU
+    led_off();
+    control_loop_suspend();
+    wheel_encoder_suspend(true);
+    ble_service_set_adv_slow(true);
+    atomic_store(&state, SLEEP_STATE_IDLE);
+    coex_policy_update();
+#if CONFIG_PM_ENABLE
+    if (cpu_lock) {
+        esp_pm_lock_release(no_sleep_lock);
+        esp_pm_lock_release(cpu_lock);
+    }
+#endif
 }
 
 static void enter_deep_sleep(void)
 {
-    ESP_LOGI(TAG, "Entering deep sleep for 10 seconds...");
+    uint32_t period_s = atomic_load(&wake_period_s);
+    if (period_s > 0) {
+        ESP_LOGI(TAG, "Entering deep sleep, waking every %" PRIu32 " s to advertise", period_s);
+    } else {
+        ESP_LOGI(TAG, "Entering deep sleep until reset");
+    }
+    atomic_store(&state, SLEEP_STATE_DEEP);
 
     // Turn off all LEDs before sleep
-    led_set_rgb(false, false, false);
+    led_off();
 
     // Small delay to allow log to flush
     vTaskDelay(pdMS_TO_TICKS(50));
 
-    // Configure timer wakeup
-    esp_sleep_enable_timer_wakeup(DEEP_SLEEP_DURATION_US);
+    if (period_s > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)period_s * 1000000ULL);
+    }
 
     // Enter deep sleep
     esp_deep_sleep_start();
@@ -60,17 +143,51 @@ static void enter_deep_sleep(void)
     // Never reaches here - device resets on wake
 }
 
+void sleep_manager_reset(void)
+{
+    atomic_store_explicit(&last_activity_time, now_ms(), memory_order_relaxed);
+    timer_wake = false;
+
+    // Fast path: nothing to do while already active
+    if (atomic_load_explicit(&state, memory_order_relaxed) == SLEEP_STATE_ACTIVE ||
+        !transition_lock) {
+        return;
+    }
+
+    xSemaphoreTake(transition_lock, portMAX_DELAY);
+    if (atomic_load(&state) == SLEEP_STATE_IDLE) {
+        enter_active();
+    }
+    xSemaphoreGive(transition_lock);
+}
+
+bool sleep_manager_is_sleeping(void)
+{
+    return atomic_load_explicit(&state, memory_order_relaxed) != SLEEP_STATE_ACTIVE;
+}
+
+sleep_state_t sleep_manager_get_state(void)
+{
+    return atomic_load_explicit(&state, memory_order_relaxed);
+}
+
 static void sleep_task(void *arg)
 {
     while (1) {
-        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        uint32_t inactive_time = now - last_activity_time;
+        uint32_t inactive_time = now_ms() - atomic_load_explicit(&last_activity_time,
+                                                                 memory_order_relaxed);
+        uint32_t deep_timeout = atomic_load(timer_wake ? &wake_window_ms : &deep_timeout_ms);
 
-        if (!is_sleeping && inactive_time >= INACTIVITY_TIMEOUT_MS) {
-            is_sleeping = true;
-            ESP_LOGI(TAG, "Entering sleep mode after %" PRIu32 " ms of inactivity", inactive_time);
+        xSemaphoreTake(transition_lock, portMAX_DELAY);
+        sleep_state_t current = atomic_load(&state);
+        if (ota_manager_is_in_progress() || ota_writer_is_active()) {
+            // Never doze off in the middle of an update
+        } else if (inactive_time >= deep_timeout && !ble_service_is_connected()) {
             enter_deep_sleep();
+        } else if (current == SLEEP_STATE_ACTIVE && inactive_time >= atomic_load(&idle_timeout_ms)) {
+            enter_idle(inactive_time);
         }
+        xSemaphoreGive(transition_lock);
 
         vTaskDelay(pdMS_TO_TICKS(100));
     }
@@ -80,31 +197,124 @@ bool sleep_manager_check_wake(void)
 {
     // Check if we woke from deep sleep timer
     if (woke_from_deep_sleep()) {
-        ESP_LOGI(TAG, "Woke from deep sleep - quick blink");
+        ESP_LOGI(TAG, "Woke from deep sleep");
 
-        // Initialize only LED GPIO (minimal init)
+        // Quick blink so a sleeping robot is still visibly alive
         led_init();
-
-        // Quick blink
         led_set_rgb(false, false, true);  // Blue
         vTaskDelay(pdMS_TO_TICKS(BLINK_DURATION_MS));
         led_set_rgb(false, false, false);
 
-        // Go back to sleep immediately
-        enter_deep_sleep();
-        // Never returns
+        timer_wake = true;
         return true;
     }
     return false;
 }
 
+static bool timeouts_valid(const sleep_manager_timeouts_t *timeouts)
+{
+    return timeouts->idle_timeout_ms >= SLEEP_IDLE_TIMEOUT_MIN_MS &&
+           timeouts->deep_timeout_ms > timeouts->idle_timeout_ms &&
+           (timeouts->wake_period_s == 0 || timeouts->wake_period_s >= SLEEP_WAKE_PERIOD_MIN_S) &&
+           timeouts->wake_window_ms >= SLEEP_WAKE_WINDOW_MIN_MS &&
+           timeouts->wake_window_ms <= SLEEP_WAKE_WINDOW_MAX_MS;
+}
+
+static void store_timeouts(const sleep_manager_timeouts_t *timeouts)
+{
+    atomic_store(&idle_timeout_ms, timeouts->idle_timeout_ms);
+    atomic_store(&deep_timeout_ms, timeouts->deep_timeout_ms);
+    atomic_store(&wake_period_s, timeouts->wake_period_s);
+    atomic_store(&wake_window_ms, timeouts->wake_window_ms);
+}
+
+static void load_timeouts(void)
+{
+    nvs_handle_t nvs_handle;
+    sleep_manager_timeouts_t stored;
+    size_t len = sizeof(stored);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    // Blobs from before the wake settings only hold the two timeouts
+    sleep_manager_get_timeouts(&stored);
+    if (nvs_get_blob(nvs_handle, NVS_KEY_TIMEOUTS, &stored, &len) == ESP_OK &&
+        (len == sizeof(stored) || len == 2 * sizeof(uint32_t)) &&
+        timeouts_valid(&stored)) {
+        store_timeouts(&stored);
+    }
+    nvs_close(nvs_handle);
+}
+
+esp_err_t sleep_manager_set_timeouts(const sleep_manager_timeouts_t *timeouts)
+{
+    if (!timeouts || !timeouts_valid(timeouts)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(nvs_handle, NVS_KEY_TIMEOUTS, timeouts, sizeof(*timeouts));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (ret == ESP_OK) {
+        store_timeouts(timeouts);
+        ESP_LOGI(TAG, "Timeouts: idle %" PRIu32 " ms, deep %" PRIu32 " ms, wake every %" PRIu32
+                 " s for %" PRIu32 " ms", timeouts->idle_timeout_ms, timeouts->deep_timeout_ms,
+                 timeouts->wake_period_s, timeouts->wake_window_ms);
+    }
+    return ret;
+}
+
+void sleep_manager_get_timeouts(sleep_manager_timeouts_t *timeouts)
+{
+    timeouts->idle_timeout_ms = atomic_load(&idle_timeout_ms);
+    timeouts->deep_timeout_ms = atomic_load(&deep_timeout_ms);
+    timeouts->wake_period_s = atomic_load(&wake_period_s);
+    timeouts->wake_window_ms = atomic_load(&wake_window_ms);
+}
+
 void sleep_manager_init(void)
 {
+    load_timeouts();
+    transition_lock = xSemaphoreCreateMutexStatic(&transition_lock_buf);
+
+#if CONFIG_PM_ENABLE
+    // Frequency scaling whenever no lock is held; automatic light sleep
+    // too, but the BT controller vetoes it while it runs off the main XTAL
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CPU_FREQ_MAX_MHZ,
+        .min_freq_mhz = CPU_FREQ_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    if (esp_pm_configure(&pm_config) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active_cpu", &cpu_lock) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "active_sleep", &no_sleep_lock) == ESP_OK) {
+        esp_pm_lock_acquire(cpu_lock);
+        esp_pm_lock_acquire(no_sleep_lock);
+    } else {
+        ESP_LOGW(TAG, "Power management unavailable, idle tier only slows advertising");
+        cpu_lock = NULL;
+    }
+#endif
+
     // Normal startup - initialize activity timer
-    last_activity_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    is_sleeping = false;
+    atomic_store(&last_activity_time, now_ms());
+    atomic_store(&state, SLEEP_STATE_ACTIVE);
 
-    xTaskCreate(sleep_task, "sleep_mgr", 2048, NULL, 3, NULL);
+    xTaskCreateStatic(sleep_task, "sleep_mgr", SLEEP_TASK_STACK, NULL, SLEEP_TASK_PRIORITY,
+                      sleep_task_stack, &sleep_task_buf);
 
-    ESP_LOGI(TAG, "Sleep manager initialized (timeout: %d ms)", INACTIVITY_TIMEOUT_MS);
+    ESP_LOGI(TAG, "Sleep manager initialized (idle %" PRIu32 " ms, deep %" PRIu32 " ms)",
+             atomic_load(&idle_timeout_ms), atomic_load(&deep_timeout_ms));
+    if (timer_wake) {
+        ESP_LOGI(TAG, "Timer wake - advertising for %" PRIu32 " ms", atomic_load(&wake_window_ms));
+    }
 }
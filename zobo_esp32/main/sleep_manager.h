@@ -1,24 +1,76 @@
 /**
  * Sleep Manager - Header
- * Handles power saving with light sleep after inactivity
+ *
+ * Tiered power saving:
+ *   ACTIVE - full speed, control loop running, fast advertising
+ *   IDLE   - CPU scaled down to 80 MHz and BT modem sleep between radio
+ *            events, control loop stopped, slow connectable advertising;
+ *            any command returns to ACTIVE within one advertising interval.
+ *            Not light sleep: without a 32 kHz crystal the BT controller
+ *            runs its sleep clock off the main XTAL and holds a
+ *            no-light-sleep lock while enabled. The ESP32 datasheet puts
+ *            modem sleep at 80 MHz at 20-31 mA plus BT activity, against
+ *            0.8 mA for light sleep (datasheet figures, not yet measured on
+ *            this board)
+ *   DEEP   - deep sleep after a much longer idle time, with optional
+ *            periodic timer wakes that advertise briefly before sleeping
+ *            again (period and window stored with the timeouts)
  */
 
 #ifndef SLEEP_MANAGER_H
 #define SLEEP_MANAGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Power tiers
+typedef enum {
+    SLEEP_STATE_ACTIVE,
+    SLEEP_STATE_IDLE,
+    SLEEP_STATE_DEEP,
+} sleep_state_t;
+
+// Timeouts, stored in NVS
+typedef struct {
+    uint32_t idle_timeout_ms;   // Inactivity before the idle tier
+    uint32_t deep_timeout_ms;   // Inactivity before deep sleep (not while connected)
+    uint32_t wake_period_s;     // Timer wake from deep sleep, 0 = sleep until reset
+    uint32_t wake_window_ms;    // Advertising after a timer wake before sleeping again
+} sleep_manager_timeouts_t;
+
+#define SLEEP_IDLE_TIMEOUT_DEFAULT_MS   15000
+#define SLEEP_DEEP_TIMEOUT_DEFAULT_MS   (10 * 60 * 1000)
+#define SLEEP_IDLE_TIMEOUT_MIN_MS       1000
+
+// Each timer wake is a cold boot plus the window at full power, so the
+// default keeps deep sleep under 1 % awake (~0.5 %)
+#define SLEEP_WAKE_PERIOD_DEFAULT_S     600
+#define SLEEP_WAKE_PERIOD_MIN_S         60
+#define SLEEP_WAKE_WINDOW_DEFAULT_MS    3000
+#define SLEEP_WAKE_WINDOW_MIN_MS        1000
+#define SLEEP_WAKE_WINDOW_MAX_MS        30000
 
 // Check if woke from deep sleep - call BEFORE other init!
-// Returns true if woke from sleep (will blink and sleep again)
+// Returns true on a timer wake; boot continues and the device advertises
+// for a short window before going back to deep sleep
 bool sleep_manager_check_wake(void);
 
 // Initialize sleep manager (call after other modules)
 void sleep_manager_init(void);
 
-// Reset inactivity timer (call on any activity)
+// Reset inactivity timer (call on any activity) - returns to ACTIVE
 void sleep_manager_reset(void);
 
-// Check if device is in sleep mode
+// Check if device is in a power-saving state
 bool sleep_manager_is_sleeping(void);
 
+// Current power tier
+sleep_state_t sleep_manager_get_state(void);
+
+// Set and persist timeouts (deep must be longer than idle, the wake window
+// in range and the wake period 0 or at least SLEEP_WAKE_PERIOD_MIN_S)
+esp_err_t sleep_manager_set_timeouts(const sleep_manager_timeouts_t *timeouts);
+void sleep_manager_get_timeouts(sleep_manager_timeouts_t *timeouts);
+
 #endif // SLEEP_MANAGER_H
@@ -0,0 +1,118 @@
+/**
+ * Telemetry Stream
+ */
+
+#include "telemetry.h"
+#include "ble_service.h"
+#include "motor.h"
+#include "control_loop.h"
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_log.h"
+
+static const char *TAG = "TELEM";
+
+#define RSSI_REFRESH_MS         1000
+
+static esp_timer_handle_t s_timer = NULL;
+static _Atomic uint8_t s_rate_hz = 0;
+
+// Timer task only
+static telemetry_frame_t s_frame;
+static uint16_t s_seq = 0;
+static int64_t s_last_rssi_us = 0;
+
+static void stop_stream(void)
+{
+    esp_timer_stop(s_timer);
+    atomic_store(&s_rate_hz, 0);
+}
+
+static void telemetry_timer_cb(void *arg)
+{
+    if (!ble_service_is_connected()) {
+        stop_stream();
+        ESP_LOGI(TAG, "Disconnected - stream stopped");
+        return;
+    }
+    if (!ble_service_telemetry_subscribed()) {
+        // CCCD write may still be on its way
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - s_last_rssi_us >= RSSI_REFRESH_MS * 1000LL) {
+        // Answer arrives on the GAP callback, picked up by a later frame
+        ble_service_read_rssi();
+        s_last_rssi_us = now_us;
+    }
+
+    motor_status_t status;
+    control_loop_stats_t loop;
+    motor_get_status(&status);
+    control_loop_get_stats(&loop);
+
+    s_frame.version = TELEMETRY_FRAME_VERSION;
+    s_frame.flags = (status.ramping ? TELEMETRY_FLAG_RAMPING : 0) |
+                    (status.latched ? TELEMETRY_FLAG_LATCHED : 0) |
+                    (status.closed_loop ? TELEMETRY_FLAG_CLOSED_LOOP : 0);
+    s_frame.seq = s_seq++;
+    s_frame.timestamp_ms = (uint32_t)(now_us / 1000);
+    s_frame.duty_left = status.speed.left;
+    s_frame.duty_right = status.speed.right;
+    s_frame.measured_left = status.measured.left;
+    s_frame.measured_right = status.measured.right;
+    s_frame.inactivity_ms = status.inactivity_ms;
+    s_frame.rssi = ble_service_get_rssi();
+    s_frame.free_heap = esp_get_free_heap_size();
+    s_frame.loop_jitter_us = loop.period_error_max > UINT16_MAX ?
+                             UINT16_MAX : (uint16_t)loop.period_error_max;
+
+    // Congested link: drop the frame, the seq gap tells the app
+    ble_service_telemetry_notify((const uint8_t *)&s_frame, sizeof(s_frame));
+}
+
+esp_err_t telemetry_set_rate(uint8_t hz)
+{
+    if (!s_timer) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (hz > TELEMETRY_RATE_MAX_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (hz > 0 && !ble_service_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(s_timer);
+    atomic_store(&s_rate_hz, hz);
+    if (hz > 0) {
+        s_seq = 0;
+        s_last_rssi_us = 0;
+        esp_err_t ret = esp_timer_start_periodic(s_timer, 1000000ULL / hz);
+        if (ret != ESP_OK) {
+            atomic_store(&s_rate_hz, 0);
+            return ret;
+        }
+    }
+    ESP_LOGI(TAG, "Rate %u Hz", hz);
+    return ESP_OK;
+}
+
+uint8_t telemetry_get_rate(void)
+{
+    return atomic_load(&s_rate_hz);
+}
+
+esp_err_t telemetry_init(void)
+{
+    memset(&s_frame, 0, sizeof(s_frame));
+
+    const esp_timer_create_args_t args = {
+        .callback = telemetry_timer_cb,
+        .name = "telemetry",
+    };
+    return esp_timer_create(&args, &s_timer);
+}
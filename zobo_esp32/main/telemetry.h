@@ -0,0 +1,48 @@
+/**
+ * Telemetry Stream - Header
+ *
+ * Fixed-layout binary status frames notified on their own characteristic
+ * (6e400005) at a rate the app chooses, so live state no longer has to be
+ * polled through text replies on the NUS TX characteristic.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define TELEMETRY_FRAME_VERSION     1
+#define TELEMETRY_RATE_MAX_HZ       50
+
+// Frame flags
+#define TELEMETRY_FLAG_RAMPING      0x01
+#define TELEMETRY_FLAG_LATCHED      0x02
+#define TELEMETRY_FLAG_CLOSED_LOOP  0x04
+
+// Wire format, little endian (25 bytes - needs more than the default 23
+// byte MTU, which every client negotiates on connect)
+typedef struct __attribute__((packed)) {
+    uint8_t version;            // TELEMETRY_FRAME_VERSION
+    uint8_t flags;              // TELEMETRY_FLAG_*
+    uint16_t seq;               // Increments per frame, gaps mean dropped notifications
+    uint32_t timestamp_ms;      // Since boot
+    int16_t duty_left;          // Commanded speed (-32767..32767)
+    int16_t duty_right;
+    int16_t measured_left;      // Encoder speed, zero when open loop
+    int16_t measured_right;
+    uint16_t inactivity_ms;     // Left before the drive watchdog steps in, 0 when not armed
+    int8_t rssi;                // dBm, 0 = unknown
+    uint32_t free_heap;
+    uint16_t loop_jitter_us;    // Worst control loop period error since stats reset
+} telemetry_frame_t;
+
+// Create the frame timer (stopped)
+esp_err_t telemetry_init(void);
+
+// Set the stream rate, 0 stops it. Frames only go out while the client is
+// subscribed; the stream stops by itself on disconnect
+esp_err_t telemetry_set_rate(uint8_t hz);
+uint8_t telemetry_get_rate(void);
+
+#endif // TELEMETRY_H
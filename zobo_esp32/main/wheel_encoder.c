@@ -0,0 +1,219 @@
+/**
+ * Wheel Encoder
+ *
+ * Each wheel uses one PCNT unit with two channels for 4x quadrature
+ * decoding. The unit accumulates across its hardware limit, so the count
+ * it returns is a free-running 32-bit value and deltas are taken with
+ * wrapping subtraction.
+ *
+ * The units are only enabled while closed loop wants counts and the
+ * robot is not idle: the glitch filter makes an enabled unit hold an
+ * APB_FREQ_MAX PM lock, which would keep the idle tier at full clock.
+ *
+ * A PCNT failure is returned, not fatal: the robot carries on open loop.
+ * Success only means the peripheral is set up - whether encoders are
+ * actually fitted shows once the wheels turn, and the control core drops
+ * closed loop when a driven wheel gives no counts.
+ */
+
+#include "wheel_encoder.h"
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/pulse_cnt.h"
+#include "esp_log.h"
+
+static const char *TAG = "ENCODER";
+
+#define ENCODER_PCNT_LIMIT      30000   // Hardware counter wraps here
+#define ENCODER_GLITCH_NS       1000    // Ignore pulses shorter than this (and the
+                                        // ~80 ns GPIO36/39 dips, see wheel_encoder.h)
+
+typedef struct {
+    pcnt_unit_handle_t unit;
+    int last_count;
+} encoder_t;
+
+static encoder_t s_left;
+static encoder_t s_right;
+static bool s_ready = false;
+
+// Wanted by closed loop (control task), vetoed while idle (sleep manager)
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+static bool s_wanted = false;
+static bool s_suspended = false;
+static atomic_bool s_running = false;
+
+static esp_err_t encoder_setup(encoder_t *enc, int pin_a, int pin_b)
+{
+    pcnt_unit_config_t unit_config = {
+        .low_limit = -ENCODER_PCNT_LIMIT,
+        .high_limit = ENCODER_PCNT_LIMIT,
+        .flags.accum_count = true,
+    };
+    esp_err_t ret = pcnt_new_unit(&unit_config, &enc->unit);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    pcnt_glitch_filter_config_t filter_config = {
+        .max_glitch_ns = ENCODER_GLITCH_NS,
+    };
+    pcnt_unit_set_glitch_filter(enc->unit, &filter_config);
+
+    // Channel A counts edges of A gated by B, channel B the reverse
+    pcnt_channel_handle_t chan_a, chan_b;
+    pcnt_chan_config_t chan_a_config = {
+        .edge_gpio_num = pin_a,
+        .level_gpio_num = pin_b,
+    };
+    pcnt_chan_config_t chan_b_config = {
+        .edge_gpio_num = pin_b,
+        .level_gpio_num = pin_a,
+    };
+    ret = pcnt_new_channel(enc->unit, &chan_a_config, &chan_a);
+    if (ret == ESP_OK) {
+        ret = pcnt_new_channel(enc->unit, &chan_b_config, &chan_b);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    pcnt_channel_set_edge_action(chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    pcnt_channel_set_level_action(chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+    pcnt_channel_set_edge_action(chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE);
+    pcnt_channel_set_level_action(chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+
+    // Watch points at the limits let the driver accumulate overflows
+    pcnt_unit_add_watch_point(enc->unit, ENCODER_PCNT_LIMIT);
+    pcnt_unit_add_watch_point(enc->unit, -ENCODER_PCNT_LIMIT);
+    return ESP_OK;
+}
+
+static esp_err_t encoder_start(encoder_t *enc)
+{
+    esp_err_t ret = pcnt_unit_enable(enc->unit);
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_clear_count(enc->unit);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_start(enc->unit);
+    }
+    enc->last_count = 0;
+    return ret;
+}
+
+static void encoder_stop(encoder_t *enc)
+{
+    pcnt_unit_stop(enc->unit);
+    pcnt_unit_disable(enc->unit);
+}
+
+// Start or stop both units to match the wanted state, s_lock held
+static void update_running(void)
+{
+    bool run = s_ready && s_wanted && !s_suspended;
+    if (run == atomic_load(&s_running)) {
+        return;
+    }
+
+    if (run) {
+        esp_err_t ret = encoder_start(&s_left);
+        if (ret == ESP_OK) {
+            ret = encoder_start(&s_right);
+        }
+        if (ret != ESP_OK) {
+            // Reads stay zero, the control core then falls back to open loop
+            ESP_LOGE(TAG, "PCNT start failed: %s", esp_err_to_name(ret));
+            encoder_stop(&s_left);
+            encoder_stop(&s_right);
+            return;
+        }
+    } else {
+        encoder_stop(&s_left);
+        encoder_stop(&s_right);
+    }
+    atomic_store(&s_running, run);
+    ESP_LOGI(TAG, "Wheel encoders %s", run ? "running" : "stopped");
+}
+
+esp_err_t wheel_encoder_init(void)
+{
+    if (s_ready) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = encoder_setup(&s_left, WHEEL_ENCODER_LEFT_A, WHEEL_ENCODER_LEFT_B);
+    if (ret == ESP_OK) {
+        ret = encoder_setup(&s_right, WHEEL_ENCODER_RIGHT_A, WHEEL_ENCODER_RIGHT_B);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "PCNT setup failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    s_ready = true;
+    ESP_LOGI(TAG, "Wheel encoders initialized");
+    return ESP_OK;
+}
+
+void wheel_encoder_enable(bool enable)
+{
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_wanted = enable;
+    update_running();
+    xSemaphoreGive(s_lock);
+}
+
+void wheel_encoder_suspend(bool suspend)
+{
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_suspended = suspend;
+    update_running();
+    xSemaphoreGive(s_lock);
+}
+
+bool wheel_encoder_is_ready(void)
+{
+    return s_ready;
+}
+
+static int32_t encoder_delta(encoder_t *enc)
+{
+    int count = 0;
+    pcnt_unit_get_count(enc->unit, &count);
+    int32_t delta = (int32_t)((uint32_t)count - (uint32_t)enc->last_count);
+    enc->last_count = count;
+    return delta;
+}
+
+void wheel_encoder_read_delta(int32_t *left, int32_t *right)
+{
+    if (!atomic_load_explicit(&s_running, memory_order_acquire)) {
+        *left = 0;
+        *right = 0;
+        return;
+    }
+    *left = encoder_delta(&s_left);
+    *right = encoder_delta(&s_right);
+}
+
+void wheel_encoder_get_total(int32_t *left, int32_t *right)
+{
+    int l = 0, r = 0;
+    if (atomic_load(&s_running)) {
+        pcnt_unit_get_count(s_left.unit, &l);
+        pcnt_unit_get_count(s_right.unit, &r);
+    }
+    *left = l;
+    *right = r;
+}
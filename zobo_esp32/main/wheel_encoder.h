@@ -0,0 +1,44 @@
+/**
+ * Wheel Encoder - Header
+ * Quadrature wheel encoders counted by the PCNT peripheral
+ */
+
+#ifndef WHEEL_ENCODER_H
+#define WHEEL_ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Encoder pins. GPIO34-39 are input only with no internal pull-ups, so
+// open-collector encoders need external pull-ups (10k to 3.3V) on all four
+// lines; floating inputs count noise. GPIO36/39 also dip low for ~80 ns
+// when the SAR ADCs or the Hall sensor power up (ESP32 errata); the PCNT
+// glitch filter rejects those
+#define WHEEL_ENCODER_LEFT_A    34
+#define WHEEL_ENCODER_LEFT_B    35
+#define WHEEL_ENCODER_RIGHT_A   36
+#define WHEEL_ENCODER_RIGHT_B   39
+
+// Set up both PCNT units in 4x quadrature mode. They stay disabled (no
+// PM lock held) until wheel_encoder_enable()
+esp_err_t wheel_encoder_init(void);
+
+// Count while closed loop needs it (control task) and not while the robot
+// is idle (sleep manager); the units run only when enabled and not
+// suspended. Counts restart from zero on every start
+void wheel_encoder_enable(bool enable);
+void wheel_encoder_suspend(bool suspend);
+
+// True once wheel_encoder_init() has succeeded. Says nothing about
+// whether encoders are fitted - see MOTOR_CORE_ENCODER_TIMEOUT_MS
+bool wheel_encoder_is_ready(void);
+
+// Counts since the previous call (positive = forward), 0 while stopped.
+// Allocation-free, meant to be called once per control tick
+void wheel_encoder_read_delta(int32_t *left, int32_t *right);
+
+// Total counts since the units last started
+void wheel_encoder_get_total(int32_t *left, int32_t *right);
+
+#endif // WHEEL_ENCODER_H
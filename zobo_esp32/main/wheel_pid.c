@@ -0,0 +1,45 @@
+/**
+ * Wheel PID
+ */
+
+#include "wheel_pid.h"
+
+static inline int32_t clamp(int32_t v, int32_t limit)
+{
+    return (v > limit) ? limit : (v < -limit) ? -limit : v;
+}
+
+static inline int32_t clamp_gain(int32_t gain)
+{
+    return (gain < 0) ? 0 : (gain > WHEEL_PID_GAIN_MAX) ? WHEEL_PID_GAIN_MAX : gain;
+}
+
+void wheel_pid_init(wheel_pid_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t limit)
+{
+    pid->kp = clamp_gain(kp);
+    pid->ki = clamp_gain(ki);
+    pid->kd = clamp_gain(kd);
+    pid->limit = limit;
+    wheel_pid_reset(pid);
+}
+
+void wheel_pid_reset(wheel_pid_t *pid)
+{
+    pid->integral = 0;
+    pid->prev_error = 0;
+}
+
+int32_t wheel_pid_update(wheel_pid_t *pid, int32_t error)
+{
+    // Error is at most 2 * MOTOR_SPEED_MAX, so each gain * error term fits
+    error = clamp(error, 65534);
+
+    // Anti-windup: the integral alone can never exceed the output limit
+    pid->integral = clamp(pid->integral + pid->ki * error, pid->limit << 8);
+
+    int32_t p = pid->kp * error;
+    int32_t d = pid->kd * (error - pid->prev_error);
+    pid->prev_error = error;
+
+    return clamp((p >> 8) + (pid->integral >> 8) + (d >> 8), pid->limit);
+}
@@ -0,0 +1,35 @@
+/**
+ * Wheel PID - Header
+ *
+ * Fixed-point PI(D) controller for wheel speed. Gains are Q8 (256 = 1.0),
+ * error and output are Q15 speeds. No allocation, no floats, safe to run
+ * from the control loop at any rate.
+ */
+
+#ifndef WHEEL_PID_H
+#define WHEEL_PID_H
+
+#include <stdint.h>
+
+#define WHEEL_PID_GAIN_ONE      256
+#define WHEEL_PID_GAIN_MAX      (32 * WHEEL_PID_GAIN_ONE)   // Keeps gain * error within 32 bits
+
+typedef struct {
+    int32_t kp;             // Q8 gains, 0..WHEEL_PID_GAIN_MAX
+    int32_t ki;             // Per tick
+    int32_t kd;             // Per tick
+    int32_t limit;          // Output clamp (symmetric, Q15)
+    int32_t integral;       // Sum of ki * error, Q8 output units
+    int32_t prev_error;
+} wheel_pid_t;
+
+// Set gains and output limit, clearing the controller state
+void wheel_pid_init(wheel_pid_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t limit);
+
+// Clear integral and derivative history
+void wheel_pid_reset(wheel_pid_t *pid);
+
+// Run one step on a Q15 error - returns the clamped Q15 correction
+int32_t wheel_pid_update(wheel_pid_t *pid, int32_t error);
+
+#endif // WHEEL_PID_H
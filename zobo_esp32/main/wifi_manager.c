@@ -1,12 +1,17 @@
 /**
  * WiFi Manager Module
+ * One task owns the connection: it starts the driver, picks cached or
+ * scanning attempts, backs off between failures and pushes every status
+ * change to the registered callback. Callers only post requests.
  */
 
 #include "wifi_manager.h"
 #include "led.h"
 #include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -14,6 +19,7 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 
 static const char *TAG = "WIFI";
 
@@ -21,76 +27,139 @@ static const char *TAG = "WIFI";
 #define NVS_NAMESPACE       "wifi_creds"
 #define NVS_KEY_SSID        "ssid"
 #define NVS_KEY_PASSWORD    "password"
+#define NVS_KEY_FAST        "fast"
+
+// Connect timing
+#define WIFI_FAST_TIMEOUT_MS    3000    // Cached AP on its known channel, then fall back to a scan
+#define WIFI_CONNECT_TIMEOUT_MS 30000
+
+// Backoff between failed scanning attempts: 1 s, 2 s, 4 s ... 32 s, then
+// give up (status FAILED) until the next connect request
+#define WIFI_BACKOFF_BASE_MS    1000
+#define WIFI_BACKOFF_MAX_MS     32000
+#define WIFI_MAX_ATTEMPTS       8
+
+// Reuse the cached lease as a static IP instead of asking DHCP. Saves the
+// DHCP exchange, but only safe where the address is reserved for the
+// robot. With DHCP, lwIP's last-IP restore already skips DISCOVER/OFFER
+#define WIFI_FAST_STATIC_IP     0
+
+// Owner task
+#define WIFI_TASK_STACK         3072
+#define WIFI_TASK_PRIORITY      4
+#define WIFI_QUEUE_LEN          8
 
 // Event group bits
 #define WIFI_CONNECTED_BIT  BIT0
 #define WIFI_FAIL_BIT       BIT1
 
+// Requests and driver events, all handled on the owner task
+typedef enum {
+    WIFI_EV_CONNECT,
+    WIFI_EV_DISCONNECT,
+    WIFI_EV_STA_START,
+    WIFI_EV_STA_CONNECTED,
+    WIFI_EV_STA_DISCONNECTED,
+    WIFI_EV_GOT_IP,
+} wifi_event_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t reason;         // WIFI_EV_STA_DISCONNECTED
+} wifi_mgr_event_t;
+
+// Connection state machine
+typedef enum {
+    WIFI_STATE_IDLE,        // Not wanted (or given up)
+    WIFI_STATE_FAST,        // Cached AP attempt
+    WIFI_STATE_SCAN,        // All channel attempt
+    WIFI_STATE_BACKOFF,     // Waiting before the next attempt
+    WIFI_STATE_CONNECTED,
+} wifi_state_t;
+
 // State
 static EventGroupHandle_t s_wifi_event_group = NULL;
-static wifi_status_t s_wifi_status = WIFI_STATUS_DISCONNECTED;
+static QueueHandle_t s_queue = NULL;
+static StaticEventGroup_t s_wifi_event_group_buf;
+static StaticQueue_t s_queue_buf;
+static uint8_t s_queue_storage[WIFI_QUEUE_LEN * sizeof(wifi_mgr_event_t)];
+static StaticTask_t s_task_buf;
+static StackType_t s_task_stack[WIFI_TASK_STACK];
+static volatile wifi_status_t s_wifi_status = WIFI_STATUS_DISCONNECTED;
+static wifi_status_callback_t s_status_callback = NULL;
 static char s_ip_addr[16] = "";
 static char s_ssid[33] = "";
 static char s_password[65] = "";
 static bool s_initialized = false;
-static int s_retry_count = 0;
-#define MAX_RETRY 5
 
-// Event handler
+// Owner task only
+static wifi_state_t s_state = WIFI_STATE_IDLE;
+static bool s_stack_started = false;   // netif/event loop/WiFi driver, brought up on demand
+static bool s_driver_started = false;
+static esp_netif_t *s_netif = NULL;
+static int64_t s_deadline_us = 0;       // Attempt timeout / backoff end, 0 = none
+static int64_t s_start_us = 0;
+static int s_attempts = 0;
+static uint32_t s_connect_ms = 0;
+static bool s_static_ip = false;        // Cached lease applied, DHCP client stopped
+
+// Last successful connection, reused for a single channel connect
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_fast_cache_t;
+
+static wifi_fast_cache_t s_cache;
+static bool s_cache_valid = false;
+
+static void post(wifi_event_type_t type, uint8_t reason)
+{
+    wifi_mgr_event_t ev = { .type = type, .reason = reason };
+    if (xQueueSend(s_queue, &ev, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full, dropped %d", type);
+    }
+}
+
+// Driver events (default event loop task) - forwarded to the owner task
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG, "WiFi STA started, connecting...");
-        esp_wifi_connect();
+        post(WIFI_EV_STA_START, 0);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        post(WIFI_EV_STA_CONNECTED, 0);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         wifi_event_sta_disconnected_t *disconn = (wifi_event_sta_disconnected_t *)event_data;
-        ESP_LOGW(TAG, "Disconnected! Reason: %d", disconn->reason);
-        // Common reasons: 2=AUTH_EXPIRE, 15=4WAY_HANDSHAKE_TIMEOUT, 201=NO_AP_FOUND, 202=AUTH_FAIL
-        if (disconn->reason == 201) {
-            ESP_LOGE(TAG, "Reason 201: AP not found - check SSID or signal strength");
-        } else if (disconn->reason == 202 || disconn->reason == 15) {
-            ESP_LOGE(TAG, "Reason %d: Authentication failed - check password", disconn->reason);
-        }
-
-        if (s_retry_count < MAX_RETRY) {
-            esp_wifi_connect();
-            s_retry_count++;
-            ESP_LOGI(TAG, "Retrying connection... (%d/%d)", s_retry_count, MAX_RETRY);
-        } else {
-            s_wifi_status = WIFI_STATUS_FAILED;
-            if (s_wifi_event_group) {
-                xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-            }
-        }
-        s_ip_addr[0] = '\0';
+        post(WIFI_EV_STA_DISCONNECTED, disconn->reason);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         snprintf(s_ip_addr, sizeof(s_ip_addr), IPSTR, IP2STR(&event->ip_info.ip));
-        ESP_LOGI(TAG, "Connected! IP: %s", s_ip_addr);
-        s_retry_count = 0;
-        s_wifi_status = WIFI_STATUS_CONNECTED;
-        if (s_wifi_event_group) {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        }
-        led_indicate_wifi_connected();
+        post(WIFI_EV_GOT_IP, 0);
     }
 }
 
-esp_err_t wifi_manager_init(void)
+// Bring up netif and the WiFi driver the first time WiFi is actually used;
+// this keeps ~100 ms and a good chunk of RAM off the boot path
+static void start_stack(void)
 {
-    if (s_initialized) {
-        return ESP_OK;
+    if (s_stack_started) {
+        return;
     }
 
     // Initialize TCP/IP stack
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_netif = esp_netif_create_default_wifi_sta();
 
     // Initialize WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
     // Register event handlers
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
@@ -98,8 +167,317 @@ esp_err_t wifi_manager_init(void)
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
                     IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
 
-    // Create event group
-    s_wifi_event_group = xEventGroupCreate();
+    s_stack_started = true;
+    ESP_LOGI(TAG, "WiFi stack started");
+}
+
+static void notify(void)
+{
+    if (s_status_callback) {
+        s_status_callback(s_wifi_status);
+    }
+}
+
+static void set_status(wifi_status_t status)
+{
+    if (s_wifi_status != status) {
+        s_wifi_status = status;
+        notify();
+    }
+}
+
+static void load_cache(void)
+{
+    nvs_handle_t nvs_handle;
+    size_t len = sizeof(s_cache);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    s_cache_valid = nvs_get_blob(nvs_handle, NVS_KEY_FAST, &s_cache, &len) == ESP_OK &&
+                    len == sizeof(s_cache) && s_cache.channel != 0;
+    nvs_close(nvs_handle);
+}
+
+// Remember the AP and lease we just got; only written when they change
+static void save_cache(void)
+{
+    wifi_fast_cache_t cache = { 0 };
+    wifi_ap_record_t ap;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK ||
+        esp_netif_get_ip_info(s_netif, &ip_info) != ESP_OK) {
+        return;
+    }
+    strlcpy(cache.ssid, s_ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+    cache.ip = ip_info.ip.addr;
+    cache.netmask = ip_info.netmask.addr;
+    cache.gw = ip_info.gw.addr;
+    if (esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        cache.dns = dns.ip.u_addr.ip4.addr;
+    }
+
+    if (s_cache_valid && memcmp(&cache, &s_cache, sizeof(cache)) == 0) {
+        return;
+    }
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs_handle, NVS_KEY_FAST, &cache, sizeof(cache)) == ESP_OK &&
+        nvs_commit(nvs_handle) == ESP_OK) {
+        s_cache = cache;
+        s_cache_valid = true;
+    }
+    nvs_close(nvs_handle);
+}
+
+// Kick off one connection attempt, either straight to the cached AP or
+// with a full scan. The outcome arrives as driver events
+static void start_attempt(bool fast)
+{
+    wifi_config_t wifi_config = {0};
+    strncpy((char *)wifi_config.sta.ssid, s_ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char *)wifi_config.sta.password, s_password, sizeof(wifi_config.sta.password));
+
+    // Auto-detect authentication mode
+    if (strlen(s_password) == 0) {
+        wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
+    } else {
+        wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK;
+    }
+
+    if (fast) {
+        // Probe a single channel for the known BSSID
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = s_cache.channel;
+        ESP_LOGI(TAG, "Connecting to %s on channel %d (cached)...", s_ssid, s_cache.channel);
+    } else {
+        // Enable scan for all channels (helps with coexistence)
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+        ESP_LOGI(TAG, "Connecting to %s (attempt %d)...", s_ssid, s_attempts + 1);
+    }
+
+    bool static_ip = fast && WIFI_FAST_STATIC_IP && s_cache.ip != 0;
+    if (static_ip && !s_static_ip) {
+        esp_netif_dhcpc_stop(s_netif);
+    } else if (!static_ip && s_static_ip) {
+        esp_netif_dhcpc_start(s_netif);
+    }
+    s_static_ip = static_ip;
+
+    s_state = fast ? WIFI_STATE_FAST : WIFI_STATE_SCAN;
+    s_deadline_us = esp_timer_get_time() +
+                    (int64_t)(fast ? WIFI_FAST_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS) * 1000;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+
+    // The driver stays up between attempts; STA_START connects the first time
+    if (!s_driver_started) {
+        ESP_ERROR_CHECK(esp_wifi_start());
+        s_driver_started = true;
+    } else {
+        esp_wifi_connect();
+    }
+}
+
+// A scanning attempt failed - wait before the next one, or give up
+static void schedule_retry(void)
+{
+    s_attempts++;
+    if (s_attempts >= WIFI_MAX_ATTEMPTS) {
+        ESP_LOGE(TAG, "Failed to connect to %s after %d attempts", s_ssid, s_attempts);
+        s_state = WIFI_STATE_IDLE;
+        s_deadline_us = 0;
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        led_indicate_wifi_stopped();
+        set_status(WIFI_STATUS_FAILED);
+        return;
+    }
+
+    uint32_t delay_ms = WIFI_BACKOFF_BASE_MS << (s_attempts - 1);
+    if (delay_ms > WIFI_BACKOFF_MAX_MS) {
+        delay_ms = WIFI_BACKOFF_MAX_MS;
+    }
+    ESP_LOGI(TAG, "Retrying in %" PRIu32 " ms", delay_ms);
+    s_state = WIFI_STATE_BACKOFF;
+    s_deadline_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+}
+
+// Start a fresh connection cycle (request, or the link dropped)
+static void begin_connect(void)
+{
+    start_stack();
+    s_attempts = 0;
+    s_start_us = esp_timer_get_time();
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    set_status(WIFI_STATUS_CONNECTING);
+    led_indicate_wifi_connecting();
+    start_attempt(s_cache_valid && strcmp(s_cache.ssid, s_ssid) == 0);
+}
+
+static void on_disconnected(uint8_t reason)
+{
+    // Our own esp_wifi_disconnect() after a timeout
+    if (reason == WIFI_REASON_ASSOC_LEAVE && s_state != WIFI_STATE_CONNECTED) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "Disconnected! Reason: %d", reason);
+    // Common reasons: 2=AUTH_EXPIRE, 15=4WAY_HANDSHAKE_TIMEOUT, 201=NO_AP_FOUND, 202=AUTH_FAIL
+    if (reason == 201) {
+        ESP_LOGE(TAG, "Reason 201: AP not found - check SSID or signal strength");
+    } else if (reason == 202 || reason == 15) {
+        ESP_LOGE(TAG, "Reason %d: Authentication failed - check password", reason);
+    }
+
+    switch (s_state) {
+        case WIFI_STATE_FAST:
+            // Cached AP gone or moved - scan right away
+            ESP_LOGW(TAG, "Cached AP not reachable, scanning");
+            start_attempt(false);
+            break;
+        case WIFI_STATE_SCAN:
+            schedule_retry();
+            break;
+        case WIFI_STATE_CONNECTED:
+            s_ip_addr[0] = '\0';
+            begin_connect();
+            break;
+        default:
+            break;
+    }
+}
+
+static void on_timeout(void)
+{
+    s_deadline_us = 0;
+    switch (s_state) {
+        case WIFI_STATE_FAST:
+            ESP_LOGW(TAG, "Cached AP not answering, scanning");
+            esp_wifi_disconnect();
+            start_attempt(false);
+            break;
+        case WIFI_STATE_SCAN:
+            ESP_LOGE(TAG, "Connection timeout");
+            esp_wifi_disconnect();
+            schedule_retry();
+            break;
+        case WIFI_STATE_BACKOFF:
+            start_attempt(false);
+            break;
+        default:
+            break;
+    }
+}
+
+static void handle_event(const wifi_mgr_event_t *ev)
+{
+    switch (ev->type) {
+        case WIFI_EV_CONNECT:
+            if (s_state == WIFI_STATE_IDLE) {
+                begin_connect();
+            } else if (s_state == WIFI_STATE_BACKOFF) {
+                start_attempt(false);       // Asked again - don't make them wait
+                notify();
+            } else {
+                if (s_state == WIFI_STATE_CONNECTED) {
+                    xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+                }
+                notify();                   // Already on it, report where we are
+            }
+            break;
+
+        case WIFI_EV_DISCONNECT:
+            s_state = WIFI_STATE_IDLE;
+            s_deadline_us = 0;
+            if (s_driver_started) {
+                esp_wifi_disconnect();
+                esp_wifi_stop();
+                s_driver_started = false;
+                ESP_LOGI(TAG, "Disconnected");
+            }
+            s_ip_addr[0] = '\0';
+            xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            led_indicate_wifi_stopped();
+            s_wifi_status = WIFI_STATUS_DISCONNECTED;
+            notify();
+            break;
+
+        case WIFI_EV_STA_START:
+            if (s_state == WIFI_STATE_FAST || s_state == WIFI_STATE_SCAN) {
+                ESP_LOGI(TAG, "WiFi STA started, connecting...");
+                esp_wifi_connect();
+            }
+            break;
+
+        case WIFI_EV_STA_CONNECTED:
+            if (s_static_ip) {
+                // Posts IP_EVENT_STA_GOT_IP right away, no DHCP round trips
+                esp_netif_ip_info_t ip_info = {
+                    .ip = { s_cache.ip }, .netmask = { s_cache.netmask }, .gw = { s_cache.gw },
+                };
+                esp_netif_dns_info_t dns = { 0 };
+                dns.ip.u_addr.ip4.addr = s_cache.dns;
+                esp_netif_set_ip_info(s_netif, &ip_info);
+                esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+            }
+            break;
+
+        case WIFI_EV_STA_DISCONNECTED:
+            on_disconnected(ev->reason);
+            break;
+
+        case WIFI_EV_GOT_IP: {
+            if (s_state != WIFI_STATE_FAST && s_state != WIFI_STATE_SCAN) {
+                break;
+            }
+            bool cached = s_state == WIFI_STATE_FAST;
+            s_state = WIFI_STATE_CONNECTED;
+            s_deadline_us = 0;
+            s_connect_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+            ESP_LOGI(TAG, "Connected! IP: %s in %" PRIu32 " ms (%s)",
+                     s_ip_addr, s_connect_ms, cached ? "cached" : "scan");
+            save_cache();
+            xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            led_indicate_wifi_connected();
+            set_status(WIFI_STATUS_CONNECTED);
+            break;
+        }
+    }
+}
+
+static void wifi_task(void *arg)
+{
+    wifi_mgr_event_t ev;
+
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (s_deadline_us) {
+            int64_t remaining_us = s_deadline_us - esp_timer_get_time();
+            wait = remaining_us > 0 ? pdMS_TO_TICKS(remaining_us / 1000) + 1 : 0;
+        }
+
+        if (xQueueReceive(s_queue, &ev, wait) == pdTRUE) {
+            handle_event(&ev);
+        } else if (s_deadline_us) {
+            on_timeout();
+        }
+    }
+}
+
+esp_err_t wifi_manager_init(void)
+{
+    if (s_initialized) {
+        return ESP_OK;
+    }
 
     // Load credentials from NVS
     nvs_handle_t nvs_handle;
@@ -113,12 +491,25 @@ esp_err_t wifi_manager_init(void)
         }
         nvs_close(nvs_handle);
     }
+    load_cache();
+
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buf);
+    s_queue = xQueueCreateStatic(WIFI_QUEUE_LEN, sizeof(wifi_mgr_event_t), s_queue_storage, &s_queue_buf);
+    if (!xTaskCreateStatic(wifi_task, "wifi_mgr", WIFI_TASK_STACK, NULL, WIFI_TASK_PRIORITY,
+                           s_task_stack, &s_task_buf)) {
+        return ESP_ERR_NO_MEM;
+    }
 
     s_initialized = true;
     ESP_LOGI(TAG, "WiFi manager initialized");
     return ESP_OK;
 }
 
+void wifi_manager_set_status_callback(wifi_status_callback_t callback)
+{
+    s_status_callback = callback;
+}
+
 esp_err_t wifi_manager_set_credentials(const char *ssid, const char *password)
 {
     if (!ssid || strlen(ssid) == 0) {
@@ -159,62 +550,40 @@ bool wifi_manager_has_credentials(void)
 esp_err_t wifi_manager_connect(void)
 {
     if (!s_initialized) {
-        wifi_manager_init();
+        return ESP_ERR_INVALID_STATE;
     }
-
     if (!wifi_manager_has_credentials()) {
         ESP_LOGW(TAG, "No WiFi credentials stored");
         return ESP_ERR_NOT_FOUND;
     }
+    // Neither a stale give-up nor a connection that has already dropped
+    // (event not handled yet) may end a wait that starts now. The request
+    // sets WIFI_CONNECTED_BIT again if the link is still up
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    post(WIFI_EV_CONNECT, 0);
+    return ESP_OK;
+}
 
-    s_wifi_status = WIFI_STATUS_CONNECTING;
-    s_retry_count = 0;
-    led_indicate_wifi_connecting();
-
-    wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, s_ssid, sizeof(wifi_config.sta.ssid));
-    strncpy((char *)wifi_config.sta.password, s_password, sizeof(wifi_config.sta.password));
-
-    // Auto-detect authentication mode
-    if (strlen(s_password) == 0) {
-        wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
-    } else {
-        wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK;
+esp_err_t wifi_manager_wait_connected(TickType_t timeout)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
     }
-
-    // Enable scan for all channels (helps with coexistence)
-    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
-    wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
-
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-
-    ESP_LOGI(TAG, "Connecting to %s...", s_ssid);
-
-    // Wait for connection
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
                                            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(30000));
-
+                                           pdFALSE, pdFALSE, timeout);
     if (bits & WIFI_CONNECTED_BIT) {
         return ESP_OK;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGE(TAG, "Failed to connect to %s", s_ssid);
-        return ESP_FAIL;
     }
-
-    ESP_LOGE(TAG, "Connection timeout");
-    return ESP_ERR_TIMEOUT;
+    return (bits & WIFI_FAIL_BIT) ? ESP_FAIL : ESP_ERR_TIMEOUT;
 }
 
 esp_err_t wifi_manager_disconnect(void)
 {
-    esp_wifi_disconnect();
-    esp_wifi_stop();
-    s_wifi_status = WIFI_STATUS_DISCONNECTED;
-    s_ip_addr[0] = '\0';
-    ESP_LOGI(TAG, "Disconnected");
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    post(WIFI_EV_DISCONNECT, 0);
     return ESP_OK;
 }
 
@@ -228,6 +597,11 @@ const char* wifi_manager_get_ip(void)
     return s_ip_addr;
 }
 
+uint32_t wifi_manager_get_connect_time_ms(void)
+{
+    return s_connect_ms;
+}
+
 esp_err_t wifi_manager_clear_credentials(void)
 {
     nvs_handle_t nvs_handle;
@@ -239,6 +613,7 @@ esp_err_t wifi_manager_clear_credentials(void)
     }
     s_ssid[0] = '\0';
     s_password[0] = '\0';
+    s_cache_valid = false;      // Erased along with the credentials
     ESP_LOGI(TAG, "Credentials cleared");
     return ret;
 }
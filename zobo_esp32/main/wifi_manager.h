@@ -1,13 +1,16 @@
 /**
  * WiFi Manager Module - Header
- * Handles WiFi connection and credentials storage in NVS
+ * Handles WiFi connection and credentials storage in NVS. Connecting is
+ * asynchronous; status changes are pushed to the status callback
  */
 
 #ifndef WIFI_MANAGER_H
 #define WIFI_MANAGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 
 // WiFi status
 typedef enum {
@@ -17,19 +20,34 @@ typedef enum {
     WIFI_STATUS_FAILED
 } wifi_status_t;
 
-// Initialize WiFi manager (loads credentials from NVS if available)
+// Status change callback, called from the WiFi manager task
+typedef void (*wifi_status_callback_t)(wifi_status_t status);
+
+// Initialize WiFi manager (loads credentials from NVS if available) and
+// start its task. The network stack itself starts on the first connect
 esp_err_t wifi_manager_init(void);
 
+// Set the status change callback. Each connect/disconnect request is
+// answered with at least one call
+void wifi_manager_set_status_callback(wifi_status_callback_t callback);
+
 // Set WiFi credentials and save to NVS
 esp_err_t wifi_manager_set_credentials(const char *ssid, const char *password);
 
 // Check if credentials are stored
 bool wifi_manager_has_credentials(void);
 
-// Connect to WiFi using stored credentials
+// Request a connection with the stored credentials and return. Goes
+// straight to the AP and channel of the last connection first, then
+// scans, backing off between failed attempts. A dropped link reconnects
+// the same way. ESP_ERR_NOT_FOUND without credentials
 esp_err_t wifi_manager_connect(void);
 
-// Disconnect from WiFi
+// Block until connected (ESP_OK), given up / disconnected (ESP_FAIL) or
+// timeout (ESP_ERR_TIMEOUT)
+esp_err_t wifi_manager_wait_connected(TickType_t timeout);
+
+// Disconnect from WiFi and stop reconnecting
 esp_err_t wifi_manager_disconnect(void);
 
 // Get current WiFi status
@@ -38,6 +56,9 @@ wifi_status_t wifi_manager_get_status(void);
 // Get current IP address (returns empty string if not connected)
 const char* wifi_manager_get_ip(void);
 
+// Duration of the last successful connect, request to IP (ms)
+uint32_t wifi_manager_get_connect_time_ms(void);
+
 // Clear stored credentials
 esp_err_t wifi_manager_clear_credentials(void);
 
@@ -7,8 +7,12 @@ Usage:
   python monitor.py           # Use default COM9
   python monitor.py COM5      # Use specific port
   python monitor.py --list    # List available ports
+  python monitor.py --latency # Only show latency reports (send BLE 0x65 to trigger)
+  python monitor.py --evlog   # Only show event log records (send BLE 0x74 0x02 to dump)
 """
 
+import os
+import re
 import sys
 import time
 
@@ -38,7 +42,88 @@ def list_ports():
         print(f"  {port.device}: {port.description}")
     print()
 
-def monitor(port):
+LAT_SUMMARY_RE = re.compile(r"LAT:(\w+):n=(\d+),p50=(\d+),p99=(\d+),max=(\d+)")
+LAT_HIST_RE = re.compile(r"LATH:(\w+):([\d=,]*)")
+HIST_BAR_WIDTH = 40
+
+def print_latency_summary(match):
+    """Print one LAT: summary line as a table row."""
+    span, count, p50, p99, peak = match.groups()
+    print(f"  {span:<16} n={count:>7}  p50={p50:>7} us  p99={p99:>7} us  max={peak:>7} us")
+
+def print_latency_histogram(span, buckets):
+    """Render collected LATH: buckets as a text histogram."""
+    if not buckets:
+        return
+    print(f"\n  {span} (us, bucket upper bound)")
+    peak = max(buckets.values())
+    for upper in sorted(buckets):
+        count = buckets[upper]
+        bar = "#" * max(1, count * HIST_BAR_WIDTH // peak)
+        print(f"  {upper:>9} | {bar} {count}")
+
+class LatencyReport:
+    """Collects LATH: lines per span until a different line arrives."""
+
+    def __init__(self):
+        self.span = None
+        self.buckets = {}
+
+    def feed(self, line):
+        match = LAT_HIST_RE.search(line)
+        if not match:
+            self.flush()
+            return False
+        span, pairs = match.groups()
+        if span != self.span:
+            self.flush()
+            self.span = span
+        for pair in filter(None, pairs.split(",")):
+            upper, count = pair.split("=")
+            self.buckets[int(upper)] = self.buckets.get(int(upper), 0) + int(count)
+        return True
+
+    def flush(self):
+        if self.span:
+            print_latency_histogram(self.span, self.buckets)
+        self.span = None
+        self.buckets = {}
+
+EVLOG_EVENTS_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "main", "evlog_events.h")
+EVLOG_EVENT_RE = re.compile(r'^EVLOG_EVENT\((\w+),\s*EVLOG_MOD_(\w+),\s*"(.*)"\)', re.MULTILINE)
+EVLOG_RECORD_RE = re.compile(r"EVL:([0-9a-f]{8}):([0-9a-f]{4}):(\d):([0-9a-f]{8}):([0-9a-f]{8})")
+EVLOG_CONVERSION_RE = re.compile(r"%[-+ 0#]*\d*([diouxX])")
+
+def load_evlog_events():
+    """Event id -> (name, module, format) from the firmware's event table."""
+    try:
+        with open(EVLOG_EVENTS_FILE) as f:
+            return EVLOG_EVENT_RE.findall(f.read())
+    except OSError:
+        print(f"Warning: {EVLOG_EVENTS_FILE} not found, EVL: records shown raw")
+        return []
+
+def format_evlog(match, events):
+    """Resolve one EVL: record against the event table."""
+    time_us, event, core, arg0, arg1 = match.groups()
+    event = int(event, 16)
+    args = [int(arg0, 16), int(arg1, 16)]
+    if event >= len(events):
+        return f"  {int(time_us, 16) / 1000:>12.3f} ms  core {core}  event {event} args {args[0]:#x} {args[1]:#x}"
+
+    name, module, fmt = events[event]
+    # Args travel as u32 - reinterpret the ones printed as signed
+    conversions = EVLOG_CONVERSION_RE.findall(fmt)
+    values = []
+    for conv, value in zip(conversions, args):
+        values.append(value - (1 << 32) if conv in "di" and value >= 1 << 31 else value)
+    try:
+        text = fmt % tuple(values)
+    except (TypeError, ValueError):
+        text = f"{fmt} {args}"
+    return f"  {int(time_us, 16) / 1000:>12.3f} ms  core {core}  {module.lower():<6} {text}"
+
+def monitor(port, latency_only=False, evlog_only=False):
     """Start serial monitor."""
     print(f"\n{'='*60}")
     print(f"  ESP32 Serial Monitor - {port} @ {BAUD_RATE} baud")
@@ -48,12 +133,26 @@ def monitor(port):
     try:
         ser = serial.Serial(port, BAUD_RATE, timeout=1)
         ser.flushInput()
+        report = LatencyReport()
+        events = load_evlog_events()
 
         while True:
             if ser.in_waiting:
                 try:
                     line = ser.readline().decode('utf-8', errors='replace')
-                    print(line, end='')
+                    if report.feed(line):
+                        continue
+                    record = EVLOG_RECORD_RE.search(line)
+                    if record:
+                        if not latency_only:
+                            print(format_evlog(record, events))
+                        continue
+                    summary = LAT_SUMMARY_RE.search(line)
+                    if summary:
+                        if not evlog_only:
+                            print_latency_summary(summary)
+                    elif not latency_only and not evlog_only:
+                        print(line, end='')
                 except:
                     pass
             else:
@@ -82,10 +181,14 @@ def main():
         print(__doc__)
         return
 
+    latency_only = "--latency" in args
+    evlog_only = "--evlog" in args
+    args = [a for a in args if not a.startswith("--")]
+
     # Get port from args or use default
     port = args[0] if args else DEFAULT_PORT
 
-    monitor(port)
+    monitor(port, latency_only, evlog_only)
 
 if __name__ == "__main__":
     main()
@@ -4,8 +4,9 @@ GitHub Release Script for Zobo ESP32 Firmware
 
 This script:
 1. Builds the firmware
-2. Creates version.json
-3. Creates a GitHub release with the firmware binary
+2. Creates the compressed (and optionally delta) OTA images
+3. Creates version.json
+4. Creates a GitHub release with the firmware binary
 
 Requirements:
 - GitHub CLI (gh) must be installed and authenticated
@@ -15,14 +16,18 @@ Usage:
     python release.py              # Create release with current version
     python release.py --draft      # Create draft release
     python release.py --prerelease # Mark as pre-release
+    python release.py --base old/zobo_esp32.bin  # Also build a delta from a previous release
 """
 
 import argparse
+import hashlib
 import json
 import os
 import re
+import struct
 import subprocess
 import sys
+import zlib
 from datetime import datetime
 from pathlib import Path
 
@@ -32,6 +37,19 @@ OTA_MANAGER_H = SCRIPT_DIR / "main" / "ota_manager.h"
 BUILD_DIR = SCRIPT_DIR / "build"
 FIRMWARE_BIN = BUILD_DIR / "zobo_esp32.bin"
 VERSION_JSON = BUILD_DIR / "version.json"
+COMPRESSED_BIN = BUILD_DIR / "zobo_esp32.zota"
+
+# ZOTA container, must match main/ota_image.h
+ZOTA_MAGIC = b"ZOTA"
+ZOTA_VERSION = 1
+ZOTA_FLAG_DEFLATE = 0x01
+ZOTA_FLAG_DELTA = 0x02
+ZOTA_WINDOW_BITS = 14       # Device allocates 1 << bits for the inflate window
+DELTA_OP_END = 0x00
+DELTA_OP_COPY = 0x01
+DELTA_OP_ADD = 0x02
+DELTA_BLOCK = 32            # Shortest match worth a COPY
+DELTA_STRIDE = 4            # Base index granularity
 
 
 def get_firmware_version():
@@ -100,7 +118,7 @@ def run_command(cmd, cwd=None, shell=False):
 
 def build_firmware():
     """Build the firmware using ESP-IDF."""
-    print("\n[1/4] Building firmware...")
+    print("\n[1/5] Building firmware...")
 
     idf_path = find_esp_idf()
     if not idf_path:
@@ -139,15 +157,18 @@ def build_firmware():
     return True
 
 
-def create_version_json(version):
+def create_version_json(version, images):
     """Create version.json file."""
-    print("\n[2/4] Creating version.json...")
+    print("\n[3/5] Creating version.json...")
 
     version_data = {
         "version": version,
         "size": FIRMWARE_BIN.stat().st_size,
         "date": datetime.now().strftime("%Y-%m-%d %H:%M:%S"),
-        "url": f"https://github.com/DavidPetrov2023/Zobo/releases/download/v{version}/zobo_esp32.bin"
+        "url": f"https://github.com/DavidPetrov2023/Zobo/releases/download/v{version}/zobo_esp32.bin",
+        # File names next to zobo_esp32.bin; deltas keyed by the IMAGE: id the robot reports
+        "compressed": images["compressed"],
+        "deltas": images["deltas"],
     }
 
     VERSION_JSON.write_text(json.dumps(version_data, indent=2))
@@ -156,9 +177,96 @@ def create_version_json(version):
     return True
 
 
+def image_sha256(data):
+    """Hash the device reports for an image (the appended SHA-256)."""
+    digest = data[-32:]
+    if hashlib.sha256(data[:-32]).digest() != digest:
+        return None
+    return digest
+
+
+def make_delta(base, target):
+    """Greedy COPY/ADD patch rebuilding target from base."""
+    index = {}
+    for off in range(0, len(base) - DELTA_BLOCK + 1, DELTA_STRIDE):
+        index.setdefault(base[off:off + DELTA_BLOCK], off)
+
+    patch = bytearray()
+
+    def add(data):
+        if data:
+            patch.extend(struct.pack("<BI", DELTA_OP_ADD, len(data)))
+            patch.extend(data)
+
+    literal_start = 0
+    pos = 0
+    while pos + DELTA_BLOCK <= len(target):
+        src = index.get(target[pos:pos + DELTA_BLOCK])
+        if src is None:
+            pos += 1
+            continue
+
+        # Grow the match both ways
+        start, src_start = pos, src
+        while start > literal_start and src_start > 0 and target[start - 1] == base[src_start - 1]:
+            start -= 1
+            src_start -= 1
+        end, src_end = pos + DELTA_BLOCK, src + DELTA_BLOCK
+        while end < len(target) and src_end < len(base) and target[end] == base[src_end]:
+            end += 1
+            src_end += 1
+
+        add(target[literal_start:start])
+        patch.extend(struct.pack("<BII", DELTA_OP_COPY, src_start, end - start))
+        pos = literal_start = end
+
+    add(target[literal_start:])
+    patch.append(DELTA_OP_END)
+    return bytes(patch)
+
+
+def make_container(payload, image_size, flags, base_sha=bytes(32)):
+    """Wrap a payload in a ZOTA header, deflating it if requested."""
+    if flags & ZOTA_FLAG_DEFLATE:
+        compressor = zlib.compressobj(9, zlib.DEFLATED, ZOTA_WINDOW_BITS)
+        payload = compressor.compress(payload) + compressor.flush()
+    header = struct.pack("<4sBBBBI32s", ZOTA_MAGIC, ZOTA_VERSION, flags,
+                         ZOTA_WINDOW_BITS, 0, image_size, base_sha)
+    return header + payload
+
+
+def create_ota_images(base_path=None):
+    """Create the compressed image and, given a base, a delta patch."""
+    print("\n[2/5] Creating OTA images...")
+
+    target = FIRMWARE_BIN.read_bytes()
+    images = {"compressed": COMPRESSED_BIN.name, "deltas": {}}
+
+    COMPRESSED_BIN.write_bytes(make_container(target, len(target), ZOTA_FLAG_DEFLATE))
+    ratio = COMPRESSED_BIN.stat().st_size * 100 / len(target)
+    print(f"  Compressed: {COMPRESSED_BIN.name} ({COMPRESSED_BIN.stat().st_size / 1024:.1f} KB, {ratio:.0f}%)")
+
+    if base_path:
+        base = Path(base_path).read_bytes()
+        base_sha = image_sha256(base)
+        if not base_sha:
+            print(f"  ERROR: {base_path} has no appended SHA-256, cannot build delta")
+            return None
+        base_id = base_sha[:8].hex()
+        delta_bin = BUILD_DIR / f"zobo_esp32-{base_id}.zota"
+        patch = make_delta(base, target)
+        delta_bin.write_bytes(make_container(patch, len(target),
+                                             ZOTA_FLAG_DEFLATE | ZOTA_FLAG_DELTA, base_sha))
+        ratio = delta_bin.stat().st_size * 100 / len(target)
+        print(f"  Delta from {base_id}: {delta_bin.name} ({delta_bin.stat().st_size / 1024:.1f} KB, {ratio:.0f}%)")
+        images["deltas"][base_id] = delta_bin.name
+
+    return images
+
+
 def check_gh_cli():
     """Check if GitHub CLI is installed and authenticated."""
-    print("\n[3/4] Checking GitHub CLI...")
+    print("\n[4/5] Checking GitHub CLI...")
 
     # Check if gh is installed
     try:
@@ -183,9 +291,9 @@ def check_gh_cli():
     return True
 
 
-def create_release(version, draft=False, prerelease=False):
+def create_release(version, images, draft=False, prerelease=False):
     """Create GitHub release with firmware files."""
-    print("\n[4/4] Creating GitHub release...")
+    print("\n[5/5] Creating GitHub release...")
 
     tag = f"v{version}"
     title = f"Firmware {version}"
@@ -196,6 +304,8 @@ def create_release(version, draft=False, prerelease=False):
 
 ### Files
 - `zobo_esp32.bin` - Firmware binary for OTA update
+- `zobo_esp32.zota` - Compressed firmware for OTA update
+- `zobo_esp32-<image>.zota` - Delta update from an earlier image (if present)
 - `version.json` - Version metadata
 
 ### OTA Update
@@ -208,6 +318,8 @@ The app will automatically detect this update when connected to the robot.
         "--title", title,
         "--notes", notes,
         str(FIRMWARE_BIN),
+        str(BUILD_DIR / images["compressed"]),
+        *[str(BUILD_DIR / name) for name in images["deltas"].values()],
         str(VERSION_JSON)
     ]
 
@@ -236,6 +348,7 @@ def main():
     parser.add_argument("--draft", action="store_true", help="Create as draft release")
     parser.add_argument("--prerelease", action="store_true", help="Mark as pre-release")
     parser.add_argument("--skip-build", action="store_true", help="Skip firmware build")
+    parser.add_argument("--base", metavar="BIN", help="Previous zobo_esp32.bin to build a delta update from")
     args = parser.parse_args()
 
     print("=" * 60)
@@ -255,13 +368,18 @@ def main():
         if not build_firmware():
             return 1
     else:
-        print("\n[1/4] Skipping build...")
+        print("\n[1/5] Skipping build...")
         if not FIRMWARE_BIN.exists():
             print(f"  ERROR: Firmware binary not found at {FIRMWARE_BIN}")
             return 1
 
+    # Create compressed / delta images
+    images = create_ota_images(args.base)
+    if images is None:
+        return 1
+
     # Create version.json
-    if not create_version_json(version):
+    if not create_version_json(version, images):
         return 1
 
     # Check GitHub CLI
@@ -269,7 +387,7 @@ def main():
         return 1
 
     # Create release
-    if not create_release(version, args.draft, args.prerelease):
+    if not create_release(version, images, args.draft, args.prerelease):
         return 1
 
     print("\n" + "=" * 60)
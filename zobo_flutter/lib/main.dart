@@ -5,6 +5,7 @@ import 'package:permission_handler/permission_handler.dart';
 import 'services/ble_service.dart';
 import 'widgets/hold_repeat_button.dart';
 import 'pages/settings_page.dart';
+import 'pages/fleet_page.dart';
 
 const bool kDebugMode = bool.fromEnvironment('DEBUG_MODE', defaultValue: false);
 
@@ -151,6 +152,19 @@ class _HomePageState extends State<HomePage> {
             onPressed: () => _showAboutDialog(context),
             tooltip: 'About',
           ),
+          IconButton(
+            icon: const Icon(Icons.groups),
+            // Fleet mode holds its own links, free the single robot first
+            onPressed: _isConnected
+                ? null
+                : () {
+                    Navigator.push(
+                      context,
+                      MaterialPageRoute(builder: (context) => const FleetPage()),
+                    );
+                  },
+            tooltip: 'Fleet',
+          ),
           IconButton(
             icon: const Icon(Icons.settings),
             onPressed: _isConnected
@@ -366,7 +380,7 @@ class _HomePageState extends State<HomePage> {
                 text: "Forward",
                 icon: Icons.arrow_upward,
                 enabled: _isConnected,
-                repeatMs: 100,
+                repeatMs: 200,
                 onRepeat: () => _bleService.sendCommand(RobotCommand.moveForward),
                 onRelease: () => _bleService.sendCommand(RobotCommand.moveStop),
                 width: 80,
@@ -382,7 +396,7 @@ class _HomePageState extends State<HomePage> {
                 text: "Left",
                 icon: Icons.arrow_back,
                 enabled: _isConnected,
-                repeatMs: 100,
+                repeatMs: 200,
                 onRepeat: () => _bleService.sendCommand(RobotCommand.moveLeft),
                 onRelease: () => _bleService.sendCommand(RobotCommand.moveStop),
                 width: 80,
@@ -393,7 +407,7 @@ class _HomePageState extends State<HomePage> {
                 text: "Stop",
                 icon: Icons.stop,
                 enabled: _isConnected,
-                repeatMs: 100,
+                repeatMs: 200,
                 onRepeat: () => _bleService.sendCommand(RobotCommand.moveStop),
                 width: 80,
                 height: 60,
@@ -403,7 +417,7 @@ class _HomePageState extends State<HomePage> {
                 text: "Right",
                 icon: Icons.arrow_forward,
                 enabled: _isConnected,
-                repeatMs: 100,
+                repeatMs: 200,
                 onRepeat: () => _bleService.sendCommand(RobotCommand.moveRight),
                 onRelease: () => _bleService.sendCommand(RobotCommand.moveStop),
                 width: 80,
@@ -419,7 +433,7 @@ class _HomePageState extends State<HomePage> {
                 text: "Backward",
                 icon: Icons.arrow_downward,
                 enabled: _isConnected,
-                repeatMs: 100,
+                repeatMs: 200,
                 onRepeat: () => _bleService.sendCommand(RobotCommand.moveBackward),
                 onRelease: () => _bleService.sendCommand(RobotCommand.moveStop),
                 width: 80,
@@ -0,0 +1,252 @@
+import 'dart:async';
+import 'package:flutter/material.dart';
+import '../services/fleet_service.dart';
+import '../widgets/hold_repeat_button.dart';
+
+// Drive every connected robot in step, see FleetService
+class FleetPage extends StatefulWidget {
+  const FleetPage({super.key});
+
+  @override
+  State<FleetPage> createState() => _FleetPageState();
+}
+
+class _FleetPageState extends State<FleetPage> {
+  static const int _driveSpeed = 20000;
+  static const int _turnSpeed = 14000;
+
+  final FleetService _fleet = FleetService();
+
+  List<FleetRobot> _robots = [];
+  bool _isScanning = false;
+  int _group = FleetCommands.groupAll;
+
+  StreamSubscription? _robotsSubscription;
+  StreamSubscription? _scanSubscription;
+
+  @override
+  void initState() {
+    super.initState();
+    _robotsSubscription = _fleet.robots.listen((robots) {
+      setState(() => _robots = robots);
+    });
+    _scanSubscription = _fleet.isScanning.listen((scanning) {
+      setState(() => _isScanning = scanning);
+    });
+  }
+
+  @override
+  void dispose() {
+    _robotsSubscription?.cancel();
+    _scanSubscription?.cancel();
+    // Let the stop frame go out before the links are torn down
+    _fleet.stopAll().whenComplete(() {
+      _fleet.disconnectAll();
+      _fleet.dispose();
+    });
+    super.dispose();
+  }
+
+  bool get _canDrive => _robots.any((r) => r.connected);
+
+  void _drive(int left, int right) {
+    _fleet.sendGroupDrive(left, right, group: _group);
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return Scaffold(
+      appBar: AppBar(
+        title: const Text('Fleet'),
+        backgroundColor: Theme.of(context).colorScheme.inversePrimary,
+        actions: [
+          IconButton(
+            icon: const Icon(Icons.sync),
+            onPressed: _canDrive ? () => _fleet.syncAll() : null,
+            tooltip: 'Resync clocks',
+          ),
+        ],
+      ),
+      body: SafeArea(
+        child: Padding(
+          padding: const EdgeInsets.all(16.0),
+          child: Column(
+            crossAxisAlignment: CrossAxisAlignment.stretch,
+            children: [
+              Row(
+                children: [
+                  Expanded(
+                    child: ElevatedButton.icon(
+                      onPressed: _isScanning ? null : () => _fleet.startScan(),
+                      icon: _isScanning
+                          ? const SizedBox(
+                              width: 16,
+                              height: 16,
+                              child: CircularProgressIndicator(strokeWidth: 2),
+                            )
+                          : const Icon(Icons.bluetooth_searching),
+                      label: Text(_isScanning ? "Scanning..." : "Find Robots"),
+                    ),
+                  ),
+                  const SizedBox(width: 8),
+                  Expanded(
+                    child: ElevatedButton.icon(
+                      onPressed: _robots.isEmpty ? null : () => _fleet.disconnectAll(),
+                      icon: const Icon(Icons.bluetooth_disabled),
+                      label: const Text("Disconnect All"),
+                    ),
+                  ),
+                ],
+              ),
+              const SizedBox(height: 8),
+              Row(
+                children: [
+                  const Text("Group"),
+                  const SizedBox(width: 12),
+                  DropdownButton<int>(
+                    value: _group,
+                    items: [
+                      for (int g = 0; g <= 4; g++)
+                        DropdownMenuItem(value: g, child: Text(g == FleetCommands.groupAll ? "All" : "$g")),
+                    ],
+                    onChanged: (g) => setState(() => _group = g ?? FleetCommands.groupAll),
+                  ),
+                  const Spacer(),
+                  Text("Lead ${_fleet.leadMs} ms", style: const TextStyle(color: Colors.grey)),
+                ],
+              ),
+              const SizedBox(height: 8),
+              Expanded(child: _buildRobotList()),
+              const SizedBox(height: 16),
+              _buildDPad(),
+            ],
+          ),
+        ),
+      ),
+    );
+  }
+
+  Widget _buildRobotList() {
+    if (_robots.isEmpty) {
+      return const Center(child: Text("No robots, tap Find Robots"));
+    }
+
+    return ListView.separated(
+      itemCount: _robots.length,
+      separatorBuilder: (_, __) => const Divider(height: 1),
+      itemBuilder: (context, index) {
+        final robot = _robots[index];
+        final String subtitle;
+        if (!robot.connected) {
+          subtitle = "Connecting...";
+        } else if (!robot.synced) {
+          subtitle = "Syncing clock...";
+        } else {
+          subtitle = "Offset ${robot.offsetMs} ms, rtt ${robot.rttMs} ms";
+        }
+
+        return ListTile(
+          dense: true,
+          leading: Icon(
+            robot.synced ? Icons.check_circle : Icons.hourglass_empty,
+            color: robot.synced ? Colors.green : Colors.orange,
+          ),
+          title: Text(robot.name),
+          subtitle: Text(subtitle),
+          trailing: PopupMenuButton<int>(
+            tooltip: 'Set robot group',
+            enabled: robot.connected,
+            onSelected: (g) => _fleet.setGroup(robot.id, g),
+            itemBuilder: (context) => [
+              for (int g = 0; g <= 4; g++)
+                PopupMenuItem(value: g, child: Text(g == FleetCommands.groupAll ? "No group" : "Group $g")),
+            ],
+          ),
+        );
+      },
+    );
+  }
+
+  Widget _buildDPad() {
+    // Drive frames at 10 Hz keep every robot's drive watchdog fed
+    return Container(
+      padding: const EdgeInsets.all(16),
+      decoration: BoxDecoration(
+        color: Theme.of(context).colorScheme.surfaceContainerHighest,
+        borderRadius: BorderRadius.circular(16),
+      ),
+      child: Column(
+        children: [
+          Row(
+            mainAxisAlignment: MainAxisAlignment.center,
+            children: [
+              HoldRepeatButton(
+                text: "Forward",
+                icon: Icons.arrow_upward,
+                enabled: _canDrive,
+                repeatMs: 100,
+                onRepeat: () => _drive(_driveSpeed, _driveSpeed),
+                onRelease: () => _drive(0, 0),
+                width: 80,
+                height: 60,
+              ),
+            ],
+          ),
+          const SizedBox(height: 8),
+          Row(
+            mainAxisAlignment: MainAxisAlignment.center,
+            children: [
+              HoldRepeatButton(
+                text: "Left",
+                icon: Icons.arrow_back,
+                enabled: _canDrive,
+                repeatMs: 100,
+                onRepeat: () => _drive(-_turnSpeed, _turnSpeed),
+                onRelease: () => _drive(0, 0),
+                width: 80,
+                height: 60,
+              ),
+              const SizedBox(width: 8),
+              HoldRepeatButton(
+                text: "Stop",
+                icon: Icons.stop,
+                enabled: _canDrive,
+                repeatMs: 200,
+                onRepeat: () => _drive(0, 0),
+                width: 80,
+                height: 60,
+              ),
+              const SizedBox(width: 8),
+              HoldRepeatButton(
+                text: "Right",
+                icon: Icons.arrow_forward,
+                enabled: _canDrive,
+                repeatMs: 100,
+                onRepeat: () => _drive(_turnSpeed, -_turnSpeed),
+                onRelease: () => _drive(0, 0),
+                width: 80,
+                height: 60,
+              ),
+            ],
+          ),
+          const SizedBox(height: 8),
+          Row(
+            mainAxisAlignment: MainAxisAlignment.center,
+            children: [
+              HoldRepeatButton(
+                text: "Backward",
+                icon: Icons.arrow_downward,
+                enabled: _canDrive,
+                repeatMs: 100,
+                onRepeat: () => _drive(-_driveSpeed, -_driveSpeed),
+                onRelease: () => _drive(0, 0),
+                width: 80,
+                height: 60,
+              ),
+            ],
+          ),
+        ],
+      ),
+    );
+  }
+}
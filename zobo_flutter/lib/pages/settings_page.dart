@@ -41,6 +41,10 @@ class _SettingsPageState extends State<SettingsPage> {
   String? _serverDate;
   bool _updateAvailable = false;
   bool _checkingUpdate = false;
+  Map<String, dynamic>? _serverInfo;
+
+  // Running image id reported by the robot (IMAGE:), null on older firmware
+  String? _imageId;
 
   StreamSubscription<String>? _responseSubscription;
 
@@ -71,7 +75,8 @@ class _SettingsPageState extends State<SettingsPage> {
           _updateAvailable = _serverVersion != null &&
               _serverVersion != _firmwareVersion &&
               _firmwareVersion != 'Unknown';
-          _otaUrlController.text = '$otaServerBase/zobo_esp32.bin';
+          _serverInfo = data;
+          _selectOtaUrl();
         });
       }
     } catch (e) {
@@ -82,6 +87,23 @@ class _SettingsPageState extends State<SettingsPage> {
     }
   }
 
+  /// Pick the smallest image the robot can take: a delta built against its
+  /// running image, else the compressed image. Firmware that doesn't report
+  /// IMAGE: predates compressed images and gets the plain binary.
+  void _selectOtaUrl() {
+    String file = 'zobo_esp32.bin';
+    final info = _serverInfo;
+    if (info != null && _imageId != null) {
+      final deltas = info['deltas'];
+      if (deltas is Map && deltas[_imageId] is String) {
+        file = deltas[_imageId];
+      } else if (info['compressed'] is String) {
+        file = info['compressed'];
+      }
+    }
+    _otaUrlController.text = '$otaServerBase/$file';
+  }
+
   Future<void> _loadSavedCredentials() async {
     final prefs = await SharedPreferences.getInstance();
     setState(() {
@@ -129,6 +151,11 @@ class _SettingsPageState extends State<SettingsPage> {
             _firmwareVersion = versionMatch.group(1) ?? _firmwareVersion;
           }
         }
+      } else if (response.startsWith('IMAGE:')) {
+        _imageId = response.substring(6);
+        if (_serverInfo != null) {
+          _selectOtaUrl();
+        }
       } else if (response.startsWith('OTA:')) {
         final parts = response.substring(4).split(':');
         if (parts.length >= 2) {
@@ -281,7 +308,8 @@ class _SettingsPageState extends State<SettingsPage> {
             ],
             const Text(
               'The device will download and install the firmware. '
-              'Make sure the device is connected to WiFi and has stable power.',
+              'Make sure the device is connected to WiFi and has stable power. '
+              'Without WiFi, choose Via Bluetooth to send it from this phone (slower).',
             ),
           ],
         ),
@@ -290,6 +318,13 @@ class _SettingsPageState extends State<SettingsPage> {
             onPressed: () => Navigator.pop(ctx),
             child: const Text('Cancel'),
           ),
+          TextButton(
+            onPressed: () {
+              Navigator.pop(ctx);
+              _installViaBluetooth(_otaUrlController.text);
+            },
+            child: const Text('Via Bluetooth'),
+          ),
           TextButton(
             onPressed: () {
               Navigator.pop(ctx);
@@ -310,6 +345,33 @@ class _SettingsPageState extends State<SettingsPage> {
     );
   }
 
+  // Download the image on the phone and push it over BLE - for robots
+  // without WiFi. Progress and result come back as OTA: responses
+  Future<void> _installViaBluetooth(String url) async {
+    setState(() {
+      _isUpdating = true;
+      _otaProgress = 0;
+      _otaStatus = 'Downloading firmware...';
+    });
+
+    try {
+      final response = await http.get(Uri.parse(url)).timeout(const Duration(seconds: 60));
+      if (response.statusCode != 200) {
+        throw Exception('HTTP ${response.statusCode}');
+      }
+      if (!mounted) return;
+      setState(() => _otaStatus = 'Sending over Bluetooth...');
+      await widget.bleService.pushFirmware(response.bodyBytes);
+    } catch (e) {
+      if (mounted) {
+        setState(() {
+          _isUpdating = false;
+          _otaStatus = 'Bluetooth update failed: $e';
+        });
+      }
+    }
+  }
+
   void _showUpdateCompleteDialog() {
     showDialog(
       context: context,
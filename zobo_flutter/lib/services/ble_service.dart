@@ -1,5 +1,7 @@
 import 'dart:async';
 import 'dart:convert';
+import 'dart:math';
+import 'dart:typed_data';
 import 'package:flutter_reactive_ble/flutter_reactive_ble.dart';
 
 enum RobotCommand {
@@ -28,7 +30,142 @@ class ExtendedCommands {
   static const int otaCheck = 0x61;
   static const int getVersion = 0x62;
   static const int getInfo = 0x63;
+  static const int getMemory = 0x66;  // Heap and stack headroom, replies MEM: and STACK:
+  static const int connParams = 0x67;  // Connection parameters, replies CONN:
+  static const int bleOta = 0x68;  // Firmware over BLE, see BleOta
   static const int ping = 0x70;  // Keepalive ping
+  static const int setAckMode = 0x71;
+  static const int telemetry = 0x72;  // Telemetry rate, replies TELEM:
+  static const int watchdog = 0x7A;  // Drive watchdog timing, replies WDOG:
+  static const int otaPipeline = 0x7B;  // OTA download buffer sizes, replies OTAPIPE:
+  static const int fleet = 0x81;  // Fleet clock sync, see FleetService
+  static const int fleetGroup = 0x82;  // Fleet group id, replies FLEET:group=
+}
+
+// BLE firmware transfer (ble_ota.h on the robot)
+class BleOta {
+  static const int begin = 0x01;
+  static const int end = 0x02;
+  static const int abort = 0x03;
+
+  // Notifications on the OTA characteristic
+  static const int ack = 0x01;
+  static const int nack = 0x02;
+
+  static const Duration ackTimeout = Duration(seconds: 1);
+  static const Duration stallTimeout = Duration(seconds: 10);
+}
+
+// Acknowledgement modes negotiated with CMD_SET_ACK_MODE
+enum AckMode {
+  legacy(0),      // "OK" after every command
+  none(1),
+  perSequence(2), // "ACK:<seq>" per binary frame
+  cumulative(3);  // "ACK:<last seq>:<count>" every interval
+
+  final int value;
+  const AckMode(this.value);
+}
+
+// Signed wheel setpoint, -32767..32767 (positive = forward)
+class MotorSetpoint {
+  final int left;
+  final int right;
+  const MotorSetpoint(this.left, this.right);
+}
+
+// Binary drive frame, see zobo_esp32/main/motor_frame.h
+class MotorFrame {
+  static const int opcode = 0x80;
+  static const int version = 1;
+  static const int flagTimestamp = 0x01;
+  static const int flagGroup = 0x02;
+  static const int maxSetpoints = 32;
+  static const int speedMax = 32767;
+
+  // applyAtMs makes it a fleet group frame (see FleetService): group 0
+  // reaches every robot, applyAtMs is on the clock the robots synced to
+  static Uint8List encode(List<MotorSetpoint> setpoints, int seq,
+      {int intervalMs = 0, int? timestampMs, int group = 0, int? applyAtMs}) {
+    final count = setpoints.length.clamp(1, maxSetpoints);
+    final hasTimestamp = timestampMs != null;
+    final hasGroup = applyAtMs != null;
+    final data = ByteData(8 + (hasTimestamp ? 4 : 0) + (hasGroup ? 5 : 0) + count * 4);
+    data.setUint8(0, opcode);
+    data.setUint8(1, version);
+    data.setUint8(2, (hasTimestamp ? flagTimestamp : 0) | (hasGroup ? flagGroup : 0));
+    data.setUint8(3, count);
+    data.setUint16(4, seq & 0xFFFF, Endian.little);
+    data.setUint16(6, intervalMs, Endian.little);
+    var offset = 8;
+    if (hasTimestamp) {
+      data.setUint32(offset, timestampMs & 0xFFFFFFFF, Endian.little);
+      offset += 4;
+    }
+    if (hasGroup) {
+      data.setUint8(offset, group);
+      data.setUint32(offset + 1, applyAtMs & 0xFFFFFFFF, Endian.little);
+      offset += 5;
+    }
+    for (var i = 0; i < count; i++) {
+      data.setInt16(offset, setpoints[i].left.clamp(-speedMax, speedMax), Endian.little);
+      data.setInt16(offset + 2, setpoints[i].right.clamp(-speedMax, speedMax), Endian.little);
+      offset += 4;
+    }
+    return data.buffer.asUint8List();
+  }
+}
+
+// Binary telemetry frame, see zobo_esp32/main/telemetry.h
+class TelemetryFrame {
+  static const int version = 1;
+  static const int length = 25;
+  static const int flagRamping = 0x01;
+  static const int flagLatched = 0x02;
+  static const int flagClosedLoop = 0x04;
+
+  final int flags;
+  final int seq;
+  final int timestampMs;
+  final MotorSetpoint duty;
+  final MotorSetpoint measured;
+  final int inactivityMs;
+  final int rssi;           // dBm, 0 = unknown
+  final int freeHeap;
+  final int loopJitterUs;
+
+  const TelemetryFrame({
+    required this.flags,
+    required this.seq,
+    required this.timestampMs,
+    required this.duty,
+    required this.measured,
+    required this.inactivityMs,
+    required this.rssi,
+    required this.freeHeap,
+    required this.loopJitterUs,
+  });
+
+  bool get ramping => flags & flagRamping != 0;
+  bool get latched => flags & flagLatched != 0;
+  bool get closedLoop => flags & flagClosedLoop != 0;
+
+  // Null for frames of another version or a truncated notification
+  static TelemetryFrame? decode(List<int> bytes) {
+    if (bytes.length < length || bytes[0] != version) return null;
+    final data = ByteData.sublistView(Uint8List.fromList(bytes));
+    return TelemetryFrame(
+      flags: data.getUint8(1),
+      seq: data.getUint16(2, Endian.little),
+      timestampMs: data.getUint32(4, Endian.little),
+      duty: MotorSetpoint(data.getInt16(8, Endian.little), data.getInt16(10, Endian.little)),
+      measured: MotorSetpoint(data.getInt16(12, Endian.little), data.getInt16(14, Endian.little)),
+      inactivityMs: data.getUint16(16, Endian.little),
+      rssi: data.getInt8(18),
+      freeHeap: data.getUint32(19, Endian.little),
+      loopJitterUs: data.getUint16(23, Endian.little),
+    );
+  }
 }
 
 class BleService {
@@ -37,6 +174,8 @@ class BleService {
   static final Uuid uartServiceUuid = Uuid.parse("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
   static final Uuid uartRxUuid = Uuid.parse("6e400002-b5a3-f393-e0a9-e50e24dcca9e");
   static final Uuid uartTxUuid = Uuid.parse("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+  static final Uuid uartOtaUuid = Uuid.parse("6e400004-b5a3-f393-e0a9-e50e24dcca9e");
+  static final Uuid telemetryUuid = Uuid.parse("6e400005-b5a3-f393-e0a9-e50e24dcca9e");
 
   final FlutterReactiveBle _ble = FlutterReactiveBle();
 
@@ -44,6 +183,7 @@ class BleService {
   StreamSubscription? _scanSubscription;
   StreamSubscription? _connectionSubscription;
   StreamSubscription? _notificationSubscription;
+  StreamSubscription? _telemetrySubscription;
   Timer? _keepaliveTimer;
 
   final _isScanning = StreamController<bool>.broadcast();
@@ -51,18 +191,21 @@ class BleService {
   final _deviceName = StreamController<String?>.broadcast();
   final _logMessages = StreamController<String>.broadcast();
   final _responses = StreamController<String>.broadcast();
+  final _telemetry = StreamController<TelemetryFrame>.broadcast();
 
   Stream<bool> get isScanning => _isScanning.stream;
   Stream<bool> get isConnected => _isConnected.stream;
   Stream<String?> get deviceNameStream => _deviceName.stream;
   Stream<String> get logMessages => _logMessages.stream;
   Stream<String> get responses => _responses.stream;
+  Stream<TelemetryFrame> get telemetry => _telemetry.stream;
 
   bool _connected = false;
   bool _scanning = false;
   String? _connectedDeviceName;
 
   QualifiedCharacteristic? _rxCharacteristic;
+  int _frameSeq = 0;
 
   Future<void> startScan() async {
     if (_scanning || _connected) return;
@@ -157,9 +300,12 @@ class BleService {
       );
 
       _notificationSubscription = _ble.subscribeToCharacteristic(txCharacteristic).listen((data) {
-        final text = utf8.decode(data);
-        _addLog("RX", text);
-        _responses.add(text);
+        // Several status strings may be coalesced into one notification
+        for (final text in utf8.decode(data).split('\n')) {
+          if (text.isEmpty) continue;
+          _addLog("RX", text);
+          _responses.add(text);
+        }
       }, onError: (e) {
         _addLog("Error", "Notification error: $e");
       });
@@ -192,6 +338,8 @@ class BleService {
   Future<void> disconnect() async {
     _stopKeepalive();
     _notificationSubscription?.cancel();
+    _telemetrySubscription?.cancel();
+    _telemetrySubscription = null;
     _connectionSubscription?.cancel();
 
     _deviceId = null;
@@ -221,6 +369,24 @@ class BleService {
     }
   }
 
+  // Send a single drive setpoint as a binary frame (write without response)
+  Future<void> sendDrive(int left, int right) async {
+    await sendSetpoints([MotorSetpoint(left, right)]);
+  }
+
+  // Send a batch of setpoints played back on the robot every intervalMs
+  Future<void> sendSetpoints(List<MotorSetpoint> setpoints, {int intervalMs = 0}) async {
+    if (_rxCharacteristic == null || !_connected || setpoints.isEmpty) return;
+
+    final frame = MotorFrame.encode(setpoints, _frameSeq, intervalMs: intervalMs);
+    _frameSeq = (_frameSeq + 1) & 0xFFFF;
+    try {
+      await _ble.writeCharacteristicWithoutResponse(_rxCharacteristic!, value: frame);
+    } catch (e) {
+      _addLog("Error", "Send failed: $e");
+    }
+  }
+
   Future<void> sendLine(String text) async {
     if (_rxCharacteristic == null || !_connected) return;
 
@@ -243,11 +409,17 @@ class BleService {
     _scanSubscription?.cancel();
     _connectionSubscription?.cancel();
     _notificationSubscription?.cancel();
+    _telemetrySubscription?.cancel();
     _isScanning.close();
     _isConnected.close();
     _deviceName.close();
     _logMessages.close();
     _responses.close();
+    _telemetry.close();
+  }
+
+  Future<void> setAckMode(AckMode mode, {int intervalMs = 100}) async {
+    await sendBytes([ExtendedCommands.setAckMode, mode.value, intervalMs & 0xFF, (intervalMs >> 8) & 0xFF]);
   }
 
   // ============================================================================
@@ -299,4 +471,156 @@ class BleService {
   Future<void> getDeviceInfo() async {
     await sendBytes([ExtendedCommands.getInfo]);
   }
+
+  // Heap headroom and task stack high-water marks, replies "MEM:..." and "STACK:..."
+  Future<void> getMemoryReport() async {
+    await sendBytes([ExtendedCommands.getMemory]);
+  }
+
+  // Negotiated interval / latency / MTU / data length, reply "CONN:..."
+  Future<void> getConnParams() async {
+    await sendBytes([ExtendedCommands.connParams]);
+  }
+
+  // Drive watchdog: the robot holds the last command for holdMs, then
+  // decelerates to a stop over decelMs. Reply "WDOG:..."
+  Future<void> setWatchdog({int holdMs = 500, int decelMs = 300}) async {
+    await sendBytes([
+      ExtendedCommands.watchdog,
+      holdMs & 0xFF, (holdMs >> 8) & 0xFF,
+      decelMs & 0xFF, (decelMs >> 8) & 0xFF,
+    ]);
+  }
+
+  // OTA download tuning for the next update: HTTP receive buffer (512-16384),
+  // flash write chunk (1024-16384, 1 KB steps) and progress rate limit
+  Future<void> setOtaPipeline({int httpBufferSize = 4096, int chunkSize = 4096, int progressMs = 1000}) async {
+    await sendBytes([
+      ExtendedCommands.otaPipeline,
+      httpBufferSize & 0xFF, (httpBufferSize >> 8) & 0xFF,
+      chunkSize & 0xFF, (chunkSize >> 8) & 0xFF,
+      progressMs & 0xFF, (progressMs >> 8) & 0xFF,
+    ]);
+  }
+
+  // Stream telemetry frames at hz (1-50), 0 stops. Frames are dropped on
+  // congestion; gaps in TelemetryFrame.seq show how many
+  Future<void> setTelemetryRate(int hz) async {
+    if (_deviceId == null || !_connected) return;
+
+    if (hz > 0 && _telemetrySubscription == null) {
+      final characteristic = QualifiedCharacteristic(
+        serviceId: uartServiceUuid,
+        characteristicId: telemetryUuid,
+        deviceId: _deviceId!,
+      );
+      _telemetrySubscription = _ble.subscribeToCharacteristic(characteristic).listen((data) {
+        final frame = TelemetryFrame.decode(data);
+        if (frame != null) _telemetry.add(frame);
+      }, onError: (e) {
+        _addLog("Error", "Telemetry error: $e");
+      });
+    }
+
+    await sendBytes([ExtendedCommands.telemetry, hz.clamp(0, 50)]);
+
+    if (hz == 0) {
+      await _telemetrySubscription?.cancel();
+      _telemetrySubscription = null;
+    }
+  }
+
+  // Push a firmware image (.bin or .zota) over BLE, no WiFi needed.
+  // Packets go out without response under the window the robot grants;
+  // its acks follow what has reached flash. onProgress gets 0.0-1.0 of
+  // acknowledged bytes. The result arrives as "OTA:" responses
+  Future<void> pushFirmware(Uint8List image, {void Function(double)? onProgress}) async {
+    if (_deviceId == null || !_connected) {
+      throw StateError('Not connected');
+    }
+
+    final otaCharacteristic = QualifiedCharacteristic(
+      serviceId: uartServiceUuid,
+      characteristicId: uartOtaUuid,
+      deviceId: _deviceId!,
+    );
+
+    // Packet numbers are absolute here, the wire carries the low 16 bits
+    var acked = 0;
+    var next = 0;
+    var lastProgress = DateTime.now();
+    var wake = Completer<void>();
+
+    final notifications = _ble.subscribeToCharacteristic(otaCharacteristic).listen((data) {
+      if (data.length < 3) return;
+      final seq = data[1] | (data[2] << 8);
+      final packet = acked + ((seq - acked) & 0xFFFF);
+      if (data[0] == BleOta.ack && packet > acked) {
+        acked = packet;
+        if (next < acked) next = acked;
+        lastProgress = DateTime.now();
+      } else if (data[0] == BleOta.nack) {
+        next = packet;
+      }
+      if (!wake.isCompleted) wake.complete();
+    });
+
+    try {
+      final size = image.length;
+      final reply = responses.firstWhere((r) => r.startsWith('BOTA:')).timeout(const Duration(seconds: 10));
+      await sendBytes([
+        ExtendedCommands.bleOta, BleOta.begin,
+        size & 0xFF, (size >> 8) & 0xFF, (size >> 16) & 0xFF, (size >> 24) & 0xFF,
+      ]);
+
+      // BOTA:READY:<window>:<max payload>
+      final parts = (await reply).split(':');
+      if (parts.length < 4 || parts[1] != 'READY') {
+        throw Exception(parts.sublist(1).join(':'));
+      }
+      final window = int.parse(parts[2]);
+      final payload = int.parse(parts[3]);
+      if (payload <= 0) {
+        throw Exception('MTU too small');
+      }
+      final packets = (size + payload - 1) ~/ payload;
+      _addLog("OTA", "Sending $size bytes in $packets packets, window $window");
+
+      while (acked < packets) {
+        if (!_connected) {
+          throw StateError('Disconnected');
+        }
+        if (next < packets && next - acked < window) {
+          final start = next * payload;
+          final seq = next & 0xFFFF;
+          await _ble.writeCharacteristicWithoutResponse(otaCharacteristic, value: [
+            seq & 0xFF, seq >> 8, ...image.sublist(start, min(start + payload, size)),
+          ]);
+          next++;
+          continue;
+        }
+
+        // Window full - wait for an ack, rewind if none comes
+        wake = Completer<void>();
+        final before = acked;
+        await wake.future.timeout(BleOta.ackTimeout, onTimeout: () {});
+        if (acked == before && next > acked && DateTime.now().difference(lastProgress) >= BleOta.ackTimeout) {
+          next = acked;
+        }
+        if (DateTime.now().difference(lastProgress) > BleOta.stallTimeout) {
+          throw TimeoutException('No progress');
+        }
+        onProgress?.call(min(acked * payload, size) / size);
+      }
+
+      onProgress?.call(1.0);
+      await sendBytes([ExtendedCommands.bleOta, BleOta.end]);
+    } catch (e) {
+      _addLog("Error", "BLE OTA failed: $e");
+      await sendBytes([ExtendedCommands.bleOta, BleOta.abort]);
+      rethrow;
+    } finally {
+      await notifications.cancel();
+    }
+  }
 }
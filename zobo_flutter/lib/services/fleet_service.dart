@@ -0,0 +1,353 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:math';
+import 'dart:typed_data';
+import 'package:flutter_reactive_ble/flutter_reactive_ble.dart';
+import 'ble_service.dart';
+
+// Fleet sub commands, see zobo_esp32/main/fleet.h
+class FleetCommands {
+  static const int time = 0x01;        // + u32 controller ms, replies FLEET:T:
+  static const int offset = 0x02;      // + i32 robot ms - controller ms
+  static const int resetStats = 0x04;
+
+  static const int groupAll = 0;
+}
+
+// One robot of the fleet as shown in the UI
+class FleetRobot {
+  final String id;
+  final String name;
+  final bool connected;
+  final int? offsetMs;   // Robot ms - controller ms, null until synced
+  final int? rttMs;      // Best round trip of the last sync
+  final String? status;  // Last FLEET: status line
+
+  const FleetRobot(this.id, this.name,
+      {this.connected = false, this.offsetMs, this.rttMs, this.status});
+
+  bool get synced => offsetMs != null;
+}
+
+class _RobotLink {
+  final String id;
+  final String name;
+  StreamSubscription? connection;
+  StreamSubscription? notifications;
+  QualifiedCharacteristic? rx;
+  bool connected = false;
+  int frameSeq = 0;
+  int? offsetMs;
+  int? rttMs;
+  String? status;
+  Completer<String>? timeReply;
+
+  _RobotLink(this.id, this.name);
+
+  FleetRobot get snapshot => FleetRobot(id, name,
+      connected: connected, offsetMs: offsetMs, rttMs: rttMs, status: status);
+}
+
+// Drives several robots in step: one link per robot, each synced to this
+// controller's clock, and every drive sent as a group frame stamped with
+// an apply time far enough ahead for the slowest link. The robots then
+// act on the same instant whatever order the writes arrive in.
+//
+// The original ESP32 only does BLE 4.2, so there is no extended or
+// periodic advertising to broadcast on; the phone stays central to all
+// robots instead, each robot still sees a single connection.
+class FleetService {
+  static const int maxRobots = 7;              // Usual Android connection limit
+  static const int syncSamples = 8;
+  static const int minLeadMs = 40;
+  static const int maxLeadMs = 500;            // Well under FLEET_MAX_LEAD_MS
+  static const Duration resyncPeriod = Duration(seconds: 20);
+
+  final FlutterReactiveBle _ble = FlutterReactiveBle();
+  final Stopwatch _clock = Stopwatch()..start();
+  final Map<String, _RobotLink> _links = {};
+
+  StreamSubscription? _scanSubscription;
+  Timer? _resyncTimer;
+  bool _scanning = false;
+  bool _syncing = false;
+
+  final _robots = StreamController<List<FleetRobot>>.broadcast();
+  final _isScanning = StreamController<bool>.broadcast();
+  final _logMessages = StreamController<String>.broadcast();
+
+  Stream<List<FleetRobot>> get robots => _robots.stream;
+  Stream<bool> get isScanning => _isScanning.stream;
+  Stream<String> get logMessages => _logMessages.stream;
+
+  List<FleetRobot> get currentRobots => _links.values.map((l) => l.snapshot).toList();
+
+  // Controller clock the robots sync to, wraps like the robots' u32 ms
+  int get nowMs => _clock.elapsedMilliseconds & 0xFFFFFFFF;
+
+  // Apply-time lead: half the slowest synced round trip plus a margin for
+  // connection-interval jitter and the robot's control tick
+  int get leadMs {
+    final rtts = _links.values.where((l) => l.connected && l.rttMs != null).map((l) => l.rttMs!);
+    if (rtts.isEmpty) return minLeadMs;
+    return (rtts.reduce(max) ~/ 2 + 30).clamp(minLeadMs, maxLeadMs);
+  }
+
+  // Connect to every Zobo seen during the scan window
+  Future<void> startScan({Duration duration = const Duration(seconds: 8)}) async {
+    if (_scanning) return;
+
+    _scanning = true;
+    _isScanning.add(true);
+    _addLog("Scan", "Scanning for fleet...");
+
+    _scanSubscription = _ble.scanForDevices(
+      withServices: [],
+      scanMode: ScanMode.lowLatency,
+    ).listen((device) {
+      final name = device.name;
+      if (!name.toLowerCase().contains(BleService.deviceName.toLowerCase())) return;
+      if (_links.containsKey(device.id) || _links.length >= maxRobots) return;
+
+      _addLog("Found", "Robot '$name' (${device.id})");
+      final link = _RobotLink(device.id, name);
+      _links[device.id] = link;
+      _connect(link);
+      _publish();
+    }, onError: (e) {
+      _addLog("Error", "Scan error: $e");
+      stopScan();
+    });
+
+    Future.delayed(duration, () {
+      if (_scanning) stopScan();
+    });
+  }
+
+  Future<void> stopScan() async {
+    _scanSubscription?.cancel();
+    _scanSubscription = null;
+    _scanning = false;
+    _isScanning.add(false);
+  }
+
+  void _connect(_RobotLink link) {
+    link.connection = _ble.connectToDevice(
+      id: link.id,
+      connectionTimeout: const Duration(seconds: 10),
+    ).listen((state) async {
+      if (state.connectionState == DeviceConnectionState.connected) {
+        await _setupLink(link);
+      } else if (state.connectionState == DeviceConnectionState.disconnected) {
+        link.notifications?.cancel();
+        link.connected = false;
+        link.rx = null;
+        link.offsetMs = null;
+        _addLog("Disconnected", link.name);
+        _publish();
+      }
+    }, onError: (e) {
+      _addLog("Error", "${link.name}: connection error: $e");
+      link.connected = false;
+      _publish();
+    });
+  }
+
+  Future<void> _setupLink(_RobotLink link) async {
+    try {
+      try {
+        await _ble.requestMtu(deviceId: link.id, mtu: 512);
+      } catch (_) {
+        // Group frames fit the default MTU
+      }
+
+      link.rx = QualifiedCharacteristic(
+        serviceId: BleService.uartServiceUuid,
+        characteristicId: BleService.uartRxUuid,
+        deviceId: link.id,
+      );
+      final tx = QualifiedCharacteristic(
+        serviceId: BleService.uartServiceUuid,
+        characteristicId: BleService.uartTxUuid,
+        deviceId: link.id,
+      );
+
+      link.notifications = _ble.subscribeToCharacteristic(tx).listen((data) {
+        for (final text in utf8.decode(data).split('\n')) {
+          if (text.isEmpty) continue;
+          _handleResponse(link, text);
+        }
+      }, onError: (e) {
+        _addLog("Error", "${link.name}: notification error: $e");
+      });
+
+      link.connected = true;
+      _addLog("Connected", link.name);
+      _publish();
+
+      await _syncLink(link);
+      _startResync();
+    } catch (e) {
+      _addLog("Error", "${link.name}: setup failed: $e");
+    }
+  }
+
+  void _handleResponse(_RobotLink link, String text) {
+    if (text.startsWith("FLEET:T:")) {
+      final pending = link.timeReply;
+      if (pending != null && !pending.isCompleted) pending.complete(text);
+    } else if (text.startsWith("FLEET:")) {
+      link.status = text;
+      _publish();
+    }
+  }
+
+  // Four-timestamp sync with the robot as the passive side: keep the
+  // sample with the lowest round trip, it has the least asymmetry
+  Future<void> _syncLink(_RobotLink link) async {
+    int? bestRtt;
+    int? bestOffset;
+
+    for (int i = 0; i < syncSamples && link.connected; i++) {
+      final t0 = nowMs;
+      final reply = Completer<String>();
+      link.timeReply = reply;
+      try {
+        await _write(link, [ExtendedCommands.fleet, FleetCommands.time, ..._u32(t0)], withResponse: false);
+        final text = await reply.future.timeout(const Duration(milliseconds: 500));
+        final t2 = nowMs;
+
+        final parts = text.split(':');
+        if (parts.length != 4 || int.tryParse(parts[2]) != t0) continue;
+        final robotMs = int.parse(parts[3]);
+        final rtt = (t2 - t0) & 0xFFFFFFFF;
+        if (bestRtt == null || rtt < bestRtt) {
+          bestRtt = rtt;
+          bestOffset = ((robotMs - (t0 + rtt ~/ 2)) & 0xFFFFFFFF).toSigned(32);
+        }
+      } on TimeoutException {
+        // Lost sample, try the next one
+      } finally {
+        link.timeReply = null;
+      }
+    }
+
+    if (bestOffset == null) {
+      _addLog("Sync", "${link.name}: no replies");
+      return;
+    }
+
+    final offset = ByteData(4)..setInt32(0, bestOffset, Endian.little);
+    await _write(link, [ExtendedCommands.fleet, FleetCommands.offset, ...offset.buffer.asUint8List()]);
+    link.offsetMs = bestOffset;
+    link.rttMs = bestRtt;
+    _addLog("Sync", "${link.name}: offset $bestOffset ms, rtt $bestRtt ms");
+    _publish();
+  }
+
+  // Robots expire a sync after FLEET_SYNC_MAX_AGE_MS, refresh well before
+  void _startResync() {
+    _resyncTimer ??= Timer.periodic(resyncPeriod, (_) => syncAll());
+  }
+
+  Future<void> syncAll() async {
+    if (_syncing) return;
+    _syncing = true;
+    try {
+      for (final link in _links.values.where((l) => l.connected).toList()) {
+        await _syncLink(link);
+      }
+    } finally {
+      _syncing = false;
+    }
+  }
+
+  // Same setpoint for every robot in the group, applied at one instant
+  Future<void> sendGroupDrive(int left, int right, {int group = FleetCommands.groupAll}) async {
+    await sendGroupSetpoints([MotorSetpoint(left, right)], group: group);
+  }
+
+  Future<void> sendGroupSetpoints(List<MotorSetpoint> setpoints,
+      {int group = FleetCommands.groupAll, int intervalMs = 0}) async {
+    if (setpoints.isEmpty) return;
+
+    final applyAt = (nowMs + leadMs) & 0xFFFFFFFF;
+    final writes = <Future<void>>[];
+    for (final link in _links.values) {
+      if (!link.connected || link.rx == null) continue;
+      final frame = MotorFrame.encode(setpoints, link.frameSeq,
+          intervalMs: intervalMs, group: group, applyAtMs: applyAt);
+      link.frameSeq = (link.frameSeq + 1) & 0xFFFF;
+      writes.add(_write(link, frame, withResponse: false));
+    }
+    await Future.wait(writes);
+  }
+
+  Future<void> stopAll() async {
+    await sendGroupDrive(0, 0);
+  }
+
+  Future<void> setGroup(String robotId, int group) async {
+    final link = _links[robotId];
+    if (link == null) return;
+    // Own opcode, the robot stores it in flash off its drive path
+    await _write(link, [ExtendedCommands.fleetGroup, group & 0xFF]);
+  }
+
+  Future<void> requestStatus() async {
+    for (final link in _links.values.where((l) => l.connected)) {
+      await _write(link, [ExtendedCommands.fleet]);
+    }
+  }
+
+  Future<void> _write(_RobotLink link, List<int> bytes, {bool withResponse = true}) async {
+    final rx = link.rx;
+    if (rx == null || !link.connected) return;
+
+    try {
+      if (withResponse) {
+        await _ble.writeCharacteristicWithResponse(rx, value: bytes);
+      } else {
+        await _ble.writeCharacteristicWithoutResponse(rx, value: bytes);
+      }
+    } catch (e) {
+      _addLog("Error", "${link.name}: send failed: $e");
+    }
+  }
+
+  static List<int> _u32(int value) =>
+      [value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF];
+
+  Future<void> disconnectAll() async {
+    _resyncTimer?.cancel();
+    _resyncTimer = null;
+    for (final link in _links.values) {
+      link.notifications?.cancel();
+      link.connection?.cancel();
+    }
+    _links.clear();
+    _publish();
+  }
+
+  void _publish() {
+    _robots.add(currentRobots);
+  }
+
+  void _addLog(String tag, String message) {
+    final time = DateTime.now();
+    final timeStr = "${time.hour.toString().padLeft(2, '0')}:${time.minute.toString().padLeft(2, '0')}:${time.second.toString().padLeft(2, '0')}.${time.millisecond.toString().padLeft(3, '0')}";
+    _logMessages.add("[$timeStr] $tag: $message");
+  }
+
+  void dispose() {
+    _scanSubscription?.cancel();
+    _resyncTimer?.cancel();
+    for (final link in _links.values) {
+      link.notifications?.cancel();
+      link.connection?.cancel();
+    }
+    _robots.close();
+    _isScanning.close();
+    _logMessages.close();
+  }
+}
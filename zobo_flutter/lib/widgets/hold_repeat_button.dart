@@ -16,7 +16,7 @@ class HoldRepeatButton extends StatefulWidget {
     required this.text,
     this.icon,
     required this.enabled,
-    this.repeatMs = 100,
+    this.repeatMs = 200,
     required this.onRepeat,
     this.onRelease,
     this.width,